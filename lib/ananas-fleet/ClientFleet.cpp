@@ -0,0 +1,174 @@
+#include "ClientFleet.h"
+#include <ServerUtils.h>
+
+namespace ananas
+{
+    ClientFleet::ClientFleet(const FleetParams &params)
+        : params(params),
+          random(params.seed),
+          clients(static_cast<size_t>(juce::jmax(0, params.numClients))),
+          authorities(static_cast<size_t>(juce::jmax(0, params.numAuthorities)))
+    {
+        const auto bipolar{[this] { return random.nextDouble() * 2. - 1.; }};
+
+        for (size_t i{0}; i < clients.size(); ++i) {
+            auto &c{clients[i]};
+            c.intervalNs = static_cast<double>(Server::Constants::NSPS) / params.announceRateHz;
+            c.offsetNs = static_cast<double>(Server::Constants::PacketOffsetNs) + 1000. * bipolar();
+            c.driftNsPerS = params.offsetDriftNsPerS * bipolar();
+            c.bufferFill = 50. + 10. * bipolar();
+
+            auto &p{c.packet};
+            p.serial = 1'000'000 + static_cast<juce::uint32>(i);
+            p.firmwareType = pickFirmwareType();
+            p.firmwareVersion = params.firmwareVersion;
+            p.samplingRate = static_cast<float>(params.sampleRate * (1. + params.sampleRateErrorPpm * 1e-6 * bipolar()));
+            p.percentCPU = static_cast<float>(25. + 10. * bipolar());
+
+            if (p.firmwareType == Utils::FirmwareType::wfsModule) {
+                // Somewhere in the room.
+                p.secondarySource0x = random.nextFloat();
+                p.secondarySource0y = random.nextFloat();
+                p.secondarySource1x = random.nextFloat();
+                p.secondarySource1y = random.nextFloat();
+            }
+        }
+
+        for (size_t i{0}; i < authorities.size(); ++i) {
+            auto &a{authorities[i]};
+            a.intervalNs = static_cast<double>(Server::Constants::NSPS) / params.authorityRateHz;
+            a.packet.serial = 2'000'000 + static_cast<juce::uint32>(i);
+            a.packet.usbFeedbackAccumulator = Utils::Constants::AuthorityInitialUSBFeedbackAccumulator;
+        }
+    }
+
+    int ClientFleet::advance(const int64_t nowNs, const Sink &sink)
+    {
+        if (!started) {
+            // Spread the first announcements over one interval, as a fleet
+            // that has been running a while would be.
+            started = true;
+            const auto lockedAtNs{nowNs - static_cast<int64_t>(params.ptpLockDelayS * Server::Constants::NSPS)};
+
+            for (size_t i{0}; i < clients.size(); ++i) {
+                clients[i].connectedAtNs = lockedAtNs;
+                schedule.push({nowNs + static_cast<int64_t>(random.nextDouble() * clients[i].intervalNs), Source::client, static_cast<int>(i)});
+            }
+            for (size_t i{0}; i < authorities.size(); ++i) {
+                schedule.push({nowNs + static_cast<int64_t>(random.nextDouble() * authorities[i].intervalNs), Source::authority, static_cast<int>(i)});
+            }
+
+            numConnected = static_cast<int>(clients.size());
+        }
+
+        auto numEmitted{0};
+
+        // Everything happens at its scheduled time, whatever the granularity
+        // of the calls to advance(); the same seed gives the same fleet.
+        while (!schedule.empty() && schedule.top().timeNs <= nowNs) {
+            const auto due{schedule.top()};
+            schedule.pop();
+
+            if (due.source == Source::authority) {
+                auto &a{authorities[static_cast<size_t>(due.index)]};
+                updateAuthority(a);
+                sink(due.source, due.index, &a.packet, sizeof(AuthorityAnnouncePacket));
+                schedule.push({due.timeNs + jitter(a.intervalNs), due.source, due.index});
+                ++numEmitted;
+                continue;
+            }
+
+            auto &c{clients[static_cast<size_t>(due.index)]};
+
+            if (!c.connected) {
+                c.connected = true;
+                c.connectedAtNs = due.timeNs;
+                ++numConnected;
+            }
+
+            const auto nextNs{updateClient(c, due.timeNs)};
+            if (c.connected) {
+                sink(due.source, due.index, &c.packet, sizeof(ClientAnnouncePacket));
+                ++numEmitted;
+            }
+            schedule.push({nextNs, due.source, due.index});
+        }
+
+        return numEmitted;
+    }
+
+    int64_t ClientFleet::getNextDueNs() const
+    {
+        return schedule.empty() ? std::numeric_limits<int64_t>::max() : schedule.top().timeNs;
+    }
+
+    int ClientFleet::getNumConnected() const
+    {
+        return numConnected;
+    }
+
+    int ClientFleet::getNumDisconnections() const
+    {
+        return numDisconnections;
+    }
+
+    Utils::FirmwareType ClientFleet::pickFirmwareType()
+    {
+        auto total{0.};
+        for (const auto &[type, weight]: params.firmwareMix) {
+            total += juce::jmax(0., weight);
+        }
+
+        auto x{random.nextDouble() * total};
+        for (const auto &[type, weight]: params.firmwareMix) {
+            x -= juce::jmax(0., weight);
+            if (x < 0.) return type;
+        }
+
+        return Utils::FirmwareType::client;
+    }
+
+    int64_t ClientFleet::jitter(const double intervalNs)
+    {
+        return static_cast<int64_t>(intervalNs * (1. + params.announceJitter * (random.nextDouble() * 2. - 1.)));
+    }
+
+    int64_t ClientFleet::updateClient(VirtualClient &client, const int64_t nowNs)
+    {
+        const auto intervalS{client.intervalNs / static_cast<double>(Server::Constants::NSPS)};
+
+        // Maybe drop off the network for a while.
+        if (random.nextDouble() < params.churnPerMinute * intervalS / 60.) {
+            client.connected = false;
+            --numConnected;
+            ++numDisconnections;
+            const auto downtimeS{-std::log(1. - random.nextDouble()) * params.meanDowntimeS};
+            return nowNs + static_cast<int64_t>(downtimeS * static_cast<double>(Server::Constants::NSPS));
+        }
+
+        client.offsetNs += client.driftNsPerS * intervalS;
+        client.bufferFill += params.bufferFillStepPercent * (random.nextDouble() * 2. - 1.) + .05 * (50. - client.bufferFill);
+        client.bufferFill = juce::jlimit(0., 100., client.bufferFill);
+
+        auto &p{client.packet};
+        p.presentationOffsetNs = static_cast<juce::int64>(client.offsetNs);
+        p.presentationOffsetFrame = static_cast<juce::int32>(client.offsetNs * params.sampleRate / static_cast<double>(Server::Constants::NSPS));
+        p.audioPTPOffsetNs = static_cast<juce::int32>(500. * (random.nextDouble() * 2. - 1.));
+        p.bufferFillPercent = static_cast<juce::uint8>(std::lround(client.bufferFill));
+        p.percentCPU = juce::jlimit(0.f, 100.f, p.percentCPU + static_cast<float>(random.nextDouble() * 2. - 1.));
+        p.ptpLock = static_cast<double>(nowNs - client.connectedAtNs) >= params.ptpLockDelayS * static_cast<double>(Server::Constants::NSPS);
+
+        return nowNs + jitter(client.intervalNs);
+    }
+
+    void ClientFleet::updateAuthority(VirtualAuthority &authority)
+    {
+        // The USB feedback accumulator hovers around nominal; the odd
+        // underrun or overflow.
+        auto &p{authority.packet};
+        p.usbFeedbackAccumulator = static_cast<juce::uint32>(Utils::Constants::AuthorityInitialUSBFeedbackAccumulator
+                                                             + random.nextInt(8193) - 4096);
+        if (random.nextDouble() < .01) ++p.numUnderruns;
+        if (random.nextDouble() < .01) ++p.numOverflows;
+    }
+}
@@ -0,0 +1,160 @@
+#ifndef ANANASCLIENTFLEET_H
+#define ANANASCLIENTFLEET_H
+
+#include <juce_core/juce_core.h>
+#include <Packet.h>
+#include <queue>
+
+namespace ananas
+{
+    struct FleetParams
+    {
+        int numClients{100};
+        int numAuthorities{1};
+
+        /**
+         * Mean announcements per second, per client; each client's interval
+         * varies by up to +/- announceJitter of the mean.
+         */
+        double announceRateHz{1.};
+        double announceJitter{.1};
+        double authorityRateHz{1.};
+
+        /**
+         * Relative weights of each firmware type across the fleet.
+         */
+        std::vector<std::pair<Utils::FirmwareType, double>> firmwareMix{{Utils::FirmwareType::client, 1.}};
+        Utils::VersionNumber firmwareVersion{0, 4, 0};
+
+        double sampleRate{48000.};
+        /**
+         * Clients' reported sampling rates deviate from nominal by up to
+         * this many parts per million.
+         */
+        double sampleRateErrorPpm{20.};
+        /**
+         * Each client's presentation offset drifts at up to this rate.
+         */
+        double offsetDriftNsPerS{200.};
+        /**
+         * Largest step, per announcement, of each client's buffer fill
+         * random walk, in percent; the walk reverts to 50%.
+         */
+        double bufferFillStepPercent{3.};
+
+        /**
+         * Per-client probability of disconnecting in any given minute, and
+         * the mean time until it reconnects.
+         */
+        double churnPerMinute{0.};
+        double meanDowntimeS{5.};
+        /**
+         * How long a (re)connected client reports that it hasn't locked to
+         * PTP.
+         */
+        double ptpLockDelayS{2.};
+
+        juce::int64 seed{1};
+    };
+
+    /**
+     * A population of virtual clients (and time authorities), producing the
+     * announcements each would send, for load-testing everything that
+     * consumes them: ClientList, ModuleList, AuthorityInfo and the UI.
+     *
+     * The fleet only generates packets, at whatever times advance() is
+     * given; the caller decides how to deliver them, e.g. from one source
+     * address per client via a socket (see ananas_fleet), or straight into
+     * a ClientList in a test.
+     */
+    class ClientFleet
+    {
+    public:
+        enum class Source : uint8_t
+        {
+            client,
+            authority
+        };
+
+        /**
+         * @param index Which client, or which authority; a stable identity,
+         * e.g. for choosing a source address.
+         */
+        using Sink = std::function<void(Source source, int index, const void *data, size_t size)>;
+
+        explicit ClientFleet(const FleetParams &params);
+
+        /**
+         * Emit every announcement due at or before the given time, in order.
+         * Start from any time; the first call schedules the fleet's first
+         * announcements across one interval from then.
+         * @return The number of announcements emitted.
+         */
+        int advance(int64_t nowNs, const Sink &sink);
+
+        /**
+         * @return When the next announcement is due.
+         */
+        [[nodiscard]] int64_t getNextDueNs() const;
+
+        [[nodiscard]] int getNumConnected() const;
+
+        [[nodiscard]] int getNumDisconnections() const;
+
+    private:
+        struct VirtualClient
+        {
+            ClientAnnouncePacket packet{};
+            double intervalNs{0.};
+            double offsetNs{0.};
+            double driftNsPerS{0.};
+            double bufferFill{50.};
+            bool connected{true};
+            int64_t connectedAtNs{0};
+        };
+
+        struct VirtualAuthority
+        {
+            AuthorityAnnouncePacket packet{};
+            double intervalNs{0.};
+        };
+
+        struct Due
+        {
+            int64_t timeNs;
+            Source source;
+            int index;
+
+            bool operator>(const Due &other) const { return timeNs > other.timeNs; }
+        };
+
+        const FleetParams params;
+        juce::Random random;
+        std::vector<VirtualClient> clients;
+        std::vector<VirtualAuthority> authorities;
+        std::priority_queue<Due, std::vector<Due>, std::greater<>> schedule;
+        bool started{false};
+        int numConnected{0};
+        int numDisconnections{0};
+
+        Utils::FirmwareType pickFirmwareType();
+
+        /**
+         * @return A time within +/- announceJitter of the given interval.
+         */
+        int64_t jitter(double intervalNs);
+
+        /**
+         * Update a client's state for an announcement at the given time.
+         * @return When its next announcement is due; if it has disconnected,
+         * when it will reconnect.
+         */
+        int64_t updateClient(VirtualClient &client, int64_t nowNs);
+
+        void updateAuthority(VirtualAuthority &authority);
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ClientFleet)
+    };
+}
+
+#endif //ANANASCLIENTFLEET_H
@@ -0,0 +1,183 @@
+#include "AudioStream.h"
+#include "ThreadPolicy.h"
+#include "Trace.h"
+
+namespace ananas
+{
+    AudioStream::AudioStream(const StreamParams &params, Clock &clock)
+        : params(params),
+          fifo(static_cast<uint8_t>(params.numChannels), clock),
+          compressionEnabled(params.compressed),
+          history(Server::Constants::RetransmitHistorySize, getMaxPacketSize(params.numChannels))
+    {
+    }
+
+    const StreamParams &AudioStream::getParams() const
+    {
+        return params;
+    }
+
+    void AudioStream::prepare(const int samplesPerBlockExpected, const double sampleRate)
+    {
+        fifo.prepare(samplesPerBlockExpected, sampleRate, fifoTargetLatencyNs);
+        packet.prepare(params.numChannels, Server::Constants::FramesPerPacket, sampleRate);
+
+        codec.prepare(params.numChannels, Server::Constants::FramesPerPacket);
+        encodedPacket.setSize(sizeof(AudioPacket::Header) + codec.getMaxEncodedSize(), true);
+
+        // In case reading was aborted when last stopped.
+        fifo.resumeRead();
+    }
+
+    void AudioStream::setFifoTargetLatency(const int64_t targetLatencyNs)
+    {
+        fifoTargetLatencyNs = targetLatencyNs;
+    }
+
+    Fifo &AudioStream::getFifo()
+    {
+        return fifo;
+    }
+
+    const Fifo &AudioStream::getFifo() const
+    {
+        return fifo;
+    }
+
+    bool AudioStream::isReady() const
+    {
+        return fifo.isReady(Server::Constants::FramesPerPacket) || fifo.isUnderflowing(Server::Constants::FramesPerPacket);
+    }
+
+    const uint8_t *AudioStream::readPacket(size_t &size, int64_t &writeTimeNs)
+    {
+        // Read from the fifo into the packet.
+        if (!fifo.read(packet.getAudioData(), Server::Constants::FramesPerPacket, &writeTimeNs)) return nullptr;
+
+        // Write the header to the packet.
+        packet.writeHeader();
+
+        if (compressionEnabled.load(std::memory_order_acquire)) {
+            ANANAS_TRACE_SCOPE("AudioStream::encode");
+
+            // Copy the header, then encode the audio after it.
+            auto *dest{static_cast<uint8_t *>(encodedPacket.getData())};
+            memcpy(dest, packet.getData(), sizeof(AudioPacket::Header));
+            size = sizeof(AudioPacket::Header) + codec.encode(packet.getAudioData(), &dest[sizeof(AudioPacket::Header)]);
+            numRawBytes.fetch_add(packet.getSize(), std::memory_order_relaxed);
+            numEncodedBytes.fetch_add(size, std::memory_order_relaxed);
+            numAudioBytes.fetch_add(size, std::memory_order_relaxed);
+            return dest;
+        }
+
+        size = packet.getSize();
+        numAudioBytes.fetch_add(size, std::memory_order_relaxed);
+        return static_cast<const uint8_t *>(packet.getData());
+    }
+
+    const uint8_t *AudioStream::getPacketAudio()
+    {
+        return packet.getAudioData();
+    }
+
+    size_t AudioStream::getPacketAudioSize() const
+    {
+        return params.numChannels * Server::Constants::FramesPerPacket * sizeof(int16_t);
+    }
+
+    bool AudioStream::setTime(const timespec ts, int64_t &diffNs)
+    {
+        return packet.setTime(ts, diffNs);
+    }
+
+    int64_t AudioStream::getTime() const
+    {
+        return packet.getTime();
+    }
+
+    long AudioStream::getSleepInterval() const
+    {
+        return packet.getSleepInterval();
+    }
+
+    void AudioStream::setCompressionEnabled(const bool shouldCompress)
+    {
+        compressionEnabled.store(shouldCompress, std::memory_order_release);
+    }
+
+    void AudioStream::setFecParams(const int numDataPackets, const int numParityPackets)
+    {
+        const auto k{juce::jlimit(0, static_cast<int>(Server::Constants::MaxFecGroupSize), numDataPackets)};
+        const auto m{k > 0 ? juce::jlimit(1, k, numParityPackets) : 0};
+        fecParams.store(static_cast<uint16_t>(k << 8 | m), std::memory_order_release);
+    }
+
+    bool AudioStream::isFecEnabled() const
+    {
+        return fecParams.load(std::memory_order_acquire) != 0;
+    }
+
+    const FecEncoder *AudioStream::addToFecGroup(const uint8_t *data, const size_t size)
+    {
+        // Pick up new FEC parameters; this starts a new group.
+        if (const auto p{fecParams.load(std::memory_order_acquire)}; p != activeFecParams) {
+            activeFecParams = p;
+            fec.prepare(p >> 8, p & 0xff, getMaxPacketSize(params.numChannels));
+        }
+
+        return fec.addPacket(data, size) ? &fec : nullptr;
+    }
+
+    void AudioStream::addParityBytesSent(const size_t numBytes)
+    {
+        numParityBytes.fetch_add(numBytes, std::memory_order_relaxed);
+    }
+
+    PacketHistory &AudioStream::getHistory()
+    {
+        return history;
+    }
+
+    juce::SpinLock &AudioStream::getSendLock()
+    {
+        return sendLock;
+    }
+
+    size_t AudioStream::lockMemory()
+    {
+        auto numLocked{fifo.lockMemory() + history.lockMemory()};
+
+        for (auto *block: {static_cast<juce::MemoryBlock *>(&packet), &encodedPacket}) {
+            if (ananas::lockMemory(block->getData(), block->getSize())) {
+                numLocked += block->getSize();
+            }
+        }
+
+        return numLocked;
+    }
+
+    uint64_t AudioStream::getNumRawBytes() const
+    {
+        return numRawBytes.load(std::memory_order_relaxed);
+    }
+
+    uint64_t AudioStream::getNumEncodedBytes() const
+    {
+        return numEncodedBytes.load(std::memory_order_relaxed);
+    }
+
+    uint64_t AudioStream::getNumAudioBytes() const
+    {
+        return numAudioBytes.load(std::memory_order_relaxed);
+    }
+
+    uint64_t AudioStream::getNumParityBytes() const
+    {
+        return numParityBytes.load(std::memory_order_relaxed);
+    }
+
+    size_t AudioStream::getMaxPacketSize(const uint numChannels)
+    {
+        return sizeof(AudioPacket::Header) + 1 + numChannels * Server::Constants::FramesPerPacket * sizeof(int16_t);
+    }
+}
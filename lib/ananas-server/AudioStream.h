@@ -0,0 +1,155 @@
+#ifndef ANANASAUDIOSTREAM_H
+#define ANANASAUDIOSTREAM_H
+
+#include <juce_core/juce_core.h>
+#include "Fifo.h"
+#include "Packet.h"
+#include "Codec.h"
+#include "Fec.h"
+#include "PacketHistory.h"
+
+namespace ananas
+{
+    struct StreamParams
+    {
+        juce::String name;
+        uint numChannels{0};
+        juce::String ip;
+        juce::uint16 port{0};
+        bool compressed{false};
+    };
+
+    /**
+     * One outgoing multicast audio stream: its FIFO, the packet being
+     * assembled, and the per-stream codec, FEC and retransmission state.
+     * Written to by the audio thread (via the FIFO), packetized by the
+     * server's audio sender or, in inline mode, by the audio thread itself;
+     * whichever does so holds the send lock.
+     */
+    class AudioStream
+    {
+    public:
+        /**
+         * @param clock For the FIFO; see Fifo::Fifo().
+         */
+        explicit AudioStream(const StreamParams &params, Clock &clock = Clock::getSystem());
+
+        [[nodiscard]] const StreamParams &getParams() const;
+
+        /**
+         * Size the FIFO (see Fifo::prepare()) and the packet buffers.
+         */
+        void prepare(int samplesPerBlockExpected, double sampleRate);
+
+        /**
+         * Set the FIFO's target latency, from the next prepare().
+         */
+        void setFifoTargetLatency(int64_t targetLatencyNs);
+
+        Fifo &getFifo();
+
+        [[nodiscard]] const Fifo &getFifo() const;
+
+        /**
+         * @return true if there's a packet's worth of audio in the FIFO, or
+         * a packet's worth of silence is due; see Fifo::UnderflowPolicy.
+         */
+        [[nodiscard]] bool isReady() const;
+
+        /**
+         * Read a packet's worth of audio from the FIFO, write the header and,
+         * if the stream is compressed, encode it.
+         * @param size Set to the size of the packet.
+         * @param writeTimeNs Set to the time, on the stream's Clock, at which
+         * the packet's first frame was written to the FIFO.
+         * @return The serialized packet, or nullptr if the read was aborted.
+         */
+        const uint8_t *readPacket(size_t &size, int64_t &writeTimeNs);
+
+        /**
+         * @return The audio of the packet last read, as interleaved
+         * little-endian int16, whether or not it was then encoded.
+         */
+        const uint8_t *getPacketAudio();
+
+        [[nodiscard]] size_t getPacketAudioSize() const;
+
+        /**
+         * See AudioPacket::setTime().
+         */
+        bool setTime(timespec ts, int64_t &diffNs);
+
+        [[nodiscard]] int64_t getTime() const;
+
+        [[nodiscard]] long getSleepInterval() const;
+
+        void setCompressionEnabled(bool shouldCompress);
+
+        void setFecParams(int numDataPackets, int numParityPackets);
+
+        [[nodiscard]] bool isFecEnabled() const;
+
+        /**
+         * Add a sent packet to the current FEC group.
+         * @return The encoder, if the group is complete and its parity
+         * packets should be sent; otherwise nullptr.
+         */
+        const FecEncoder *addToFecGroup(const uint8_t *data, size_t size);
+
+        void addParityBytesSent(size_t numBytes);
+
+        PacketHistory &getHistory();
+
+        /**
+         * Held while packetizing, sending, storing or restamping the stream's
+         * packets, so that the audio thread (in inline mode) and the audio
+         * sender never do so at once. The audio thread only ever tries it.
+         */
+        juce::SpinLock &getSendLock();
+
+        /**
+         * Lock the FIFO, packet buffers and history into RAM. Call after
+         * prepare(), before sending starts.
+         * @return The number of bytes locked.
+         */
+        size_t lockMemory();
+
+        [[nodiscard]] uint64_t getNumRawBytes() const;
+
+        [[nodiscard]] uint64_t getNumEncodedBytes() const;
+
+        [[nodiscard]] uint64_t getNumAudioBytes() const;
+
+        [[nodiscard]] uint64_t getNumParityBytes() const;
+
+        /**
+         * @return Room for a header, the codec mode byte and the audio.
+         */
+        static size_t getMaxPacketSize(uint numChannels);
+
+    private:
+        StreamParams params;
+        Fifo fifo;
+        int64_t fifoTargetLatencyNs{Server::Constants::DefaultFifoTargetLatencyNs};
+        AudioPacket packet{};
+        AudioCodec codec;
+        juce::MemoryBlock encodedPacket;
+        std::atomic<bool> compressionEnabled{false};
+        FecEncoder fec;
+        // Group size and parity count, packed as (K << 8) | M, so that
+        // they can be updated together.
+        std::atomic<uint16_t> fecParams{0};
+        uint16_t activeFecParams{0};
+        PacketHistory history;
+        juce::SpinLock sendLock;
+
+        std::atomic<uint64_t> numRawBytes{0};
+        std::atomic<uint64_t> numEncodedBytes{0};
+        std::atomic<uint64_t> numAudioBytes{0};
+        std::atomic<uint64_t> numParityBytes{0};
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioStream)
+    };
+}
+
+#endif //ANANASAUDIOSTREAM_H
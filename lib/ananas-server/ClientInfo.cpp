@@ -1,18 +1,30 @@
 #include "ClientInfo.h"
 #include <AnanasUtils.h>
 #include "ServerUtils.h"
+#include "Logger.h"
 
 namespace ananas
 {
-    void ClientInfo::update(const ClientAnnouncePacket *packet)
+    namespace
     {
-        lastReceiveTime = juce::Time::getMillisecondCounter();
+        bool isWithinDisconnectionThreshold(const std::optional<int64_t> &lastReceiveNs, const int64_t nowNs)
+        {
+            const auto thresholdNs{
+                static_cast<int64_t>(Server::Sockets::ClientListenerSocketParams.disconnectionThresholdMs) * Server::Constants::NSPS / 1000
+            };
+            return lastReceiveNs.has_value() && nowNs - *lastReceiveNs < thresholdNs;
+        }
+    }
+
+    void ClientInfo::update(const ClientAnnouncePacket *packet, const int64_t nowNs)
+    {
+        lastReceiveNs = nowNs;
         info = *packet;
     }
 
-    bool ClientInfo::isConnected() const
+    bool ClientInfo::isConnected(const int64_t nowNs) const
     {
-        return juce::Time::getMillisecondCounter() - lastReceiveTime < Server::Sockets::ClientListenerSocketParams.disconnectionThresholdMs;
+        return isWithinDisconnectionThreshold(lastReceiveNs, nowNs);
     }
 
     ClientAnnouncePacket ClientInfo::getInfo() const
@@ -22,9 +34,9 @@ namespace ananas
 
     //==========================================================================
 
-    void ModuleInfo::update()
+    void ModuleInfo::update(const int64_t nowNs)
     {
-        lastReceiveTime = juce::Time::getMillisecondCounter();
+        lastReceiveNs = nowNs;
     }
 
     juce::ValueTree ModuleInfo::toValueTree() const
@@ -37,14 +49,14 @@ namespace ananas
         return tree;
     }
 
-    bool ModuleInfo::isConnected() const
+    bool ModuleInfo::isConnected(const int64_t nowNs) const
     {
-        return juce::Time::getMillisecondCounter() - lastReceiveTime < Server::Sockets::ClientListenerSocketParams.disconnectionThresholdMs;
+        return isWithinDisconnectionThreshold(lastReceiveNs, nowNs);
     }
 
-    bool ModuleInfo::justDisconnected()
+    bool ModuleInfo::justDisconnected(const int64_t nowNs)
     {
-        const auto didJustDisconnect{!isConnected() && wasConnected};
+        const auto didJustDisconnect{!isConnected(nowNs) && wasConnected};
 
         if (didJustDisconnect) {
             wasConnected = false;
@@ -53,9 +65,9 @@ namespace ananas
         return didJustDisconnect;
     }
 
-    bool ModuleInfo::justConnected()
+    bool ModuleInfo::justConnected(const int64_t nowNs)
     {
-        const auto didJustConnect{isConnected() && !wasConnected};
+        const auto didJustConnect{isConnected(nowNs) && !wasConnected};
 
         if (didJustConnect) {
             wasConnected = true;
@@ -102,20 +114,25 @@ namespace ananas
 
     //==========================================================================
 
-    ClientList::ClientList()
+    ClientList::ClientList(Clock &clock) : ClockTimer(clock)
     {
         startTimer(Server::Constants::ClientConnectednessCheckIntervalMs);
     }
 
+    ClientList::~ClientList()
+    {
+        stopTimer();
+    }
+
     void ClientList::handlePacket(const juce::String &clientIP, const ClientAnnouncePacket *packet)
     {
         auto iter{clients.find(clientIP)};
         if (iter == clients.end()) {
             ClientInfo c{};
             iter = clients.insert(std::make_pair(clientIP, c)).first;
-            std::cout << "Client " << iter->first << " connected." << std::endl;
+            ANANAS_LOG_INFO("Client %s connected.", iter->first.toRawUTF8());
         }
-        iter->second.update(packet);
+        iter->second.update(packet, getClock().now());
 
         sendChangeMessage();
     }
@@ -196,10 +213,11 @@ namespace ananas
 
     void ClientList::checkConnectivity()
     {
+        const auto now{getClock().now()};
         std::vector<juce::String> toErase;
         for (const auto &[ip, c]: clients) {
-            if (!c.isConnected()) {
-                std::cout << "Client " << ip << " disconnected." << std::endl;
+            if (!c.isConnected(now)) {
+                ANANAS_LOG_INFO("Client %s disconnected.", ip.toRawUTF8());
                 toErase.push_back(ip);
             }
         }
@@ -211,22 +229,28 @@ namespace ananas
 
     //==========================================================================
 
-    ModuleList::ModuleList()
+    ModuleList::ModuleList(Clock &clock) : ClockTimer(clock)
     {
         startTimer(Server::Constants::ClientConnectednessCheckIntervalMs);
     }
 
+    ModuleList::~ModuleList()
+    {
+        stopTimer();
+    }
+
     void ModuleList::handlePacket(const juce::String &moduleIP)
     {
         auto iter{modules.find(moduleIP)};
         if (iter == modules.end()) {
             ModuleInfo m{};
             iter = modules.insert(std::make_pair(moduleIP, m)).first;
-            std::cout << "Module " << moduleIP << " available." << std::endl;
+            ANANAS_LOG_INFO("Module %s available.", moduleIP.toRawUTF8());
         }
-        iter->second.update();
-        if (iter->second.justConnected()) {
-            std::cout << "Module " << iter->first << " just connected." << std::endl;
+        const auto now{getClock().now()};
+        iter->second.update(now);
+        if (iter->second.justConnected(now)) {
+            ANANAS_LOG_INFO("Module %s just connected.", iter->first.toRawUTF8());
             sendChangeMessage();
         }
     }
@@ -239,6 +263,7 @@ namespace ananas
     juce::var ModuleList::toVar() const
     {
         const auto object{new juce::DynamicObject()};
+        const auto now{getClock().now()};
 
         for (const auto &[ip, m]: modules) {
             auto *module{new juce::DynamicObject()};
@@ -246,7 +271,7 @@ namespace ananas
             module->setProperty(Utils::Identifiers::ModuleSecondarySource0yPropertyID, static_cast<int>(m.getSecondarySource0Position().second));
             module->setProperty(Utils::Identifiers::ModuleSecondarySource1xPropertyID, static_cast<int>(m.getSecondarySource1Position().first));
             module->setProperty(Utils::Identifiers::ModuleSecondarySource1yPropertyID, static_cast<int>(m.getSecondarySource1Position().second));
-            module->setProperty(Utils::Identifiers::ModuleIsConnectedPropertyID, m.isConnected());
+            module->setProperty(Utils::Identifiers::ModuleIsConnectedPropertyID, m.isConnected(now));
             object->setProperty(ip, module);
         }
 
@@ -279,9 +304,10 @@ namespace ananas
 
     void ModuleList::checkConnectivity()
     {
+        const auto now{getClock().now()};
         for (auto it{modules.begin()}; it != modules.end(); ++it) {
-            if (it->second.justDisconnected()) {
-                std::cout << "Module " << it->first << " just disconnected." << std::endl;
+            if (it->second.justDisconnected(now)) {
+                ANANAS_LOG_INFO("Module %s just disconnected.", it->first.toRawUTF8());
                 sendChangeMessage();
             }
         }
@@ -3,36 +3,41 @@
 
 #include <juce_events/juce_events.h>
 #include <juce_data_structures/juce_data_structures.h>
+#include "Clock.h"
 #include "Packet.h"
+#include <optional>
 
 namespace ananas
 {
     class ClientInfo
     {
     public:
-        void update(const ClientAnnouncePacket *packet);
+        /**
+         * @param nowNs The receive time, per the list's Clock.
+         */
+        void update(const ClientAnnouncePacket *packet, int64_t nowNs);
 
-        [[nodiscard]] bool isConnected() const;
+        [[nodiscard]] bool isConnected(int64_t nowNs) const;
 
         [[nodiscard]] ClientAnnouncePacket getInfo() const;
 
     private:
         ClientAnnouncePacket info{};
-        uint32_t lastReceiveTime{0};
+        std::optional<int64_t> lastReceiveNs;
     };
 
     class ModuleInfo
     {
     public:
-        void update();
+        void update(int64_t nowNs);
 
         [[nodiscard]] juce::ValueTree toValueTree() const;
 
-        [[nodiscard]] bool isConnected() const;
+        [[nodiscard]] bool isConnected(int64_t nowNs) const;
 
-        [[nodiscard]] bool justDisconnected();
+        [[nodiscard]] bool justDisconnected(int64_t nowNs);
 
-        [[nodiscard]] bool justConnected();
+        [[nodiscard]] bool justConnected(int64_t nowNs);
 
         [[nodiscard]] std::pair<float, float> getSecondarySource0Position() const;
 
@@ -41,17 +46,19 @@ namespace ananas
         static ModuleInfo fromValueTree(const juce::ValueTree &tree);
 
     private:
-        juce::uint32 lastReceiveTime{0};
+        std::optional<int64_t> lastReceiveNs;
         bool wasConnected{false};
         std::pair<float, float> secondarySource0Position;
         std::pair<float, float> secondarySource1Position;
     };
 
-    class ClientList final : public juce::Timer,
+    class ClientList final : public ClockTimer,
                              public juce::ChangeBroadcaster
     {
     public:
-        ClientList();
+        explicit ClientList(Clock &clock = Clock::getSystem());
+
+        ~ClientList() override;
 
         void handlePacket(const juce::String &clientIP, const ClientAnnouncePacket *packet);
 
@@ -75,10 +82,12 @@ namespace ananas
     };
 
     class ModuleList final : public juce::ChangeBroadcaster,
-                             public juce::Timer
+                             public ClockTimer
     {
     public:
-        ModuleList();
+        explicit ModuleList(Clock &clock = Clock::getSystem());
+
+        ~ModuleList() override;
 
         void handlePacket(const juce::String &moduleIP);
 
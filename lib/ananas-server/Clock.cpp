@@ -0,0 +1,209 @@
+#include "Clock.h"
+#include "ServerUtils.h"
+
+namespace ananas
+{
+    void Clock::sleepFor(const int64_t durationNs)
+    {
+        if (durationNs > 0) {
+            sleepUntil(now() + durationNs);
+        }
+    }
+
+    Clock &Clock::getSystem()
+    {
+        static SystemClock clock;
+        return clock;
+    }
+
+    void Clock::forwardStartTimer(Clock &other, ClockTimer &timer, const int64_t intervalNs)
+    {
+        other.startTimer(timer, intervalNs);
+    }
+
+    void Clock::forwardStopTimer(Clock &other, ClockTimer &timer)
+    {
+        other.stopTimer(timer);
+    }
+
+    //==========================================================================
+
+    ClockTimer::ClockTimer(Clock &clock) : clock(clock)
+    {
+    }
+
+    ClockTimer::~ClockTimer()
+    {
+        stopTimer();
+    }
+
+    void ClockTimer::startTimer(const int intervalMs)
+    {
+        clock.startTimer(*this, static_cast<int64_t>(juce::jmax(1, intervalMs)) * Server::Constants::NSPS / 1000);
+    }
+
+    void ClockTimer::stopTimer()
+    {
+        clock.stopTimer(*this);
+    }
+
+    Clock &ClockTimer::getClock() const
+    {
+        return clock;
+    }
+
+    //==========================================================================
+
+    int64_t SystemClock::now() const
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * Server::Constants::NSPS + ts.tv_nsec;
+    }
+
+    void SystemClock::sleepUntil(const int64_t timeNs)
+    {
+        const timespec t{
+            static_cast<time_t>(timeNs / Server::Constants::NSPS),
+            static_cast<long>(timeNs % Server::Constants::NSPS)
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, nullptr) == EINTR) {}
+    }
+
+    void SystemClock::startTimer(ClockTimer &timer, const int64_t intervalNs)
+    {
+        const std::lock_guard lock{mutex};
+        auto &t{timers[&timer]};
+        if (t == nullptr) {
+            t = std::make_unique<MessageThreadTimer>(timer);
+        }
+        t->startTimer(static_cast<int>(intervalNs * 1000 / Server::Constants::NSPS));
+    }
+
+    void SystemClock::stopTimer(ClockTimer &timer)
+    {
+        const std::lock_guard lock{mutex};
+        timers.erase(&timer);
+    }
+
+    SystemClock::MessageThreadTimer::MessageThreadTimer(ClockTimer &owner) : owner(owner)
+    {
+    }
+
+    void SystemClock::MessageThreadTimer::timerCallback()
+    {
+        owner.timerCallback();
+    }
+
+    //==========================================================================
+
+    VirtualClock::VirtualClock(const int64_t startNs) : time(startNs)
+    {
+    }
+
+    int64_t VirtualClock::now() const
+    {
+        return time.load(std::memory_order_acquire);
+    }
+
+    void VirtualClock::sleepUntil(const int64_t timeNs)
+    {
+        if (std::this_thread::get_id() == drivingThread.load(std::memory_order_relaxed)) {
+            advanceTo(timeNs);
+            return;
+        }
+
+        std::unique_lock lock{mutex};
+        timeChanged.wait(lock, [this, timeNs] { return released || now() >= timeNs; });
+    }
+
+    void VirtualClock::setDrivingThread()
+    {
+        drivingThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    }
+
+    void VirtualClock::advanceTo(const int64_t timeNs)
+    {
+        std::unique_lock lock{mutex};
+
+        while (true) {
+            // The earliest timer due by the target time, if any; first
+            // started first, for ties.
+            auto next{timers.end()};
+            for (auto it{timers.begin()}; it != timers.end(); ++it) {
+                if (it->dueNs <= timeNs
+                    && (next == timers.end() || it->dueNs < next->dueNs
+                        || (it->dueNs == next->dueNs && it->order < next->order))) {
+                    next = it;
+                }
+            }
+            if (next == timers.end()) break;
+
+            auto *timer{next->timer};
+            setTime(next->dueNs);
+            next->dueNs += next->intervalNs;
+
+            // The callback is free to start and stop timers, this one
+            // included.
+            lock.unlock();
+            timer->timerCallback();
+            lock.lock();
+        }
+
+        setTime(timeNs);
+    }
+
+    void VirtualClock::advanceBy(const int64_t durationNs)
+    {
+        advanceTo(now() + durationNs);
+    }
+
+    void VirtualClock::release()
+    {
+        const std::lock_guard lock{mutex};
+        released = true;
+        timeChanged.notify_all();
+    }
+
+    int64_t VirtualClock::getNextTimerDueNs() const
+    {
+        const std::lock_guard lock{mutex};
+        auto result{std::numeric_limits<int64_t>::max()};
+        for (const auto &t: timers) {
+            result = std::min(result, t.dueNs);
+        }
+        return result;
+    }
+
+    void VirtualClock::startTimer(ClockTimer &timer, const int64_t intervalNs)
+    {
+        const std::lock_guard lock{mutex};
+        const auto dueNs{now() + intervalNs};
+        for (auto &t: timers) {
+            if (t.timer == &timer) {
+                // Restarting resets the period, as with juce::Timer.
+                t.intervalNs = intervalNs;
+                t.dueNs = dueNs;
+                return;
+            }
+        }
+        timers.push_back({&timer, intervalNs, dueNs, nextOrder++});
+    }
+
+    void VirtualClock::stopTimer(ClockTimer &timer)
+    {
+        const std::lock_guard lock{mutex};
+        timers.erase(std::remove_if(timers.begin(), timers.end(),
+                                    [&timer](const TimerEntry &t) { return t.timer == &timer; }),
+                     timers.end());
+    }
+
+    void VirtualClock::setTime(const int64_t timeNs)
+    {
+        // Called with the mutex held.
+        if (timeNs > now()) {
+            time.store(timeNs, std::memory_order_release);
+            timeChanged.notify_all();
+        }
+    }
+}
@@ -0,0 +1,201 @@
+#ifndef ANANASCLOCK_H
+#define ANANASCLOCK_H
+
+#include <juce_events/juce_events.h>
+#include <condition_variable>
+#include <thread>
+
+namespace ananas
+{
+    class ClockTimer;
+
+    /**
+     * The server core's source of time: what time it is, how to wait, and
+     * when periodic housekeeping (connectedness checks and the like) runs.
+     * Components take a Clock rather than reading the system clock, so that
+     * a VirtualClock can stand in for it.
+     */
+    class Clock
+    {
+    public:
+        virtual ~Clock() = default;
+
+        /**
+         * @return Monotonic time, in nanoseconds.
+         */
+        [[nodiscard]] virtual int64_t now() const = 0;
+
+        /**
+         * Block the calling thread until the given time.
+         */
+        virtual void sleepUntil(int64_t timeNs) = 0;
+
+        void sleepFor(int64_t durationNs);
+
+        /**
+         * @return The real, monotonic clock, shared by everything that isn't
+         * given another.
+         */
+        static Clock &getSystem();
+
+    protected:
+        friend class ClockTimer;
+
+        virtual void startTimer(ClockTimer &timer, int64_t intervalNs) = 0;
+
+        virtual void stopTimer(ClockTimer &timer) = 0;
+
+        /**
+         * For clocks that leave their timers to another clock.
+         */
+        static void forwardStartTimer(Clock &other, ClockTimer &timer, int64_t intervalNs);
+
+        static void forwardStopTimer(Clock &other, ClockTimer &timer);
+    };
+
+    //==========================================================================
+
+    /**
+     * A periodic callback driven by a Clock; the equivalent of juce::Timer.
+     */
+    class ClockTimer
+    {
+    public:
+        explicit ClockTimer(Clock &clock);
+
+        virtual ~ClockTimer();
+
+        virtual void timerCallback() = 0;
+
+        void startTimer(int intervalMs);
+
+        void stopTimer();
+
+        [[nodiscard]] Clock &getClock() const;
+
+    private:
+        Clock &clock;
+
+        JUCE_DECLARE_NON_COPYABLE(ClockTimer)
+    };
+
+    //==========================================================================
+
+    /**
+     * CLOCK_MONOTONIC. Timers are juce::Timers, so callbacks arrive on the
+     * message thread, as they always have; see EventLoop for the same clock
+     * without one.
+     */
+    class SystemClock final : public Clock
+    {
+    public:
+        [[nodiscard]] int64_t now() const override;
+
+        void sleepUntil(int64_t timeNs) override;
+
+    protected:
+        void startTimer(ClockTimer &timer, int64_t intervalNs) override;
+
+        void stopTimer(ClockTimer &timer) override;
+
+    private:
+        class MessageThreadTimer final : public juce::Timer
+        {
+        public:
+            explicit MessageThreadTimer(ClockTimer &owner);
+
+            void timerCallback() override;
+
+        private:
+            ClockTimer &owner;
+        };
+
+        std::mutex mutex;
+        std::map<ClockTimer *, std::unique_ptr<MessageThreadTimer> > timers;
+    };
+
+    //==========================================================================
+
+    /**
+     * Time that only moves when told to. Timer callbacks fire on the thread
+     * that calls advanceTo(), one at a time, in order of due time (and of
+     * starting, for ties), with now() reading each callback's due time; so a
+     * scenario driven from one thread plays out identically every run, and an
+     * hour of it takes as long as the work it involves.
+     *
+     * Threads that sleep on a VirtualClock are woken as time passes their
+     * wake-up time; they're real threads, though, so how their work
+     * interleaves with the driver's isn't deterministic. For that, run the
+     * work on the driving thread too; see setDrivingThread().
+     */
+    class VirtualClock final : public Clock
+    {
+    public:
+        explicit VirtualClock(int64_t startNs = 0);
+
+        [[nodiscard]] int64_t now() const override;
+
+        /**
+         * Blocks until another thread advances time far enough, or until
+         * release() is called; on the driving thread, advances time itself.
+         */
+        void sleepUntil(int64_t timeNs) override;
+
+        /**
+         * Make the calling thread the one that drives the clock: its
+         * sleepUntil() advances time (firing timers on the way) rather than
+         * waiting for another thread to, so that code that paces itself on
+         * the clock, e.g. a simulated Server's audio sender, can run there.
+         */
+        void setDrivingThread();
+
+        /**
+         * Move time forward, firing any timers that fall due on the way.
+         * Moving backwards isn't a thing.
+         */
+        void advanceTo(int64_t timeNs);
+
+        void advanceBy(int64_t durationNs);
+
+        /**
+         * Wake all sleepers, and return from any later sleepUntil()
+         * immediately, e.g. so that threads sleeping on the clock can be
+         * stopped.
+         */
+        void release();
+
+        /**
+         * @return The time at which the next timer falls due, or max() if
+         * none are running.
+         */
+        [[nodiscard]] int64_t getNextTimerDueNs() const;
+
+    protected:
+        void startTimer(ClockTimer &timer, int64_t intervalNs) override;
+
+        void stopTimer(ClockTimer &timer) override;
+
+    private:
+        struct TimerEntry
+        {
+            ClockTimer *timer{nullptr};
+            int64_t intervalNs{0};
+            int64_t dueNs{0};
+            uint64_t order{0};
+        };
+
+        std::atomic<int64_t> time;
+        std::atomic<std::thread::id> drivingThread{};
+        bool released{false};
+        mutable std::mutex mutex;
+        std::condition_variable timeChanged;
+        std::vector<TimerEntry> timers;
+        uint64_t nextOrder{0};
+
+        void setTime(int64_t timeNs);
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VirtualClock)
+    };
+}
+
+#endif //ANANASCLOCK_H
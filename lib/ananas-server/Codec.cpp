@@ -0,0 +1,302 @@
+#include "Codec.h"
+
+namespace ananas
+{
+    class AudioCodec::BitWriter
+    {
+    public:
+        BitWriter(uint8_t *dest, const size_t capacity) : dest(dest), capacity(capacity)
+        {
+        }
+
+        void write(const uint32_t value, const int numBits)
+        {
+            accumulator = accumulator << numBits | (value & ((1ull << numBits) - 1));
+            numPendingBits += numBits;
+
+            while (numPendingBits >= 8) {
+                numPendingBits -= 8;
+                put(static_cast<uint8_t>(accumulator >> numPendingBits));
+            }
+        }
+
+        void writeOnes(uint32_t count)
+        {
+            for (; count >= 16; count -= 16) {
+                write(0xffff, 16);
+            }
+            write((1u << count) - 1, static_cast<int>(count));
+        }
+
+        size_t finish()
+        {
+            if (numPendingBits > 0) {
+                put(static_cast<uint8_t>(accumulator << (8 - numPendingBits)));
+                numPendingBits = 0;
+            }
+            return numBytes;
+        }
+
+        [[nodiscard]] bool hasOverflowed() const
+        {
+            return overflowed;
+        }
+
+    private:
+        void put(const uint8_t byte)
+        {
+            if (numBytes < capacity) {
+                dest[numBytes++] = byte;
+            } else {
+                overflowed = true;
+            }
+        }
+
+        uint8_t *dest;
+        size_t capacity;
+        size_t numBytes{0};
+        uint64_t accumulator{0};
+        int numPendingBits{0};
+        bool overflowed{false};
+    };
+
+    //==========================================================================
+
+    class AudioCodec::BitReader
+    {
+    public:
+        BitReader(const uint8_t *src, const size_t numBytes) : src(src), numBytes(numBytes)
+        {
+        }
+
+        uint32_t read(const int numBits)
+        {
+            uint32_t value{0};
+            for (int i{0}; i < numBits; ++i) {
+                value = value << 1 | readBit();
+            }
+            return value;
+        }
+
+        uint32_t readOnes(const uint32_t limit)
+        {
+            uint32_t count{0};
+            while (count < limit && readBit() == 1) {
+                ++count;
+            }
+            return count;
+        }
+
+        [[nodiscard]] bool hasOverrun() const
+        {
+            return overrun;
+        }
+
+    private:
+        uint32_t readBit()
+        {
+            if (position >= numBytes * 8) {
+                overrun = true;
+                return 0;
+            }
+            const auto bit{src[position / 8] >> (7 - position % 8) & 1};
+            ++position;
+            return static_cast<uint32_t>(bit);
+        }
+
+        const uint8_t *src;
+        size_t numBytes;
+        size_t position{0};
+        bool overrun{false};
+    };
+
+    //==========================================================================
+
+    void AudioCodec::prepare(const uint numChannelsToCode, const int numFramesToCode)
+    {
+        numChannels = numChannelsToCode;
+        numFrames = numFramesToCode;
+
+        // Keep MaxOrder frames of zeros ahead of the audio, so that the
+        // predictors can be evaluated uniformly from the first frame on.
+        samples.assign((numFrames + MaxOrder) * numChannels, 0);
+
+        for (auto &r: residuals) {
+            r.assign(numFrames * numChannels, 0);
+        }
+        for (auto &s: residualSums) {
+            s.assign(numChannels, 0);
+        }
+    }
+
+    size_t AudioCodec::encode(const uint8_t *src, uint8_t *dest)
+    {
+        const auto rawSize{static_cast<size_t>(numFrames) * numChannels * sizeof(int16_t)};
+        const auto C{static_cast<size_t>(numChannels)};
+
+        auto *x{&samples[MaxOrder * C]};
+        for (size_t i{0}; i < numFrames * C; ++i) {
+            int16_t s;
+            memcpy(&s, &src[i * sizeof(int16_t)], sizeof(int16_t));
+            x[i] = s;
+        }
+
+        for (auto &s: residualSums) {
+            std::fill(s.begin(), s.end(), 0);
+        }
+
+        // Evaluate all four predictors at once. The inner loops run over
+        // contiguous channels, so they vectorise.
+        for (int n{0}; n < numFrames; ++n) {
+            const auto *x0{&x[n * C]}, *x1{x0 - C}, *x2{x1 - C}, *x3{x2 - C};
+            auto *r0{&residuals[0][n * C]}, *r1{&residuals[1][n * C]},
+                    *r2{&residuals[2][n * C]}, *r3{&residuals[3][n * C]};
+
+            for (size_t ch{0}; ch < C; ++ch) {
+                r0[ch] = zigzag(x0[ch]);
+                r1[ch] = zigzag(x0[ch] - x1[ch]);
+                r2[ch] = zigzag(x0[ch] - 2 * x1[ch] + x2[ch]);
+                r3[ch] = zigzag(x0[ch] - 3 * x1[ch] + 3 * x2[ch] - x3[ch]);
+            }
+
+            // There's no history before the start of the packet; for the
+            // first frames, higher-order predictors fall back to order n.
+            for (int order{n + 1}; order <= MaxOrder; ++order) {
+                std::copy_n(&residuals[n][n * C], C, &residuals[order][n * C]);
+            }
+
+            for (int order{0}; order <= MaxOrder; ++order) {
+                auto *sum{residualSums[order].data()};
+                const auto *r{&residuals[order][n * C]};
+                for (size_t ch{0}; ch < C; ++ch) {
+                    sum[ch] += r[ch];
+                }
+            }
+        }
+
+        // Channel parameters, then the residual bitstream. Give up if that
+        // would be any larger than the raw audio.
+        auto *channelParams{&dest[1]};
+        BitWriter writer{&dest[1 + C], rawSize - C};
+
+        for (size_t ch{0}; ch < C && !writer.hasOverflowed(); ++ch) {
+            int order{0};
+            for (int o{1}; o <= MaxOrder; ++o) {
+                if (residualSums[o][ch] < residualSums[order][ch]) {
+                    order = o;
+                }
+            }
+
+            uint32_t k{0};
+            while (k < MaxRiceParameter && (static_cast<uint64_t>(numFrames) << (k + 1)) <= residualSums[order][ch]) {
+                ++k;
+            }
+
+            channelParams[ch] = static_cast<uint8_t>(order << 5 | k);
+
+            for (int n{0}; n < numFrames; ++n) {
+                const auto u{residuals[order][n * C + ch]};
+                if (const auto q{u >> k}; q >= EscapeQuotient) {
+                    writer.writeOnes(EscapeQuotient);
+                    writer.write(u, EscapeBits);
+                } else {
+                    writer.writeOnes(q);
+                    writer.write(0, 1);
+                    writer.write(u, static_cast<int>(k));
+                }
+            }
+        }
+
+        const auto numBitstreamBytes{writer.finish()};
+
+        if (writer.hasOverflowed()) {
+            dest[0] = static_cast<uint8_t>(Mode::raw);
+            memcpy(&dest[1], src, rawSize);
+            return 1 + rawSize;
+        }
+
+        dest[0] = static_cast<uint8_t>(Mode::predictive);
+        return 1 + C + numBitstreamBytes;
+    }
+
+    bool AudioCodec::decode(const uint8_t *src, const size_t numBytes, uint8_t *dest)
+    {
+        const auto rawSize{static_cast<size_t>(numFrames) * numChannels * sizeof(int16_t)};
+        const auto C{static_cast<size_t>(numChannels)};
+
+        if (numBytes < 1) return false;
+
+        if (src[0] == static_cast<uint8_t>(Mode::raw)) {
+            if (numBytes != 1 + rawSize) return false;
+            memcpy(dest, &src[1], rawSize);
+            return true;
+        }
+
+        if (src[0] != static_cast<uint8_t>(Mode::predictive) || numBytes < 1 + C) return false;
+
+        const auto *channelParams{&src[1]};
+        BitReader reader{&src[1 + C], numBytes - 1 - C};
+        auto *x{&samples[MaxOrder * C]};
+        const auto stride{static_cast<int>(numChannels)};
+
+        for (size_t ch{0}; ch < C; ++ch) {
+            const auto order{channelParams[ch] >> 5};
+            const auto k{channelParams[ch] & RiceParameterMask};
+
+            if (order > MaxOrder || k > MaxRiceParameter) return false;
+
+            for (int n{0}; n < numFrames; ++n) {
+                uint32_t u;
+                if (const auto q{reader.readOnes(EscapeQuotient)}; q == EscapeQuotient) {
+                    u = reader.read(EscapeBits);
+                } else {
+                    u = q << k | reader.read(static_cast<int>(k));
+                }
+
+                const auto i{n * stride + static_cast<int>(ch)};
+                int32_t prediction{0};
+                switch (std::min(order, n)) {
+                    case 1: prediction = x[i - stride];
+                        break;
+                    case 2: prediction = 2 * x[i - stride] - x[i - 2 * stride];
+                        break;
+                    case 3: prediction = 3 * x[i - stride] - 3 * x[i - 2 * stride] + x[i - 3 * stride];
+                        break;
+                    default: break;
+                }
+
+                // A malformed residual may be anything; add in 64 bits, so
+                // that it's caught below rather than overflowing.
+                const auto sample{static_cast<int64_t>(prediction) + unzigzag(u)};
+                if (sample < std::numeric_limits<int16_t>::min() || sample > std::numeric_limits<int16_t>::max()) {
+                    return false;
+                }
+                x[i] = static_cast<int32_t>(sample);
+            }
+        }
+
+        if (reader.hasOverrun()) return false;
+
+        for (size_t i{0}; i < numFrames * C; ++i) {
+            const auto s{static_cast<int16_t>(x[i])};
+            memcpy(&dest[i * sizeof(int16_t)], &s, sizeof(int16_t));
+        }
+
+        return true;
+    }
+
+    size_t AudioCodec::getMaxEncodedSize() const
+    {
+        return 1 + static_cast<size_t>(numFrames) * numChannels * sizeof(int16_t);
+    }
+
+    uint32_t AudioCodec::zigzag(const int32_t value)
+    {
+        return static_cast<uint32_t>(value) << 1 ^ static_cast<uint32_t>(value >> 31);
+    }
+
+    int32_t AudioCodec::unzigzag(const uint32_t value)
+    {
+        return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+    }
+}
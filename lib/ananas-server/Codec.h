@@ -0,0 +1,90 @@
+#ifndef ANANASCODEC_H
+#define ANANASCODEC_H
+
+#include <juce_core/juce_core.h>
+
+namespace ananas
+{
+    /**
+     * Lossless, packet-local audio codec: fixed-order linear prediction
+     * (orders 0–3, chosen per channel) followed by Rice coding of the
+     * residuals.
+     *
+     * Every packet is self-contained — prediction history starts afresh at
+     * the first frame of each packet — so a lost packet never affects the
+     * decoding of any other.
+     *
+     * Encoded payload layout (immediately following AudioPacket::Header):
+     *   - 1 byte Mode; if Mode::raw, the original interleaved int16 PCM
+     *     follows verbatim;
+     *   - otherwise one byte per channel, (order << 5) | riceParameter,
+     *     followed by a bitstream of Rice-coded residuals, channel by
+     *     channel, MSB first.
+     */
+    class AudioCodec
+    {
+    public:
+        enum class Mode : uint8_t
+        {
+            raw = 0,
+            predictive = 1
+        };
+
+        void prepare(uint numChannels, int numFrames);
+
+        /**
+         * Encode one packet's worth of interleaved, little-endian int16
+         * audio. Falls back to Mode::raw if prediction doesn't make the
+         * payload any smaller.
+         * @param src numChannels * numFrames interleaved samples.
+         * @param dest At least getMaxEncodedSize() bytes.
+         * @return The number of bytes written to dest.
+         */
+        size_t encode(const uint8_t *src, uint8_t *dest);
+
+        /**
+         * Decode an encoded payload back to interleaved int16 audio.
+         * @param src An encoded payload.
+         * @param numBytes The size of the encoded payload.
+         * @param dest At least numChannels * numFrames * sizeof(int16_t) bytes.
+         * @return false if the payload is malformed.
+         */
+        bool decode(const uint8_t *src, size_t numBytes, uint8_t *dest);
+
+        [[nodiscard]] size_t getMaxEncodedSize() const;
+
+        constexpr static int MaxOrder{3};
+
+    private:
+        class BitWriter;
+        class BitReader;
+
+        /**
+         * Unary quotients of this length or more are escaped, and the
+         * zigzag-mapped residual is written verbatim in EscapeBits bits.
+         */
+        constexpr static uint32_t EscapeQuotient{24};
+        constexpr static int EscapeBits{20};
+
+        /**
+         * The Rice parameter takes the low five bits of a channel's
+         * parameter byte, but the encoder never goes past
+         * MaxRiceParameter; anything beyond is malformed.
+         */
+        constexpr static uint32_t RiceParameterMask{(1 << 5) - 1};
+        constexpr static uint32_t MaxRiceParameter{EscapeBits - 2};
+
+        static uint32_t zigzag(int32_t value);
+
+        static int32_t unzigzag(uint32_t value);
+
+        uint numChannels{0};
+        int numFrames{0};
+        std::vector<int32_t> samples;
+        // Residuals for each order, interleaved like the source audio.
+        std::array<std::vector<uint32_t>, MaxOrder + 1> residuals;
+        std::array<std::vector<uint64_t>, MaxOrder + 1> residualSums;
+    };
+}
+
+#endif //ANANASCODEC_H
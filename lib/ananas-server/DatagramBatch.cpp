@@ -0,0 +1,140 @@
+#include "DatagramBatch.h"
+#include "Trace.h"
+#if JUCE_LINUX
+#include <arpa/inet.h>
+#endif
+
+namespace ananas
+{
+    DatagramBatch::DatagramBatch(SenderMetrics &metrics)
+        : metrics(metrics)
+    {
+    }
+
+    bool DatagramBatch::prepare(const int maxDatagrams, const size_t maxDatagramSize, const juce::String &ip, const int port)
+    {
+        const auto n{static_cast<size_t>(std::max(1, maxDatagrams))};
+        maxSize = maxDatagramSize;
+        storage.assign(n * maxSize, 0);
+        sizes.assign(n, 0);
+        writeTimes.assign(n, 0);
+        first = 0;
+        numPending = 0;
+
+#if JUCE_LINUX
+        destination = {};
+        destination.sin_family = AF_INET;
+        destination.sin_port = htons(static_cast<uint16_t>(port));
+        if (inet_pton(AF_INET, ip.toRawUTF8(), &destination.sin_addr) != 1) return false;
+
+        // Each message points at its own slot; only the lengths change.
+        iovecs.assign(n, {});
+        messages.assign(n, {});
+        for (size_t i{0}; i < n; ++i) {
+            iovecs[i].iov_base = &storage[i * maxSize];
+            messages[i].msg_hdr.msg_name = &destination;
+            messages[i].msg_hdr.msg_namelen = sizeof(destination);
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        return true;
+#else
+        juce::ignoreUnused(ip, port);
+        return false;
+#endif
+    }
+
+    bool DatagramBatch::isEmpty() const
+    {
+        return numPending == 0;
+    }
+
+    bool DatagramBatch::isFull() const
+    {
+        return static_cast<size_t>(first + numPending) >= sizes.size();
+    }
+
+    int DatagramBatch::getNumPending() const
+    {
+        return numPending;
+    }
+
+    bool DatagramBatch::add(const uint8_t *data, const size_t size, const int64_t writeTimeNs)
+    {
+        if (numPending == 0) {
+            first = 0;
+        }
+        if (isFull() || size > maxSize) return false;
+
+        const auto i{static_cast<size_t>(first + numPending)};
+        memcpy(&storage[i * maxSize], data, size);
+        sizes[i] = size;
+        writeTimes[i] = writeTimeNs;
+#if JUCE_LINUX
+        iovecs[i].iov_len = size;
+#endif
+        ++numPending;
+        return true;
+    }
+
+    int DatagramBatch::send(const int socketHandle, int64_t *lastDepartureNs)
+    {
+#if JUCE_LINUX
+        ANANAS_TRACE_SCOPE("DatagramBatch::send");
+
+        if (numPending == 0 || socketHandle < 0) return 0;
+
+        const auto start{SenderMetrics::now()};
+        // EAGAIN (the socket buffer is full), or anything else, leaves the
+        // lot pending.
+        const auto numSent{
+            std::max(0, sendmmsg(socketHandle, &messages[static_cast<size_t>(first)], static_cast<unsigned int>(numPending), MSG_DONTWAIT))
+        };
+        const auto departure{SenderMetrics::now()};
+        metrics.send.record(departure - start);
+
+        for (auto i{0}; i < numSent; ++i) {
+            if (const auto writeTimeNs{writeTimes[static_cast<size_t>(first + i)]}; writeTimeNs > 0) {
+                metrics.fifoResidency.record(departure - writeTimeNs);
+            }
+            // The batch leaves in one system call, so all but the first
+            // packet depart with the one before.
+            if (lastDepartureNs != nullptr) {
+                if (*lastDepartureNs > 0) {
+                    metrics.interDeparture.record(departure - *lastDepartureNs);
+                }
+                *lastDepartureNs = departure;
+            }
+        }
+
+        first += numSent;
+        numPending -= numSent;
+        return numSent;
+#else
+        juce::ignoreUnused(socketHandle, lastDepartureNs);
+        return 0;
+#endif
+    }
+
+    bool DatagramBatch::pop(const uint8_t *&data, size_t &size, int64_t &writeTimeNs)
+    {
+        if (numPending == 0) return false;
+
+        const auto i{static_cast<size_t>(first)};
+        data = &storage[i * maxSize];
+        size = sizes[i];
+        writeTimeNs = writeTimes[i];
+        ++first;
+        --numPending;
+        return true;
+    }
+
+    bool DatagramBatch::isSupported()
+    {
+#if JUCE_LINUX
+        return true;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef ANANASDATAGRAMBATCH_H
+#define ANANASDATAGRAMBATCH_H
+
+#include <juce_core/juce_core.h>
+#include "Metrics.h"
+#if JUCE_LINUX
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+namespace ananas
+{
+    /**
+     * A preallocated batch of datagrams for one destination, sent with one
+     * non-blocking sendmmsg(), for the audio sender's inline mode; see
+     * Server::setInlineSendEnabled().
+     *
+     * Datagrams are copied in with add(); send() hands as many to the
+     * kernel as it will take without blocking, in order, and whatever it
+     * won't take stays pending, to be taken out with pop() and sent some
+     * other way. Nothing allocates after prepare().
+     *
+     * Linux only; elsewhere, send() sends nothing, so everything is left
+     * pending.
+     */
+    class DatagramBatch
+    {
+    public:
+        explicit DatagramBatch(SenderMetrics &metrics);
+
+        /**
+         * @return false if the destination isn't an IPv4 address.
+         */
+        bool prepare(int maxDatagrams, size_t maxDatagramSize, const juce::String &ip, int port);
+
+        [[nodiscard]] bool isEmpty() const;
+
+        [[nodiscard]] bool isFull() const;
+
+        [[nodiscard]] int getNumPending() const;
+
+        /**
+         * Copy a datagram to the end of the batch.
+         * @param writeTimeNs For audio packets, when the packet's first frame
+         * was written to the FIFO; otherwise 0.
+         * @return false if the batch is full, or the datagram too big.
+         */
+        bool add(const uint8_t *data, size_t size, int64_t writeTimeNs);
+
+        /**
+         * Send what's pending from a socket, without blocking, recording the
+         * send syscall time and each packet's FIFO residency.
+         * @param lastDepartureNs If not null, when the stream's last packet
+         * left, to record the inter-departure time of each packet sent from;
+         * updated to when these left.
+         * @return The number of datagrams sent.
+         */
+        int send(int socketHandle, int64_t *lastDepartureNs = nullptr);
+
+        /**
+         * Take the oldest pending datagram out of the batch; it's valid until
+         * the next add().
+         * @return false if there's nothing pending.
+         */
+        bool pop(const uint8_t *&data, size_t &size, int64_t &writeTimeNs);
+
+        static bool isSupported();
+
+    private:
+        SenderMetrics &metrics;
+        size_t maxSize{0};
+        std::vector<uint8_t> storage;
+        std::vector<size_t> sizes;
+        std::vector<int64_t> writeTimes;
+        int first{0};
+        int numPending{0};
+#if JUCE_LINUX
+        sockaddr_in destination{};
+        std::vector<iovec> iovecs;
+        std::vector<mmsghdr> messages;
+#endif
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DatagramBatch)
+    };
+}
+
+#endif //ANANASDATAGRAMBATCH_H
@@ -0,0 +1,113 @@
+#include "EventLoop.h"
+
+namespace ananas
+{
+    int64_t EventLoop::now() const
+    {
+        return getSystem().now();
+    }
+
+    void EventLoop::sleepUntil(const int64_t timeNs)
+    {
+        getSystem().sleepUntil(timeNs);
+    }
+
+    void EventLoop::run()
+    {
+        std::unique_lock lock{mutex};
+
+        while (!shouldQuit) {
+            if (!posted.empty()) {
+                auto callbacks{std::move(posted)};
+                posted.clear();
+
+                lock.unlock();
+                for (auto &c: callbacks) {
+                    c();
+                }
+                lock.lock();
+                continue;
+            }
+
+            const auto nowNs{now()};
+            if (const auto due{findDueTimer(nowNs)}; due != timers.end()) {
+                auto *timer{due->timer};
+                // If the loop has fallen behind (or the machine was asleep),
+                // don't fire a burst of catch-up callbacks.
+                due->dueNs += due->intervalNs;
+                if (due->dueNs <= nowNs) {
+                    due->dueNs = nowNs + due->intervalNs;
+                }
+
+                // The callback is free to start and stop timers, this one
+                // included.
+                lock.unlock();
+                timer->timerCallback();
+                lock.lock();
+                continue;
+            }
+
+            auto nextDueNs{std::numeric_limits<int64_t>::max()};
+            for (const auto &t: timers) {
+                nextDueNs = std::min(nextDueNs, t.dueNs);
+            }
+
+            // std::chrono::steady_clock is CLOCK_MONOTONIC, as is now().
+            if (nextDueNs == std::numeric_limits<int64_t>::max()) {
+                wake.wait(lock);
+            } else {
+                wake.wait_until(lock, std::chrono::steady_clock::time_point{std::chrono::nanoseconds{nextDueNs}});
+            }
+        }
+    }
+
+    void EventLoop::quit()
+    {
+        const std::lock_guard lock{mutex};
+        shouldQuit = true;
+        wake.notify_all();
+    }
+
+    void EventLoop::post(std::function<void()> callback)
+    {
+        const std::lock_guard lock{mutex};
+        posted.push_back(std::move(callback));
+        wake.notify_all();
+    }
+
+    void EventLoop::startTimer(ClockTimer &timer, const int64_t intervalNs)
+    {
+        const std::lock_guard lock{mutex};
+        const auto dueNs{now() + intervalNs};
+        for (auto &t: timers) {
+            if (t.timer == &timer) {
+                // Restarting resets the period, as with juce::Timer.
+                t.intervalNs = intervalNs;
+                t.dueNs = dueNs;
+                wake.notify_all();
+                return;
+            }
+        }
+        timers.push_back({&timer, intervalNs, dueNs});
+        wake.notify_all();
+    }
+
+    void EventLoop::stopTimer(ClockTimer &timer)
+    {
+        const std::lock_guard lock{mutex};
+        timers.erase(std::remove_if(timers.begin(), timers.end(),
+                                    [&timer](const TimerEntry &t) { return t.timer == &timer; }),
+                     timers.end());
+    }
+
+    std::vector<EventLoop::TimerEntry>::iterator EventLoop::findDueTimer(const int64_t nowNs)
+    {
+        auto due{timers.end()};
+        for (auto it{timers.begin()}; it != timers.end(); ++it) {
+            if (it->dueNs <= nowNs && (due == timers.end() || it->dueNs < due->dueNs)) {
+                due = it;
+            }
+        }
+        return due;
+    }
+}
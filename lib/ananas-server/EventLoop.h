@@ -0,0 +1,71 @@
+#ifndef ANANASEVENTLOOP_H
+#define ANANASEVENTLOOP_H
+
+#include "Clock.h"
+
+namespace ananas
+{
+    /**
+     * The real, monotonic clock, with timers and posted callbacks run by
+     * whichever thread calls run(), rather than by the JUCE message thread;
+     * so the server core can run headless, with no MessageManager. Between
+     * events, run() sleeps, for as long as the next timer allows.
+     *
+     * Start and stop timers on the loop's thread, or while it isn't running.
+     */
+    class EventLoop final : public Clock
+    {
+    public:
+        EventLoop() = default;
+
+        [[nodiscard]] int64_t now() const override;
+
+        void sleepUntil(int64_t timeNs) override;
+
+        /**
+         * Run timers and posted callbacks until quit() is called.
+         */
+        void run();
+
+        /**
+         * Make run() return, once any callback in progress has finished; or
+         * return straight away, if it hasn't been called yet. Safe to call
+         * from any thread.
+         */
+        void quit();
+
+        /**
+         * Call a function on the loop's thread, soon. Safe to call from any
+         * thread, but not from a signal handler.
+         */
+        void post(std::function<void()> callback);
+
+    protected:
+        void startTimer(ClockTimer &timer, int64_t intervalNs) override;
+
+        void stopTimer(ClockTimer &timer) override;
+
+    private:
+        struct TimerEntry
+        {
+            ClockTimer *timer{nullptr};
+            int64_t intervalNs{0};
+            int64_t dueNs{0};
+        };
+
+        /**
+         * @return The earliest timer due by now, or timers.end().
+         */
+        std::vector<TimerEntry>::iterator findDueTimer(int64_t nowNs);
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<TimerEntry> timers;
+        std::vector<std::function<void()> > posted;
+        bool shouldQuit{false};
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EventLoop)
+    };
+}
+
+#endif //ANANASEVENTLOOP_H
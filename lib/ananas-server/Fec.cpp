@@ -0,0 +1,158 @@
+#include "Fec.h"
+#include "Packet.h"
+
+namespace ananas
+{
+    void Fec::xorInto(uint8_t *dest, const uint8_t *src, const size_t numBytes)
+    {
+        // Work a word at a time; the compiler turns this into SIMD.
+        size_t i{0};
+        for (; i + sizeof(uint64_t) <= numBytes; i += sizeof(uint64_t)) {
+            uint64_t a, b;
+            memcpy(&a, &dest[i], sizeof(uint64_t));
+            memcpy(&b, &src[i], sizeof(uint64_t));
+            a ^= b;
+            memcpy(&dest[i], &a, sizeof(uint64_t));
+        }
+        for (; i < numBytes; ++i) {
+            dest[i] ^= src[i];
+        }
+    }
+
+    //==========================================================================
+
+    void FecEncoder::prepare(const int numDataPackets, const int numParityPackets, const size_t maxPacketSize)
+    {
+        numParity = numDataPackets > 0 ? juce::jlimit(1, numDataPackets, numParityPackets) : 0;
+        numData = numDataPackets;
+        numAdded = 0;
+        maxSize = maxPacketSize;
+
+        parity.setSize(numParity * (sizeof(Fec::Header) + maxSize), true);
+        headers.assign(numParity, Fec::Header{});
+        payloadSizes.assign(numParity, 0);
+    }
+
+    bool FecEncoder::addPacket(const uint8_t *data, const size_t size)
+    {
+        if (numData == 0 || size > maxSize) return false;
+
+        if (numAdded == 0) {
+            // Start of a new group.
+            parity.fillWith(0);
+            std::fill(payloadSizes.begin(), payloadSizes.end(), 0);
+
+            AudioPacket::Header dataHeader;
+            memcpy(&dataHeader, data, sizeof(AudioPacket::Header));
+
+            for (int j{0}; j < numParity; ++j) {
+                headers[j] = {
+                    dataHeader.sequenceNumber,
+                    static_cast<uint8_t>(numData),
+                    static_cast<uint8_t>(numParity),
+                    static_cast<uint8_t>(j),
+                    0
+                };
+            }
+        }
+
+        const auto j{numAdded % numParity};
+        auto *payload{&static_cast<uint8_t *>(parity.getData())[j * (sizeof(Fec::Header) + maxSize) + sizeof(Fec::Header)]};
+        Fec::xorInto(payload, data, size);
+        headers[j].sizeRecovery ^= static_cast<uint16_t>(size);
+        payloadSizes[j] = std::max(payloadSizes[j], size);
+
+        if (++numAdded < numData) return false;
+
+        for (int p{0}; p < numParity; ++p) {
+            parity.copyFrom(&headers[p], static_cast<int>(p * (sizeof(Fec::Header) + maxSize)), sizeof(Fec::Header));
+        }
+        numAdded = 0;
+
+        return true;
+    }
+
+    int FecEncoder::getNumParityPackets() const
+    {
+        return numParity;
+    }
+
+    const uint8_t *FecEncoder::getParityPacket(const int index) const
+    {
+        return &static_cast<const uint8_t *>(parity.getData())[index * (sizeof(Fec::Header) + maxSize)];
+    }
+
+    size_t FecEncoder::getParityPacketSize(const int index) const
+    {
+        return sizeof(Fec::Header) + payloadSizes[index];
+    }
+
+    //==========================================================================
+
+    void FecDecoder::prepare(const size_t maxPacketSize)
+    {
+        maxSize = maxPacketSize;
+        storage.assign(HistorySize * maxSize, 0);
+        slots.fill(Slot{});
+    }
+
+    void FecDecoder::addDataPacket(const uint8_t *data, const size_t size)
+    {
+        if (size < sizeof(AudioPacket::Header) || size > maxSize) return;
+
+        AudioPacket::Header header;
+        memcpy(&header, data, sizeof(AudioPacket::Header));
+
+        const auto index{header.sequenceNumber % HistorySize};
+        slots[index] = {true, header.sequenceNumber, size};
+        memcpy(&storage[index * maxSize], data, size);
+    }
+
+    bool FecDecoder::addParityPacket(const uint8_t *data, const size_t size, uint8_t *recovered, size_t &recoveredSize)
+    {
+        if (size < sizeof(Fec::Header) || size - sizeof(Fec::Header) > maxSize) return false;
+
+        Fec::Header header;
+        memcpy(&header, data, sizeof(Fec::Header));
+
+        if (header.numParityPackets == 0 || header.parityIndex >= header.numParityPackets) return false;
+
+        // Find the one (and only one) missing packet covered by this parity
+        // packet.
+        int numMissing{0};
+        uint16_t missing{0};
+        for (int i{header.parityIndex}; i < header.numDataPackets; i += header.numParityPackets) {
+            if (const auto seq{static_cast<uint16_t>(header.groupSequenceNumber + i)}; !has(seq)) {
+                missing = seq;
+                ++numMissing;
+            }
+        }
+
+        if (numMissing != 1) return false;
+
+        const auto payloadSize{size - sizeof(Fec::Header)};
+        memcpy(recovered, &data[sizeof(Fec::Header)], payloadSize);
+        auto packetSize{static_cast<size_t>(header.sizeRecovery)};
+
+        for (int i{header.parityIndex}; i < header.numDataPackets; i += header.numParityPackets) {
+            if (const auto seq{static_cast<uint16_t>(header.groupSequenceNumber + i)}; seq != missing) {
+                const auto &slot{slots[seq % HistorySize]};
+                Fec::xorInto(recovered, &storage[(seq % HistorySize) * maxSize], std::min(slot.size, payloadSize));
+                packetSize ^= slot.size;
+            }
+        }
+
+        if (packetSize < sizeof(AudioPacket::Header) || packetSize > payloadSize) return false;
+
+        recoveredSize = packetSize;
+        addDataPacket(recovered, recoveredSize);
+
+        return true;
+    }
+
+    bool FecDecoder::has(const uint16_t sequenceNumber) const
+    {
+        const auto &slot{slots[sequenceNumber % HistorySize]};
+        return slot.valid && slot.sequenceNumber == sequenceNumber;
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef ANANASFEC_H
+#define ANANASFEC_H
+
+#include <juce_core/juce_core.h>
+
+namespace ananas
+{
+    /**
+     * Interleaved XOR forward error correction for audio packets.
+     *
+     * For each group of K consecutive data packets, M parity packets are
+     * generated; parity packet j is the XOR of data packets i for which
+     * i % M == j. Any single loss per parity packet can be repaired, so a
+     * burst of up to M consecutive losses within a group is recoverable.
+     * Parity for a group can only be sent once the group is complete, so K
+     * adds up to K packets' worth of latency to any repair.
+     */
+    class Fec
+    {
+    public:
+#pragma pack(push, 1)
+        struct Header
+        {
+            /**
+             * Sequence number of the first data packet in the group.
+             */
+            uint16_t groupSequenceNumber{0};
+            uint8_t numDataPackets{0};
+            uint8_t numParityPackets{0};
+            uint8_t parityIndex{0};
+            /**
+             * XOR of the sizes of the covered data packets, so that the size
+             * of a repaired packet can be recovered too.
+             */
+            uint16_t sizeRecovery{0};
+        };
+#pragma pack(pop)
+
+        static void xorInto(uint8_t *dest, const uint8_t *src, size_t numBytes);
+    };
+
+    //==========================================================================
+
+    class FecEncoder
+    {
+    public:
+        void prepare(int numDataPackets, int numParityPackets, size_t maxPacketSize);
+
+        /**
+         * Add a serialized data packet to the current group.
+         * @return true if the group is now complete, and its parity packets
+         * are ready to be sent.
+         */
+        bool addPacket(const uint8_t *data, size_t size);
+
+        [[nodiscard]] int getNumParityPackets() const;
+
+        [[nodiscard]] const uint8_t *getParityPacket(int index) const;
+
+        [[nodiscard]] size_t getParityPacketSize(int index) const;
+
+    private:
+        int numData{0};
+        int numParity{0};
+        int numAdded{0};
+        size_t maxSize{0};
+        juce::MemoryBlock parity;
+        std::vector<Fec::Header> headers;
+        std::vector<size_t> payloadSizes;
+    };
+
+    //==========================================================================
+
+    /**
+     * Receiver-side counterpart to FecEncoder; retains recent data packets
+     * and uses incoming parity packets to reconstruct missing ones.
+     */
+    class FecDecoder
+    {
+    public:
+        void prepare(size_t maxPacketSize);
+
+        void addDataPacket(const uint8_t *data, size_t size);
+
+        /**
+         * Add a parity packet, and try to repair a missing data packet with
+         * it.
+         * @param recovered At least maxPacketSize bytes.
+         * @param recoveredSize Set to the size of the repaired packet.
+         * @return true if a packet was repaired.
+         */
+        bool addParityPacket(const uint8_t *data, size_t size, uint8_t *recovered, size_t &recoveredSize);
+
+        constexpr static int HistorySize{256};
+
+    private:
+        struct Slot
+        {
+            bool valid{false};
+            uint16_t sequenceNumber{0};
+            size_t size{0};
+        };
+
+        [[nodiscard]] bool has(uint16_t sequenceNumber) const;
+
+        size_t maxSize{0};
+        std::array<Slot, HistorySize> slots{};
+        std::vector<uint8_t> storage;
+    };
+}
+
+#endif //ANANASFEC_H
@@ -1,12 +1,61 @@
 #include "Fifo.h"
+#include "ThreadPolicy.h"
+#include "Trace.h"
 
 namespace ananas
 {
-    Fifo::Fifo(uint8_t numChannels)
-        : buffer(std::make_unique<juce::AudioBuffer<float> >(numChannels, Server::Constants::FifoCapacityFrames)),
+    Fifo::Fifo(uint8_t numChannels, Clock &clock)
+        : numChannels(numChannels),
+          clock(clock),
+          buffer(std::make_unique<juce::AudioBuffer<float> >(numChannels, 0)),
           converter(std::make_unique<FormatConverter>(numChannels, numChannels))
     {
-        startTimer(Server::Constants::FifoReportIntervalMs);
+    }
+
+    std::optional<Fifo::OverflowPolicy> Fifo::parseOverflowPolicy(const juce::String &name)
+    {
+        if (name == "drop-newest") return OverflowPolicy::dropNewest;
+        if (name == "drop-oldest") return OverflowPolicy::dropOldest;
+        return std::nullopt;
+    }
+
+    std::optional<Fifo::UnderflowPolicy> Fifo::parseUnderflowPolicy(const juce::String &name)
+    {
+        if (name == "wait") return UnderflowPolicy::wait;
+        if (name == "silence") return UnderflowPolicy::insertSilence;
+        return std::nullopt;
+    }
+
+    void Fifo::prepare(const int samplesPerBlockExpected, const double newSampleRate, const int64_t targetLatencyNs)
+    {
+        const std::lock_guard lock{mutex};
+
+        sampleRate = newSampleRate;
+        const auto blockFrames{std::max(samplesPerBlockExpected, static_cast<int>(Server::Constants::FramesPerPacket))};
+        const auto headroomFrames{
+            static_cast<int>(std::ceil(sampleRate * static_cast<double>(targetLatencyNs) / Server::Constants::NSPS))
+        };
+        const auto newCapacity{2 * blockFrames + headroomFrames};
+        capacity.store(newCapacity, std::memory_order_relaxed);
+        underflowTimeoutNs = static_cast<int64_t>(blockFrames * Server::Constants::NSPS / sampleRate) + targetLatencyNs;
+
+        fifo.setTotalSize(newCapacity + 1);
+        buffer->setSize(numChannels, newCapacity + 1);
+        buffer->clear();
+
+        writeRecords.fill({});
+        nextWriteRecord = 0;
+        numFramesWritten = 0;
+        numFramesRead = 0;
+        underflowing = false;
+        underflowDeadlineNs.store(std::numeric_limits<int64_t>::max(), std::memory_order_relaxed);
+    }
+
+    void Fifo::setPolicies(const OverflowPolicy overflow, const UnderflowPolicy underflow)
+    {
+        const std::lock_guard lock{mutex};
+        overflowPolicy = overflow;
+        underflowPolicy.store(underflow, std::memory_order_relaxed);
     }
 
     bool Fifo::isReady(const int framesRequested) const
@@ -14,8 +63,28 @@ namespace ananas
         return fifo.getNumReady() >= framesRequested;
     }
 
+    bool Fifo::isUnderflowing(const int framesRequested) const
+    {
+        return underflowPolicy.load(std::memory_order_relaxed) == UnderflowPolicy::insertSilence
+               && !isReady(framesRequested)
+               && clock.now() >= underflowDeadlineNs.load(std::memory_order_relaxed);
+    }
+
+    int Fifo::getUnderflowWaitMs(const int maxMs) const
+    {
+        if (underflowPolicy.load(std::memory_order_relaxed) != UnderflowPolicy::insertSilence) return maxMs;
+
+        const auto deadline{underflowDeadlineNs.load(std::memory_order_relaxed)};
+        if (deadline == std::numeric_limits<int64_t>::max()) return maxMs;
+
+        const auto remainingNs{deadline - clock.now()};
+        return static_cast<int>(juce::jlimit(int64_t{0}, static_cast<int64_t>(maxMs), (remainingNs + 999'999) / 1'000'000));
+    }
+
     void Fifo::write(const juce::AudioBuffer<float> *src)
     {
+        ANANAS_TRACE_SCOPE("Fifo::write");
+
         // Try to acquire the lock. If the send thread is reading from the FIFO and
         // converting samples, the audio thread will wait here until the send thread
         // is done, which may not be perfectly ideal.
@@ -25,22 +94,56 @@ namespace ananas
         // scope — and the number of available samples is updated — before notifying
         // the send thread.
         {
-            const auto writeHandle{fifo.write(src->getNumSamples())};
+            auto numFrames{src->getNumSamples()};
+            auto srcOffset{0};
+
+            if (const auto freeSpace{fifo.getFreeSpace()}; numFrames > freeSpace) {
+                numOverflows.fetch_add(1, std::memory_order_relaxed);
+
+                if (overflowPolicy == OverflowPolicy::dropOldest) {
+                    // Of a block bigger than the whole FIFO, only the latest
+                    // frames can go in.
+                    srcOffset = std::max(0, numFrames - capacity.load(std::memory_order_relaxed));
+                    numFrames -= srcOffset;
+                    const auto numDiscarded{std::max(0, numFrames - freeSpace)};
+                    fifo.finishedRead(numDiscarded);
+                    numFramesRead += static_cast<uint64_t>(numDiscarded);
+                    numFramesOverflowed.fetch_add(static_cast<uint64_t>(srcOffset + numDiscarded), std::memory_order_relaxed);
+                } else {
+                    numFramesOverflowed.fetch_add(static_cast<uint64_t>(numFrames - freeSpace), std::memory_order_relaxed);
+                    numFrames = freeSpace;
+                }
+            }
+
+            const auto writeHandle{fifo.write(numFrames)};
 
             for (auto ch{0}; ch < std::min(buffer->getNumChannels(), src->getNumChannels()); ++ch) {
-                const auto readPointer{src->getReadPointer(ch)};
+                const auto readPointer{src->getReadPointer(ch, srcOffset)};
                 buffer->copyFrom(ch, writeHandle.startIndex1, readPointer, writeHandle.blockSize1);
                 buffer->copyFrom(ch, writeHandle.startIndex2, readPointer + writeHandle.blockSize1, writeHandle.blockSize2);
             }
+
+            const auto now{clock.now()};
+            numFramesWritten += static_cast<uint64_t>(writeHandle.blockSize1 + writeHandle.blockSize2);
+            writeRecords[nextWriteRecord++ % writeRecords.size()] = {numFramesWritten, now};
+
+            underflowing = false;
+            underflowDeadlineNs.store(now + underflowTimeoutNs, std::memory_order_relaxed);
         }
 
         // Tell the send thread to check the wait predicate, i.e. see if there are
         // enough samples ready to send.
         condition.notify_one();
+
+        if (auto *event = readyEvent.load(std::memory_order_acquire)) {
+            event->signal();
+        }
     }
 
-    void Fifo::read(uint8_t *dest, const int numFrames)
+    bool Fifo::read(uint8_t *dest, const int numFrames, int64_t *writeTimeNs)
     {
+        ANANAS_TRACE_SCOPE("Fifo::read");
+
         // Try to acquire the lock (std::unique_lock because that's what
         // condition_variable::wait() demands). If the audio thread is writing
         // to the FIFO, execution will pause here.
@@ -50,20 +153,23 @@ namespace ananas
         // will relinquish the lock until it is notified, at which point it will
         // try to reacquire the lock and check again.
         // If shouldStop evaluates to true, the plugin is probably being destroyed.
+        // An underflow deadline passing doesn't notify; the sender checks
+        // isUnderflowing() itself before reading.
         condition.wait(lock, [this, numFrames]
         {
-            return isReady(numFrames) || shouldStop.load();
+            return isReady(numFrames) || isUnderflowing(numFrames) || shouldStop.load();
         });
 
         // If by this point there aren't actually the requested number of samples
-        // available, or, more likely, shouldStop is true, the plugin is probably
-        // being destroyed so GTFO.
-        if (!isReady(numFrames) || shouldStop.load()) return;
+        // available (and no silence is due), or, more likely, shouldStop is
+        // true, the plugin is probably being destroyed so GTFO.
+        const auto numToRead{std::min(numFrames, fifo.getNumReady())};
+        if (shouldStop.load() || (numToRead < numFrames && !isUnderflowing(numFrames))) return false;
 
         // The wait predicate passed; read from the FIFO into the destination
         // buffer. NB, the send thread holds the lock until the end of this method;
         // probably fine, but in theory this could block the audio thread.
-        const auto readHandle{fifo.read(numFrames)};
+        const auto readHandle{fifo.read(numToRead)};
 
         // if (readHandle.blockSize1 + readHandle.blockSize2 != 128) {
         //     // DBG("Read num samples: " << readHandle.blockSize1 + readHandle.blockSize2);
@@ -75,16 +181,64 @@ namespace ananas
             converter->convertSamples(dest, ch, buffer->getReadPointer(ch, readHandle.startIndex1), 0, readHandle.blockSize1);
             converter->convertSamples(&dest[blockTwoOffset], ch, buffer->getReadPointer(ch, readHandle.startIndex2), 0, readHandle.blockSize2);
         }
+
+        if (writeTimeNs != nullptr) {
+            // Find the oldest recorded block that ends after the first frame
+            // read, i.e. the block that contains it.
+            *writeTimeNs = 0;
+            for (size_t i{0}; i < writeRecords.size(); ++i) {
+                const auto &record{writeRecords[(nextWriteRecord + i) % writeRecords.size()]};
+                if (record.endFrame > numFramesRead) {
+                    *writeTimeNs = record.timeNs;
+                    break;
+                }
+            }
+        }
+        numFramesRead += static_cast<uint64_t>(numToRead);
+
+        if (numToRead < numFrames) {
+            // Make up the rest with silence, and pace the next padding by the
+            // sample rate.
+            const auto frameSize{static_cast<size_t>(numChannels) * sizeof(int16_t)};
+            memset(&dest[static_cast<size_t>(numToRead) * frameSize], 0, static_cast<size_t>(numFrames - numToRead) * frameSize);
+
+            if (!underflowing) {
+                underflowing = true;
+                underflowStartNs = underflowDeadlineNs.load(std::memory_order_relaxed);
+                numFramesPadded = 0;
+                numUnderflows.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            numFramesPadded += static_cast<uint64_t>(numFrames - numToRead);
+            numFramesUnderflowed.fetch_add(static_cast<uint64_t>(numFrames - numToRead), std::memory_order_relaxed);
+            underflowDeadlineNs.store(underflowStartNs + static_cast<int64_t>(static_cast<double>(numFramesPadded) * Server::Constants::NSPS / sampleRate),
+                                      std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+    int Fifo::getCapacity() const
+    {
+        return capacity.load(std::memory_order_relaxed);
+    }
+
+    float Fifo::getFillLevel() const
+    {
+        const auto frames{capacity.load(std::memory_order_relaxed)};
+        return frames > 0 ? static_cast<float>(fifo.getNumReady()) / static_cast<float>(frames) : 0.f;
     }
 
-    void Fifo::timerCallback()
+    juce::var Fifo::getStats() const
     {
-#if JUCE_DEBUG
-        // std::cout << '\r' << "FIFO size:" << std::setw(6) << fifo.getTotalSize() <<
-        //         " | frames ready:" << std::setw(6) << fifo.getNumReady() <<
-        //         " | free space:" << std::setw(6) << fifo.getFreeSpace() <<
-        //         std::flush;
-#endif
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::FifoCapacityPropertyID, getCapacity());
+        object->setProperty(Utils::Identifiers::FifoFillPropertyID, getFillLevel());
+        object->setProperty(Utils::Identifiers::FifoOverflowsPropertyID, static_cast<juce::int64>(numOverflows.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::FifoOverflowFramesPropertyID, static_cast<juce::int64>(numFramesOverflowed.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::FifoUnderflowsPropertyID, static_cast<juce::int64>(numUnderflows.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::FifoUnderflowFramesPropertyID, static_cast<juce::int64>(numFramesUnderflowed.load(std::memory_order_relaxed)));
+        return object;
     }
 
     void Fifo::abortRead()
@@ -94,4 +248,28 @@ namespace ananas
         shouldStop = true;
         condition.notify_all();
     }
+
+    void Fifo::resumeRead()
+    {
+        shouldStop = false;
+    }
+
+    void Fifo::setReadyEvent(juce::WaitableEvent *event)
+    {
+        readyEvent.store(event, std::memory_order_release);
+    }
+
+    size_t Fifo::lockMemory()
+    {
+        size_t numLocked{0};
+        const auto numBytes{static_cast<size_t>(buffer->getNumSamples()) * sizeof(float)};
+
+        for (auto ch{0}; ch < buffer->getNumChannels(); ++ch) {
+            if (ananas::lockMemory(buffer->getWritePointer(ch), numBytes)) {
+                numLocked += numBytes;
+            }
+        }
+
+        return numLocked;
+    }
 }
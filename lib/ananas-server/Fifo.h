@@ -2,7 +2,8 @@
 #define ANANASFIFO_H
 
 #include <juce_audio_basics/juce_audio_basics.h>
-#include <juce_events/juce_events.h>
+#include <optional>
+#include "Clock.h"
 #include "ServerUtils.h"
 
 using FormatConverter = juce::AudioData::ConverterInstance<
@@ -22,10 +23,71 @@ using FormatConverter = juce::AudioData::ConverterInstance<
 
 namespace ananas
 {
-    class Fifo final : juce::Timer
+    class Fifo final
     {
     public:
-        explicit Fifo(uint8_t numChannels);
+        /**
+         * What write() does with a block that won't fit.
+         */
+        enum class OverflowPolicy
+        {
+            /**
+             * Write as much of the block as fits, and drop the rest.
+             */
+            dropNewest,
+            /**
+             * Discard the oldest audio in the FIFO to make room for the
+             * block, so that the latest audio always goes out.
+             */
+            dropOldest
+        };
+
+        /**
+         * What the reader does when the audio thread stops writing.
+         */
+        enum class UnderflowPolicy
+        {
+            /**
+             * Wait for more audio; nothing is sent in the meantime.
+             */
+            wait,
+            /**
+             * Once the FIFO has gone a block and the target latency (see
+             * prepare()) without a write, pad reads with silence, at the sample rate, so
+             * that clients keep receiving a continuous stream.
+             */
+            insertSilence
+        };
+
+        /**
+         * @param clock Times writes and underflow deadlines; a simulated
+         * server's VirtualClock, say.
+         */
+        explicit Fifo(uint8_t numChannels, Clock &clock = Clock::getSystem());
+
+        /**
+         * @param name "drop-newest" or "drop-oldest".
+         */
+        static std::optional<OverflowPolicy> parseOverflowPolicy(const juce::String &name);
+
+        /**
+         * @param name "wait" or "silence".
+         */
+        static std::optional<UnderflowPolicy> parseUnderflowPolicy(const juce::String &name);
+
+        /**
+         * Size the FIFO for the host's block size and the sample rate: room
+         * for two blocks (one being written while the last is still being
+         * read) and the target latency more, for the reader to fall behind
+         * by. The writer, likewise, may be a block and the target latency
+         * late before the FIFO underflows. Call while neither thread is
+         * using the FIFO.
+         */
+        void prepare(int samplesPerBlockExpected,
+                     double sampleRate,
+                     int64_t targetLatencyNs = Server::Constants::DefaultFifoTargetLatencyNs);
+
+        void setPolicies(OverflowPolicy overflow, UnderflowPolicy underflow);
 
         /**
          * Used as a condition_variable predicate.
@@ -35,7 +97,21 @@ namespace ananas
         [[nodiscard]] bool isReady(int framesRequested) const;
 
         /**
-         * Write some samples to the FIFO. Called by the audio thread.
+         * @return true if the FIFO is short of framesRequested, and the
+         * underflow policy says that read() should make up the difference
+         * with silence now.
+         */
+        [[nodiscard]] bool isUnderflowing(int framesRequested) const;
+
+        /**
+         * @return How long the reader may wait for a write before it should
+         * check isUnderflowing() again, up to maxMs.
+         */
+        [[nodiscard]] int getUnderflowWaitMs(int maxMs) const;
+
+        /**
+         * Write some samples to the FIFO. Called by the audio thread. If they
+         * don't all fit, the overflow policy decides what's lost.
          * @param src
          */
         void write(const juce::AudioBuffer<float> *src);
@@ -44,20 +120,93 @@ namespace ananas
          * Read some samples from the FIFO. Called by the network send thread.
          * @param dest
          * @param numFrames
+         * @param writeTimeNs If not null, set to the time (on the FIFO's
+         * Clock) at which the first frame read was written.
+         * @return false if the read was aborted.
+         */
+        bool read(uint8_t *dest, int numFrames, int64_t *writeTimeNs = nullptr);
+
+        /**
+         * @return The capacity set by prepare(), in frames.
          */
-        void read(uint8_t *dest, int numFrames);
+        [[nodiscard]] int getCapacity() const;
 
-        void timerCallback() override;
+        /**
+         * @return How full the FIFO is, from 0 to 1; safe to call from any
+         * thread, e.g. to steer the rate at which it's written.
+         */
+        [[nodiscard]] float getFillLevel() const;
+
+        /**
+         * @return Capacity, fill level, and overflow and underflow counts.
+         */
+        [[nodiscard]] juce::var getStats() const;
 
         void abortRead();
 
+        /**
+         * Undo abortRead(), so that the FIFO can be read again after a
+         * restart.
+         */
+        void resumeRead();
+
+        /**
+         * Set an event to be signalled whenever samples are written, so that
+         * one thread can wait on several FIFOs.
+         */
+        void setReadyEvent(juce::WaitableEvent *event);
+
+        /**
+         * Lock the sample buffer into RAM; see ananas::lockMemory().
+         * @return The number of bytes locked.
+         */
+        size_t lockMemory();
+
     private:
-        juce::AbstractFifo fifo{Server::Constants::FifoCapacityFrames};
+        const uint8_t numChannels;
+        Clock &clock;
+        // One more than the capacity; AbstractFifo keeps a slot free.
+        juce::AbstractFifo fifo{1};
         std::unique_ptr<juce::AudioBuffer<float>> buffer;
         std::unique_ptr<FormatConverter> converter;
         std::mutex mutex;
         std::condition_variable condition;
         std::atomic<bool> shouldStop{false};
+        std::atomic<juce::WaitableEvent *> readyEvent{nullptr};
+
+        // Guarded by mutex.
+        OverflowPolicy overflowPolicy{OverflowPolicy::dropNewest};
+        // Set under mutex; read without it by the sender, and by anything
+        // polling the fill level.
+        std::atomic<UnderflowPolicy> underflowPolicy{UnderflowPolicy::wait};
+        std::atomic<int> capacity{0};
+        double sampleRate{0};
+        int64_t underflowTimeoutNs{0};
+        // When, if the FIFO is short, reads should be padded with silence;
+        // pushed back by every write, and by every frame of silence.
+        std::atomic<int64_t> underflowDeadlineNs{std::numeric_limits<int64_t>::max()};
+        // Guarded by mutex.
+        bool underflowing{false};
+        int64_t underflowStartNs{0};
+        uint64_t numFramesPadded{0};
+
+        std::atomic<uint64_t> numOverflows{0};
+        std::atomic<uint64_t> numFramesOverflowed{0};
+        std::atomic<uint64_t> numUnderflows{0};
+        std::atomic<uint64_t> numFramesUnderflowed{0};
+
+        // When recent blocks were written, for measuring FIFO residency.
+        // Guarded by mutex.
+        struct WriteRecord
+        {
+            uint64_t endFrame{0};
+            int64_t timeNs{0};
+        };
+
+        std::array<WriteRecord, 64> writeRecords{};
+        size_t nextWriteRecord{0};
+        uint64_t numFramesWritten{0};
+        uint64_t numFramesRead{0};
     };
 }
 
@@ -0,0 +1,340 @@
+#include "Logger.h"
+#include <cstdarg>
+
+namespace
+{
+    int64_t getTimeNs(const clockid_t clock)
+    {
+        timespec ts{};
+        clock_gettime(clock, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+}
+
+namespace ananas
+{
+    Logger::RateLimit::RateLimit(const int maxPerSecond)
+        : maxPerSecond(static_cast<uint32_t>(juce::jlimit(1, 0xffff, maxPerSecond)))
+    {
+    }
+
+    bool Logger::RateLimit::allow(const int64_t nowNs, uint32_t &numSuppressed)
+    {
+        const auto window{static_cast<uint32_t>(nowNs / 1'000'000'000)};
+
+        auto current{state.load(std::memory_order_relaxed)};
+        for (;;) {
+            auto numInWindow{static_cast<uint32_t>(current >> 32 & 0xffff)};
+            const auto suppressed{static_cast<uint32_t>(current >> 48)};
+
+            if (static_cast<uint32_t>(current) != window) {
+                numInWindow = 0;
+            }
+
+            const auto allowed{numInWindow < maxPerSecond};
+            const auto next{
+                window
+                | static_cast<uint64_t>(allowed ? numInWindow + 1 : numInWindow) << 32
+                | static_cast<uint64_t>(allowed ? 0 : std::min(suppressed + 1, 0xffffu)) << 48
+            };
+
+            if (state.compare_exchange_weak(current, next, std::memory_order_relaxed)) {
+                numSuppressed = allowed ? suppressed : 0;
+                return allowed;
+            }
+        }
+    }
+
+    //==========================================================================
+
+    Logger::Logger() : Thread("Ananas Logger")
+    {
+    }
+
+    Logger::~Logger()
+    {
+        stopThread(1000);
+        drain();
+    }
+
+    Logger &Logger::getInstance()
+    {
+        static Logger instance;
+        return instance;
+    }
+
+    Logger::Record *Logger::beginRecord(const Level level, RateLimit &rateLimit, ThreadRing *&ring)
+    {
+        if (level < getInstance().level.load(std::memory_order_relaxed)) return nullptr;
+
+        uint32_t numSuppressed{0};
+        if (!rateLimit.allow(getTimeNs(CLOCK_MONOTONIC), numSuppressed)) return nullptr;
+
+        ring = &getThreadRing();
+
+        // Single producer: only this thread advances head.
+        const auto head{ring->head.load(std::memory_order_relaxed)};
+        if (head - ring->tail.load(std::memory_order_acquire) >= RecordsPerThread) {
+            ring->numDropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto &record{ring->records[head % RecordsPerThread]};
+        record.timeNs = getTimeNs(CLOCK_REALTIME);
+        record.level = level;
+        record.numSuppressed = numSuppressed;
+        record.numArguments = 0;
+        record.stringsSize = 0;
+        return &record;
+    }
+
+    void Logger::endRecord(ThreadRing &ring)
+    {
+        ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    size_t Logger::copyString(Record &record, const char *string)
+    {
+        const auto offset{record.stringsSize};
+        auto *dest{&record.strings[offset]};
+        const auto space{sizeof(record.strings) - offset};
+
+        // There's always room for at least the terminator: no more
+        // than MaxArguments strings are ever copied.
+        const auto length{strnlen(string != nullptr ? string : "(null)", space - 1)};
+        memcpy(dest, string != nullptr ? string : "(null)", length);
+        dest[length] = '\0';
+        record.stringsSize += length + 1;
+
+        return offset;
+    }
+
+    void Logger::setLevel(const Level minimumLevel)
+    {
+        getInstance().level.store(minimumLevel, std::memory_order_relaxed);
+    }
+
+    void Logger::attach()
+    {
+        auto &logger{getInstance()};
+        if (logger.numAttached.fetch_add(1) == 0) {
+            logger.startThread();
+        }
+    }
+
+    void Logger::detach()
+    {
+        auto &logger{getInstance()};
+        if (logger.numAttached.fetch_sub(1) == 1) {
+            logger.stopThread(1000);
+            logger.drain();
+        }
+    }
+
+    void Logger::setThreadName(const juce::String &name)
+    {
+        auto &ring{getThreadRing()};
+        name.copyToUTF8(ring.threadName, sizeof(ring.threadName));
+    }
+
+    const char *Logger::levelToString(const Level level)
+    {
+        switch (level) {
+            case Level::debug: return "D";
+            case Level::info: return "I";
+            case Level::warning: return "W";
+            case Level::error: return "E";
+            default: return "?";
+        }
+    }
+
+    Logger::ThreadRing &Logger::getThreadRing()
+    {
+        // Flags the ring, when the thread exits, for the drain to free once
+        // it's written out the last of the thread's messages.
+        struct Owner
+        {
+            ThreadRing *ring{nullptr};
+
+            ~Owner()
+            {
+                if (ring != nullptr) {
+                    ring->threadExited.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        thread_local Owner owner;
+
+        if (owner.ring == nullptr) {
+            auto newRing{std::make_unique<ThreadRing>()};
+            if (const auto *t = juce::Thread::getCurrentThread()) {
+                t->getThreadName().copyToUTF8(newRing->threadName, sizeof(newRing->threadName));
+            }
+
+            auto &logger{getInstance()};
+            const std::lock_guard lock{logger.ringsMutex};
+            owner.ring = newRing.get();
+            logger.rings.push_back(std::move(newRing));
+        }
+
+        return *owner.ring;
+    }
+
+    void Logger::run()
+    {
+        while (!threadShouldExit()) {
+            drain();
+            wait(DrainIntervalMs);
+        }
+    }
+
+    void Logger::drain()
+    {
+        // Messages from different threads may come out slightly out of
+        // order; each carries its own timestamp.
+        const std::lock_guard drainLock{drainMutex};
+
+        {
+            const std::lock_guard lock{ringsMutex};
+            ringsToDrain.clear();
+            for (const auto &ring: rings) {
+                ringsToDrain.push_back(ring.get());
+            }
+        }
+
+        auto wroteAny{false}, anyFinished{false};
+
+        for (auto *ring: ringsToDrain) {
+            // Read before head, so that nothing the thread logged before it
+            // exited is missed.
+            const auto exited{ring->threadExited.load(std::memory_order_acquire)};
+            const auto head{ring->head.load(std::memory_order_acquire)};
+            auto tail{ring->tail.load(std::memory_order_relaxed)};
+
+            for (; tail != head; ++tail) {
+                write(*ring, ring->records[tail % RecordsPerThread]);
+                wroteAny = true;
+            }
+            ring->tail.store(tail, std::memory_order_release);
+
+            if (const auto dropped{ring->numDropped.load(std::memory_order_relaxed)}; dropped != ring->numDroppedReported) {
+                fprintf(stderr, "[W] %s: %llu log messages dropped (ring full)\n",
+                        ring->threadName, static_cast<unsigned long long>(dropped - ring->numDroppedReported));
+                ring->numDroppedReported = dropped;
+                wroteAny = true;
+            }
+
+            anyFinished = anyFinished || exited;
+        }
+
+        if (wroteAny) {
+            fflush(stdout);
+            fflush(stderr);
+        }
+
+        if (anyFinished) {
+            const std::lock_guard lock{ringsMutex};
+            rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::unique_ptr<ThreadRing> &ring)
+            {
+                return ring->threadExited.load(std::memory_order_acquire)
+                       && ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_acquire);
+            }), rings.end());
+        }
+    }
+
+    void Logger::formatMessage(const Record &record, char *message, const size_t size)
+    {
+        size_t length{0};
+        size_t nextArgument{0};
+        const auto *f{record.format};
+
+        while (*f != '\0' && length + 1 < size) {
+            if (*f != '%') {
+                message[length++] = *f++;
+                continue;
+            }
+
+            if (f[1] == '%') {
+                message[length++] = '%';
+                f += 2;
+                continue;
+            }
+
+            // Keep the conversion's flags, width and precision; the length
+            // modifier follows from the type of the captured argument.
+            char spec[32]{'%'};
+            size_t specLength{1};
+            for (++f; *f != '\0' && strchr("-+ #0123456789.", *f) != nullptr; ++f) {
+                if (specLength < sizeof(spec) - 4) spec[specLength++] = *f;
+            }
+            while (*f != '\0' && strchr("hlLqjzt", *f) != nullptr) ++f;
+            if (*f == '\0' || nextArgument >= record.numArguments) break;
+
+            const auto conversion{*f++};
+            const auto &argument{record.arguments[nextArgument++]};
+            auto *out{&message[length]};
+            const auto space{size - length};
+            auto n{0};
+
+            switch (argument.type) {
+                case Argument::Type::string:
+                    spec[specLength] = 's';
+                    n = snprintf(out, space, spec, &record.strings[argument.integer]);
+                    break;
+                case Argument::Type::floatingPoint:
+                    spec[specLength] = strchr("eEfFgGaA", conversion) != nullptr ? conversion : 'g';
+                    n = snprintf(out, space, spec, argument.real);
+                    break;
+                case Argument::Type::pointer:
+                    spec[specLength] = 'p';
+                    n = snprintf(out, space, spec, argument.pointer);
+                    break;
+                case Argument::Type::signedInteger:
+                case Argument::Type::unsignedInteger:
+                    if (strchr("ouxX", conversion) != nullptr
+                        || (conversion != 'd' && conversion != 'i' && argument.type == Argument::Type::unsignedInteger)) {
+                        spec[specLength++] = 'l';
+                        spec[specLength++] = 'l';
+                        spec[specLength] = strchr("ouxX", conversion) != nullptr ? conversion : 'u';
+                        n = snprintf(out, space, spec, static_cast<unsigned long long>(argument.integer));
+                    } else {
+                        spec[specLength++] = 'l';
+                        spec[specLength++] = 'l';
+                        spec[specLength] = 'd';
+                        n = snprintf(out, space, spec, static_cast<long long>(argument.integer));
+                    }
+                    break;
+            }
+
+            if (n > 0) {
+                length += std::min(static_cast<size_t>(n), space - 1);
+            }
+        }
+
+        message[length] = '\0';
+    }
+
+    void Logger::write(const ThreadRing &ring, const Record &record)
+    {
+        auto *stream{record.level >= Level::warning ? stderr : stdout};
+
+        // E.g. "[W 12:34:56.789012] Ananas Audio Sender: "
+        const time_t seconds{record.timeNs / 1'000'000'000};
+        tm local{};
+        localtime_r(&seconds, &local);
+        char prefix[sizeof(ring.threadName) + 32];
+        snprintf(prefix, sizeof(prefix), "[%s %02d:%02d:%02d.%06d] %s%s",
+                 levelToString(record.level), local.tm_hour, local.tm_min, local.tm_sec,
+                 static_cast<int>(record.timeNs % 1'000'000'000 / 1000),
+                 ring.threadName, ring.threadName[0] != '\0' ? ": " : "");
+
+        char message[MaxMessageLength];
+        formatMessage(record, message, sizeof(message));
+
+        if (record.numSuppressed > 0) {
+            fprintf(stream, "%s(%u similar messages suppressed)\n", prefix, record.numSuppressed);
+        }
+        fprintf(stream, "%s%s\n", prefix, message);
+    }
+}
@@ -0,0 +1,246 @@
+#ifndef ANANASLOGGER_H
+#define ANANASLOGGER_H
+
+#include <juce_core/juce_core.h>
+#include <type_traits>
+
+#define ANANAS_LOG(level, maxPerSecond, ...) \
+    do { \
+        static ananas::Logger::RateLimit ananasLogRateLimit{maxPerSecond}; \
+        if (false) ananas::Logger::checkFormat(__VA_ARGS__); \
+        ananas::Logger::log(level, ananasLogRateLimit, __VA_ARGS__); \
+    } while (false)
+
+#define ANANAS_LOG_DEBUG(...) ANANAS_LOG(ananas::Logger::Level::debug, ananas::Logger::DefaultMaxPerSecond, __VA_ARGS__)
+#define ANANAS_LOG_INFO(...) ANANAS_LOG(ananas::Logger::Level::info, ananas::Logger::DefaultMaxPerSecond, __VA_ARGS__)
+#define ANANAS_LOG_WARNING(...) ANANAS_LOG(ananas::Logger::Level::warning, ananas::Logger::DefaultMaxPerSecond, __VA_ARGS__)
+#define ANANAS_LOG_ERROR(...) ANANAS_LOG(ananas::Logger::Level::error, ananas::Logger::DefaultMaxPerSecond, __VA_ARGS__)
+
+namespace ananas
+{
+    /**
+     * An asynchronous logger that's safe to call from time-critical threads.
+     *
+     * A message is pushed, unformatted, to a single-producer, single-consumer
+     * ring belonging to the calling thread: a pointer to its printf-style
+     * format (which must be a string literal), its arguments, and a copy of
+     * any strings among them. A background thread drains the rings, formats
+     * the messages, and writes them to stdout (debug, info) or stderr
+     * (warning, error). Logging never allocates (after a thread's first
+     * message), locks, formats, or blocks on the terminal: if a ring is full,
+     * the message is dropped and counted. Each call site is rate-limited to
+     * so many messages per second, across all threads; the next message it
+     * lets through reports how many were suppressed. A thread's ring is freed
+     * once the thread has exited and its messages are out.
+     *
+     * The background thread runs while anything is attached(); until then,
+     * messages wait in their rings, and are written when it starts, or at
+     * exit.
+     */
+    class Logger final : juce::Thread
+    {
+    public:
+        enum class Level : uint8_t
+        {
+            debug = 0,
+            info,
+            warning,
+            error
+        };
+
+        constexpr static int DefaultMaxPerSecond{10};
+        constexpr static size_t MaxMessageLength{240};
+        constexpr static size_t MaxArguments{8};
+        constexpr static size_t RecordsPerThread{256};
+        constexpr static int DrainIntervalMs{20};
+
+        /**
+         * Per-call-site message rate limit, in one-second windows; see
+         * ANANAS_LOG.
+         */
+        class RateLimit
+        {
+        public:
+            explicit RateLimit(int maxPerSecond);
+
+            /**
+             * @param numSuppressed Set to the number of messages suppressed
+             * since the last one allowed.
+             */
+            bool allow(int64_t nowNs, uint32_t &numSuppressed);
+
+        private:
+            const uint32_t maxPerSecond;
+            // The window (whole seconds, low 32 bits), the number of
+            // messages allowed in it (16 bits) and the number suppressed
+            // since the last one allowed (16 bits), updated together.
+            std::atomic<uint64_t> state{0};
+        };
+
+        /**
+         * Arguments may be integers, enums, floating-point numbers, C
+         * strings (copied, truncated to what fits) and pointers.
+         */
+        template<typename... Args>
+        static void log(const Level level, RateLimit &rateLimit, const char *format, const Args &... args)
+        {
+            static_assert(sizeof...(Args) <= MaxArguments, "Too many arguments for a log message");
+
+            ThreadRing *ring;
+            if (auto *record{beginRecord(level, rateLimit, ring)}) {
+                record->format = format;
+                (capture(*record, args), ...);
+                endRecord(*ring);
+            }
+        }
+
+        /**
+         * Never called; lets the compiler check ANANAS_LOG arguments against
+         * their format.
+         */
+        static void checkFormat(const char *format, ...)
+#if defined(__GNUC__)
+            __attribute__((format(printf, 1, 2)))
+#endif
+        {
+            juce::ignoreUnused(format);
+        }
+
+        static void setLevel(Level minimumLevel);
+
+        /**
+         * Start the background thread, if it isn't already running. Pair
+         * with detach().
+         */
+        static void attach();
+
+        /**
+         * Once every attach() has been matched, write out whatever is left
+         * and stop the background thread.
+         */
+        static void detach();
+
+        /**
+         * Name the calling thread in log messages; by default, JUCE threads
+         * take their own names.
+         */
+        static void setThreadName(const juce::String &name);
+
+        static const char *levelToString(Level level);
+
+        ~Logger() override;
+
+    private:
+        struct Argument
+        {
+            enum class Type : uint8_t
+            {
+                signedInteger = 0,
+                unsignedInteger,
+                floatingPoint,
+                pointer,
+                // An offset into the record's strings.
+                string
+            };
+
+            Type type{Type::signedInteger};
+
+            union
+            {
+                int64_t integer{0};
+                double real;
+                const void *pointer;
+            };
+        };
+
+        struct Record
+        {
+            int64_t timeNs{0};
+            Level level{Level::info};
+            uint32_t numSuppressed{0};
+            const char *format{nullptr};
+            size_t numArguments{0};
+            std::array<Argument, MaxArguments> arguments{};
+            size_t stringsSize{0};
+            char strings[MaxMessageLength]{};
+        };
+
+        struct ThreadRing
+        {
+            char threadName[32]{};
+            std::array<Record, RecordsPerThread> records{};
+            std::atomic<uint64_t> head{0};
+            std::atomic<uint64_t> tail{0};
+            std::atomic<uint64_t> numDropped{0};
+            uint64_t numDroppedReported{0};
+            std::atomic<bool> threadExited{false};
+        };
+
+        Logger();
+
+        static Logger &getInstance();
+
+        static ThreadRing &getThreadRing();
+
+        /**
+         * @return The record to fill in, or nullptr if the message is
+         * filtered out, rate-limited, or the ring is full.
+         */
+        static Record *beginRecord(Level level, RateLimit &rateLimit, ThreadRing *&ring);
+
+        static void endRecord(ThreadRing &ring);
+
+        template<typename T>
+        static void capture(Record &record, const T &value)
+        {
+            auto &argument{record.arguments[record.numArguments++]};
+            using Value = std::decay_t<T>;
+
+            if constexpr (std::is_same_v<Value, const char *> || std::is_same_v<Value, char *>) {
+                argument.type = Argument::Type::string;
+                argument.integer = static_cast<int64_t>(copyString(record, value));
+            } else if constexpr (std::is_floating_point_v<Value>) {
+                argument.type = Argument::Type::floatingPoint;
+                argument.real = static_cast<double>(value);
+            } else if constexpr (std::is_enum_v<Value>) {
+                argument.type = Argument::Type::signedInteger;
+                argument.integer = static_cast<int64_t>(static_cast<std::underlying_type_t<Value>>(value));
+            } else if constexpr (std::is_integral_v<Value> && std::is_signed_v<Value>) {
+                argument.type = Argument::Type::signedInteger;
+                argument.integer = static_cast<int64_t>(value);
+            } else if constexpr (std::is_integral_v<Value>) {
+                argument.type = Argument::Type::unsignedInteger;
+                argument.integer = static_cast<int64_t>(static_cast<uint64_t>(value));
+            } else {
+                static_assert(std::is_pointer_v<Value>, "Unsupported log argument type");
+                argument.type = Argument::Type::pointer;
+                argument.pointer = value;
+            }
+        }
+
+        /**
+         * @return The string's offset in the record's strings.
+         */
+        static size_t copyString(Record &record, const char *string);
+
+        void run() override;
+
+        void drain();
+
+        static void formatMessage(const Record &record, char *message, size_t size);
+
+        static void write(const ThreadRing &ring, const Record &record);
+
+        std::atomic<Level> level{Level::info};
+        std::atomic<int> numAttached{0};
+        // Held while draining, so that only one thread writes at a time.
+        std::mutex drainMutex;
+        // Held only to add or remove rings; never by a thread that's logging
+        // (after its first message), nor while writing.
+        std::mutex ringsMutex;
+        std::vector<std::unique_ptr<ThreadRing>> rings;
+        std::vector<ThreadRing *> ringsToDrain;
+    };
+}
+
+#endif //ANANASLOGGER_H
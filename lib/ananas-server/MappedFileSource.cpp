@@ -0,0 +1,454 @@
+#include "MappedFileSource.h"
+#include "ServerUtils.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ananas
+{
+    namespace
+    {
+        constexpr uint16_t WaveFormatPcm{0x0001};
+        constexpr uint16_t WaveFormatFloat{0x0003};
+        constexpr uint16_t WaveFormatExtensible{0xfffe};
+
+        constexpr uint8_t W64RiffGuid[16]{
+            'r', 'i', 'f', 'f', 0x2e, 0x91, 0xcf, 0x11, 0xa5, 0xd6, 0x28, 0xdb, 0x04, 0xc1, 0x00, 0x00
+        };
+        constexpr uint8_t W64WaveGuid[16]{
+            'w', 'a', 'v', 'e', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a
+        };
+        constexpr uint8_t W64FmtGuid[16]{
+            'f', 'm', 't', ' ', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a
+        };
+        constexpr uint8_t W64DataGuid[16]{
+            'd', 'a', 't', 'a', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a
+        };
+
+        uint16_t read16(const uint8_t *p)
+        {
+            return juce::ByteOrder::littleEndianShort(p);
+        }
+
+        uint32_t read32(const uint8_t *p)
+        {
+            return juce::ByteOrder::littleEndianInt(p);
+        }
+
+        uint64_t read64(const uint8_t *p)
+        {
+            return juce::ByteOrder::littleEndianInt64(p);
+        }
+    }
+
+    std::unique_ptr<MappedFileSource> MappedFileSource::open(const juce::File &file, juce::String &error)
+    {
+        const auto fd{::open(file.getFullPathName().toRawUTF8(), O_RDONLY | O_CLOEXEC)};
+        if (fd < 0) {
+            error = juce::String{"Can't open file: "} + strerror(errno);
+            return nullptr;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || st.st_size < 12) {
+            error = "Not an audio file";
+            close(fd);
+            return nullptr;
+        }
+
+        const auto size{static_cast<size_t>(st.st_size)};
+        auto *mapping{mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)};
+        // The mapping holds its own reference to the file.
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            error = juce::String{"Can't map file: "} + strerror(errno);
+            return nullptr;
+        }
+
+        // Read-ahead happens on the prefetch thread, but the kernel may as
+        // well read generously while it's at it.
+        madvise(mapping, size, MADV_SEQUENTIAL);
+
+        const auto *bytes{static_cast<const uint8_t *>(mapping)};
+        Layout layout;
+        auto ok{false};
+        if (memcmp(bytes, "RIFF", 4) == 0 || memcmp(bytes, "RF64", 4) == 0) {
+            ok = parseRiff(bytes, size, layout, error);
+        } else if (size >= 40 && memcmp(bytes, W64RiffGuid, sizeof(W64RiffGuid)) == 0) {
+            ok = parseW64(bytes, size, layout, error);
+        } else {
+            error = "Not a WAV, RF64 or W64 file";
+        }
+
+        if (!ok) {
+            munmap(mapping, size);
+            return nullptr;
+        }
+
+        return std::unique_ptr<MappedFileSource>(new MappedFileSource(bytes, size, layout));
+    }
+
+    MappedFileSource::MappedFileSource(const uint8_t *mapping, const size_t mappingSize, const Layout &layout)
+        : Thread(Server::Threads::PlaybackPrefetchThreadParams.name),
+          mapping(mapping),
+          mappingSize(mappingSize),
+          data(mapping + layout.dataOffset),
+          numFrames(static_cast<juce::int64>(layout.dataSize / (layout.bytesPerSample * static_cast<size_t>(layout.numChannels)))),
+          numChannels(layout.numChannels),
+          sampleRate(layout.sampleRate),
+          format(layout.format),
+          bytesPerSample(layout.bytesPerSample),
+          frameSize(layout.bytesPerSample * static_cast<size_t>(layout.numChannels))
+    {
+    }
+
+    MappedFileSource::~MappedFileSource()
+    {
+        releaseResources();
+        munmap(const_cast<uint8_t *>(mapping), mappingSize);
+    }
+
+    void MappedFileSource::setChannelMap(std::vector<int> map)
+    {
+        channelMap = std::move(map);
+    }
+
+    std::optional<std::vector<int> > MappedFileSource::parseChannelMap(const juce::String &spec)
+    {
+        std::vector<int> map;
+
+        for (const auto &token: juce::StringArray::fromTokens(spec, ",", "")) {
+            const auto entry{token.trim()};
+
+            if (entry == "-") {
+                map.push_back(-1);
+            } else if (entry.containsOnly("0123456789")) {
+                map.push_back(entry.getIntValue());
+            } else if (const auto first{entry.upToFirstOccurrenceOf("-", false, false)},
+                           last{entry.fromFirstOccurrenceOf("-", false, false)};
+                       first.isNotEmpty() && first.containsOnly("0123456789")
+                       && last.isNotEmpty() && last.containsOnly("0123456789")) {
+                const auto from{first.getIntValue()}, to{last.getIntValue()};
+                for (auto ch{from}; from <= to ? ch <= to : ch >= to; from <= to ? ++ch : --ch) {
+                    map.push_back(ch);
+                }
+            } else {
+                return std::nullopt;
+            }
+        }
+
+        if (map.empty()) {
+            return std::nullopt;
+        }
+
+        return map;
+    }
+
+    int MappedFileSource::getNumChannels() const
+    {
+        return numChannels;
+    }
+
+    double MappedFileSource::getSampleRate() const
+    {
+        return sampleRate;
+    }
+
+    void MappedFileSource::prepareToPlay(int, double)
+    {
+        releaseResources();
+
+        prefetchFrames = static_cast<juce::int64>(sampleRate * Server::Constants::PlaybackPrefetchNs / Server::Constants::NSPS);
+        prefetchedTo = -1;
+        startThread();
+    }
+
+    void MappedFileSource::releaseResources()
+    {
+        stopThread(Server::Threads::PlaybackPrefetchThreadParams.timeoutMs);
+    }
+
+    void MappedFileSource::getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill)
+    {
+        auto &buffer{*bufferToFill.buffer};
+        auto pos{position.load(std::memory_order_relaxed)};
+        const auto loop{looping.load(std::memory_order_relaxed)};
+        auto done{0};
+
+        while (done < bufferToFill.numSamples) {
+            if (pos >= numFrames) {
+                if (!loop || numFrames == 0) {
+                    for (auto ch{0}; ch < buffer.getNumChannels(); ++ch) {
+                        buffer.clear(ch, bufferToFill.startSample + done, bufferToFill.numSamples - done);
+                    }
+                    break;
+                }
+                pos = 0;
+            }
+
+            const auto n{static_cast<int>(std::min(static_cast<juce::int64>(bufferToFill.numSamples - done), numFrames - pos))};
+            const auto *frame{data + static_cast<size_t>(pos) * frameSize};
+
+            for (auto ch{0}; ch < buffer.getNumChannels(); ++ch) {
+                const auto source{
+                    channelMap.empty() ? ch : static_cast<size_t>(ch) < channelMap.size() ? channelMap[static_cast<size_t>(ch)] : -1
+                };
+                auto *dest{buffer.getWritePointer(ch, bufferToFill.startSample + done)};
+
+                if (source < 0 || source >= numChannels) {
+                    juce::FloatVectorOperations::clear(dest, n);
+                } else {
+                    convert(frame + static_cast<size_t>(source) * bytesPerSample, frameSize, format, dest, n);
+                }
+            }
+
+            pos += n;
+            done += n;
+        }
+
+        position.store(pos, std::memory_order_relaxed);
+    }
+
+    void MappedFileSource::setNextReadPosition(const juce::int64 newPosition)
+    {
+        position.store(juce::jlimit(juce::int64{0}, numFrames, newPosition), std::memory_order_relaxed);
+        // Catch up with a seek straight away.
+        notify();
+    }
+
+    juce::int64 MappedFileSource::getNextReadPosition() const
+    {
+        return position.load(std::memory_order_relaxed);
+    }
+
+    juce::int64 MappedFileSource::getTotalLength() const
+    {
+        return numFrames;
+    }
+
+    bool MappedFileSource::isLooping() const
+    {
+        return looping.load(std::memory_order_relaxed);
+    }
+
+    void MappedFileSource::setLooping(const bool shouldLoop)
+    {
+        looping.store(shouldLoop, std::memory_order_relaxed);
+    }
+
+    bool MappedFileSource::parseRiff(const uint8_t *file, const size_t size, Layout &layout, juce::String &error)
+    {
+        if (memcmp(file + 8, "WAVE", 4) != 0) {
+            error = "Not a WAV file";
+            return false;
+        }
+
+        // RF64 keeps the sizes that don't fit in 32 bits in a ds64 chunk.
+        std::optional<uint64_t> ds64DataSize;
+        auto haveFormat{false};
+
+        for (size_t offset{12}; offset + 8 <= size;) {
+            const auto *chunk{file + offset};
+            uint64_t chunkSize{read32(chunk + 4)};
+
+            if (memcmp(chunk, "ds64", 4) == 0 && chunkSize >= 16 && offset + 8 + 16 <= size) {
+                ds64DataSize = read64(chunk + 16);
+            } else if (memcmp(chunk, "fmt ", 4) == 0) {
+                if (offset + 8 + chunkSize > size || !parseFormat(chunk + 8, chunkSize, layout, error)) {
+                    if (error.isEmpty()) error = "Truncated format chunk";
+                    return false;
+                }
+                haveFormat = true;
+            } else if (memcmp(chunk, "data", 4) == 0) {
+                if (!haveFormat) {
+                    error = "Data before format";
+                    return false;
+                }
+                if (chunkSize == 0xffffffff && ds64DataSize.has_value()) {
+                    chunkSize = *ds64DataSize;
+                }
+                layout.dataOffset = offset + 8;
+                // A recording that was cut short may claim more than is there.
+                layout.dataSize = std::min<uint64_t>(chunkSize, size - layout.dataOffset);
+                return true;
+            }
+
+            // Chunks are padded to an even size.
+            offset += 8 + chunkSize + (chunkSize & 1);
+        }
+
+        error = "No audio data";
+        return false;
+    }
+
+    bool MappedFileSource::parseW64(const uint8_t *file, const size_t size, Layout &layout, juce::String &error)
+    {
+        if (memcmp(file + 24, W64WaveGuid, sizeof(W64WaveGuid)) != 0) {
+            error = "Not a W64 file";
+            return false;
+        }
+
+        auto haveFormat{false};
+
+        // Chunk sizes include the 24-byte header; chunks are 8-byte aligned.
+        for (size_t offset{40}; offset + 24 <= size;) {
+            const auto *chunk{file + offset};
+            const auto chunkSize{read64(chunk + 16)};
+            if (chunkSize < 24) {
+                error = "Malformed chunk";
+                return false;
+            }
+
+            if (memcmp(chunk, W64FmtGuid, sizeof(W64FmtGuid)) == 0) {
+                if (offset + chunkSize > size || !parseFormat(chunk + 24, chunkSize - 24, layout, error)) {
+                    if (error.isEmpty()) error = "Truncated format chunk";
+                    return false;
+                }
+                haveFormat = true;
+            } else if (memcmp(chunk, W64DataGuid, sizeof(W64DataGuid)) == 0) {
+                if (!haveFormat) {
+                    error = "Data before format";
+                    return false;
+                }
+                layout.dataOffset = offset + 24;
+                layout.dataSize = std::min<uint64_t>(chunkSize - 24, size - layout.dataOffset);
+                return true;
+            }
+
+            offset += (chunkSize + 7) & ~uint64_t{7};
+        }
+
+        error = "No audio data";
+        return false;
+    }
+
+    bool MappedFileSource::parseFormat(const uint8_t *chunk, const uint64_t size, Layout &layout, juce::String &error)
+    {
+        if (size < 16) {
+            error = "Truncated format chunk";
+            return false;
+        }
+
+        auto tag{read16(chunk)};
+        layout.numChannels = read16(chunk + 2);
+        layout.sampleRate = read32(chunk + 4);
+        const auto blockAlign{read16(chunk + 12)};
+        const auto bitsPerSample{read16(chunk + 14)};
+
+        if (tag == WaveFormatExtensible) {
+            if (size < 40) {
+                error = "Truncated extensible format";
+                return false;
+            }
+            // The first two bytes of the subformat GUID are the format tag.
+            tag = read16(chunk + 24);
+        }
+
+        if (tag == WaveFormatPcm && bitsPerSample == 16) {
+            layout.format = SampleFormat::int16;
+        } else if (tag == WaveFormatPcm && bitsPerSample == 24) {
+            layout.format = SampleFormat::int24;
+        } else if (tag == WaveFormatPcm && bitsPerSample == 32) {
+            layout.format = SampleFormat::int32;
+        } else if (tag == WaveFormatFloat && bitsPerSample == 32) {
+            layout.format = SampleFormat::float32;
+        } else {
+            error = "Unsupported sample format (format " + juce::String{tag} + ", " + juce::String{bitsPerSample} + " bits)";
+            return false;
+        }
+
+        layout.bytesPerSample = bitsPerSample / 8;
+
+        if (layout.numChannels < 1 || layout.sampleRate <= 0.
+            || blockAlign != layout.bytesPerSample * static_cast<size_t>(layout.numChannels)) {
+            error = "Malformed format chunk";
+            return false;
+        }
+
+        return true;
+    }
+
+    void MappedFileSource::convert(const uint8_t *source, const size_t stride, const SampleFormat format, float *dest, const int numFrames)
+    {
+        switch (format) {
+            case SampleFormat::int16:
+                for (auto i{0}; i < numFrames; ++i, source += stride) {
+                    dest[i] = static_cast<float>(static_cast<int16_t>(juce::ByteOrder::littleEndianShort(source))) / 32768.f;
+                }
+                break;
+            case SampleFormat::int24:
+                for (auto i{0}; i < numFrames; ++i, source += stride) {
+                    dest[i] = static_cast<float>(juce::ByteOrder::littleEndian24Bit(source)) / 8388608.f;
+                }
+                break;
+            case SampleFormat::int32:
+                for (auto i{0}; i < numFrames; ++i, source += stride) {
+                    dest[i] = static_cast<float>(static_cast<int32_t>(juce::ByteOrder::littleEndianInt(source))) / 2147483648.f;
+                }
+                break;
+            case SampleFormat::float32:
+                for (auto i{0}; i < numFrames; ++i, source += stride) {
+                    const auto bits{juce::ByteOrder::littleEndianInt(source)};
+                    memcpy(&dest[i], &bits, sizeof(float));
+                }
+                break;
+        }
+    }
+
+    void MappedFileSource::run()
+    {
+        const auto window{std::min(prefetchFrames, numFrames)};
+
+        while (!threadShouldExit()) {
+            const auto pos{position.load(std::memory_order_relaxed)};
+            const auto loop{looping.load(std::memory_order_relaxed)};
+            const auto end{loop ? pos + window : std::min(pos + window, numFrames)};
+
+            // Carry on from where the last pass got to, unless the read
+            // position has jumped since.
+            auto from{pos};
+            if (prefetchedTo >= 0) {
+                auto ahead{prefetchedTo - pos};
+                if (loop && ahead < 0) ahead += numFrames;
+                if (ahead >= 0 && ahead <= end - pos) from = pos + ahead;
+            }
+
+            if (from < end) {
+                prefetch(from, end);
+            }
+            prefetchedTo = loop && numFrames > 0 ? end % numFrames : end;
+
+            wait(Server::Constants::PlaybackPrefetchIntervalMs);
+        }
+    }
+
+    void MappedFileSource::prefetch(juce::int64 start, juce::int64 end) const
+    {
+        static const auto pageSize{static_cast<uintptr_t>(sysconf(_SC_PAGESIZE))};
+
+        const auto touch{
+            [this](const juce::int64 from, const juce::int64 to)
+            {
+                if (from >= to) return;
+
+                const auto first{reinterpret_cast<uintptr_t>(data + static_cast<size_t>(from) * frameSize) & ~(pageSize - 1)};
+                const auto last{reinterpret_cast<uintptr_t>(data + static_cast<size_t>(to) * frameSize)};
+                madvise(reinterpret_cast<void *>(first), last - first, MADV_WILLNEED);
+
+                // Fault the pages in here, rather than on the audio thread.
+                for (auto p{first}; p < last; p += pageSize) {
+                    juce::ignoreUnused(*reinterpret_cast<const volatile uint8_t *>(p));
+                }
+            }
+        };
+
+        if (start >= numFrames) {
+            start -= numFrames;
+            end -= numFrames;
+        }
+
+        touch(start, std::min(end, numFrames));
+        touch(0, end - numFrames);
+    }
+}
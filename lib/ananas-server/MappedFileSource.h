@@ -0,0 +1,134 @@
+#ifndef ANANASMAPPEDFILESOURCE_H
+#define ANANASMAPPEDFILESOURCE_H
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <optional>
+
+namespace ananas
+{
+    /**
+     * Plays a multichannel WAV, RF64 or W64 file (16, 24 or 32-bit PCM, or
+     * 32-bit float) straight out of a memory mapping, for stems too wide or
+     * too long for the usual readers to keep up with.
+     *
+     * A background thread keeps the pages ahead of the read position
+     * resident (madvise(), then touching them), so getNextAudioBlock() only
+     * converts samples: no allocation, no decoding, and, as long as the disk
+     * keeps up, no page faults. Output channels are taken from file channels
+     * by a channel map.
+     */
+    class MappedFileSource final : public juce::PositionableAudioSource,
+                                   juce::Thread
+    {
+    public:
+        /**
+         * @return nullptr, with a description in error, if the file can't be
+         * mapped, or isn't in a supported format.
+         */
+        static std::unique_ptr<MappedFileSource> open(const juce::File &file, juce::String &error);
+
+        ~MappedFileSource() override;
+
+        /**
+         * Output channel n plays file channel map[n], or silence for -1 (or
+         * past the end of the map, or a channel the file doesn't have). By
+         * default, channel n plays channel n. Call before prepareToPlay().
+         */
+        void setChannelMap(std::vector<int> map);
+
+        /**
+         * From, e.g., "0-31" (the first 32 channels, in order), "3,2,-,0"
+         * (channels 3 and 2, then silence, then channel 0), or a mixture.
+         * @return nullopt if the spec doesn't parse.
+         */
+        static std::optional<std::vector<int> > parseChannelMap(const juce::String &spec);
+
+        [[nodiscard]] int getNumChannels() const;
+
+        [[nodiscard]] double getSampleRate() const;
+
+        void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+        void releaseResources() override;
+
+        void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override;
+
+        void setNextReadPosition(juce::int64 newPosition) override;
+
+        [[nodiscard]] juce::int64 getNextReadPosition() const override;
+
+        [[nodiscard]] juce::int64 getTotalLength() const override;
+
+        [[nodiscard]] bool isLooping() const override;
+
+        void setLooping(bool shouldLoop) override;
+
+    private:
+        enum class SampleFormat : uint8_t
+        {
+            int16,
+            int24,
+            int32,
+            float32
+        };
+
+        /**
+         * Where the audio is, and how it's laid out.
+         */
+        struct Layout
+        {
+            size_t dataOffset{0};
+            uint64_t dataSize{0};
+            int numChannels{0};
+            double sampleRate{0.};
+            SampleFormat format{SampleFormat::int16};
+            size_t bytesPerSample{0};
+        };
+
+        MappedFileSource(const uint8_t *mapping, size_t mappingSize, const Layout &layout);
+
+        static bool parseRiff(const uint8_t *file, size_t size, Layout &layout, juce::String &error);
+
+        static bool parseW64(const uint8_t *file, size_t size, Layout &layout, juce::String &error);
+
+        static bool parseFormat(const uint8_t *chunk, uint64_t size, Layout &layout, juce::String &error);
+
+        /**
+         * Convert numFrames samples, stride bytes apart, to float.
+         */
+        static void convert(const uint8_t *source, size_t stride, SampleFormat format, float *dest, int numFrames);
+
+        /**
+         * Keep the pages ahead of the read position resident.
+         */
+        void run() override;
+
+        /**
+         * Read ahead, and fault in, frames [start, end), wrapping round to
+         * the start of the file past its end.
+         */
+        void prefetch(juce::int64 start, juce::int64 end) const;
+
+        const uint8_t *const mapping;
+        const size_t mappingSize;
+        const uint8_t *const data;
+        const juce::int64 numFrames;
+        const int numChannels;
+        const double sampleRate;
+        const SampleFormat format;
+        const size_t bytesPerSample;
+        const size_t frameSize;
+
+        std::vector<int> channelMap;
+        std::atomic<juce::int64> position{0};
+        std::atomic<bool> looping{false};
+
+        // Prefetch thread only.
+        juce::int64 prefetchFrames{0};
+        juce::int64 prefetchedTo{-1};
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MappedFileSource)
+    };
+}
+
+#endif //ANANASMAPPEDFILESOURCE_H
@@ -0,0 +1,145 @@
+#include "Metrics.h"
+#include <AnanasUtils.h>
+
+namespace ananas
+{
+    void Histogram::record(const int64_t value)
+    {
+        const auto v{std::min(static_cast<uint64_t>(std::max(value, int64_t{0})), MaxValue)};
+
+        counts[static_cast<size_t>(getBucketIndex(v))].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(v, std::memory_order_relaxed);
+
+        auto currentMin{min.load(std::memory_order_relaxed)};
+        while (v < currentMin && !min.compare_exchange_weak(currentMin, v, std::memory_order_relaxed)) {}
+
+        auto currentMax{max.load(std::memory_order_relaxed)};
+        while (v > currentMax && !max.compare_exchange_weak(currentMax, v, std::memory_order_relaxed)) {}
+    }
+
+    void Histogram::reset()
+    {
+        for (auto &c: counts) {
+            c.store(0, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t Histogram::getCount() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Histogram::getMin() const
+    {
+        return getCount() > 0 ? min.load(std::memory_order_relaxed) : 0;
+    }
+
+    uint64_t Histogram::getMax() const
+    {
+        return max.load(std::memory_order_relaxed);
+    }
+
+    double Histogram::getMean() const
+    {
+        const auto n{getCount()};
+        return n > 0 ? static_cast<double>(sum.load(std::memory_order_relaxed)) / static_cast<double>(n) : 0.;
+    }
+
+    uint64_t Histogram::getValueAtPercentile(const double percentile) const
+    {
+        // Sum the buckets rather than trusting count, which may be a
+        // recording or two ahead.
+        uint64_t total{0};
+        for (const auto &c: counts) {
+            total += c.load(std::memory_order_relaxed);
+        }
+        if (total == 0) return 0;
+
+        const auto target{
+            std::max(uint64_t{1}, static_cast<uint64_t>(std::ceil(juce::jlimit(0., 100., percentile) / 100. * static_cast<double>(total))))
+        };
+
+        uint64_t cumulative{0};
+        for (int i{0}; i < NumBuckets; ++i) {
+            cumulative += counts[static_cast<size_t>(i)].load(std::memory_order_relaxed);
+            if (cumulative >= target) {
+                return juce::jlimit(getMin(), getMax(), getBucketValue(i));
+            }
+        }
+
+        return getMax();
+    }
+
+    juce::var Histogram::toVar() const
+    {
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::HistogramCountPropertyID, static_cast<juce::int64>(getCount()));
+        object->setProperty(Utils::Identifiers::HistogramMinPropertyID, static_cast<juce::int64>(getMin()));
+        object->setProperty(Utils::Identifiers::HistogramMeanPropertyID, getMean());
+        object->setProperty(Utils::Identifiers::HistogramP50PropertyID, static_cast<juce::int64>(getValueAtPercentile(50.)));
+        object->setProperty(Utils::Identifiers::HistogramP90PropertyID, static_cast<juce::int64>(getValueAtPercentile(90.)));
+        object->setProperty(Utils::Identifiers::HistogramP99PropertyID, static_cast<juce::int64>(getValueAtPercentile(99.)));
+        object->setProperty(Utils::Identifiers::HistogramP999PropertyID, static_cast<juce::int64>(getValueAtPercentile(99.9)));
+        object->setProperty(Utils::Identifiers::HistogramMaxPropertyID, static_cast<juce::int64>(getMax()));
+        return object;
+    }
+
+    int Histogram::getBucketIndex(const uint64_t value)
+    {
+        if (value < 2 * SubBucketCount) return static_cast<int>(value);
+
+        // Position of the most significant bit; at least SubBucketBits + 1.
+        const auto msb{63 - __builtin_clzll(value)};
+        const auto shift{msb - SubBucketBits};
+        return shift * SubBucketCount + static_cast<int>(value >> shift);
+    }
+
+    uint64_t Histogram::getBucketValue(const int index)
+    {
+        if (index < 2 * SubBucketCount) return static_cast<uint64_t>(index);
+
+        const auto shift{index / SubBucketCount - 1};
+        const auto lower{static_cast<uint64_t>(index - shift * SubBucketCount) << shift};
+        return lower + (uint64_t{1} << shift) / 2;
+    }
+
+    //==========================================================================
+
+    void SenderMetrics::reset()
+    {
+        fifoResidency.reset();
+        conversion.reset();
+        send.reset();
+        interDeparture.reset();
+        callbackToWire.reset();
+        wireToPresentation.reset();
+        timestampError.reset();
+        timestampStep.reset();
+    }
+
+    juce::var SenderMetrics::toVar() const
+    {
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::MetricsFifoResidencyPropertyID, fifoResidency.toVar());
+        object->setProperty(Utils::Identifiers::MetricsConversionPropertyID, conversion.toVar());
+        object->setProperty(Utils::Identifiers::MetricsSendPropertyID, send.toVar());
+        object->setProperty(Utils::Identifiers::MetricsInterDeparturePropertyID, interDeparture.toVar());
+        object->setProperty(Utils::Identifiers::MetricsCallbackToWirePropertyID, callbackToWire.toVar());
+        object->setProperty(Utils::Identifiers::MetricsWireToPresentationPropertyID, wireToPresentation.toVar());
+        object->setProperty(Utils::Identifiers::MetricsTimestampErrorPropertyID, timestampError.toVar());
+        object->setProperty(Utils::Identifiers::MetricsTimestampStepPropertyID, timestampStep.toVar());
+        return object;
+    }
+
+    int64_t SenderMetrics::now()
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+}
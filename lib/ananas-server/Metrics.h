@@ -0,0 +1,125 @@
+#ifndef ANANASMETRICS_H
+#define ANANASMETRICS_H
+
+#include <juce_core/juce_core.h>
+
+namespace ananas
+{
+    /**
+     * A lock-free, HDR-style histogram of non-negative integer values (in
+     * practice, nanoseconds).
+     *
+     * Values below 2 * SubBucketCount are counted exactly; above that, each
+     * power-of-two range is split into SubBucketCount linear buckets, so the
+     * relative error of any reported value is at most 1 / SubBucketCount
+     * (about 3%). Values above MaxValue are counted as MaxValue.
+     *
+     * record() is wait-free and may be called from any thread; reads and
+     * reset() are safe alongside it, but may see a recording in progress.
+     */
+    class Histogram
+    {
+    public:
+        constexpr static int SubBucketBits{5};
+        constexpr static int SubBucketCount{1 << SubBucketBits};
+        constexpr static int MaxValueBits{40};
+        constexpr static uint64_t MaxValue{(uint64_t{1} << MaxValueBits) - 1};
+        constexpr static int NumBuckets{(MaxValueBits - SubBucketBits + 1) * SubBucketCount};
+
+        void record(int64_t value);
+
+        void reset();
+
+        [[nodiscard]] uint64_t getCount() const;
+
+        [[nodiscard]] uint64_t getMin() const;
+
+        [[nodiscard]] uint64_t getMax() const;
+
+        [[nodiscard]] double getMean() const;
+
+        /**
+         * @param percentile 0–100.
+         * @return The value at the given percentile, to within the precision
+         * of its bucket; 0 if nothing has been recorded.
+         */
+        [[nodiscard]] uint64_t getValueAtPercentile(double percentile) const;
+
+        [[nodiscard]] juce::var toVar() const;
+
+        static int getBucketIndex(uint64_t value);
+
+        /**
+         * @return A representative value, the midpoint, of a bucket.
+         */
+        static uint64_t getBucketValue(int index);
+
+    private:
+        std::array<std::atomic<uint64_t>, NumBuckets> counts{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> min{std::numeric_limits<uint64_t>::max()};
+        std::atomic<uint64_t> max{0};
+    };
+
+    //==========================================================================
+
+    /**
+     * Timings recorded by the audio sender for every packet, and packet clock
+     * corrections, in nanoseconds.
+     */
+    struct SenderMetrics
+    {
+        /**
+         * From the audio thread writing a packet's first frame to the FIFO,
+         * to the packet being written to the socket.
+         */
+        Histogram fifoResidency;
+        /**
+         * Reading a packet from the FIFO: converting to int16 (and encoding,
+         * if the stream is compressed).
+         */
+        Histogram conversion;
+        /**
+         * The send syscall itself.
+         */
+        Histogram send;
+        /**
+         * Between consecutive packets of the same stream leaving the socket.
+         */
+        Histogram interDeparture;
+        /**
+         * From the audio thread writing a packet's first frame to the FIFO,
+         * to the kernel's transmit timestamp for the packet. Only recorded
+         * with TX timestamping enabled; see TxTimestamper.
+         */
+        Histogram callbackToWire;
+        /**
+         * From the kernel's transmit timestamp to the packet's presentation
+         * time, i.e. the margin left for the network and the client. Packets
+         * that went out after their presentation time are recorded as 0.
+         */
+        Histogram wireToPresentation;
+        /**
+         * How far each stream's packet clock was from each PTP timestamp
+         * received, either way.
+         */
+        Histogram timestampError;
+        /**
+         * The size of each step of a packet clock to a PTP timestamp, which
+         * clients hear as a discontinuity; the count is the number of steps.
+         */
+        Histogram timestampStep;
+
+        void reset();
+
+        [[nodiscard]] juce::var toVar() const;
+
+        /**
+         * @return CLOCK_MONOTONIC, in nanoseconds.
+         */
+        static int64_t now();
+    };
+}
+
+#endif //ANANASMETRICS_H
@@ -0,0 +1,242 @@
+#include "NetworkImpairment.h"
+
+namespace ananas
+{
+    namespace
+    {
+        int64_t msToNs(const juce::var &v, const juce::Identifier &id, const int64_t defaultNs)
+        {
+            return v.hasProperty(id)
+                       ? static_cast<int64_t>(static_cast<double>(v[id]) * Server::Constants::NSPS / 1000)
+                       : defaultNs;
+        }
+
+        double nsToMs(const int64_t ns)
+        {
+            return static_cast<double>(ns) * 1000 / Server::Constants::NSPS;
+        }
+
+        /**
+         * Orders the queue as a min-heap on due time, then order of arrival.
+         */
+        bool isLater(const NetworkImpairment::Datagram &a, const NetworkImpairment::Datagram &b)
+        {
+            return a.dueNs > b.dueNs || (a.dueNs == b.dueNs && a.order > b.order);
+        }
+    }
+
+    ImpairmentProfile ImpairmentProfile::fromVar(const juce::var &v)
+    {
+        ImpairmentProfile p;
+        p.loss = v.getProperty(Utils::Identifiers::ImpairmentLossPropertyID, p.loss);
+        p.burstProbability = v.getProperty(Utils::Identifiers::ImpairmentBurstProbabilityPropertyID, p.burstProbability);
+        p.burstLength = juce::jmax(1., static_cast<double>(v.getProperty(Utils::Identifiers::ImpairmentBurstLengthPropertyID, p.burstLength)));
+        p.duplicate = v.getProperty(Utils::Identifiers::ImpairmentDuplicatePropertyID, p.duplicate);
+        p.reorder = v.getProperty(Utils::Identifiers::ImpairmentReorderPropertyID, p.reorder);
+        p.reorderDelayNs = msToNs(v, Utils::Identifiers::ImpairmentReorderDelayPropertyID, p.reorderDelayNs);
+        p.delayNs = msToNs(v, Utils::Identifiers::ImpairmentDelayPropertyID, p.delayNs);
+        p.jitterNs = msToNs(v, Utils::Identifiers::ImpairmentJitterPropertyID, p.jitterNs);
+        return p;
+    }
+
+    juce::var ImpairmentProfile::toVar() const
+    {
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::ImpairmentLossPropertyID, loss);
+        object->setProperty(Utils::Identifiers::ImpairmentBurstProbabilityPropertyID, burstProbability);
+        object->setProperty(Utils::Identifiers::ImpairmentBurstLengthPropertyID, burstLength);
+        object->setProperty(Utils::Identifiers::ImpairmentDuplicatePropertyID, duplicate);
+        object->setProperty(Utils::Identifiers::ImpairmentReorderPropertyID, reorder);
+        object->setProperty(Utils::Identifiers::ImpairmentReorderDelayPropertyID, nsToMs(reorderDelayNs));
+        object->setProperty(Utils::Identifiers::ImpairmentDelayPropertyID, nsToMs(delayNs));
+        object->setProperty(Utils::Identifiers::ImpairmentJitterPropertyID, nsToMs(jitterNs));
+        return object;
+    }
+
+    //==========================================================================
+
+    ImpairmentScript ImpairmentScript::fromVar(const juce::var &v)
+    {
+        ImpairmentScript script;
+        script.loop = v.getProperty(Utils::Identifiers::ImpairmentLoopPropertyID, false);
+        script.seed = static_cast<juce::int64>(v.getProperty(Utils::Identifiers::ImpairmentSeedPropertyID, script.seed));
+
+        if (const auto *steps = v[Utils::Identifiers::ImpairmentStepsPropertyID].getArray()) {
+            for (const auto &s: *steps) {
+                script.steps.push_back({
+                    static_cast<int64_t>(static_cast<double>(s.getProperty(Utils::Identifiers::ImpairmentDurationPropertyID, 0.)) * Server::Constants::NSPS),
+                    ImpairmentProfile::fromVar(s)
+                });
+            }
+        } else {
+            script.steps.push_back({0, ImpairmentProfile::fromVar(v)});
+        }
+
+        return script;
+    }
+
+    int ImpairmentScript::getStepIndex(int64_t elapsedNs) const
+    {
+        if (loop) {
+            int64_t totalNs{0};
+            for (const auto &s: steps) {
+                // A step that lasts for ever means there's nothing to loop.
+                if (s.durationNs <= 0) {
+                    totalNs = 0;
+                    break;
+                }
+                totalNs += s.durationNs;
+            }
+            if (totalNs > 0) {
+                elapsedNs %= totalNs;
+            }
+        }
+
+        for (size_t i{0}; i < steps.size(); ++i) {
+            if (steps[i].durationNs <= 0 || elapsedNs < steps[i].durationNs) {
+                return static_cast<int>(i);
+            }
+            elapsedNs -= steps[i].durationNs;
+        }
+
+        return -1;
+    }
+
+    //==========================================================================
+
+    NetworkImpairment::NetworkImpairment(ImpairmentScript script, Clock &clock)
+        : script(std::move(script)),
+          clock(clock),
+          random(this->script.seed)
+    {
+    }
+
+    void NetworkImpairment::submit(const Direction direction,
+                                   const uint8_t *data,
+                                   const size_t size,
+                                   const juce::String &ip,
+                                   const int port)
+    {
+        const auto now{clock.now()};
+        if (!startNs.has_value()) {
+            startNs = now;
+        }
+
+        numDatagrams.fetch_add(1, std::memory_order_relaxed);
+
+        const auto index{script.getStepIndex(now - *startNs)};
+        step.store(index, std::memory_order_relaxed);
+        if (index < 0) {
+            // The script has finished; pass everything straight through.
+            enqueue(direction, data, size, ip, port, now);
+            return;
+        }
+
+        const auto &p{script.steps[static_cast<size_t>(index)].profile};
+
+        // Bursts end with probability 1/length at each datagram, which makes
+        // for the given mean length.
+        inBurst = inBurst
+                      ? random.nextDouble() >= 1. / p.burstLength
+                      : random.nextDouble() < p.burstProbability;
+        if (inBurst) {
+            numBurstLost.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (random.nextDouble() < p.loss) {
+            numLost.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        auto numCopies{1};
+        if (random.nextDouble() < p.duplicate) {
+            numDuplicated.fetch_add(1, std::memory_order_relaxed);
+            numCopies = 2;
+        }
+
+        for (auto i{0}; i < numCopies; ++i) {
+            auto dueNs{now + p.delayNs};
+            if (p.jitterNs > 0) {
+                dueNs += static_cast<int64_t>(random.nextDouble() * static_cast<double>(p.jitterNs));
+            }
+            if (i == 0 && random.nextDouble() < p.reorder) {
+                numReordered.fetch_add(1, std::memory_order_relaxed);
+                dueNs += p.reorderDelayNs;
+            }
+            enqueue(direction, data, size, ip, port, dueNs);
+        }
+    }
+
+    bool NetworkImpairment::next(Datagram &datagram)
+    {
+        if (queue.empty() || queue.front().dueNs > clock.now()) {
+            return false;
+        }
+
+        std::pop_heap(queue.begin(), queue.end(), isLater);
+        if (spare.size() < Server::Constants::ImpairmentMaxHeldDatagrams) {
+            spare.push_back(std::move(datagram.data));
+        }
+        datagram = std::move(queue.back());
+        queue.pop_back();
+        return true;
+    }
+
+    int64_t NetworkImpairment::getNextDueNs() const
+    {
+        return queue.empty() ? std::numeric_limits<int64_t>::max() : queue.front().dueNs;
+    }
+
+    int NetworkImpairment::getWaitMs(const int timeoutMs) const
+    {
+        if (queue.empty()) {
+            return timeoutMs;
+        }
+
+        const auto remainingNs{queue.front().dueNs - clock.now()};
+        const auto remainingMs{(remainingNs + Server::Constants::NSPS / 1000 - 1) / (Server::Constants::NSPS / 1000)};
+        return static_cast<int>(juce::jlimit(int64_t{0}, static_cast<int64_t>(timeoutMs), remainingMs));
+    }
+
+    juce::var NetworkImpairment::getStats() const
+    {
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::ImpairmentStepPropertyID, step.load(std::memory_order_relaxed));
+        object->setProperty(Utils::Identifiers::ImpairmentDatagramsPropertyID, static_cast<juce::int64>(numDatagrams.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::ImpairmentLostPropertyID, static_cast<juce::int64>(numLost.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::ImpairmentBurstLostPropertyID, static_cast<juce::int64>(numBurstLost.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::ImpairmentDuplicatedPropertyID, static_cast<juce::int64>(numDuplicated.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::ImpairmentReorderedPropertyID, static_cast<juce::int64>(numReordered.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::ImpairmentOverflowedPropertyID, static_cast<juce::int64>(numOverflowed.load(std::memory_order_relaxed)));
+        return object;
+    }
+
+    void NetworkImpairment::enqueue(const Direction direction,
+                                    const uint8_t *data,
+                                    const size_t size,
+                                    const juce::String &ip,
+                                    const int port,
+                                    const int64_t dueNs)
+    {
+        if (queue.size() >= Server::Constants::ImpairmentMaxHeldDatagrams) {
+            numOverflowed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        Datagram datagram;
+        if (!spare.empty()) {
+            datagram.data = std::move(spare.back());
+            spare.pop_back();
+        }
+        datagram.direction = direction;
+        datagram.ip = ip;
+        datagram.port = port;
+        datagram.data.assign(data, data + size);
+        datagram.dueNs = dueNs;
+        datagram.order = nextOrder++;
+
+        queue.push_back(std::move(datagram));
+        std::push_heap(queue.begin(), queue.end(), isLater);
+    }
+}
@@ -0,0 +1,183 @@
+#ifndef ANANASNETWORKIMPAIRMENT_H
+#define ANANASNETWORKIMPAIRMENT_H
+
+#include <juce_core/juce_core.h>
+#include "Clock.h"
+#include "PacketCapture.h"
+#include "ServerUtils.h"
+#include <optional>
+
+namespace ananas
+{
+    /**
+     * What to do to datagrams on their way through a NetworkImpairment.
+     * Probabilities are per datagram, 0–1.
+     */
+    struct ImpairmentProfile
+    {
+        /**
+         * Independent, random loss.
+         */
+        double loss{0.};
+        /**
+         * Chance that a burst of loss starts at any datagram; every datagram
+         * is lost until it ends (a Gilbert-Elliott channel).
+         */
+        double burstProbability{0.};
+        /**
+         * Mean burst length, in datagrams.
+         */
+        double burstLength{1.};
+        /**
+         * Chance that a datagram is sent twice.
+         */
+        double duplicate{0.};
+        /**
+         * Chance that a datagram is held back by an extra reorderDelayNs,
+         * for later datagrams to overtake.
+         */
+        double reorder{0.};
+        int64_t reorderDelayNs{Server::Constants::DefaultImpairmentReorderDelayNs};
+        /**
+         * Every datagram is delayed by delayNs, plus up to jitterNs more,
+         * uniformly distributed; jitter alone can reorder datagrams.
+         */
+        int64_t delayNs{0};
+        int64_t jitterNs{0};
+
+        /**
+         * From, e.g., {"loss": 0.01, "delayMs": 2, "jitterMs": 0.5};
+         * anything not given keeps its default.
+         */
+        static ImpairmentProfile fromVar(const juce::var &v);
+
+        [[nodiscard]] juce::var toVar() const;
+    };
+
+    //==========================================================================
+
+    /**
+     * A sequence of impairment profiles, each lasting a given time, e.g. a
+     * clean start, a spell of heavy loss, then recovery.
+     */
+    struct ImpairmentScript
+    {
+        struct Step
+        {
+            /**
+             * 0 for as long as the script runs; only sensible for the last
+             * step.
+             */
+            int64_t durationNs{0};
+            ImpairmentProfile profile;
+        };
+
+        std::vector<Step> steps;
+        /**
+         * Start again from the first step after the last one ends.
+         */
+        bool loop{false};
+        juce::int64 seed{1};
+
+        /**
+         * From, e.g.,
+         * {"seed": 3, "loop": true, "steps": [{"duration": 10}, {"duration": 5, "loss": 0.2}]},
+         * durations in seconds; or a single profile, which lasts for ever.
+         */
+        static ImpairmentScript fromVar(const juce::var &v);
+
+        /**
+         * @return The index of the step in force the given time after the
+         * script started; -1 once a script that doesn't loop has finished,
+         * after which nothing is impaired.
+         */
+        [[nodiscard]] int getStepIndex(int64_t elapsedNs) const;
+    };
+
+    //==========================================================================
+
+    /**
+     * An in-process stand-in for netem: drops, duplicates, delays and
+     * reorders datagrams between a thread and its socket, as scripted, so
+     * that robustness can be tested without root or a lossy network.
+     *
+     * Datagrams are submitted as they're sent or received, and come back out
+     * of next() once they're due; the owning thread is responsible for
+     * calling next() often enough, using getNextDueNs(). Not thread-safe,
+     * other than getStats(). Randomness is seeded from the script, so a
+     * given sequence of datagrams is always impaired the same way.
+     */
+    class NetworkImpairment
+    {
+    public:
+        using Direction = PacketCapture::Direction;
+
+        struct Datagram
+        {
+            Direction direction{Direction::outbound};
+            /**
+             * The remote end: destination if outbound, source if inbound.
+             */
+            juce::String ip;
+            int port{0};
+            std::vector<uint8_t> data;
+            int64_t dueNs{0};
+            uint64_t order{0};
+        };
+
+        NetworkImpairment(ImpairmentScript script, Clock &clock);
+
+        void submit(Direction direction, const uint8_t *data, size_t size, const juce::String &ip, int port);
+
+        /**
+         * Take the next datagram that's due, if any; datagram's previous
+         * contents are recycled.
+         */
+        bool next(Datagram &datagram);
+
+        /**
+         * @return When the next held datagram falls due, or max() if none
+         * are held.
+         */
+        [[nodiscard]] int64_t getNextDueNs() const;
+
+        /**
+         * @return Given a timeout, the timeout to use so as not to overshoot
+         * the next held datagram.
+         */
+        [[nodiscard]] int getWaitMs(int timeoutMs) const;
+
+        [[nodiscard]] juce::var getStats() const;
+
+    private:
+        void enqueue(Direction direction,
+                     const uint8_t *data,
+                     size_t size,
+                     const juce::String &ip,
+                     int port,
+                     int64_t dueNs);
+
+        const ImpairmentScript script;
+        Clock &clock;
+        juce::Random random;
+        std::optional<int64_t> startNs;
+        bool inBurst{false};
+        uint64_t nextOrder{0};
+
+        // A min-heap on (dueNs, order).
+        std::vector<Datagram> queue;
+        std::vector<std::vector<uint8_t> > spare;
+
+        std::atomic<int> step{0};
+        std::atomic<uint64_t> numDatagrams{0};
+        std::atomic<uint64_t> numLost{0};
+        std::atomic<uint64_t> numBurstLost{0};
+        std::atomic<uint64_t> numDuplicated{0};
+        std::atomic<uint64_t> numReordered{0};
+        std::atomic<uint64_t> numOverflowed{0};
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NetworkImpairment)
+    };
+}
+
+#endif //ANANASNETWORKIMPAIRMENT_H
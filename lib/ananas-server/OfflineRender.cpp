@@ -0,0 +1,88 @@
+#include "OfflineRender.h"
+#include "Logger.h"
+
+namespace ananas
+{
+    OfflineRender::OfflineRender(juce::File file)
+        : capture(std::move(file), Server::Constants::OfflineRenderCapacityBytes),
+          channel(capture.addChannel()),
+          source(Endpoint::fromString(Utils::Strings::LocalInterfaceIP, Server::Sockets::AudioSenderSocketParams.localPort))
+    {
+    }
+
+    OfflineRender::~OfflineRender()
+    {
+        stop();
+    }
+
+    bool OfflineRender::start()
+    {
+        started = capture.start();
+        return started;
+    }
+
+    void OfflineRender::stop()
+    {
+        capture.stop();
+        started = false;
+    }
+
+    void OfflineRender::write(AudioStream &stream, const juce::AudioSourceChannelInfo &block)
+    {
+        if (!started) return;
+
+        // The FIFO takes whole buffers, so feed it in pieces it can hold,
+        // packetizing as it fills.
+        const auto maxFrames{std::max(stream.getFifo().getCapacity() / 2, 1)};
+        auto *const *channels{block.buffer->getArrayOfWritePointers()};
+        const auto numChannels{block.buffer->getNumChannels()};
+
+        for (auto done{0}; done < block.numSamples;) {
+            const auto n{std::min(maxFrames, block.numSamples - done)};
+            const juce::AudioBuffer<float> piece{channels, numChannels, block.startSample + done, n};
+            stream.getFifo().write(&piece);
+            writePackets(stream);
+            done += n;
+        }
+    }
+
+    juce::File OfflineRender::getFile() const
+    {
+        return capture.getFile();
+    }
+
+    juce::File OfflineRender::createDefaultFile(const juce::String &name)
+    {
+        const auto folder{juce::File::getSpecialLocation(juce::File::userMusicDirectory).getChildFile("Ananas Renders")};
+        folder.createDirectory();
+        return folder.getNonexistentChildFile(name + " " + juce::Time::getCurrentTime().formatted("%Y-%m-%d %H-%M-%S"), ".pcapng", false);
+    }
+
+    juce::var OfflineRender::getStats() const
+    {
+        return capture.getStats();
+    }
+
+    void OfflineRender::writePackets(AudioStream &stream)
+    {
+        const auto &params{stream.getParams()};
+        const auto destination{Endpoint::fromString(params.ip, params.port)};
+
+        while (stream.isReady()) {
+            size_t size;
+            int64_t writeTimeNs;
+            const auto *data{stream.readPacket(size, writeTimeNs)};
+            if (data == nullptr) return;
+
+            // Not realtime, so there's no harm in waiting.
+            while (!channel.hasSpaceFor(size)) {
+                capture.flush();
+                juce::Thread::sleep(1);
+            }
+
+            // Timestamped by the packet clock, so that playback can pace the
+            // packets exactly as they were rendered.
+            channel.add(PacketCapture::Direction::outbound, data, size, source, destination, stream.getTime());
+        }
+    }
+}
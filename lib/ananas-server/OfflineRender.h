@@ -0,0 +1,69 @@
+#ifndef ANANASOFFLINERENDER_H
+#define ANANASOFFLINERENDER_H
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "AudioStream.h"
+#include "PacketCapture.h"
+
+namespace ananas
+{
+    /**
+     * Writes the audio packets a Server would send to a pcapng file (see
+     * PacketCapture), instead of sending them, for hosts rendering offline:
+     * packetizing happens on the host's thread, as fast as it renders, with
+     * no FIFO to overflow and no network to keep pace with.
+     *
+     * Packets are timestamped, in the file and in their headers, by the
+     * audio, not by PTP. Server::setRenderPlaybackFile() sends them on
+     * later, in real time, restamped.
+     */
+    class OfflineRender
+    {
+    public:
+        explicit OfflineRender(juce::File file);
+
+        ~OfflineRender();
+
+        /**
+         * Create the file and start writing. Until this succeeds, write()
+         * discards its input.
+         */
+        bool start();
+
+        /**
+         * Finish writing the file.
+         */
+        void stop();
+
+        /**
+         * Packetize a block for a stream, and record the packets. Waits for
+         * the writer, rather than dropping packets, if it falls behind.
+         */
+        void write(AudioStream &stream, const juce::AudioSourceChannelInfo &block);
+
+        [[nodiscard]] juce::File getFile() const;
+
+        /**
+         * @return A new file in "Ananas Renders", in the user's music
+         * folder, named for what's rendering and when.
+         */
+        static juce::File createDefaultFile(const juce::String &name);
+
+        /**
+         * @return As PacketCapture::getStats().
+         */
+        [[nodiscard]] juce::var getStats() const;
+
+    private:
+        void writePackets(AudioStream &stream);
+
+        PacketCapture capture;
+        PacketCapture::Channel &channel;
+        const Endpoint source;
+        bool started{false};
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OfflineRender)
+    };
+}
+
+#endif //ANANASOFFLINERENDER_H
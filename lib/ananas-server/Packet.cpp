@@ -1,5 +1,6 @@
 #include "Packet.h"
 #include "ServerUtils.h"
+#include "Logger.h"
 
 namespace ananas
 {
@@ -11,10 +12,14 @@ namespace ananas
         header.numFrames = framesPerPacket;
 
         // Compute the nanosecond packet timestamp interval. This may not be an
-        // integer, so calculate the remainder too, so this can be accumulated
-        // (somewhat) accurately.
-        nsPerPacket = Server::Constants::NSPS * framesPerPacket / static_cast<int>(sampleRate);
-        nsPerPacketRemainder = static_cast<double>(Server::Constants::NSPS) * framesPerPacket / static_cast<int>(sampleRate) - static_cast<double>(nsPerPacket);
+        // integer, e.g. 16/44100 s, so keep the remainder as an exact
+        // fraction, which writeHeader() carries whole nanoseconds out of.
+        sampleRateHz = std::max(int64_t{1}, static_cast<int64_t>(std::llround(sampleRate)));
+        const auto nsFramesPerPacket{Server::Constants::NSPS * framesPerPacket};
+        nsPerPacket = nsFramesPerPacket / sampleRateHz;
+        nsPerPacketRemainder = nsFramesPerPacket % sampleRateHz;
+        timestampRemainder = 0;
+
         // Audio packets will be transmitted in bursts according to the number
         // of frames available in the FIFO. E.g., for a host buffer size of 128
         // frames, and a framesPerPacket value of 32, four packets will be
@@ -23,11 +28,11 @@ namespace ananas
         // disruptive to reception of PTP packets, client-side.
         nsSleepInterval = nsPerPacket * 1 / 100;
 
-        clientBufferDuration = (static_cast<double>(nsPerPacket) + nsPerPacketRemainder) * Server::Constants::ClientPacketBufferSize;
+        clientBufferDuration = static_cast<double>(nsFramesPerPacket) * Server::Constants::ClientPacketBufferSize / static_cast<double>(sampleRateHz);
 
-        std::cout << framesPerPacket << "/" << sampleRate << " = " <<
-                nsPerPacket << " + " << nsPerPacketRemainder << " ns per block. " <<
-                "Inter-packet sleep interval " << nsSleepInterval << " ns." << std::endl;
+        ANANAS_LOG_INFO("%d/%lld = %lld + %lld/%lld ns per packet. Inter-packet sleep interval %ld ns.",
+                        framesPerPacket, static_cast<long long>(sampleRateHz), static_cast<long long>(nsPerPacket),
+                        static_cast<long long>(nsPerPacketRemainder), static_cast<long long>(sampleRateHz), nsSleepInterval);
     }
 
     uint8_t *AudioPacket::getAudioData()
@@ -39,15 +44,16 @@ namespace ananas
     {
         ++header.sequenceNumber;
         header.timestamp += nsPerPacket;
+        // The remainder is less than a nanosecond, so carries at most one.
         timestampRemainder += nsPerPacketRemainder;
-        if (timestampRemainder > 1) {
+        if (timestampRemainder >= sampleRateHz) {
             header.timestamp += 1;
-            timestampRemainder -= 1;
+            timestampRemainder -= sampleRateHz;
         }
         copyFrom(&header, 0, sizeof(Header));
     }
 
-    void AudioPacket::setTime(const timespec ts)
+    bool AudioPacket::setTime(const timespec ts, int64_t &diffNs)
     {
         // Set the time a little ahead; a reproduction offset, and something to
         // compensate for the fact that it took a little while for the follow-up
@@ -57,27 +63,27 @@ namespace ananas
         // If the difference between the new time and the current packet
         // timestamp exceeds what can possibly be available at the client,
         // update the header timestamp.
-        const auto timestampDiff{static_cast<double>(newTime - header.timestamp)};
-
-        // TODO: make the diff available at server level so it can be displayed in UI
-        std::stringstream ss;
-        ss.imbue(std::locale("en_GB.UTF-8")); // Use system locale
-        ss << std::fixed << std::setprecision(0) << timestampDiff;
-
-        // std::cout << "Audio/PTP timestamp diff " << ss.str() << " ns" << std::endl;
+        diffNs = newTime - header.timestamp;
+        const auto timestampDiff{static_cast<double>(diffNs)};
 
         if (timestampDiff > clientBufferDuration / 2 || timestampDiff < -clientBufferDuration / 2) {
-            std::cerr << "Timestamp diff is " << std::fixed << timestampDiff << std::endl;
+            ANANAS_LOG_WARNING("Timestamp diff is %.0f ns", timestampDiff);
 
             // Sometimes bad timestamps come in pairs and things subsequently
             // settle down. Allow a couple of bad timestamps before updating the
             // header.
             if (++consecutiveBadTimestampCount >= 3) {
-                std::cerr << "... Setting packet timestamp to " << newTime << std::endl;
+                ANANAS_LOG_WARNING("... Setting packet timestamp to %lld", static_cast<long long>(newTime));
                 header.timestamp = newTime;
+                timestampRemainder = 0;
                 consecutiveBadTimestampCount = 0;
+                return true;
             }
+        } else {
+            consecutiveBadTimestampCount = 0;
         }
+
+        return false;
     }
 
     int64_t AudioPacket::getTime() const
@@ -19,13 +19,23 @@ namespace ananas
         };
 #pragma pack(pop)
 
+        /**
+         * @param sampleRate Taken to the nearest whole Hz, in which the
+         * packet timestamps are exact, however long the stream runs.
+         */
         void prepare(uint numChannels, int framesPerPacket, double sampleRate);
 
         uint8_t *getAudioData();
 
         void writeHeader();
 
-        void setTime(timespec ts);
+        /**
+         * Compare the packet clock with a PTP timestamp, and step it into
+         * line if it has strayed further than the client buffer allows.
+         * @param diffNs Set to how far the packet clock was off.
+         * @return true if the packet clock was stepped.
+         */
+        bool setTime(timespec ts, int64_t &diffNs);
 
         [[nodiscard]] int64_t getTime() const;
 
@@ -34,10 +44,16 @@ namespace ananas
     private:
         Header header{};
         uint consecutiveBadTimestampCount{0};
+        // The packet interval is framesPerPacket * NSPS / sampleRate ns,
+        // kept exactly: whole nanoseconds, plus a remainder in ns·frames
+        // over a denominator of the sample rate in Hz.
+        int64_t sampleRateHz{1};
         int64_t nsPerPacket{};
+        int64_t nsPerPacketRemainder{};
+        // The fraction of a nanosecond the timestamp is behind the packet
+        // clock, over sampleRateHz; always less than sampleRateHz.
+        int64_t timestampRemainder{0};
         long nsSleepInterval{};
-        double nsPerPacketRemainder{};
-        double timestampRemainder{0};
         double clientBufferDuration{};
     };
 
@@ -61,6 +77,30 @@ namespace ananas
     };
 #pragma pack(pop)
 
+#pragma pack(push, 1)
+    /**
+     * A client's request for retransmission of lost audio packets: a
+     * NackHeader identifying the stream, followed by one or more NackPackets.
+     */
+    struct NackHeader
+    {
+        /**
+         * The port the stream is sent to.
+         */
+        uint16_t streamPort;
+    };
+
+    /**
+     * The sequence number of one lost packet, and a bitmask of which of the
+     * following 16 were also lost (bit 0 = sequenceNumber + 1).
+     */
+    struct NackPacket
+    {
+        uint16_t sequenceNumber;
+        uint16_t followingLostMask;
+    };
+#pragma pack(pop)
+
     struct AuthorityAnnouncePacket
     {
         juce::uint32 serial;
@@ -0,0 +1,663 @@
+#include "PacketCapture.h"
+#include <AnanasUtils.h>
+#include <arpa/inet.h>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "Logger.h"
+
+namespace ananas
+{
+    namespace
+    {
+        /**
+         * What Channel::add() puts in the ring ahead of each datagram.
+         */
+        struct RecordHeader
+        {
+            int64_t timeNs;
+            uint32_t sourceIP;
+            uint32_t destinationIP;
+            uint16_t sourcePort;
+            uint16_t destinationPort;
+            uint16_t size;
+            PacketCapture::Direction direction;
+        };
+
+        constexpr uint32_t SectionHeaderBlockType{0x0A0D0D0A};
+        constexpr uint32_t InterfaceDescriptionBlockType{1};
+        constexpr uint32_t EnhancedPacketBlockType{6};
+        constexpr uint32_t ByteOrderMagic{0x1A2B3C4D};
+        constexpr uint32_t PcapMagicMicroseconds{0xA1B2C3D4};
+        constexpr uint32_t PcapMagicNanoseconds{0xA1B23C4D};
+
+        constexpr uint16_t OptionEndOfOptions{0};
+        constexpr uint16_t OptionFlags{2};
+        constexpr uint16_t OptionTimestampResolution{9};
+
+        constexpr uint16_t LinkTypeEthernet{1};
+        constexpr uint16_t LinkTypeRaw{101};
+        constexpr uint16_t LinkTypeLinuxSll{113};
+        constexpr uint16_t LinkTypeIPv4{228};
+        constexpr uint16_t LinkTypeLinuxSll2{276};
+
+        constexpr uint16_t EtherTypeIPv4{0x0800};
+        constexpr uint16_t EtherTypeVlan{0x8100};
+        constexpr uint16_t EtherTypeQinQ{0x88A8};
+        constexpr uint8_t ProtocolUDP{17};
+
+        constexpr size_t IPv4HeaderSize{20};
+        constexpr size_t UDPHeaderSize{8};
+        constexpr size_t PacketBlockHeaderSize{28};
+        // A packet block's fixed fields, then synthesised IPv4 and UDP
+        // headers.
+        constexpr size_t RecordPrefixSize{PacketBlockHeaderSize + IPv4HeaderSize + UDPHeaderSize};
+        // Up to three bytes of padding, epb_flags, end of options, and the
+        // block's trailing length.
+        constexpr size_t RecordSuffixMaxSize{3 + 8 + 4 + 4};
+        // Prefix, up to two pieces of payload, suffix.
+        constexpr int MaxIovecsPerRecord{4};
+        constexpr int MaxRecordsPerWrite{IOV_MAX / MaxIovecsPerRecord};
+
+        int64_t getRealtimeNs()
+        {
+            timespec ts{};
+            clock_gettime(CLOCK_REALTIME, &ts);
+            return ts.tv_sec * Server::Constants::NSPS + ts.tv_nsec;
+        }
+
+        // pcapng fields are in the writer's byte order; network headers
+        // aren't.
+        template<typename T>
+        void put(uint8_t *&p, const T value)
+        {
+            memcpy(p, &value, sizeof(T));
+            p += sizeof(T);
+        }
+
+        void putBigEndian16(uint8_t *&p, const uint16_t value) { put(p, htons(value)); }
+
+        void putBigEndian32(uint8_t *&p, const uint32_t value) { put(p, htonl(value)); }
+
+        template<typename T>
+        T get(const uint8_t *p)
+        {
+            T value;
+            memcpy(&value, p, sizeof(T));
+            return value;
+        }
+
+        uint16_t getBigEndian16(const uint8_t *p) { return ntohs(get<uint16_t>(p)); }
+
+        uint32_t getBigEndian32(const uint8_t *p) { return ntohl(get<uint32_t>(p)); }
+
+        uint16_t getIPv4Checksum(const uint8_t *header)
+        {
+            uint32_t sum{0};
+            for (size_t i{0}; i < IPv4HeaderSize; i += 2) {
+                sum += static_cast<uint32_t>(header[i] << 8 | header[i + 1]);
+            }
+            while (sum >> 16) {
+                sum = (sum & 0xFFFF) + (sum >> 16);
+            }
+            return static_cast<uint16_t>(~sum);
+        }
+
+        /**
+         * The region an AbstractFifo hands out, in up to two pieces.
+         */
+        struct RingRegion
+        {
+            uint8_t *ring;
+            int start1;
+            int size1;
+            int start2;
+
+            /**
+             * Point up to two iovecs at n bytes of the region, from offset.
+             * @return The number of iovecs used.
+             */
+            int gather(const int offset, const int n, iovec *iov) const
+            {
+                auto count{0};
+                auto remaining{n};
+                auto position{offset};
+                if (position < size1 && remaining > 0) {
+                    const auto n1{std::min(remaining, size1 - position)};
+                    iov[count++] = {ring + start1 + position, static_cast<size_t>(n1)};
+                    remaining -= n1;
+                    position += n1;
+                }
+                if (remaining > 0) {
+                    iov[count++] = {ring + start2 + position - size1, static_cast<size_t>(remaining)};
+                }
+                return count;
+            }
+
+            void copyIn(const int offset, const void *src, const int n) const
+            {
+                iovec iov[2];
+                auto *bytes{static_cast<const uint8_t *>(src)};
+                for (auto i{0}, count{gather(offset, n, iov)}; i < count; ++i) {
+                    memcpy(iov[i].iov_base, bytes, iov[i].iov_len);
+                    bytes += iov[i].iov_len;
+                }
+            }
+
+            void copyOut(const int offset, void *dest, const int n) const
+            {
+                iovec iov[2];
+                auto *bytes{static_cast<uint8_t *>(dest)};
+                for (auto i{0}, count{gather(offset, n, iov)}; i < count; ++i) {
+                    memcpy(bytes, iov[i].iov_base, iov[i].iov_len);
+                    bytes += iov[i].iov_len;
+                }
+            }
+        };
+    }
+
+    //==========================================================================
+
+    Endpoint Endpoint::fromString(const juce::String &ip, const int port)
+    {
+        in_addr address{};
+        inet_pton(AF_INET, ip.toRawUTF8(), &address);
+        return {ntohl(address.s_addr), static_cast<uint16_t>(port)};
+    }
+
+    juce::String Endpoint::getIPString() const
+    {
+        const in_addr address{htonl(ip)};
+        char text[INET_ADDRSTRLEN]{};
+        inet_ntop(AF_INET, &address, text, sizeof(text));
+        return text;
+    }
+
+    //==========================================================================
+
+    PacketCapture::Channel::Channel(const int capacityBytes)
+        : ring(static_cast<size_t>(capacityBytes)),
+          fifo(capacityBytes)
+    {
+    }
+
+    void PacketCapture::Channel::add(const Direction direction,
+                                     const void *data,
+                                     const size_t size,
+                                     const Endpoint &source,
+                                     const Endpoint &destination) noexcept
+    {
+        add(direction, data, size, source, destination, getRealtimeNs());
+    }
+
+    void PacketCapture::Channel::add(const Direction direction,
+                                     const void *data,
+                                     const size_t size,
+                                     const Endpoint &source,
+                                     const Endpoint &destination,
+                                     const int64_t timeNs) noexcept
+    {
+        const auto total{static_cast<int>(sizeof(RecordHeader) + size)};
+
+        if (!hasSpaceFor(size)) {
+            numDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        const RecordHeader header{
+            timeNs,
+            source.ip,
+            destination.ip,
+            source.port,
+            destination.port,
+            static_cast<uint16_t>(size),
+            direction
+        };
+
+        // The whole record becomes visible to the writer when the handle
+        // goes out of scope.
+        const auto handle{fifo.write(total)};
+        const RingRegion region{ring.data(), handle.startIndex1, handle.blockSize1, handle.startIndex2};
+        region.copyIn(0, &header, sizeof(header));
+        region.copyIn(sizeof(header), data, static_cast<int>(size));
+    }
+
+    bool PacketCapture::Channel::hasSpaceFor(const size_t size) const noexcept
+    {
+        return size <= std::numeric_limits<uint16_t>::max()
+               && fifo.getFreeSpace() >= static_cast<int>(sizeof(RecordHeader) + size);
+    }
+
+    //==========================================================================
+
+    PacketCapture::PacketCapture(juce::File file, const int channelCapacityBytes)
+        : file(std::move(file)),
+          channelCapacityBytes(channelCapacityBytes),
+          writer(*this)
+    {
+    }
+
+    PacketCapture::~PacketCapture()
+    {
+        stop();
+    }
+
+    PacketCapture::Channel &PacketCapture::addChannel()
+    {
+        jassert(fd < 0);
+        return *channels.add(new Channel(channelCapacityBytes));
+    }
+
+    bool PacketCapture::start()
+    {
+        fd = open(file.getFullPathName().toRawUTF8(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            ANANAS_LOG_ERROR("Failed to open capture file %s: %s", file.getFullPathName().toRawUTF8(), strerror(errno));
+            return false;
+        }
+
+        // A section header, then the one interface: raw IPv4, with
+        // nanosecond timestamps.
+        std::array<uint8_t, 28 + 32> header{};
+        auto *p{header.data()};
+        put(p, SectionHeaderBlockType);
+        put(p, uint32_t{28});
+        put(p, ByteOrderMagic);
+        put(p, uint16_t{1});
+        put(p, uint16_t{0});
+        put(p, int64_t{-1});
+        put(p, uint32_t{28});
+        put(p, InterfaceDescriptionBlockType);
+        put(p, uint32_t{32});
+        put(p, LinkTypeIPv4);
+        put(p, uint16_t{0});
+        put(p, uint32_t{0});
+        put(p, OptionTimestampResolution);
+        put(p, uint16_t{1});
+        put(p, uint8_t{9});
+        p += 3;
+        put(p, OptionEndOfOptions);
+        put(p, uint16_t{0});
+        put(p, uint32_t{32});
+
+        iovec iov{header.data(), header.size()};
+        if (!write(&iov, 1)) {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+
+        ANANAS_LOG_INFO("Capturing packets to %s.", file.getFullPathName().toRawUTF8());
+        writer.startThread();
+        return true;
+    }
+
+    void PacketCapture::stop()
+    {
+        if (fd < 0) return;
+
+        // The writer drains the rings once more on its way out.
+        writer.stopThread(Server::Threads::CaptureWriterThreadParams.timeoutMs);
+        close(fd);
+        fd = -1;
+
+        const auto stats{getStats()};
+        ANANAS_LOG_INFO("Captured %s packets; %s dropped.",
+                        stats[Utils::Identifiers::CapturePacketsPropertyID].toString().toRawUTF8(),
+                        stats[Utils::Identifiers::CaptureDroppedPropertyID].toString().toRawUTF8());
+    }
+
+    void PacketCapture::flush()
+    {
+        writer.notify();
+    }
+
+    juce::File PacketCapture::getFile() const
+    {
+        return file;
+    }
+
+    juce::var PacketCapture::getStats() const
+    {
+        uint64_t numDropped{0};
+        for (const auto *c: channels) {
+            numDropped += c->numDropped.load(std::memory_order_relaxed);
+        }
+
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::CaptureFilePropertyID, file.getFullPathName());
+        object->setProperty(Utils::Identifiers::CapturePacketsPropertyID, static_cast<juce::int64>(numPackets.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::CaptureBytesPropertyID, static_cast<juce::int64>(numBytes.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::CaptureDroppedPropertyID, static_cast<juce::int64>(numDropped));
+        object->setProperty(Utils::Identifiers::CaptureFailedPropertyID, failed.load(std::memory_order_relaxed));
+        return object;
+    }
+
+    void PacketCapture::drain()
+    {
+        for (auto *c: channels) {
+            drain(*c);
+        }
+    }
+
+    void PacketCapture::drain(Channel &channel)
+    {
+        // Producers only ever commit whole records.
+        const auto numReady{channel.fifo.getNumReady()};
+        if (numReady == 0) return;
+
+        if (failed.load(std::memory_order_relaxed)) {
+            channel.fifo.finishedRead(numReady);
+            return;
+        }
+
+        int start1, size1, start2, size2;
+        channel.fifo.prepareToRead(numReady, start1, size1, start2, size2);
+        const RingRegion region{channel.ring.data(), start1, size1, start2};
+
+        std::array<std::array<uint8_t, RecordPrefixSize>, MaxRecordsPerWrite> prefixes;
+        std::array<std::array<uint8_t, RecordSuffixMaxSize>, MaxRecordsPerWrite> suffixes;
+        std::array<iovec, MaxRecordsPerWrite * MaxIovecsPerRecord> iovecs;
+        auto numRecords{0}, numIovecs{0}, offset{0}, numConsumed{0};
+
+        const auto flush{
+            [&]
+            {
+                if (numIovecs > 0) {
+                    write(iovecs.data(), numIovecs);
+                }
+                // Hand the space back to the producer as soon as possible.
+                channel.fifo.finishedRead(offset - numConsumed);
+                numConsumed = offset;
+                numRecords = 0;
+                numIovecs = 0;
+            }
+        };
+
+        while (offset + static_cast<int>(sizeof(RecordHeader)) <= numReady) {
+            RecordHeader header;
+            region.copyOut(offset, &header, sizeof(header));
+
+            const auto capturedSize{static_cast<uint32_t>(IPv4HeaderSize + UDPHeaderSize + header.size)};
+            const auto padding{(4 - capturedSize % 4) % 4};
+            const auto blockSize{static_cast<uint32_t>(PacketBlockHeaderSize + capturedSize + padding + 8 + 4 + 4)};
+            const auto timestamp{static_cast<uint64_t>(header.timeNs)};
+
+            auto *p{prefixes[static_cast<size_t>(numRecords)].data()};
+            put(p, EnhancedPacketBlockType);
+            put(p, blockSize);
+            put(p, uint32_t{0});
+            put(p, static_cast<uint32_t>(timestamp >> 32));
+            put(p, static_cast<uint32_t>(timestamp));
+            put(p, capturedSize);
+            put(p, capturedSize);
+
+            auto *ip{p};
+            put(p, uint8_t{0x45});
+            put(p, uint8_t{0});
+            putBigEndian16(p, static_cast<uint16_t>(capturedSize));
+            putBigEndian16(p, 0);
+            // Don't fragment.
+            putBigEndian16(p, 0x4000);
+            put(p, uint8_t{64});
+            put(p, ProtocolUDP);
+            putBigEndian16(p, 0);
+            putBigEndian32(p, header.sourceIP);
+            putBigEndian32(p, header.destinationIP);
+            const auto checksum{getIPv4Checksum(ip)};
+            ip[10] = static_cast<uint8_t>(checksum >> 8);
+            ip[11] = static_cast<uint8_t>(checksum);
+
+            // No UDP checksum, which IPv4 allows.
+            putBigEndian16(p, header.sourcePort);
+            putBigEndian16(p, header.destinationPort);
+            putBigEndian16(p, static_cast<uint16_t>(UDPHeaderSize + header.size));
+            putBigEndian16(p, 0);
+
+            auto *s{suffixes[static_cast<size_t>(numRecords)].data()};
+            for (uint32_t i{0}; i < padding; ++i) {
+                put(s, uint8_t{0});
+            }
+            put(s, OptionFlags);
+            put(s, uint16_t{4});
+            put(s, static_cast<uint32_t>(header.direction));
+            put(s, OptionEndOfOptions);
+            put(s, uint16_t{0});
+            put(s, blockSize);
+
+            iovecs[static_cast<size_t>(numIovecs++)] = {prefixes[static_cast<size_t>(numRecords)].data(), RecordPrefixSize};
+            numIovecs += region.gather(offset + static_cast<int>(sizeof(header)), header.size, &iovecs[static_cast<size_t>(numIovecs)]);
+            iovecs[static_cast<size_t>(numIovecs++)] = {
+                suffixes[static_cast<size_t>(numRecords)].data(),
+                static_cast<size_t>(s - suffixes[static_cast<size_t>(numRecords)].data())
+            };
+
+            offset += static_cast<int>(sizeof(header)) + header.size;
+            numPackets.fetch_add(1, std::memory_order_relaxed);
+            numBytes.fetch_add(header.size, std::memory_order_relaxed);
+
+            if (++numRecords == MaxRecordsPerWrite) {
+                flush();
+            }
+        }
+
+        flush();
+    }
+
+    bool PacketCapture::write(iovec *iov, int count)
+    {
+        while (count > 0) {
+            const auto result{writev(fd, iov, std::min(count, IOV_MAX))};
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                ANANAS_LOG_ERROR("Failed to write to capture file: %s", strerror(errno));
+                failed.store(true, std::memory_order_relaxed);
+                return false;
+            }
+
+            // Pick up where a short write left off.
+            auto remaining{static_cast<size_t>(result)};
+            while (count > 0 && remaining >= iov->iov_len) {
+                remaining -= iov->iov_len;
+                ++iov;
+                --count;
+            }
+            if (count > 0) {
+                iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + remaining;
+                iov->iov_len -= remaining;
+            }
+        }
+        return true;
+    }
+
+    PacketCapture::Writer::Writer(PacketCapture &owner)
+        : Thread(Server::Threads::CaptureWriterThreadParams.name),
+          owner(owner)
+    {
+    }
+
+    void PacketCapture::Writer::run()
+    {
+        while (!threadShouldExit()) {
+            owner.drain();
+            wait(Server::Constants::CaptureWriteIntervalMs);
+        }
+        owner.drain();
+    }
+
+    //==========================================================================
+
+    CaptureReader::CaptureReader(const juce::File &file)
+        : file(file, juce::MemoryMappedFile::readOnly)
+    {
+        data = static_cast<const uint8_t *>(this->file.getData());
+        size = this->file.getSize();
+
+        if (data == nullptr || size < 24) return;
+
+        if (const auto magic{get<uint32_t>(data)}; magic == PcapMagicMicroseconds || magic == PcapMagicNanoseconds) {
+            format = Format::pcap;
+            pcapInterface.linkType = static_cast<uint16_t>(get<uint32_t>(data + 20));
+            pcapInterface.exponent = magic == PcapMagicNanoseconds ? 9 : 6;
+            position = 24;
+        } else if (magic == SectionHeaderBlockType && get<uint32_t>(data + 8) == ByteOrderMagic) {
+            format = Format::pcapng;
+        } else {
+            ANANAS_LOG_ERROR("%s isn't a capture in this machine's byte order.", file.getFullPathName().toRawUTF8());
+        }
+    }
+
+    bool CaptureReader::isValid() const
+    {
+        return format != Format::unknown;
+    }
+
+    bool CaptureReader::next(Datagram &datagram)
+    {
+        switch (format) {
+            case Format::pcap:
+                return nextPcap(datagram);
+            case Format::pcapng:
+                return nextPcapng(datagram);
+            case Format::unknown:
+            default:
+                return false;
+        }
+    }
+
+    bool CaptureReader::nextPcap(Datagram &datagram)
+    {
+        while (position + 16 <= size) {
+            const auto *record{data + position};
+            const auto capturedSize{get<uint32_t>(record + 8)};
+            if (capturedSize > size - position - 16) return false;
+            position += 16 + capturedSize;
+
+            const auto timestamp{static_cast<uint64_t>(get<uint32_t>(record)) * Server::Constants::NSPS};
+            const auto fraction{static_cast<uint64_t>(get<uint32_t>(record + 4))};
+            datagram.timeNs = static_cast<int64_t>(timestamp + (pcapInterface.exponent == 9 ? fraction : fraction * 1000));
+
+            if (decode(pcapInterface.linkType, record + 16, capturedSize, datagram)) return true;
+        }
+        return false;
+    }
+
+    bool CaptureReader::nextPcapng(Datagram &datagram)
+    {
+        while (position + 12 <= size) {
+            const auto type{get<uint32_t>(data + position)};
+            const auto length{get<uint32_t>(data + position + 4)};
+            if (length < 12 || length % 4 != 0 || length > size - position) return false;
+
+            const auto *body{data + position + 8};
+            const auto bodySize{static_cast<size_t>(length - 12)};
+            position += length;
+
+            if (type == SectionHeaderBlockType) {
+                if (bodySize < 16 || get<uint32_t>(body) != ByteOrderMagic) {
+                    ANANAS_LOG_ERROR("Capture section in the wrong byte order.");
+                    return false;
+                }
+                // Interface IDs are per section.
+                interfaces.clear();
+            } else if (type == InterfaceDescriptionBlockType) {
+                if (bodySize < 8) return false;
+                Interface description;
+                description.linkType = get<uint16_t>(body);
+                for (size_t o{8}; o + 4 <= bodySize;) {
+                    const auto code{get<uint16_t>(body + o)};
+                    const auto optionLength{get<uint16_t>(body + o + 2)};
+                    if (code == OptionEndOfOptions) break;
+                    if (code == OptionTimestampResolution && optionLength >= 1 && o + 4 < bodySize) {
+                        description.binary = (body[o + 4] & 0x80) != 0;
+                        description.exponent = body[o + 4] & 0x7F;
+                    }
+                    o += 4 + ((optionLength + 3u) & ~3u);
+                }
+                interfaces.push_back(description);
+            } else if (type == EnhancedPacketBlockType) {
+                if (bodySize < 20) return false;
+                const auto interfaceID{get<uint32_t>(body)};
+                if (interfaceID >= interfaces.size()) continue;
+                const auto capturedSize{get<uint32_t>(body + 12)};
+                if (capturedSize > bodySize - 20) return false;
+
+                const auto &description{interfaces[interfaceID]};
+                const auto timestamp{static_cast<uint64_t>(get<uint32_t>(body + 4)) << 32 | get<uint32_t>(body + 8)};
+                datagram.timeNs = toNanoseconds(timestamp, description);
+
+                if (decode(description.linkType, body + 20, capturedSize, datagram)) return true;
+            }
+        }
+        return false;
+    }
+
+    bool CaptureReader::decode(const uint16_t linkType, const uint8_t *frame, const size_t size, Datagram &datagram)
+    {
+        size_t offset;
+
+        switch (linkType) {
+            case LinkTypeEthernet: {
+                if (size < 14) return false;
+                auto etherType{getBigEndian16(frame + 12)};
+                offset = 14;
+                if (etherType == EtherTypeVlan || etherType == EtherTypeQinQ) {
+                    if (size < 18) return false;
+                    etherType = getBigEndian16(frame + 16);
+                    offset = 18;
+                }
+                if (etherType != EtherTypeIPv4) return false;
+                break;
+            }
+            case LinkTypeLinuxSll:
+                if (size < 16 || getBigEndian16(frame + 14) != EtherTypeIPv4) return false;
+                offset = 16;
+                break;
+            case LinkTypeLinuxSll2:
+                if (size < 20 || getBigEndian16(frame) != EtherTypeIPv4) return false;
+                offset = 20;
+                break;
+            case LinkTypeRaw:
+            case LinkTypeIPv4:
+                offset = 0;
+                break;
+            default:
+                return false;
+        }
+
+        const auto *ip{frame + offset};
+        const auto ipSize{size - offset};
+        if (ipSize < IPv4HeaderSize || ip[0] >> 4 != 4) return false;
+
+        const auto headerSize{static_cast<size_t>(ip[0] & 0x0F) * 4};
+        if (headerSize < IPv4HeaderSize || ip[9] != ProtocolUDP || ipSize < headerSize + UDPHeaderSize) return false;
+
+        // Fragments can't be reassembled here; ananas datagrams never need
+        // fragmenting anyway.
+        if ((getBigEndian16(ip + 6) & 0x3FFF) != 0) return false;
+
+        const auto *udp{ip + headerSize};
+        const auto udpLength{static_cast<size_t>(getBigEndian16(udp + 4))};
+        if (udpLength < UDPHeaderSize) return false;
+
+        datagram.source = {getBigEndian32(ip + 12), getBigEndian16(udp)};
+        datagram.destination = {getBigEndian32(ip + 16), getBigEndian16(udp + 2)};
+        datagram.data = udp + UDPHeaderSize;
+        datagram.size = std::min(udpLength, ipSize - headerSize) - UDPHeaderSize;
+        return true;
+    }
+
+    int64_t CaptureReader::toNanoseconds(const uint64_t timestamp, const Interface &info)
+    {
+        if (info.binary) {
+            const auto seconds{std::ldexp(static_cast<double>(timestamp), -info.exponent)};
+            return static_cast<int64_t>(seconds * static_cast<double>(Server::Constants::NSPS));
+        }
+
+        auto result{static_cast<int64_t>(timestamp)};
+        for (auto e{info.exponent}; e < 9; ++e) result *= 10;
+        for (auto e{info.exponent}; e > 9; --e) result /= 10;
+        return result;
+    }
+}
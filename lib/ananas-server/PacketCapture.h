@@ -0,0 +1,225 @@
+#ifndef ANANASPACKETCAPTURE_H
+#define ANANASPACKETCAPTURE_H
+
+#include <juce_core/juce_core.h>
+#include <sys/uio.h>
+#include "ServerUtils.h"
+
+namespace ananas
+{
+    /**
+     * An IPv4 address and UDP port, in host byte order.
+     */
+    struct Endpoint
+    {
+        uint32_t ip{0};
+        uint16_t port{0};
+
+        static Endpoint fromString(const juce::String &ip, int port);
+
+        [[nodiscard]] juce::String getIPString() const;
+    };
+
+    //==========================================================================
+
+    /**
+     * Records datagrams to a pcapng file, as raw IPv4/UDP (LINKTYPE_IPV4)
+     * with nanosecond timestamps and each packet's direction in its flags,
+     * for Wireshark, tcpdump or CaptureReader.
+     *
+     * Each recording thread gets its own Channel: a single-producer ring
+     * into which add() copies the datagram, the only copy made of it. A
+     * background writer gathers records straight from the rings into
+     * writev() calls. If the writer falls behind and a ring fills, packets
+     * are left out of the capture (and counted), never held up.
+     */
+    class PacketCapture
+    {
+    public:
+        /**
+         * As pcapng's epb_flags.
+         */
+        enum class Direction : uint8_t
+        {
+            inbound = 1,
+            outbound = 2
+        };
+
+        class Channel
+        {
+        public:
+            explicit Channel(int capacityBytes);
+
+            /**
+             * Copy a datagram into the ring; wait-free. Call only from the
+             * channel's own thread.
+             */
+            void add(Direction direction,
+                     const void *data,
+                     size_t size,
+                     const Endpoint &source,
+                     const Endpoint &destination) noexcept;
+
+            /**
+             * As above, but timestamped as given (in nanoseconds) rather than
+             * by the wall clock.
+             */
+            void add(Direction direction,
+                     const void *data,
+                     size_t size,
+                     const Endpoint &source,
+                     const Endpoint &destination,
+                     int64_t timeNs) noexcept;
+
+            /**
+             * @return true if add() would take a datagram of this size now,
+             * rather than dropping it.
+             */
+            [[nodiscard]] bool hasSpaceFor(size_t size) const noexcept;
+
+        private:
+            friend class PacketCapture;
+
+            std::vector<uint8_t> ring;
+            juce::AbstractFifo fifo;
+            std::atomic<uint64_t> numDropped{0};
+
+            JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Channel)
+        };
+
+        explicit PacketCapture(juce::File file,
+                               int channelCapacityBytes = Server::Constants::CaptureChannelCapacityBytes);
+
+        ~PacketCapture();
+
+        /**
+         * Add a channel, for one recording thread. Call before start().
+         */
+        Channel &addChannel();
+
+        /**
+         * Create the file, write its header, and start the writer.
+         */
+        bool start();
+
+        /**
+         * Stop the writer, once it has written whatever is left in the rings.
+         */
+        void stop();
+
+        /**
+         * Wake the writer to drain the rings now, rather than at its next
+         * interval.
+         */
+        void flush();
+
+        [[nodiscard]] juce::File getFile() const;
+
+        [[nodiscard]] juce::var getStats() const;
+
+    private:
+        class Writer final : public juce::Thread
+        {
+        public:
+            explicit Writer(PacketCapture &owner);
+
+            void run() override;
+
+        private:
+            PacketCapture &owner;
+        };
+
+        /**
+         * Write everything each channel has ready.
+         */
+        void drain();
+
+        void drain(Channel &channel);
+
+        bool write(iovec *iov, int count);
+
+        const juce::File file;
+        const int channelCapacityBytes;
+        juce::OwnedArray<Channel> channels;
+        Writer writer;
+        int fd{-1};
+        std::atomic<uint64_t> numPackets{0};
+        std::atomic<uint64_t> numBytes{0};
+        std::atomic<bool> failed{false};
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PacketCapture)
+    };
+
+    //==========================================================================
+
+    /**
+     * Reads IPv4/UDP datagrams from a capture: pcapng, as written by
+     * PacketCapture or by Wireshark or tcpdump (Ethernet, raw IP and Linux
+     * "any" interfaces), or classic pcap. Anything else is skipped.
+     */
+    class CaptureReader
+    {
+    public:
+        struct Datagram
+        {
+            /**
+             * Capture time, in nanoseconds.
+             */
+            int64_t timeNs{0};
+            Endpoint source;
+            Endpoint destination;
+            const uint8_t *data{nullptr};
+            size_t size{0};
+        };
+
+        explicit CaptureReader(const juce::File &file);
+
+        /**
+         * @return true if the file was mapped and looks like a capture.
+         */
+        [[nodiscard]] bool isValid() const;
+
+        /**
+         * Read the next datagram; its data is valid for the reader's lifetime.
+         * @return false at the end of the file, or of its last intact block.
+         */
+        bool next(Datagram &datagram);
+
+    private:
+        enum class Format
+        {
+            unknown,
+            pcap,
+            pcapng
+        };
+
+        struct Interface
+        {
+            uint16_t linkType{0};
+            // Timestamp units per second: 10^exponent, or 2^exponent.
+            uint8_t exponent{6};
+            bool binary{false};
+        };
+
+        bool nextPcap(Datagram &datagram);
+
+        bool nextPcapng(Datagram &datagram);
+
+        static bool decode(uint16_t linkType, const uint8_t *frame, size_t size, Datagram &datagram);
+
+        static int64_t toNanoseconds(uint64_t timestamp, const Interface &info);
+
+        juce::MemoryMappedFile file;
+        const uint8_t *data{nullptr};
+        size_t size{0};
+        size_t position{0};
+        Format format{Format::unknown};
+        // Classic pcap only has one interface.
+        Interface pcapInterface;
+        std::vector<Interface> interfaces;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CaptureReader)
+    };
+}
+
+#endif //ANANASPACKETCAPTURE_H
@@ -0,0 +1,67 @@
+#include "PacketHistory.h"
+#include "Packet.h"
+#include "ThreadPolicy.h"
+
+namespace ananas
+{
+    PacketHistory::PacketHistory(const size_t numPackets, const size_t maxPacketSize)
+        : maxSize(maxPacketSize),
+          slots(numPackets),
+          storage(numPackets * maxPacketSize)
+    {
+        jassert(numPackets > 0 && (1 << 16) % numPackets == 0);
+    }
+
+    void PacketHistory::store(const uint8_t *data, const size_t size)
+    {
+        if (size < sizeof(AudioPacket::Header) || size > maxSize) return;
+
+        AudioPacket::Header header;
+        memcpy(&header, data, sizeof(AudioPacket::Header));
+
+        const auto index{header.sequenceNumber % slots.size()};
+        auto &slot{slots[index]};
+
+        // Odd version: write in progress.
+        const auto version{slot.version.load(std::memory_order_relaxed)};
+        slot.version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        memcpy(&storage[index * maxSize], data, size);
+        slot.sequenceNumber.store(header.sequenceNumber, std::memory_order_relaxed);
+        slot.size.store(size, std::memory_order_relaxed);
+
+        slot.version.store(version + 2, std::memory_order_release);
+    }
+
+    bool PacketHistory::fetch(const uint16_t sequenceNumber, uint8_t *dest, size_t &size) const
+    {
+        const auto index{sequenceNumber % slots.size()};
+        const auto &slot{slots[index]};
+
+        const auto before{slot.version.load(std::memory_order_acquire)};
+        if (before == 0 || before % 2 != 0) return false;
+
+        const auto storedSequenceNumber{slot.sequenceNumber.load(std::memory_order_relaxed)};
+        const auto storedSize{slot.size.load(std::memory_order_relaxed)};
+        if (storedSequenceNumber != sequenceNumber || storedSize > maxSize) return false;
+
+        memcpy(dest, &storage[index * maxSize], storedSize);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.version.load(std::memory_order_relaxed) != before) return false;
+
+        size = storedSize;
+        return true;
+    }
+
+    size_t PacketHistory::getMaxPacketSize() const
+    {
+        return maxSize;
+    }
+
+    size_t PacketHistory::lockMemory()
+    {
+        return ananas::lockMemory(storage.data(), storage.size()) ? storage.size() : 0;
+    }
+}
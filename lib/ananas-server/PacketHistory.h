@@ -0,0 +1,63 @@
+#ifndef ANANASPACKETHISTORY_H
+#define ANANASPACKETHISTORY_H
+
+#include <juce_core/juce_core.h>
+
+namespace ananas
+{
+    /**
+     * A ring of the most recently sent audio packets, indexed by sequence
+     * number, for retransmission on request.
+     *
+     * One thread (the audio sender) stores; any number of threads may fetch.
+     * Each slot is guarded by a sequence lock, so neither side ever blocks:
+     * a fetch that races with a store simply fails.
+     */
+    class PacketHistory
+    {
+    public:
+        /**
+         * @param numPackets Number of packets to retain; must divide 65536,
+         * so that slots stay consistent across sequence number wrap-around.
+         * @param maxPacketSize The largest packet that will be stored.
+         */
+        PacketHistory(size_t numPackets, size_t maxPacketSize);
+
+        /**
+         * Store a serialized AudioPacket, keyed by its header's sequence
+         * number.
+         */
+        void store(const uint8_t *data, size_t size);
+
+        /**
+         * Copy a stored packet, if it's still in the history.
+         * @param dest At least getMaxPacketSize() bytes.
+         * @param size Set to the size of the packet.
+         * @return false if the packet has been overwritten, was never stored,
+         * or was being overwritten at the time.
+         */
+        bool fetch(uint16_t sequenceNumber, uint8_t *dest, size_t &size) const;
+
+        [[nodiscard]] size_t getMaxPacketSize() const;
+
+        /**
+         * Lock the packet storage into RAM; see ananas::lockMemory().
+         * @return The number of bytes locked.
+         */
+        size_t lockMemory();
+
+    private:
+        struct Slot
+        {
+            std::atomic<uint32_t> version{0};
+            std::atomic<uint32_t> sequenceNumber{0};
+            std::atomic<size_t> size{0};
+        };
+
+        const size_t maxSize;
+        std::vector<Slot> slots;
+        std::vector<uint8_t> storage;
+    };
+}
+
+#endif //ANANASPACKETHISTORY_H
@@ -0,0 +1,125 @@
+#include "PtpClock.h"
+#include "Logger.h"
+#include "ServerUtils.h"
+
+namespace ananas
+{
+    PtpClock::PtpClock(Clock &reference) : reference(reference)
+    {
+        window.reserve(Server::Constants::PtpClockWindowSize);
+    }
+
+    int64_t PtpClock::now() const
+    {
+        return toTime(mapping.load(std::memory_order_acquire), reference.now());
+    }
+
+    void PtpClock::sleepUntil(const int64_t timeNs)
+    {
+        reference.sleepUntil(toReference(mapping.load(std::memory_order_acquire), timeNs));
+    }
+
+    void PtpClock::addTimestamp(const int64_t ptpNs, const int64_t referenceNs)
+    {
+        const auto m{mapping.load(std::memory_order_acquire)};
+
+        if (!window.empty()) {
+            const auto &last{window.back()};
+            if (ptpNs <= last.ptpNs) {
+                return;
+            }
+
+            // Where the last timestamp, and the current rate, say this one
+            // should be.
+            const auto expectedNs{
+                last.ptpNs + static_cast<int64_t>(std::llround(static_cast<double>(referenceNs - last.referenceNs) * m.rate))
+            };
+            if (std::abs(ptpNs - expectedNs) > Server::Constants::PtpClockMaxStepNs) {
+                ANANAS_LOG_INFO("PTP timebase stepped by %lld us; refitting clock rate.",
+                                static_cast<long long>((ptpNs - expectedNs) / 1000));
+                window.clear();
+                numResets.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        if (window.size() == Server::Constants::PtpClockWindowSize) {
+            window.erase(window.begin());
+        }
+        window.push_back({ptpNs, referenceNs});
+        numTimestamps.fetch_add(1, std::memory_order_relaxed);
+
+        if (const auto rate{fitRate()}; rate.has_value()) {
+            // Take the new rate from here on, carrying on from where the old
+            // one had got to.
+            mapping.store({referenceNs, toTime(m, referenceNs), *rate}, std::memory_order_release);
+            locked.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    juce::var PtpClock::getStats() const
+    {
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::PtpClockLockedPropertyID, locked.load(std::memory_order_relaxed));
+        object->setProperty(Utils::Identifiers::PtpClockRatePpmPropertyID, (mapping.load(std::memory_order_acquire).rate - 1.) * 1e6);
+        object->setProperty(Utils::Identifiers::PtpClockTimestampsPropertyID, static_cast<juce::int64>(numTimestamps.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::PtpClockResetsPropertyID, static_cast<juce::int64>(numResets.load(std::memory_order_relaxed)));
+        return object;
+    }
+
+    void PtpClock::startTimer(ClockTimer &timer, const int64_t intervalNs)
+    {
+        forwardStartTimer(reference, timer, intervalNs);
+    }
+
+    void PtpClock::stopTimer(ClockTimer &timer)
+    {
+        forwardStopTimer(reference, timer);
+    }
+
+    int64_t PtpClock::toTime(const Mapping &m, const int64_t referenceNs)
+    {
+        // Scale only the deviation from the reference rate, to keep the
+        // precision of the integer part.
+        const auto d{referenceNs - m.referenceNs};
+        return m.timeNs + d + static_cast<int64_t>(std::llround(static_cast<double>(d) * (m.rate - 1.)));
+    }
+
+    int64_t PtpClock::toReference(const Mapping &m, const int64_t timeNs)
+    {
+        const auto d{timeNs - m.timeNs};
+        return m.referenceNs + d + static_cast<int64_t>(std::llround(static_cast<double>(d) * (1. / m.rate - 1.)));
+    }
+
+    std::optional<double> PtpClock::fitRate() const
+    {
+        if (window.size() < 2 || window.back().referenceNs - window.front().referenceNs < Server::Constants::PtpClockMinSpanNs) {
+            return std::nullopt;
+        }
+
+        // Least squares, relative to the first sample so that doubles keep
+        // nanosecond precision.
+        const auto &first{window.front()};
+        auto meanX{0.}, meanY{0.};
+        for (const auto &s: window) {
+            meanX += static_cast<double>(s.referenceNs - first.referenceNs);
+            meanY += static_cast<double>(s.ptpNs - first.ptpNs);
+        }
+        meanX /= static_cast<double>(window.size());
+        meanY /= static_cast<double>(window.size());
+
+        auto sxy{0.}, sxx{0.};
+        for (const auto &s: window) {
+            const auto dx{static_cast<double>(s.referenceNs - first.referenceNs) - meanX};
+            const auto dy{static_cast<double>(s.ptpNs - first.ptpNs) - meanY};
+            sxy += dx * dy;
+            sxx += dx * dx;
+        }
+
+        const auto rate{sxy / sxx};
+        if (std::abs(rate - 1.) > Server::Constants::PtpClockMaxRateDeviation) {
+            return std::nullopt;
+        }
+
+        return rate;
+    }
+}
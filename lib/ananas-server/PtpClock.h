@@ -0,0 +1,94 @@
+#ifndef ANANASPTPCLOCK_H
+#define ANANASPTPCLOCK_H
+
+#include "Clock.h"
+#include <juce_core/juce_core.h>
+#include <optional>
+
+namespace ananas
+{
+    /**
+     * A clock that runs at the rate of the PTP timebase, for pacing audio
+     * where there's no sound card to do it, without the drift of the local
+     * oscillator against the clients.
+     *
+     * The rate is a least-squares fit of PTP timestamps against the
+     * reference clock at which they arrived; until there's enough of them,
+     * it's the reference clock's rate. Only the rate follows PTP: time is
+     * counted from the reference clock's epoch, and stays continuous as the
+     * fit changes, so the clock never jumps, even if the timebase does.
+     * Timers are the reference clock's.
+     *
+     * addTimestamp() is for one thread at a time; everything else is safe
+     * from any thread.
+     */
+    class PtpClock final : public Clock
+    {
+    public:
+        explicit PtpClock(Clock &reference = getSystem());
+
+        [[nodiscard]] int64_t now() const override;
+
+        void sleepUntil(int64_t timeNs) override;
+
+        /**
+         * Feed a PTP timestamp, received at the given reference time.
+         * Timestamps that don't move time forward (duplicates, or reordered
+         * in transit) are ignored.
+         */
+        void addTimestamp(int64_t ptpNs, int64_t referenceNs);
+
+        /**
+         * @return Whether the rate follows PTP yet; how far it is from the
+         * reference clock's, in ppm; and how many timestamps have been used,
+         * and fits restarted.
+         */
+        [[nodiscard]] juce::var getStats() const;
+
+    protected:
+        void startTimer(ClockTimer &timer, int64_t intervalNs) override;
+
+        void stopTimer(ClockTimer &timer) override;
+
+    private:
+        /**
+         * time = timeNs + (reference - referenceNs) * rate.
+         */
+        struct Mapping
+        {
+            int64_t referenceNs{0};
+            int64_t timeNs{0};
+            double rate{1.};
+        };
+
+        struct Sample
+        {
+            int64_t ptpNs{0};
+            int64_t referenceNs{0};
+        };
+
+        static int64_t toTime(const Mapping &m, int64_t referenceNs);
+
+        static int64_t toReference(const Mapping &m, int64_t timeNs);
+
+        /**
+         * @return The rate implied by the current window; nullopt if it
+         * doesn't span long enough, or the rate is implausible.
+         */
+        [[nodiscard]] std::optional<double> fitRate() const;
+
+        Clock &reference;
+        std::atomic<Mapping> mapping{Mapping{}};
+
+        // Oldest first.
+        std::vector<Sample> window;
+
+        std::atomic<bool> locked{false};
+        std::atomic<uint64_t> numTimestamps{0};
+        std::atomic<uint64_t> numResets{0};
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PtpClock)
+    };
+}
+
+#endif //ANANASPTPCLOCK_H
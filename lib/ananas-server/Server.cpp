@@ -2,23 +2,42 @@
 #include "Server.h"
 #include <AnanasUtils.h>
 #include <AuthorityInfo.h>
+#include "Logger.h"
 
 namespace ananas::Server
 {
-    Server::Server(const uint numChannelsToSend) : numChannels(numChannelsToSend),
-                                                   fifo(numChannelsToSend)
+    Server::Server(const uint numChannelsToSend, Clock &clock)
+        : clock(clock),
+          ptpClock(clock),
+          clients(clock),
+          modules(clock)
     {
-        // Add all the threads.
-        threads.add(new AudioSender(Sockets::AudioSenderSocketParams, fifo));
-        threads.add(new TimestampListener(Sockets::TimestampListenerSocketParams));
+        Logger::attach();
+
+        // The default stream.
+        addStream({
+            "main",
+            numChannelsToSend,
+            Sockets::AudioSenderSocketParams.ip,
+            Sockets::AudioSenderSocketParams.remotePort
+        });
+
+        // Add all the threads. The audio sender applies new timestamps from
+        // the timestamp listener to every stream.
+        const auto timestampListener{new TimestampListener(Sockets::TimestampListenerSocketParams, ptpClock, clock)};
+        threads.add(new AudioSender(Sockets::AudioSenderSocketParams, streams, *timestampListener, metrics, clock, ptpClock));
+        threads.add(timestampListener);
         threads.add(new ClientListener(Sockets::ClientListenerSocketParams, clients, modules));
         threads.add(new AuthorityListener(Sockets::AuthorityListenerSocketParams, authority));
         threads.add(new RebootSender(Sockets::RebootSenderSocketParams, clients));
         threads.add(new SwitchInspector(Threads::SwitchInspectorThreadParams, switches));
+        threads.add(new RetransmitListener(Sockets::RetransmitListenerSocketParams, streams, clock));
 
-        // The server should listen for change messages sent by all threads.
+        // If one of the threads announces a change, broadcast that change to
+        // any listeners. With none (e.g. headless), nothing is posted, so no
+        // message loop is needed.
         for (const auto &t: threads) {
-            t->addChangeListener(this);
+            t->setStateChangedCallback([this] { sendChangeMessage(); });
         }
     }
 
@@ -26,20 +45,43 @@ namespace ananas::Server
     {
         releaseResources();
 
-        for (const auto &t: threads) {
-            t->removeChangeListener(this);
-        }
+        Logger::detach();
     }
 
     void Server::prepareToPlay(const int samplesPerBlockExpected, const double sampleRate)
     {
+        // For whichever thread the host calls processBlock() on.
+        Trace::reserveThread("Audio thread");
+
+        if (capture != nullptr) {
+            // Not fatal; the audio still goes out.
+            capture->start();
+        }
+
+        if (recorder != nullptr && offlineRender == nullptr) {
+            // Not fatal either.
+            recorder->start(sampleRate);
+        }
+
+        if (offlineRender != nullptr) {
+            // Packetized on the writing thread, rather than by the audio
+            // sender, which stays idle.
+            for (auto *stream: streams) {
+                stream->prepare(samplesPerBlockExpected, sampleRate);
+            }
+            offlineRender->start();
+        }
+
         for (const auto &t: threads) {
             if (auto *s = dynamic_cast<AudioSender *>(t)) {
+                if (offlineRender != nullptr) continue;
                 // The audio sender needs to be prepared; other threads do not.
-                s->prepare(numChannels, samplesPerBlockExpected, sampleRate);
+                s->prepare(samplesPerBlockExpected, sampleRate);
             }
+            // In a simulation, the thread that drives it does their work.
+            if (simulated) continue;
             // With the audio sender thread prepared, and memory allocated to
-            // its AudioPacket member, it's safe to start all the threads.
+            // each stream's AudioPacket, it's safe to start all the threads.
             t->startThread();
         }
     }
@@ -58,196 +100,1186 @@ namespace ananas::Server
                 }
             }
         }
+
+        // With everything that records to it stopped.
+        if (capture != nullptr) {
+            capture->stop();
+        }
+
+        if (recorder != nullptr) {
+            recorder->stop();
+        }
+
+        if (offlineRender != nullptr) {
+            offlineRender->stop();
+        }
+    }
+
+    void Server::getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill)
+    {
+        writeToStream(0, bufferToFill);
+    }
+
+    int Server::addStream(const StreamParams &params)
+    {
+        jassert(getStreamIndex(params.name) < 0);
+
+        streams.add(new AudioStream(params, clock));
+        return streams.size() - 1;
+    }
+
+    void Server::writeToStream(const int streamIndex, const juce::AudioSourceChannelInfo &bufferToFill)
+    {
+        ANANAS_TRACE_SCOPE("Server::writeToStream");
+
+        if (auto *stream = streams[streamIndex]) {
+            if (offlineRender != nullptr) {
+                offlineRender->write(*stream, bufferToFill);
+            } else if (!playingRender) {
+                stream->getFifo().write(bufferToFill.buffer);
+
+                if (auto *s = getAudioSender()) {
+                    s->sendInline(streamIndex);
+                }
+            }
+        }
+    }
+
+    int Server::getNumStreams() const
+    {
+        return streams.size();
+    }
+
+    int Server::getStreamIndex(const juce::String &name) const
+    {
+        for (int i{0}; i < streams.size(); ++i) {
+            if (streams[i]->getParams().name == name) return i;
+        }
+        return -1;
+    }
+
+    bool Server::isConnected() const
+    {
+        return std::all_of(threads.begin(), threads.end(), [](const AnanasThread *t)
+        {
+            return t->isConnected();
+        });
+    }
+
+    ClientList *Server::getClientList()
+    {
+        return &clients;
+    }
+
+    ModuleList *Server::getModuleList()
+    {
+        return &modules;
+    }
+
+    AuthorityInfo *Server::getAuthority()
+    {
+        return &authority;
+    }
+
+    SwitchList *Server::getSwitches()
+    {
+        return &switches;
+    }
+
+    void Server::setCompressionEnabled(const bool shouldCompress)
+    {
+        for (auto *stream: streams) {
+            stream->setCompressionEnabled(shouldCompress);
+        }
+    }
+
+    double Server::getCompressionRatio() const
+    {
+        juce::uint64 raw{0}, encoded{0};
+        for (const auto *stream: streams) {
+            raw += stream->getNumRawBytes();
+            encoded += stream->getNumEncodedBytes();
+        }
+        return raw > 0 ? static_cast<double>(encoded) / static_cast<double>(raw) : 1.;
+    }
+
+    void Server::setFecParams(const int numDataPackets, const int numParityPackets)
+    {
+        for (auto *stream: streams) {
+            stream->setFecParams(numDataPackets, numParityPackets);
+        }
+    }
+
+    double Server::getFecOverhead() const
+    {
+        juce::uint64 audio{0}, parity{0};
+        for (const auto *stream: streams) {
+            audio += stream->getNumAudioBytes();
+            parity += stream->getNumParityBytes();
+        }
+        return audio > 0 ? static_cast<double>(parity) / static_cast<double>(audio) : 0.;
+    }
+
+    void Server::setFifoPolicies(const Fifo::OverflowPolicy overflow, const Fifo::UnderflowPolicy underflow)
+    {
+        for (auto *stream: streams) {
+            stream->getFifo().setPolicies(overflow, underflow);
+        }
+    }
+
+    void Server::setFifoTargetLatency(const int64_t targetLatencyNs)
+    {
+        jassert(targetLatencyNs >= 0);
+
+        for (auto *stream: streams) {
+            stream->setFifoTargetLatency(std::max(int64_t{0}, targetLatencyNs));
+        }
+    }
+
+    float Server::getFifoFillLevel(const int streamIndex) const
+    {
+        if (const auto *stream = streams[streamIndex]) {
+            return stream->getFifo().getFillLevel();
+        }
+        return 0.f;
+    }
+
+    juce::var Server::getFifoStats() const
+    {
+        const auto object{new juce::DynamicObject()};
+        for (const auto *stream: streams) {
+            object->setProperty(stream->getParams().name, stream->getFifo().getStats());
+        }
+        return object;
+    }
+
+    void Server::setRedundantPath(const juce::String &interfaceIP, const juce::String &groupIP, const long skewNs)
+    {
+        if (auto *s = getAudioSender()) {
+            s->setRedundantPath(interfaceIP, groupIP, skewNs);
+        }
+    }
+
+    void Server::setMulticastLoopback(const bool shouldLoopBack)
+    {
+        if (auto *s = getAudioSender()) {
+            s->setMulticastLoopback(shouldLoopBack);
+        }
+    }
+
+    void Server::setInlineSendEnabled(const bool shouldSendInline)
+    {
+        if (auto *s = getAudioSender()) {
+            s->setInlineSendEnabled(shouldSendInline);
+        }
+    }
+
+    bool Server::isInlineSendActive() const
+    {
+        if (const auto *s = getAudioSender()) {
+            return s->isInlineSendActive();
+        }
+        return false;
+    }
+
+    juce::var Server::getInlineSendStats() const
+    {
+        if (const auto *s = getAudioSender()) {
+            return s->getInlineSendStats();
+        }
+        return {};
+    }
+
+    juce::var Server::getRetransmitStats() const
+    {
+        for (const auto &t: threads) {
+            if (const auto *r = dynamic_cast<RetransmitListener *>(t)) {
+                return r->getStats();
+            }
+        }
+        return juce::var{};
+    }
+
+    bool Server::setThreadPolicy(const juce::String &threadName, const ThreadPolicy &policy)
+    {
+        for (const auto &t: threads) {
+            if (t->getThreadName() == threadName) {
+                t->setPolicy(policy);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    juce::var Server::getThreadPolicies() const
+    {
+        const auto object{new juce::DynamicObject()};
+
+        for (const auto &t: threads) {
+            if (const auto applied{t->getAppliedPolicy()}; !applied.isVoid()) {
+                object->setProperty(t->getThreadName(), applied);
+            }
+        }
+
+        return object;
+    }
+
+    void Server::setMemoryLocked(const bool shouldLock)
+    {
+        if (auto *s = getAudioSender()) {
+            s->setMemoryLocked(shouldLock);
+        }
+    }
+
+    size_t Server::getNumLockedBytes() const
+    {
+        if (const auto *s = getAudioSender()) {
+            return s->getNumLockedBytes();
+        }
+        return 0;
+    }
+
+    juce::var Server::getMetrics() const
+    {
+        return metrics.toVar();
+    }
+
+    void Server::resetMetrics()
+    {
+        metrics.reset();
+    }
+
+    void Server::setTxTimestamping(const TxTimestamper::Mode mode, const int64_t clockOffsetNs)
+    {
+        if (auto *s = getAudioSender()) {
+            s->setTxTimestamping(mode, clockOffsetNs);
+        }
+    }
+
+    void Server::setCaptureFile(const juce::File &file)
+    {
+        jassert(capture == nullptr || !threads[0]->isThreadRunning());
+
+        capture = std::make_unique<PacketCapture>(file);
+
+        // One channel per recording thread.
+        for (auto *t: threads) {
+            if (dynamic_cast<AudioSender *>(t) != nullptr || dynamic_cast<AnnouncementListenerThread *>(t) != nullptr) {
+                dynamic_cast<UDPMulticastThread *>(t)->setCapture(&capture->addChannel());
+            }
+        }
+    }
+
+    juce::var Server::getCaptureStats() const
+    {
+        return capture != nullptr ? capture->getStats() : juce::var{};
+    }
+
+    void Server::setRecordingFile(const juce::File &file)
+    {
+        jassert(!threads[0]->isThreadRunning());
+
+        recorder = std::make_unique<StreamRecorder>(file);
+
+        std::vector<StreamRecorder::Track *> tracks;
+        for (const auto *stream: streams) {
+            tracks.push_back(&recorder->addTrack(stream->getParams().name, stream->getParams().numChannels));
+        }
+
+        if (auto *s = getAudioSender()) {
+            s->setRecordingTracks(std::move(tracks));
+        }
+    }
+
+    juce::var Server::getRecordingStats() const
+    {
+        return recorder != nullptr ? recorder->getStats() : juce::var{};
+    }
+
+    void Server::setReplayFile(const juce::File &file, const double speed)
+    {
+        jassert(!threads[0]->isThreadRunning());
+
+        for (auto *t: threads) {
+            if (dynamic_cast<ReplayThread *>(t) != nullptr) {
+                threads.removeObject(t);
+                break;
+            }
+        }
+
+        auto *replay{new ReplayThread(Threads::ReplayThreadParams, file, speed, clock)};
+        for (auto *t: threads) {
+            if (dynamic_cast<TimestampListener *>(t) != nullptr
+                || dynamic_cast<ClientListener *>(t) != nullptr
+                || dynamic_cast<AuthorityListener *>(t) != nullptr) {
+                replay->addListener(*dynamic_cast<AnnouncementListenerThread *>(t));
+            }
+        }
+
+        threads.add(replay);
+        replay->setStateChangedCallback([this] { sendChangeMessage(); });
+    }
+
+    void Server::setOfflineRenderFile(const juce::File &file)
+    {
+        jassert(!threads[0]->isThreadRunning());
+
+        offlineRender = file != juce::File{} ? std::make_unique<OfflineRender>(file) : nullptr;
+    }
+
+    bool Server::isRenderingOffline() const
+    {
+        return offlineRender != nullptr;
+    }
+
+    juce::var Server::getOfflineRenderStats() const
+    {
+        return offlineRender != nullptr ? offlineRender->getStats() : juce::var{};
+    }
+
+    void Server::setRenderPlaybackFile(const juce::File &file)
+    {
+        if (auto *s = getAudioSender()) {
+            s->setRenderPlaybackFile(file);
+            playingRender = file != juce::File{};
+        }
+    }
+
+    bool Server::isPlayingRender() const
+    {
+        return playingRender;
+    }
+
+    bool Server::setImpairment(const juce::String &threadName, const ImpairmentScript &script)
+    {
+        for (auto *t: threads) {
+            if (auto *u = dynamic_cast<UDPMulticastThread *>(t); u != nullptr && t->getThreadName() == threadName) {
+                u->setImpairment(script, clock);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    juce::var Server::getImpairmentStats() const
+    {
+        const auto object{new juce::DynamicObject()};
+
+        for (const auto *t: threads) {
+            if (const auto *u = dynamic_cast<const UDPMulticastThread *>(t)) {
+                if (const auto stats{u->getImpairmentStats()}; !stats.isVoid()) {
+                    object->setProperty(t->getThreadName(), stats);
+                }
+            }
+        }
+
+        return object;
+    }
+
+    PtpClock &Server::getPtpClock()
+    {
+        return ptpClock;
+    }
+
+    void Server::setSimulated(const bool shouldSimulate, SimulatedSink sink)
+    {
+        jassert(!threads[0]->isThreadRunning());
+
+        simulated = shouldSimulate;
+
+        for (auto *t: threads) {
+            if (auto *u = dynamic_cast<UDPMulticastThread *>(t)) {
+                UDPMulticastThread::Sink threadSink;
+                if (sink != nullptr) {
+                    threadSink = [sink, name = t->getThreadName()](const uint8_t *data, const size_t size, const juce::String &toIP, const int toPort)
+                    {
+                        sink(name, data, size, toIP, toPort);
+                    };
+                }
+                u->setSimulated(shouldSimulate, std::move(threadSink));
+            }
+        }
+    }
+
+    bool Server::simulateDatagram(const juce::String &threadName,
+                                  const uint8_t *data,
+                                  const size_t size,
+                                  const juce::String &fromIP,
+                                  const int fromPort)
+    {
+        jassert(simulated);
+
+        for (auto *t: threads) {
+            if (auto *u = dynamic_cast<UDPMulticastThread *>(t); u != nullptr && t->getThreadName() == threadName) {
+                u->simulateArrival(data, size, fromIP, fromPort);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int Server::runSimulation()
+    {
+        jassert(simulated);
+
+        for (auto *t: threads) {
+            if (auto *u = dynamic_cast<UDPMulticastThread *>(t)) {
+                u->releaseDueDatagrams();
+            }
+        }
+
+        if (auto *s = getAudioSender(); s != nullptr && offlineRender == nullptr) {
+            return s->runOnce();
+        }
+        return 0;
+    }
+
+    Server::AudioSender *Server::getAudioSender() const
+    {
+        return dynamic_cast<AudioSender *>(threads[0]);
+    }
+
+
+    //==========================================================================
+
+    Server::AnanasThread::AnanasThread(const Utils::ThreadParams &p)
+        : Thread(p.name), timeoutMs(p.timeoutMs)
+    {
+    }
+
+    void Server::AnanasThread::setStateChangedCallback(std::function<void()> callback)
+    {
+        jassert(!isThreadRunning());
+        onStateChanged = std::move(callback);
+    }
+
+    void Server::AnanasThread::notifyStateChanged() const
+    {
+        if (onStateChanged) {
+            onStateChanged();
+        }
+    }
+
+    void Server::AnanasThread::run()
+    {
+        Trace::registerThread();
+
+        {
+            const auto applied{policy.applyToCurrentThread()};
+
+            if (const auto errors{applied[Utils::Identifiers::ThreadPolicyErrorsPropertyID].toString()}; errors.isNotEmpty()) {
+                ANANAS_LOG_WARNING("Thread policy not fully applied: %s", errors.toRawUTF8());
+            }
+
+            const std::lock_guard lock{policyMutex};
+            appliedPolicy = applied;
+        }
+
+        while (!connect() && !threadShouldExit()) {
+            for (uint i{0}; i < Constants::ThreadConnectWaitIterations && !threadShouldExit(); ++i)
+                wait(Constants::ThreadConnectWaitIntervalMs);
+        }
+
+        if (!threadShouldExit()) {
+            connected = true;
+            runImpl();
+        }
+    }
+
+    int Server::AnanasThread::getTimeout() const
+    {
+        return timeoutMs;
+    }
+
+    bool Server::AnanasThread::isConnected() const
+    {
+        return connected;
+    }
+
+    void Server::AnanasThread::setPolicy(const ThreadPolicy &newPolicy)
+    {
+        jassert(!isThreadRunning());
+        policy = newPolicy;
+    }
+
+    juce::var Server::AnanasThread::getAppliedPolicy() const
+    {
+        const std::lock_guard lock{policyMutex};
+        return appliedPolicy;
+    }
+
+    //==========================================================================
+
+    Server::UDPMulticastThread::UDPMulticastThread(const Utils::ThreadSocketParams &p)
+        : AnanasThread(p),
+          ip(p.ip),
+          localPort(p.localPort)
+    {
+    }
+
+    Server::UDPMulticastThread::~UDPMulticastThread()
+    {
+        socket.leaveMulticast(ip);
+        socket.shutdown();
+    }
+
+    bool Server::UDPMulticastThread::connect()
+    {
+        const auto result{connectSocket(socket, Utils::Strings::LocalInterfaceIP, ip)};
+        notifyStateChanged();
+        return result;
+    }
+
+    juce::uint16 Server::UDPMulticastThread::getLocalPort() const
+    {
+        return localPort;
+    }
+
+    void Server::UDPMulticastThread::setCapture(PacketCapture::Channel *channel)
+    {
+        jassert(!isThreadRunning());
+        capture = channel;
+
+        // Senders send from the local interface; listeners receive on their
+        // group, or on the local interface if unicast.
+        const auto isSender{dynamic_cast<const SenderThread *>(this) != nullptr};
+        captureEndpoint = Endpoint::fromString(isSender || ip.isEmpty() ? juce::String{Utils::Strings::LocalInterfaceIP} : ip,
+                                               localPort);
+    }
+
+    void Server::UDPMulticastThread::setImpairment(const ImpairmentScript &script, Clock &clock)
+    {
+        jassert(!isThreadRunning());
+        impairment = std::make_unique<NetworkImpairment>(script, clock);
+    }
+
+    juce::var Server::UDPMulticastThread::getImpairmentStats() const
+    {
+        return impairment != nullptr ? impairment->getStats() : juce::var{};
+    }
+
+    bool Server::UDPMulticastThread::sendDatagram(const juce::String &toIP,
+                                                  const int toPort,
+                                                  const uint8_t *data,
+                                                  const size_t size)
+    {
+        if (impairment == nullptr) {
+            return writeToSocket(toIP, toPort, data, size);
+        }
+
+        impairment->submit(PacketCapture::Direction::outbound, data, size, toIP, toPort);
+        releaseDueDatagrams();
+        return true;
+    }
+
+    void Server::UDPMulticastThread::simulateArrival(const uint8_t *data,
+                                                     const size_t size,
+                                                     const juce::String &fromIP,
+                                                     const int fromPort)
+    {
+        if (impairment == nullptr) {
+            receive(data, size, fromIP, fromPort);
+            return;
+        }
+
+        impairment->submit(PacketCapture::Direction::inbound, data, size, fromIP, fromPort);
+        releaseDueDatagrams();
+    }
+
+    void Server::UDPMulticastThread::setSimulated(const bool shouldSimulate, Sink sink)
+    {
+        jassert(!isThreadRunning());
+        simulated = shouldSimulate;
+        simulatedSink = std::move(sink);
+    }
+
+    void Server::UDPMulticastThread::releaseDueDatagrams()
+    {
+        if (impairment == nullptr) return;
+
+        while (impairment->next(dueDatagram)) {
+            if (dueDatagram.direction == PacketCapture::Direction::outbound) {
+                writeToSocket(dueDatagram.ip, dueDatagram.port, dueDatagram.data.data(), dueDatagram.data.size());
+            } else {
+                receive(dueDatagram.data.data(), dueDatagram.data.size(), dueDatagram.ip, dueDatagram.port);
+            }
+        }
+    }
+
+    void Server::UDPMulticastThread::receive(const uint8_t *, size_t, const juce::String &, int)
+    {
+    }
+
+    bool Server::UDPMulticastThread::writeToSocket(const juce::String &toIP,
+                                                   const int toPort,
+                                                   const uint8_t *data,
+                                                   const size_t size)
+    {
+        if (simulated) {
+            if (simulatedSink != nullptr) {
+                simulatedSink(data, size, toIP, toPort);
+            }
+        } else if (socket.write(toIP, toPort, data, static_cast<int>(size)) < 0) {
+            return false;
+        }
+
+        if (capture != nullptr) {
+            capture->add(PacketCapture::Direction::outbound, data, size, captureEndpoint, Endpoint::fromString(toIP, toPort));
+        }
+        return true;
+    }
+
+    bool Server::UDPMulticastThread::connectSocket(juce::DatagramSocket &socketToConnect,
+                                                   const juce::String &interfaceIP,
+                                                   const juce::String &groupIP)
+    {
+        if (-1 == socketToConnect.getBoundPort()) {
+            if (!socketToConnect.setEnablePortReuse(true)) {
+                ANANAS_LOG_ERROR("Failed to set socket port reuse: %s", strerror(errno));
+                return false;
+            }
+
+            if (!socketToConnect.bindToPort(localPort, interfaceIP)) {
+                ANANAS_LOG_ERROR("Failed to bind socket to port: %s", strerror(errno));
+                return false;
+            }
+
+            if (!socketToConnect.joinMulticast(groupIP)) {
+                ANANAS_LOG_ERROR("Failed to join multicast group: %s", strerror(errno));
+                return false;
+            }
+
+            socketToConnect.setMulticastLoopbackEnabled(false);
+            socketToConnect.waitUntilReady(false, 1000);
+        }
+
+        return true;
+    }
+
+    //==========================================================================
+
+    Server::SenderThread::SenderThread(const Utils::SenderThreadSocketParams &p)
+        : UDPMulticastThread(p),
+          remotePort(p.remotePort)
+    {
+    }
+
+    //==========================================================================
+
+    Server::AudioSender::AudioSender(const Utils::SenderThreadSocketParams &p,
+                                     juce::OwnedArray<AudioStream> &streams,
+                                     TimestampListener &timestampListener,
+                                     SenderMetrics &metrics,
+                                     Clock &clock,
+                                     PtpClock &ptpClock)
+        : SenderThread(p),
+          streams(streams),
+          timestampListener(timestampListener),
+          metrics(metrics),
+          clock(clock),
+          ptpClock(ptpClock),
+          txTimestamper(metrics)
+    {
+    }
+
+    bool Server::AudioSender::prepare(const int samplesPerBlockExpected, const double sampleRate)
+    {
+        size_t numLocked{0};
+
+        inlineSendActive.store(false, std::memory_order_release);
+        inlineBatches.clear();
+        auto inlineActive{inlineSendEnabled && canSendInline()};
+
+        for (auto *stream: streams) {
+            stream->prepare(samplesPerBlockExpected, sampleRate);
+
+            if (inlineActive) {
+                const auto &params{stream->getParams()};
+                auto batch{std::make_unique<DatagramBatch>(metrics)};
+                if (!batch->prepare(Constants::InlineSendMaxPackets, AudioStream::getMaxPacketSize(params.numChannels), params.ip, params.port)) {
+                    ANANAS_LOG_WARNING("Can't send %s inline to %s; sending from the audio sender.",
+                                       params.name.toRawUTF8(), params.ip.toRawUTF8());
+                    inlineActive = false;
+                }
+                inlineBatches.push_back(std::move(batch));
+            }
+
+            if (memoryLocked) {
+                numLocked += stream->lockMemory();
+            }
+        }
+
+        // In inline mode, the audio thread wakes the sender itself, and only
+        // when it leaves something for it.
+        for (auto *stream: streams) {
+            stream->getFifo().setReadyEvent(inlineActive ? nullptr : &streamReady);
+        }
+        if (!inlineActive) {
+            inlineBatches.clear();
+        }
+        lastDepartureNs.assign(static_cast<size_t>(streams.size()), 0);
+        inlineSendActive.store(inlineActive, std::memory_order_release);
+
+        numLockedBytes.store(numLocked, std::memory_order_relaxed);
+
+        return simulated || startThread();
+    }
+
+    bool Server::AudioSender::stopThread(const int timeOutMilliseconds)
+    {
+        // Keep the audio thread off the socket, waiting out any inline send
+        // in progress.
+        inlineSocketHandle.store(-1, std::memory_order_release);
+        for (auto *stream: streams) {
+            const juce::SpinLock::ScopedLockType lock{stream->getSendLock()};
+        }
+
+        signalThreadShouldExit();
+        streamReady.signal();
+        for (auto *stream: streams) {
+            stream->getFifo().abortRead();
+        }
+        const auto stopped{Thread::stopThread(timeOutMilliseconds)};
+        if (stopped) {
+            txTimestamper.disable();
+        }
+        return stopped;
     }
 
-    void Server::getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill)
+    int Server::AudioSender::runOnce()
     {
-        // These checks are kind of overkill, since the order in which threads
-        // were added to the OwnedArray is known, but as a santiy check...
-        if (auto *s = dynamic_cast<AudioSender *>(threads[0])) {
-            if (auto *t = dynamic_cast<TimestampListener *>(threads[1])) {
-                // If a new timestamp is available, send it to the audio sender
-                // to see whether the packet timestamp needs to be updated.
-                if (t->isNewTimestampAvailable()) {
-                    s->setPacketTime(t->getTimestamp());
+        // If a new timestamp is available, see whether each stream's
+        // packet timestamp needs to be updated. Doing so here, rather than
+        // on the audio thread, keeps it from racing with writeHeader().
+        if (timestampListener.isNewTimestampAvailable()) {
+            const auto ts{timestampListener.getTimestamp()};
+            for (auto *stream: streams) {
+                int64_t diffNs;
+                bool stepped;
+                {
+                    // In inline mode, the audio thread may be mid-packet.
+                    const juce::SpinLock::ScopedLockType lock{stream->getSendLock()};
+                    stepped = stream->setTime(ts, diffNs);
                 }
+                metrics.timestampError.record(std::abs(diffNs));
+                if (stepped) {
+                    metrics.timestampStep.record(std::abs(diffNs));
+                }
+            }
+        }
+
+        // Send a packet from each stream that has one ready, in turn, so
+        // that no stream can starve the others.
+        auto numSent{0};
+
+        for (int i{0}; i < streams.size() && !threadShouldExit(); ++i) {
+            if (sendNextPacket(i, lastDepartureNs[static_cast<size_t>(i)])) {
+                ++numSent;
+                clock.sleepFor(streams[i]->getSleepInterval());
             }
         }
 
-        fifo.write(bufferToFill.buffer);
+        releaseDueDatagrams();
+
+        // Collect transmit timestamps for whatever has gone out so far.
+        txTimestamper.poll(socket.getRawSocketHandle());
+
+        return numSent;
     }
 
-    void Server::changeListenerCallback(ChangeBroadcaster *source)
+    void Server::AudioSender::setRedundantPath(const juce::String &interfaceIP, const juce::String &groupIP, const long skewNs)
     {
-        // If one of the threads announces a change, broadcast that change to
-        // any listeners.
-        sendChangeMessage();
+        // The redundant socket is connected alongside the primary one, when
+        // the thread starts.
+        jassert(!isThreadRunning());
+
+        redundantPathEnabled = true;
+        redundantInterfaceIP = interfaceIP;
+        redundantIP = groupIP;
+        redundantSkewNs = juce::jlimit(0l, Constants::MaxRedundantPathSkewNs, skewNs);
     }
 
-    bool Server::isConnected() const
+    void Server::AudioSender::setMemoryLocked(const bool shouldLock)
     {
-        return std::all_of(threads.begin(), threads.end(), [](const AnanasThread *t)
-        {
-            return t->isConnected();
-        });
+        jassert(!isThreadRunning());
+        memoryLocked = shouldLock;
     }
 
-    ClientList *Server::getClientList()
+    size_t Server::AudioSender::getNumLockedBytes() const
     {
-        return &clients;
+        return numLockedBytes.load(std::memory_order_relaxed);
     }
 
-    ModuleList *Server::getModuleList()
+    void Server::AudioSender::setMulticastLoopback(const bool shouldLoopBack)
     {
-        return &modules;
+        jassert(!isThreadRunning());
+        multicastLoopback = shouldLoopBack;
     }
 
-    AuthorityInfo *Server::getAuthority()
+    void Server::AudioSender::setInlineSendEnabled(const bool shouldSendInline)
     {
-        return &authority;
+        jassert(!isThreadRunning());
+        inlineSendEnabled = shouldSendInline;
     }
 
-    SwitchList *Server::getSwitches()
+    bool Server::AudioSender::isInlineSendActive() const
     {
-        return &switches;
+        return inlineSendActive.load(std::memory_order_acquire);
     }
 
-
-    //==========================================================================
-
-    Server::AnanasThread::AnanasThread(const Utils::ThreadParams &p)
-        : Thread(p.name), timeoutMs(p.timeoutMs)
+    juce::var Server::AudioSender::getInlineSendStats() const
     {
+        if (!inlineSendEnabled) return {};
+
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::InlineSendActivePropertyID, isInlineSendActive());
+        object->setProperty(Utils::Identifiers::InlineSendPacketsPropertyID, static_cast<juce::int64>(numInlinePackets.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::InlineSendDeferredPropertyID, static_cast<juce::int64>(numInlineDeferred.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::InlineSendContendedPropertyID, static_cast<juce::int64>(numInlineContended.load(std::memory_order_relaxed)));
+        return object;
     }
 
-    void Server::AnanasThread::run()
+    void Server::AudioSender::sendInline(const int streamIndex)
     {
-        while (!connect() && !threadShouldExit()) {
-            for (uint i{0}; i < Constants::ThreadConnectWaitIterations && !threadShouldExit(); ++i)
-                wait(Constants::ThreadConnectWaitIntervalMs);
+        if (!inlineSendActive.load(std::memory_order_acquire)) return;
+
+        ANANAS_TRACE_SCOPE("AudioSender::sendInline");
+
+        auto *stream{streams[streamIndex]};
+
+        // FEC is the audio sender's.
+        if (stream->isFecEnabled()) {
+            streamReady.signal();
+            return;
         }
 
-        if (!threadShouldExit()) {
-            connected = true;
-            runImpl();
+        // If the audio sender has the stream, it'll see what's ready.
+        const juce::SpinLock::ScopedTryLockType lock{stream->getSendLock()};
+        if (!lock.isLocked()) {
+            numInlineContended.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // Not connected yet, or stopping; read under the lock, so that
+        // stopThread() can wait out a send in progress.
+        const auto socketHandle{inlineSocketHandle.load(std::memory_order_acquire)};
+        if (socketHandle < 0) {
+            streamReady.signal();
+            return;
+        }
+
+        // Anything the audio sender has yet to send from the last callback
+        // must go first, so leave it all to the sender.
+        auto &batch{*inlineBatches[static_cast<size_t>(streamIndex)]};
+        if (batch.isEmpty()) {
+            auto *track{static_cast<size_t>(streamIndex) < recordingTracks.size() ? recordingTracks[static_cast<size_t>(streamIndex)] : nullptr};
+
+            // Real audio only; silence for an underflow is the sender's.
+            while (!batch.isFull() && stream->getFifo().isReady(Constants::FramesPerPacket)) {
+                size_t size;
+                int64_t writeTimeNs;
+                const auto readStart{SenderMetrics::now()};
+                const auto *data{stream->readPacket(size, writeTimeNs)};
+                if (data == nullptr) break;
+                metrics.conversion.record(SenderMetrics::now() - readStart);
+
+                batch.add(data, size, writeTimeNs);
+                stream->getHistory().store(data, size);
+                if (track != nullptr) {
+                    track->add(stream->getPacketAudio(), stream->getPacketAudioSize());
+                }
+            }
+
+            // The stream's last departure is the sender's too, but guarded
+            // by the send lock, so either may take it up.
+            numInlinePackets.fetch_add(static_cast<uint64_t>(batch.send(socketHandle, &lastDepartureNs[static_cast<size_t>(streamIndex)])),
+                                       std::memory_order_relaxed);
+            numInlineDeferred.fetch_add(static_cast<uint64_t>(batch.getNumPending()), std::memory_order_relaxed);
+        }
+
+        if (!batch.isEmpty() || stream->isReady()) {
+            streamReady.signal();
         }
     }
 
-    int Server::AnanasThread::getTimeout() const
+    bool Server::AudioSender::canSendInline() const
     {
-        return timeoutMs;
+        const char *reason{nullptr};
+
+        if (!DatagramBatch::isSupported()) {
+            reason = "isn't supported on this platform";
+        } else if (impairment != nullptr) {
+            reason = "doesn't go through an impairment";
+        } else if (capture != nullptr) {
+            reason = "isn't captured";
+        } else if (txTimestamper.getMode() != TxTimestamper::Mode::off) {
+            reason = "isn't transmit timestamped";
+        } else if (redundantPathEnabled) {
+            reason = "doesn't take a redundant path";
+        } else if (simulated) {
+            // Batches go straight to the socket, on the system clock.
+            reason = "isn't simulated";
+        }
+
+        if (reason != nullptr) {
+            ANANAS_LOG_WARNING("Inline sending %s; sending from the audio sender.", reason);
+            return false;
+        }
+
+        return true;
     }
 
-    bool Server::AnanasThread::isConnected() const
+    void Server::AudioSender::setTxTimestamping(const TxTimestamper::Mode mode, const int64_t clockOffsetNs)
     {
-        return connected;
+        jassert(!isThreadRunning());
+        txTimestamper.setMode(mode, clockOffsetNs);
     }
 
-    //==========================================================================
+    void Server::AudioSender::setRenderPlaybackFile(const juce::File &file)
+    {
+        jassert(!isThreadRunning());
+        renderFile = file;
+    }
 
-    Server::UDPMulticastThread::UDPMulticastThread(const Utils::ThreadSocketParams &p)
-        : AnanasThread(p),
-          ip(p.ip),
-          localPort(p.localPort)
+    bool Server::AudioSender::isPlayingRender() const
     {
+        return renderFile != juce::File{};
     }
 
-    Server::UDPMulticastThread::~UDPMulticastThread()
+    void Server::AudioSender::setRecordingTracks(std::vector<StreamRecorder::Track *> tracks)
     {
-        socket.leaveMulticast(ip);
-        socket.shutdown();
+        jassert(!isThreadRunning());
+        recordingTracks = std::move(tracks);
     }
 
-    bool Server::UDPMulticastThread::connect()
+    bool Server::AudioSender::connect()
     {
-        if (-1 == socket.getBoundPort()) {
-            if (!socket.setEnablePortReuse(true)) {
-                std::cerr << getThreadName() << " failed to set socket port reuse: " << strerror(errno) << std::endl;
-                sendChangeMessage();
-                return false;
-            }
+        auto result{connectSocket(socket, Utils::Strings::LocalInterfaceIP, ip)};
 
-            if (!socket.bindToPort(localPort, Utils::Strings::LocalInterfaceIP)) {
-                std::cerr << getThreadName() << " failed to bind socket to port: " << strerror(errno) << std::endl;
-                sendChangeMessage();
-                return false;
-            }
+        if (result && multicastLoopback) {
+            socket.setMulticastLoopbackEnabled(true);
+        }
 
-            if (!socket.joinMulticast(ip)) {
-                std::cerr << getThreadName() << " failed to join multicast group: " << strerror(errno) << std::endl;
-                sendChangeMessage();
-                return false;
-            }
+        if (result && txTimestamper.getMode() != TxTimestamper::Mode::off) {
+            // Not fatal; the audio still goes out.
+            txTimestamper.enable(socket.getRawSocketHandle(), Utils::Strings::LocalInterfaceIP);
+        }
 
-            socket.setMulticastLoopbackEnabled(false);
-            socket.waitUntilReady(false, 1000);
+        if (result && redundantPathEnabled) {
+            result = connectSocket(redundantSocket, redundantInterfaceIP, redundantIP);
         }
 
-        sendChangeMessage();
-        return true;
-    }
+        inlineSocketHandle.store(result ? socket.getRawSocketHandle() : -1, std::memory_order_release);
 
-    //==========================================================================
+        notifyStateChanged();
+        return result;
+    }
 
-    Server::SenderThread::SenderThread(const Utils::SenderThreadSocketParams &p)
-        : UDPMulticastThread(p),
-          remotePort(p.remotePort)
+    void Server::AudioSender::send(const uint8_t *data,
+                                   const size_t size,
+                                   const juce::String &groupIP,
+                                   const int port,
+                                   const int64_t writeTimeNs)
     {
-    }
+        ANANAS_TRACE_SCOPE("AudioSender::send");
 
-    //==========================================================================
+        const auto start{SenderMetrics::now()};
+        const auto sent{sendDatagram(groupIP, port, data, size)};
+        metrics.send.record(SenderMetrics::now() - start);
 
-    Server::AudioSender::AudioSender(const Utils::SenderThreadSocketParams &p, Fifo &fifo)
-        : SenderThread(p),
-          fifo(fifo)
+        // Transmit timestamps are matched to packets in order of sending,
+        // which an impairment would upset.
+        if (sent && impairment == nullptr) {
+            txTimestamper.addSent(writeTimeNs > 0 ? data : nullptr, size, writeTimeNs);
+        }
+
+        if (redundantPathEnabled && !simulated) {
+            // Same bytes, same sequence number, same timestamp; only the path
+            // differs. Skewing the copies means a transient on one fabric is
+            // unlikely to hit both.
+            clock.sleepFor(redundantSkewNs);
+            redundantSocket.write(redundantIP, port, data, static_cast<int>(size));
+        }
+    }
+
+    void Server::AudioSender::sendParity(AudioStream &stream, const uint8_t *data, const size_t size)
     {
+        if (const auto *fec = stream.addToFecGroup(data, size)) {
+            const auto &params{stream.getParams()};
+            for (int j{0}; j < fec->getNumParityPackets(); ++j) {
+                const auto paritySize{fec->getParityPacketSize(j)};
+                send(fec->getParityPacket(j), paritySize, params.ip, params.port + Constants::FecPortOffset, 0);
+                stream.addParityBytesSent(paritySize);
+            }
+        }
     }
 
-    bool Server::AudioSender::prepare(const uint numChannels, const int samplesPerBlockExpected, const double sampleRate)
+    bool Server::AudioSender::sendNextPacket(const int streamIndex, int64_t &lastDepartureNs)
     {
-        juce::ignoreUnused(sampleRate);
+        auto *stream{streams[streamIndex]};
+        const auto &params{stream->getParams()};
+
+        // In inline mode, the audio thread may have the stream; it signals
+        // if it leaves anything behind.
+        const juce::SpinLock::ScopedTryLockType lock{stream->getSendLock()};
+        if (!lock.isLocked()) return false;
+
+        // What the audio thread packetized, but the socket wouldn't take.
+        if (static_cast<size_t>(streamIndex) < inlineBatches.size()) {
+            if (auto &batch{*inlineBatches[static_cast<size_t>(streamIndex)]}; !batch.isEmpty()) {
+                const uint8_t *data;
+                size_t size;
+                int64_t writeTimeNs;
+                while (batch.pop(data, size, writeTimeNs)) {
+                    send(data, size, params.ip, params.port, writeTimeNs);
+
+                    const auto departure{SenderMetrics::now()};
+                    if (writeTimeNs > 0) {
+                        metrics.fifoResidency.record(clock.now() - writeTimeNs);
+                    }
+                    if (lastDepartureNs > 0) {
+                        metrics.interDeparture.record(departure - lastDepartureNs);
+                    }
+                    lastDepartureNs = departure;
 
-        audioBlockSamples = samplesPerBlockExpected;
+                    sendParity(*stream, data, size);
+                }
+                return true;
+            }
+        }
 
-        packet.prepare(numChannels, Constants::FramesPerPacket, sampleRate);
+        if (!stream->isReady()) return false;
 
-        return startThread();
-    }
+        size_t size;
+        int64_t writeTimeNs;
+        const auto readStart{SenderMetrics::now()};
+        const auto *data{stream->readPacket(size, writeTimeNs)};
+        if (data == nullptr) return false;
+        const auto departure{SenderMetrics::now()};
+        metrics.conversion.record(departure - readStart);
 
-    void Server::AudioSender::setPacketTime(const timespec ts)
-    {
-        packet.setTime(ts);
-    }
+        // Write the packet to the socket(s).
+        send(data, size, params.ip, params.port, writeTimeNs);
 
-    int64_t Server::AudioSender::getPacketTime() const
-    {
-        return packet.getTime();
-    }
+        // Write times are on the server's clock.
+        if (writeTimeNs > 0) {
+            metrics.fifoResidency.record(clock.now() - writeTimeNs);
+        }
+        if (lastDepartureNs > 0) {
+            metrics.interDeparture.record(departure - lastDepartureNs);
+        }
+        lastDepartureNs = departure;
 
-    bool Server::AudioSender::stopThread(const int timeOutMilliseconds)
-    {
-        fifo.abortRead();
-        return Thread::stopThread(timeOutMilliseconds);
+        // Keep a copy in case a client asks for it again.
+        stream->getHistory().store(data, size);
+
+        if (static_cast<size_t>(streamIndex) < recordingTracks.size()) {
+            recordingTracks[static_cast<size_t>(streamIndex)]->add(stream->getPacketAudio(), stream->getPacketAudioSize());
+        }
+
+        sendParity(*stream, data, size);
+        return true;
     }
 
     void Server::AudioSender::runImpl()
     {
-        std::cout << getThreadName() << " sending audio packets..." << std::endl << std::flush;
+        if (isPlayingRender()) {
+            playRender();
+            return;
+        }
+
+        ANANAS_LOG_INFO("Sending audio packets...");
 
         while (!threadShouldExit()) {
-            // Read from the fifo into the packet.
-            fifo.read(packet.getAudioData(), Constants::FramesPerPacket);
-            if (threadShouldExit()) break;
-            // Write the header to the packet.
-            packet.writeHeader();
-            // Write the packet to the socket.
-            socket.write(ip, remotePort, packet.getData(), static_cast<int>(packet.getSize()));
+            // Nothing to send; wait for the audio thread to write to a FIFO
+            // (or for a held-back datagram to fall due).
+            if (runOnce() == 0) {
+                ANANAS_TRACE_SCOPE("AudioSender::idle");
+                auto waitMs{
+                    impairment != nullptr
+                        ? impairment->getWaitMs(Constants::SenderIdleWaitMs)
+                        : Constants::SenderIdleWaitMs
+                };
+                // Or until silence is due, if a FIFO is running dry.
+                for (const auto *stream: streams) {
+                    waitMs = stream->getFifo().getUnderflowWaitMs(waitMs);
+                }
+                streamReady.wait(waitMs);
+            }
+        }
+
+        ANANAS_LOG_INFO("Stopping.");
+    }
+
+    void Server::AudioSender::playRender()
+    {
+        CaptureReader reader{renderFile};
+        if (!reader.isValid()) {
+            ANANAS_LOG_ERROR("Can't play render %s.", renderFile.getFullPathName().toRawUTF8());
+        } else {
+            // Anchor the render's timeline to PTP time, as soon as there is
+            // any.
+            ANANAS_LOG_INFO("Waiting for a PTP timestamp to play %s...", renderFile.getFullPathName().toRawUTF8());
+            while (!threadShouldExit() && !timestampListener.isNewTimestampAvailable()) {
+                wait(Constants::SenderIdleWaitMs);
+            }
 
-            const timespec t{0, packet.getSleepInterval()};
-            nanosleep(&t, nullptr);
+            const auto ts{timestampListener.getTimestamp()};
+            const auto startPtpNs{ts.tv_sec * Constants::NSPS + ts.tv_nsec + Constants::PacketOffsetNs};
+            const auto startNs{ptpClock.now()};
+            const auto sliceNs{static_cast<int64_t>(timeoutMs) * Constants::NSPS / 1000};
+            constexpr auto timestampOffset{offsetof(AudioPacket::Header, timestamp)};
+
+            CaptureReader::Datagram datagram;
+            auto started{false};
+            int64_t firstRenderNs{0};
+            uint64_t numSent{0};
+
+            while (!threadShouldExit() && reader.next(datagram)) {
+                AudioStream *stream{nullptr};
+                for (auto *s: streams) {
+                    if (s->getParams().port == datagram.destination.port) {
+                        stream = s;
+                        break;
+                    }
+                }
+                if (stream == nullptr || datagram.size < sizeof(AudioPacket::Header)) continue;
+
+                if (!started) {
+                    firstRenderNs = datagram.timeNs;
+                    started = true;
+                }
+                const auto elapsedNs{datagram.timeNs - firstRenderNs};
+
+                // Paced by the PTP timebase, so as not to drift from the
+                // timestamps over a long show. Sleep in slices, so that a
+                // long gap doesn't hold up stopping.
+                const auto dueNs{startNs + elapsedNs};
+                while (!threadShouldExit() && ptpClock.now() < dueNs) {
+                    ptpClock.sleepUntil(std::min(dueNs, ptpClock.now() + sliceNs));
+                }
+                if (threadShouldExit()) break;
+
+                // Restamp a copy; the rest of the packet goes as rendered.
+                renderPacket.assign(datagram.data, datagram.data + datagram.size);
+                const auto timestamp{startPtpNs + elapsedNs};
+                memcpy(&renderPacket[timestampOffset], &timestamp, sizeof(timestamp));
+
+                const auto &params{stream->getParams()};
+                send(renderPacket.data(), renderPacket.size(), params.ip, params.port, 0);
+                stream->getHistory().store(renderPacket.data(), renderPacket.size());
+                sendParity(*stream, renderPacket.data(), renderPacket.size());
+                ++numSent;
+
+                releaseDueDatagrams();
+            }
+
+            ANANAS_LOG_INFO("Played %llu packets of %s.", static_cast<unsigned long long>(numSent), renderFile.getFullPathName().toRawUTF8());
         }
 
-        std::cout << getThreadName() << " stopping." << std::endl;
+        while (!threadShouldExit()) {
+            wait(timeoutMs);
+        }
     }
 
     //==========================================================================
@@ -260,6 +1292,11 @@ namespace ananas::Server
 
     bool Server::AnnouncementListenerThread::connect()
     {
+        if (replaying) {
+            notifyStateChanged();
+            return true;
+        }
+
         if (-1 == socket.getBoundPort()) {
             // JUCE doesn't handle multicast in a manner that's compatible with
             // reading multicast packets on a specific interface...
@@ -267,16 +1304,16 @@ namespace ananas::Server
             // ...(it's probably not necessary to allow port-reuse, but what the
             // hell)...
             if (!socket.setEnablePortReuse(true)) {
-                std::cerr << getThreadName() << " failed to set socket port reuse: " << strerror(errno) << std::endl;
-                sendChangeMessage();
+                ANANAS_LOG_ERROR("Failed to set socket port reuse: %s", strerror(errno));
+                notifyStateChanged();
                 return false;
             }
 
             // ...bind the relevant port to ALL interfaces (INADDR_ANY) by not
             // specifying a local interface here...
             if (!socket.bindToPort(localPort)) {
-                std::cerr << getThreadName() << " failed to bind socket to port: " << strerror(errno) << std::endl;
-                sendChangeMessage();
+                ANANAS_LOG_ERROR("Failed to bind socket to port: %s", strerror(errno));
+                notifyStateChanged();
                 return false;
             }
 
@@ -291,44 +1328,112 @@ namespace ananas::Server
                     IPPROTO_IP,
                     IP_ADD_MEMBERSHIP,
                     &mreq, sizeof (mreq)) < 0) {
-                std::cerr << getThreadName() << " failed to add multicast membership: " << strerror(errno) << std::endl;
-                sendChangeMessage();
+                ANANAS_LOG_ERROR("Failed to add multicast membership: %s", strerror(errno));
+                notifyStateChanged();
                 return false;
             }
 
             socket.setMulticastLoopbackEnabled(false);
         }
 
-        sendChangeMessage();
+        notifyStateChanged();
         return true;
     }
 
+    void Server::AnnouncementListenerThread::setReplaying(const bool shouldReplay)
+    {
+        jassert(!isThreadRunning());
+        replaying = shouldReplay;
+    }
+
+    void Server::AnnouncementListenerThread::replayPacket(const uint8_t *data,
+                                                          const size_t size,
+                                                          const juce::String &fromIP,
+                                                          const int fromPort)
+    {
+        jassert(replaying);
+
+        numBytesRead = static_cast<int>(std::min(size, Constants::ListenerBufferSize));
+        memcpy(buffer, data, static_cast<size_t>(numBytesRead));
+        senderIP = fromIP;
+        senderPort = fromPort;
+
+        ANANAS_TRACE_SCOPE("handlePacket");
+        handlePacket();
+    }
+
+    void Server::AnnouncementListenerThread::receive(const uint8_t *data,
+                                                     const size_t size,
+                                                     const juce::String &fromIP,
+                                                     const int fromPort)
+    {
+        numBytesRead = static_cast<int>(std::min(size, Constants::ListenerBufferSize));
+        if (data != buffer) {
+            memcpy(buffer, data, static_cast<size_t>(numBytesRead));
+            senderIP = fromIP;
+            senderPort = fromPort;
+        }
+
+        if (capture != nullptr) {
+            capture->add(PacketCapture::Direction::inbound,
+                         buffer,
+                         static_cast<size_t>(numBytesRead),
+                         Endpoint::fromString(senderIP, senderPort),
+                         captureEndpoint);
+        }
+
+        ANANAS_TRACE_SCOPE("handlePacket");
+        handlePacket();
+    }
+
     void Server::AnnouncementListenerThread::runImpl()
     {
-        std::cout << getThreadName() << " listening..." << std::endl << std::flush;
+        if (replaying) {
+            // The replay thread does the work.
+            ANANAS_LOG_INFO("Replaying...");
+            while (!threadShouldExit()) {
+                wait(timeoutMs);
+            }
+            return;
+        }
+
+        ANANAS_LOG_INFO("Listening...");
 
         while (!threadShouldExit()) {
-            if (socket.waitUntilReady(true, timeoutMs)) {
+            if (socket.waitUntilReady(true, impairment != nullptr ? impairment->getWaitMs(timeoutMs) : timeoutMs)) {
                 if (threadShouldExit()) break;
 
-                if (const auto bytesRead{
-                    socket.read(buffer, Constants::ListenerBufferSize, false, senderIP, senderPort)
-                }; bytesRead > 0) {
-                    handlePacket();
-                } else if (bytesRead < 0) {
-                    std::cerr << getThreadName() << ": error reading from socket: " << strerror(errno) << std::endl;
+                numBytesRead = socket.read(buffer, Constants::ListenerBufferSize, false, senderIP, senderPort);
+                if (numBytesRead > 0) {
+                    if (impairment != nullptr) {
+                        impairment->submit(PacketCapture::Direction::inbound,
+                                           buffer,
+                                           static_cast<size_t>(numBytesRead),
+                                           senderIP,
+                                           senderPort);
+                    } else {
+                        receive(buffer, static_cast<size_t>(numBytesRead), senderIP, senderPort);
+                    }
+                } else if (numBytesRead < 0) {
+                    ANANAS_LOG_ERROR("Error reading from socket: %s", strerror(errno));
                 }
             }
+
+            releaseDueDatagrams();
         }
 
-        std::cout << getThreadName() << " stopping." << std::endl;
+        ANANAS_LOG_INFO("Stopping.");
     }
 
     //==============================================================================
 
     Server::TimestampListener::TimestampListener(
-        const Utils::ListenerThreadSocketParams &p
-    ) : AnnouncementListenerThread(p)
+        const Utils::ListenerThreadSocketParams &p,
+        PtpClock &ptpClock,
+        Clock &clock
+    ) : AnnouncementListenerThread(p),
+        ptpClock(ptpClock),
+        clock(clock)
     {
     }
 
@@ -361,6 +1466,8 @@ namespace ananas::Server
             // Store the new timestamp and indicate that it is available.
             timestamp.store(ts, std::memory_order_release);
             newTimestampAvailable.store(true, std::memory_order_release);
+
+            ptpClock.addTimestamp(ts.tv_sec * Constants::NSPS + ts.tv_nsec, clock.now());
         }
     }
 
@@ -399,6 +1506,221 @@ namespace ananas::Server
 
     //==========================================================================
 
+    Server::RetransmitListener::RetransmitListener(
+        const Utils::ListenerThreadSocketParams &p,
+        juce::OwnedArray<AudioStream> &streams,
+        Clock &clock
+    ) : AnnouncementListenerThread(p),
+        streams(streams),
+        clock(clock)
+    {
+        clients.reserve(Constants::RetransmitMaxClients);
+    }
+
+    bool Server::RetransmitListener::connect()
+    {
+        // NACKs are unicast, so just bind to the local interface.
+        if (-1 == socket.getBoundPort()) {
+            if (!socket.bindToPort(localPort, Utils::Strings::LocalInterfaceIP)) {
+                ANANAS_LOG_ERROR("Failed to bind socket to port: %s", strerror(errno));
+                notifyStateChanged();
+                return false;
+            }
+        }
+
+        notifyStateChanged();
+        return true;
+    }
+
+    juce::var Server::RetransmitListener::getStats() const
+    {
+        const auto object{new juce::DynamicObject()};
+
+        const std::lock_guard lock{clientsMutex};
+
+        for (const auto &c: clients) {
+            auto *client{new juce::DynamicObject()};
+            client->setProperty(Utils::Identifiers::RetransmitRequestedPropertyID, static_cast<juce::int64>(c.numRequested));
+            client->setProperty(Utils::Identifiers::RetransmitSentPropertyID, static_cast<juce::int64>(c.numSent));
+            client->setProperty(Utils::Identifiers::RetransmitUnavailablePropertyID, static_cast<juce::int64>(c.numUnavailable));
+            client->setProperty(Utils::Identifiers::RetransmitRateLimitedPropertyID, static_cast<juce::int64>(c.numRateLimited));
+            object->setProperty(c.ip, client);
+        }
+
+        return object;
+    }
+
+    Server::RetransmitListener::ClientState &Server::RetransmitListener::getClient(const juce::String &ip)
+    {
+        if (const auto it{std::find_if(clients.begin(), clients.end(), [&ip](const ClientState &c) { return c.ip == ip; })};
+            it != clients.end()) {
+            return *it;
+        }
+
+        if (clients.size() < Constants::RetransmitMaxClients) {
+            auto &client{clients.emplace_back()};
+            client.ip = ip;
+            return client;
+        }
+
+        // Full; forget the client heard from longest ago. Every client in the
+        // list has been heard from.
+        auto &oldest{
+            *std::min_element(clients.begin(), clients.end(), [](const ClientState &a, const ClientState &b)
+            {
+                return *a.lastRefillNs < *b.lastRefillNs;
+            })
+        };
+        oldest = {};
+        oldest.ip = ip;
+        return oldest;
+    }
+
+    void Server::RetransmitListener::handlePacket()
+    {
+        const std::lock_guard lock{clientsMutex};
+
+        auto &client{getClient(senderIP)};
+
+        // Top up the client's token bucket.
+        const auto now{clock.now()};
+        if (client.lastRefillNs.has_value()) {
+            client.tokens = std::min(Constants::RetransmitMaxBurstPackets,
+                                     client.tokens + static_cast<double>(now - *client.lastRefillNs) * Constants::RetransmitMaxPacketsPerSecond / Constants::NSPS);
+        }
+        client.lastRefillNs = now;
+
+        if (numBytesRead < static_cast<int>(sizeof(NackHeader))) return;
+
+        // Find the stream the NACK refers to.
+        const auto *header{reinterpret_cast<const NackHeader *>(buffer)};
+        AudioStream *stream{nullptr};
+        for (auto *s: streams) {
+            if (s->getParams().port == header->streamPort) {
+                stream = s;
+                break;
+            }
+        }
+        if (stream == nullptr) return;
+
+        const auto &history{stream->getHistory()};
+        packetBuffer.resize(history.getMaxPacketSize());
+
+        const auto numNacks{(static_cast<size_t>(numBytesRead) - sizeof(NackHeader)) / sizeof(NackPacket)};
+        const auto *nacks{reinterpret_cast<const NackPacket *>(&buffer[sizeof(NackHeader)])};
+
+        for (size_t i{0}; i < numNacks; ++i) {
+            retransmit(history, nacks[i].sequenceNumber, client);
+            for (int bit{0}; bit < 16; ++bit) {
+                if (nacks[i].followingLostMask & 1 << bit) {
+                    retransmit(history, static_cast<uint16_t>(nacks[i].sequenceNumber + bit + 1), client);
+                }
+            }
+        }
+    }
+
+    void Server::RetransmitListener::retransmit(const PacketHistory &history, const uint16_t sequenceNumber, ClientState &client)
+    {
+        ++client.numRequested;
+
+        if (client.tokens < 1.) {
+            ++client.numRateLimited;
+            return;
+        }
+
+        size_t size;
+        if (!history.fetch(sequenceNumber, packetBuffer.data(), size)) {
+            ++client.numUnavailable;
+            return;
+        }
+
+        client.tokens -= 1.;
+        // Reply to wherever the NACK came from.
+        sendDatagram(senderIP, senderPort, packetBuffer.data(), size);
+        ++client.numSent;
+    }
+
+    //==========================================================================
+
+    Server::ReplayThread::ReplayThread(const Utils::ThreadParams &p,
+                                       juce::File file,
+                                       const double speed,
+                                       Clock &clock)
+        : AnanasThread(p),
+          file(std::move(file)),
+          speed(speed),
+          clock(clock)
+    {
+    }
+
+    void Server::ReplayThread::addListener(AnnouncementListenerThread &listener)
+    {
+        jassert(!isThreadRunning());
+        listener.setReplaying(true);
+        listeners.add(&listener);
+    }
+
+    bool Server::ReplayThread::connect()
+    {
+        reader = std::make_unique<CaptureReader>(file);
+        if (!reader->isValid()) {
+            ANANAS_LOG_ERROR("Can't replay %s.", file.getFullPathName().toRawUTF8());
+            reader.reset();
+        }
+
+        notifyStateChanged();
+        return reader != nullptr;
+    }
+
+    void Server::ReplayThread::runImpl()
+    {
+        ANANAS_LOG_INFO("Replaying %s at %.2gx...", file.getFullPathName().toRawUTF8(), speed);
+
+        CaptureReader::Datagram datagram;
+        auto started{false};
+        int64_t firstCaptureNs{0}, startNs{0};
+        uint64_t numReplayed{0};
+
+        while (!threadShouldExit() && reader->next(datagram)) {
+            AnnouncementListenerThread *listener{nullptr};
+            for (auto *l: listeners) {
+                if (l->getLocalPort() == datagram.destination.port) {
+                    listener = l;
+                    break;
+                }
+            }
+            if (listener == nullptr) continue;
+
+            if (speed > 0.) {
+                if (!started) {
+                    firstCaptureNs = datagram.timeNs;
+                    startNs = clock.now();
+                    started = true;
+                }
+
+                // Sleep in slices, so that a long gap in the capture doesn't
+                // hold up stopping.
+                const auto dueNs{startNs + static_cast<int64_t>(static_cast<double>(datagram.timeNs - firstCaptureNs) / speed)};
+                const auto sliceNs{static_cast<int64_t>(timeoutMs) * Constants::NSPS / 1000};
+                while (!threadShouldExit() && clock.now() < dueNs) {
+                    clock.sleepUntil(std::min(dueNs, clock.now() + sliceNs));
+                }
+                if (threadShouldExit()) break;
+            }
+
+            listener->replayPacket(datagram.data, datagram.size, datagram.source.getIPString(), datagram.source.port);
+            ++numReplayed;
+        }
+
+        ANANAS_LOG_INFO("Replayed %llu datagrams.", static_cast<unsigned long long>(numReplayed));
+
+        while (!threadShouldExit()) {
+            wait(timeoutMs);
+        }
+    }
+
+    //==========================================================================
+
     Server::RebootSender::RebootSender(
         const Utils::SenderThreadSocketParams &p,
         ClientList &clients
@@ -412,12 +1734,14 @@ namespace ananas::Server
         while (!threadShouldExit()) {
             if (clients.getShouldReboot()) {
                 clients.setShouldReboot(false);
-                socket.write(ip, remotePort, nullptr, 0);
+                sendDatagram(ip, remotePort, nullptr, 0);
             }
 
             // Wait 1 second, but check for thread exit every 100ms
-            for (int i = 0; i < 10 && !threadShouldExit(); ++i)
+            for (int i = 0; i < 10 && !threadShouldExit(); ++i) {
                 wait(100);
+                releaseDueDatagrams();
+            }
         }
     }
 
@@ -433,7 +1757,7 @@ namespace ananas::Server
 
     void Server::SwitchInspector::runImpl()
     {
-        std::cout << getThreadName() <<  " inspecting..." << std::endl << std::flush;
+        ANANAS_LOG_INFO("Inspecting...");
 
         while (!threadShouldExit()) {
             auto switchesVar{switches.toVar()};
@@ -472,12 +1796,12 @@ namespace ananas::Server
                 wait(100);
         }
 
-        std::cout << getThreadName() << " stopping." << std::endl;
+        ANANAS_LOG_INFO("Stopping.");
     }
 
     bool Server::SwitchInspector::connect()
     {
-        sendChangeMessage();
+        notifyStateChanged();
         return true;
     }
 
@@ -487,6 +1811,8 @@ namespace ananas::Server
                                                    const juce::StringRef &path,
                                                    const juce::String &postData)
     {
+        ANANAS_TRACE_SCOPE("SwitchInspector::curlRequest");
+
         const juce::URL url("http://" + ip + path);
 
         juce::StringArray args;
@@ -6,17 +6,40 @@
 #include "ClientInfo.h"
 #include "AuthorityInfo.h"
 #include "SwitchInfo.h"
-#include "Fifo.h"
 #include "Packet.h"
+#include "AudioStream.h"
+#include "DatagramBatch.h"
+#include "Metrics.h"
+#include "Clock.h"
+#include "PtpClock.h"
+#include "PacketCapture.h"
+#include "OfflineRender.h"
+#include "StreamRecorder.h"
+#include "NetworkImpairment.h"
+#include "TxTimestamper.h"
+#include "Trace.h"
+#include <functional>
+#include <optional>
 
 namespace ananas::Server
 {
+    /**
+     * Hosts one or more named audio streams, which share one set of
+     * announcement listeners, one PTP timebase and one audio sender thread.
+     * The first stream is created on construction, and is the one fed by
+     * getNextAudioBlock().
+     *
+     * All timing — packet pacing, connectedness checks, retransmit rate
+     * limits — goes through the Clock given on construction; pass a
+     * VirtualClock to run the server core in simulated time, or an EventLoop
+     * to run it without the JUCE message thread. Change messages go out only
+     * if something is listening.
+     */
     class Server final : public juce::AudioSource,
-                         public juce::ChangeListener,
                          public juce::ChangeBroadcaster
     {
     public:
-        explicit Server(uint numChannelsToSend);
+        explicit Server(uint numChannelsToSend, Clock &clock = Clock::getSystem());
 
         ~Server() override;
 
@@ -24,9 +47,30 @@ namespace ananas::Server
 
         void releaseResources() override;
 
+        /**
+         * Write a block of audio to the first stream.
+         */
         void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override;
 
-        void changeListenerCallback(ChangeBroadcaster *source) override;
+        /**
+         * Add a stream; call before prepareToPlay(). Each stream needs its own
+         * multicast group or port (and the port above it is used for the
+         * stream's FEC parity packets).
+         * @return The index of the new stream.
+         */
+        int addStream(const StreamParams &params);
+
+        /**
+         * Write a block of audio to the given stream.
+         */
+        void writeToStream(int streamIndex, const juce::AudioSourceChannelInfo &bufferToFill);
+
+        [[nodiscard]] int getNumStreams() const;
+
+        /**
+         * @return The index of the named stream, or -1.
+         */
+        [[nodiscard]] int getStreamIndex(const juce::String &name) const;
 
         [[nodiscard]] bool isConnected() const;
 
@@ -38,15 +82,307 @@ namespace ananas::Server
 
         SwitchList *getSwitches();
 
+        /**
+         * Enable or disable lossless compression of outgoing audio packets,
+         * on all streams. Clients must be configured to expect compressed
+         * payloads; see AudioCodec for the payload layout.
+         */
+        void setCompressionEnabled(bool shouldCompress);
+
+        /**
+         * @return The ratio of encoded to raw bytes sent, across all
+         * compressed streams; 1 if nothing has been compressed.
+         */
+        [[nodiscard]] double getCompressionRatio() const;
+
+        /**
+         * Configure forward error correction, on all streams. For every
+         * numDataPackets audio packets, numParityPackets XOR parity packets
+         * are sent to the stream's group, on the stream's port plus
+         * Constants::FecPortOffset. Repairs can't happen until a group is
+         * complete, so larger groups cost latency at the client.
+         * @param numDataPackets Group size, K; 0 disables FEC.
+         * @param numParityPackets Parity packets per group, M; 1 <= M <= K.
+         */
+        void setFecParams(int numDataPackets, int numParityPackets);
+
+        /**
+         * @return Parity bytes sent as a proportion of audio bytes sent.
+         */
+        [[nodiscard]] double getFecOverhead() const;
+
+        /**
+         * Choose what every stream's FIFO does when the audio thread writes
+         * more than it can hold, and when it stops writing; see Fifo. By
+         * default, the newest audio is dropped, and the sender waits. Call
+         * after adding streams.
+         */
+        void setFifoPolicies(Fifo::OverflowPolicy overflow, Fifo::UnderflowPolicy underflow);
+
+        /**
+         * Set how far, beyond a host block, every stream's FIFO lets the
+         * audio sender fall behind, and the audio thread be late, before it
+         * overflows or underflows; see Fifo::prepare(). By default,
+         * Constants::DefaultFifoTargetLatencyNs. Call after adding streams,
+         * before prepareToPlay().
+         */
+        void setFifoTargetLatency(int64_t targetLatencyNs);
+
+        /**
+         * @return How full a stream's FIFO is, from 0 to 1; safe to call
+         * from any thread, e.g. to steer whatever feeds the server.
+         */
+        [[nodiscard]] float getFifoFillLevel(int streamIndex = 0) const;
+
+        /**
+         * @return Each stream's FIFO capacity, fill level, and overflow and
+         * underflow counts, keyed by stream name.
+         */
+        [[nodiscard]] juce::var getFifoStats() const;
+
+        /**
+         * Transmit every audio (and parity) packet a second time, identically
+         * sequenced and timestamped, on a second interface and multicast
+         * group, so that clients on two independent switch fabrics can merge
+         * the streams hitlessly. Every stream's copy goes to the same group,
+         * on the stream's own port. Call before prepareToPlay().
+         * @param interfaceIP Local address of the second interface.
+         * @param groupIP Multicast group to send to on that interface.
+         * @param skewNs Delay between the primary and redundant copies of a
+         * packet; limited to Constants::MaxRedundantPathSkewNs.
+         */
+        void setRedundantPath(const juce::String &interfaceIP,
+                              const juce::String &groupIP,
+                              long skewNs = Constants::DefaultRedundantPathSkewNs);
+
+        /**
+         * Packetize and send each stream's audio on the audio thread, from
+         * writeToStream(), rather than waking the audio sender to do it: at
+         * most Constants::InlineSendMaxPackets packets per stream per
+         * callback, in one non-blocking sendmmsg(), back to back rather than
+         * paced. Whatever the socket won't take, or the audio thread finds
+         * the audio sender already sending, goes from the audio sender as
+         * usual. Only the plain path goes inline; with a capture, an
+         * impairment, transmit timestamping or a redundant path, the audio
+         * sender sends everything, as it does any stream with FEC. Linux
+         * only. Call before prepareToPlay().
+         */
+        void setInlineSendEnabled(bool shouldSendInline);
+
+        /**
+         * @return true if inline sending was asked for, and is possible.
+         */
+        [[nodiscard]] bool isInlineSendActive() const;
+
+        /**
+         * @return Whether inline sending is active, the packets sent inline,
+         * those left for the audio sender, and the callbacks that found the
+         * audio sender busy with a stream; void if not enabled.
+         */
+        [[nodiscard]] juce::var getInlineSendStats() const;
+
+        /**
+         * Deliver the audio sender's packets to receivers on this host too,
+         * e.g. ananas_probe; off by default. Call before prepareToPlay().
+         */
+        void setMulticastLoopback(bool shouldLoopBack);
+
+        /**
+         * @return Retransmission counters for each client that has sent a
+         * NACK, keyed by client IP.
+         */
+        [[nodiscard]] juce::var getRetransmitStats() const;
+
+        /**
+         * Set the scheduling class, priority and CPU affinity of one of the
+         * server's threads; applied when the thread starts, so call before
+         * prepareToPlay().
+         * @param threadName E.g. Sockets::AudioSenderSocketParams.name.
+         * @return false if there's no thread with that name.
+         */
+        bool setThreadPolicy(const juce::String &threadName, const ThreadPolicy &policy);
+
+        /**
+         * @return The policy actually applied to each running thread, keyed
+         * by thread name, including any privileges that were refused.
+         */
+        [[nodiscard]] juce::var getThreadPolicies() const;
+
+        /**
+         * Lock the FIFOs and packet buffers of every stream into RAM (and
+         * pre-fault them) when preparing to play. Falls back to pre-faulting
+         * alone if locking is refused; see getNumLockedBytes().
+         */
+        void setMemoryLocked(bool shouldLock);
+
+        /**
+         * @return How many bytes of stream memory were actually locked.
+         */
+        [[nodiscard]] size_t getNumLockedBytes() const;
+
+        /**
+         * @return Histograms of FIFO residency, conversion time, send syscall
+         * time and inter-departure interval, for every packet sent since the
+         * last reset, across all streams. Values in nanoseconds.
+         */
+        [[nodiscard]] juce::var getMetrics() const;
+
+        void resetMetrics();
+
+        /**
+         * Instrument the audio sender's socket with kernel transmit
+         * timestamps, from which the callbackToWire and wireToPresentation
+         * metrics are recorded; see TxTimestamper. Call before
+         * prepareToPlay().
+         * @param clockOffsetNs Added to kernel timestamps to bring them into
+         * the PTP timescale.
+         */
+        void setTxTimestamping(TxTimestamper::Mode mode, int64_t clockOffsetNs = 0);
+
+        /**
+         * Record every packet sent by the audio sender and retransmit
+         * listener, and every datagram received by the listeners, to a
+         * pcapng file; see PacketCapture. Call before prepareToPlay().
+         */
+        void setCaptureFile(const juce::File &file);
+
+        /**
+         * @return Packets captured and dropped so far; void if not capturing.
+         */
+        [[nodiscard]] juce::var getCaptureStats() const;
+
+        /**
+         * Record each stream's audio, as sent, to a multichannel W64 file;
+         * see StreamRecorder. With more than one stream, each gets a file of
+         * its own alongside this one. Call after adding streams, before
+         * prepareToPlay().
+         */
+        void setRecordingFile(const juce::File &file);
+
+        /**
+         * @return As getCaptureStats(), for the recording; void if not
+         * recording.
+         */
+        [[nodiscard]] juce::var getRecordingStats() const;
+
+        /**
+         * Take PTP timestamps, client announcements and authority
+         * announcements from a capture (see CaptureReader), rather than from
+         * the network, matching datagrams to listeners by destination port.
+         * Pacing follows the server's Clock. Call before prepareToPlay().
+         * @param speed 1 for the original timing, 10 for ten times as fast,
+         * etc.; 0 for as fast as possible.
+         */
+        void setReplayFile(const juce::File &file, double speed = 1.);
+
+        /**
+         * Render offline: packetize what's written to the streams on the
+         * writing thread, and record the packets to a pcapng file (see
+         * OfflineRender) rather than sending them, as fast as the audio comes.
+         * The network threads run as usual, but no audio goes out. Call
+         * before prepareToPlay(); an empty File goes back to sending.
+         */
+        void setOfflineRenderFile(const juce::File &file);
+
+        [[nodiscard]] bool isRenderingOffline() const;
+
+        /**
+         * @return As getCaptureStats(), for the offline render; void if not
+         * rendering offline.
+         */
+        [[nodiscard]] juce::var getOfflineRenderStats() const;
+
+        /**
+         * Send the audio packets of an offline render, in real time (as paced
+         * by the PTP timebase) and restamped from the first PTP timestamp to
+         * arrive, instead of audio written to the streams, which is ignored.
+         * Packets are matched to streams by destination port. Call before
+         * prepareToPlay().
+         */
+        void setRenderPlaybackFile(const juce::File &file);
+
+        [[nodiscard]] bool isPlayingRender() const;
+
+        /**
+         * Drop, duplicate, delay and reorder one thread's datagrams, in and
+         * out, as scripted; see NetworkImpairment. Call before
+         * prepareToPlay().
+         * @param threadName E.g. Sockets::TimestampListenerSocketParams.name.
+         * @return false if there's no socket thread with that name.
+         */
+        bool setImpairment(const juce::String &threadName, const ImpairmentScript &script);
+
+        /**
+         * @return What each impaired thread's impairment has done so far,
+         * keyed by thread name.
+         */
+        [[nodiscard]] juce::var getImpairmentStats() const;
+
+        /**
+         * @return A clock that runs at the rate of the PTP timebase, as
+         * received by the timestamp listener, for pacing audio into the
+         * server where there's no audio device to do it; see SourceStreamer.
+         */
+        PtpClock &getPtpClock();
+
+        /**
+         * Takes the name of the thread that sent a datagram, the datagram,
+         * and where it was sent.
+         */
+        using SimulatedSink = std::function<void(const juce::String &threadName,
+                                                 const uint8_t *data,
+                                                 size_t size,
+                                                 const juce::String &toIP,
+                                                 int toPort)>;
+
+        /**
+         * Leave the network alone, and start no threads: for running the
+         * server in simulated time, deterministically, on the thread that
+         * drives a VirtualClock (see VirtualClock::setDrivingThread()). That
+         * thread delivers what would have arrived from the network with
+         * simulateDatagram(), writes audio as usual, and calls
+         * runSimulation() to do what the network threads would have done in
+         * the meantime. What the threads would have sent goes to the sink,
+         * if any, as it would have gone out (i.e. after any impairment).
+         * Call before prepareToPlay().
+         */
+        void setSimulated(bool shouldSimulate, SimulatedSink sink = {});
+
+        /**
+         * Hand a datagram to a listener as if it had arrived on its socket,
+         * by way of its impairment, if any. Simulated only.
+         * @param threadName E.g. Sockets::TimestampListenerSocketParams.name.
+         * @return false if there's no listener with that name.
+         */
+        bool simulateDatagram(const juce::String &threadName,
+                              const uint8_t *data,
+                              size_t size,
+                              const juce::String &fromIP,
+                              int fromPort);
+
+        /**
+         * Release whatever the threads' impairments are holding that has
+         * fallen due, then run one pass of the audio sender: apply the
+         * latest PTP timestamp, if there's a new one, and send what each
+         * stream has ready, its pacing advancing the clock. Simulated only.
+         * @return The number of audio packets sent.
+         */
+        int runSimulation();
+
     private:
         //======================================================================
 
-        class AnanasThread : public juce::Thread,
-                             public ChangeBroadcaster
+        class AnanasThread : public juce::Thread
         {
         public:
             explicit AnanasThread(const Utils::ThreadParams &p);
 
+            /**
+             * Called, on the thread, when it connects or fails to. Set before
+             * the thread starts.
+             */
+            void setStateChangedCallback(std::function<void()> callback);
+
             virtual bool connect() = 0;
 
             void run() override;
@@ -55,11 +391,23 @@ namespace ananas::Server
 
             bool isConnected() const;
 
+            void setPolicy(const ThreadPolicy &newPolicy);
+
+            [[nodiscard]] juce::var getAppliedPolicy() const;
+
         protected:
             virtual void runImpl() = 0;
 
+            void notifyStateChanged() const;
+
             int timeoutMs{0};
             bool connected{false};
+
+        private:
+            std::function<void()> onStateChanged;
+            ThreadPolicy policy;
+            juce::var appliedPolicy;
+            mutable std::mutex policyMutex;
         };
 
         //======================================================================
@@ -73,12 +421,79 @@ namespace ananas::Server
 
             bool connect() override;
 
+            [[nodiscard]] juce::uint16 getLocalPort() const;
+
+            /**
+             * Record this thread's traffic to a channel of a PacketCapture.
+             * Call before the thread starts.
+             */
+            void setCapture(PacketCapture::Channel *channel);
+
+            /**
+             * Pass this thread's traffic through a NetworkImpairment. Call
+             * before the thread starts.
+             */
+            void setImpairment(const ImpairmentScript &script, Clock &clock);
+
+            /**
+             * @return Void if not impaired.
+             */
+            [[nodiscard]] juce::var getImpairmentStats() const;
+
+            /**
+             * Handle a datagram as if it had been read from the socket, by
+             * way of the impairment, if any; see Server::setSimulated().
+             */
+            void simulateArrival(const uint8_t *data, size_t size, const juce::String &fromIP, int fromPort);
+
+            using Sink = std::function<void(const uint8_t *data, size_t size, const juce::String &toIP, int toPort)>;
+
+            /**
+             * Write nothing to the socket, handing it to the sink, if any,
+             * instead; see Server::setSimulated(). Call before the thread
+             * starts.
+             */
+            void setSimulated(bool shouldSimulate, Sink sink);
+
+            /**
+             * Send, or receive, whatever the impairment has held back that's
+             * now due.
+             */
+            void releaseDueDatagrams();
+
         protected:
             void runImpl() override = 0;
 
+            bool connectSocket(juce::DatagramSocket &socketToConnect,
+                               const juce::String &interfaceIP,
+                               const juce::String &groupIP);
+
+            /**
+             * Send a datagram from the socket, by way of the impairment, if
+             * any; it's captured as and when it actually goes.
+             * @return false if the socket wouldn't take it.
+             */
+            bool sendDatagram(const juce::String &toIP, int toPort, const uint8_t *data, size_t size);
+
+            /**
+             * Handle a datagram that has arrived, directly or via the
+             * impairment; senders ignore them.
+             */
+            virtual void receive(const uint8_t *data, size_t size, const juce::String &fromIP, int fromPort);
+
             juce::DatagramSocket socket;
             juce::String ip;
             juce::uint16 localPort;
+            PacketCapture::Channel *capture{nullptr};
+            Endpoint captureEndpoint;
+            std::unique_ptr<NetworkImpairment> impairment;
+            bool simulated{false};
+
+        private:
+            bool writeToSocket(const juce::String &toIP, int toPort, const uint8_t *data, size_t size);
+
+            NetworkImpairment::Datagram dueDatagram;
+            Sink simulatedSink;
         };
 
         //======================================================================
@@ -94,18 +509,73 @@ namespace ananas::Server
 
         //======================================================================
 
+        class TimestampListener;
+
+        /**
+         * The pacing engine: sends packets for every stream, round-robin, as
+         * their FIFOs fill.
+         */
         class AudioSender final : public SenderThread
         {
         public:
-            AudioSender(const Utils::SenderThreadSocketParams &p, Fifo &fifo);
+            AudioSender(const Utils::SenderThreadSocketParams &p,
+                        juce::OwnedArray<AudioStream> &streams,
+                        TimestampListener &timestampListener,
+                        SenderMetrics &metrics,
+                        Clock &clock,
+                        PtpClock &ptpClock);
+
+            bool prepare(int samplesPerBlockExpected, double sampleRate);
+
+            bool stopThread(int timeOutMilliseconds);
 
-            bool prepare(uint numChannels, int samplesPerBlockExpected, double sampleRate);
+            /**
+             * One pass of the sender's loop: apply the latest PTP timestamp
+             * to every stream, if there's a new one, then send a packet from
+             * each stream that has one ready, in turn, pacing them with the
+             * clock.
+             * @return The number of packets sent.
+             */
+            int runOnce();
 
-            void setPacketTime(timespec ts);
+            void setRedundantPath(const juce::String &interfaceIP, const juce::String &groupIP, long skewNs);
 
-            int64_t getPacketTime() const;
+            void setMemoryLocked(bool shouldLock);
 
-            bool stopThread(int timeOutMilliseconds);
+            [[nodiscard]] size_t getNumLockedBytes() const;
+
+            void setMulticastLoopback(bool shouldLoopBack);
+
+            void setInlineSendEnabled(bool shouldSendInline);
+
+            [[nodiscard]] bool isInlineSendActive() const;
+
+            [[nodiscard]] juce::var getInlineSendStats() const;
+
+            /**
+             * Packetize and send what's ready in a stream's FIFO, if inline
+             * sending is active. Call on the audio thread, after writing to
+             * the FIFO; never blocks.
+             */
+            void sendInline(int streamIndex);
+
+            void setTxTimestamping(TxTimestamper::Mode mode, int64_t clockOffsetNs);
+
+            /**
+             * Send this offline render rather than the streams' FIFOs; see
+             * Server::setRenderPlaybackFile().
+             */
+            void setRenderPlaybackFile(const juce::File &file);
+
+            [[nodiscard]] bool isPlayingRender() const;
+
+            /**
+             * Copy each packet's audio to its stream's track (by index) once
+             * it's sent; see Server::setRecordingFile().
+             */
+            void setRecordingTracks(std::vector<StreamRecorder::Track *> tracks);
+
+            bool connect() override;
 
         protected:
             void runImpl() override;
@@ -113,9 +583,68 @@ namespace ananas::Server
         private:
             JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioSender);
 
-            Fifo &fifo;
-            AudioPacket packet{};
-            int audioBlockSamples{0};
+            juce::OwnedArray<AudioStream> &streams;
+            TimestampListener &timestampListener;
+            SenderMetrics &metrics;
+            Clock &clock;
+            PtpClock &ptpClock;
+            juce::WaitableEvent streamReady;
+            // When each stream's last packet was sent, by either thread;
+            // guarded by the stream's send lock.
+            std::vector<int64_t> lastDepartureNs;
+
+            bool redundantPathEnabled{false};
+            juce::DatagramSocket redundantSocket;
+            juce::String redundantInterfaceIP;
+            juce::String redundantIP;
+            long redundantSkewNs{0};
+
+            bool memoryLocked{false};
+            std::atomic<size_t> numLockedBytes{0};
+
+            bool multicastLoopback{false};
+
+            TxTimestamper txTimestamper;
+
+            juce::File renderFile;
+            std::vector<uint8_t> renderPacket;
+
+            std::vector<StreamRecorder::Track *> recordingTracks;
+
+            bool inlineSendEnabled{false};
+            std::atomic<bool> inlineSendActive{false};
+            std::atomic<int> inlineSocketHandle{-1};
+            // One per stream; each guarded by its stream's send lock.
+            std::vector<std::unique_ptr<DatagramBatch> > inlineBatches;
+            std::atomic<uint64_t> numInlinePackets{0};
+            std::atomic<uint64_t> numInlineDeferred{0};
+            std::atomic<uint64_t> numInlineContended{0};
+
+            /**
+             * @return false, logging why, if anything in the way the sender
+             * is set up needs every packet to go through send().
+             */
+            bool canSendInline() const;
+
+            /**
+             * Send whatever of a stream the audio thread left behind, or else
+             * its next packet, if it has one ready.
+             * @return false if nothing was sent.
+             */
+            bool sendNextPacket(int streamIndex, int64_t &lastDepartureNs);
+
+            /**
+             * @param writeTimeNs For audio packets, when the packet's first
+             * frame was written to the FIFO; otherwise 0.
+             */
+            void send(const uint8_t *data, size_t size, const juce::String &groupIP, int port, int64_t writeTimeNs);
+
+            void sendParity(AudioStream &stream, const uint8_t *data, size_t size);
+
+            /**
+             * Send the render file's packets, then idle.
+             */
+            void playRender();
         };
 
         //======================================================================
@@ -127,14 +656,30 @@ namespace ananas::Server
 
             bool connect() override;
 
+            /**
+             * Leave the network alone, and handle only what's passed to
+             * replayPacket(). Call before the thread starts.
+             */
+            void setReplaying(bool shouldReplay);
+
+            /**
+             * Handle a datagram as if it had been read from the socket. Call
+             * from one thread only, and only when replaying.
+             */
+            void replayPacket(const uint8_t *data, size_t size, const juce::String &fromIP, int fromPort);
+
         protected:
             void runImpl() override;
 
+            void receive(const uint8_t *data, size_t size, const juce::String &fromIP, int fromPort) override;
+
             virtual void handlePacket() = 0;
 
             uint8_t buffer[Constants::ListenerBufferSize]{};
+            int numBytesRead{0};
             juce::String senderIP{};
             int senderPort{0};
+            bool replaying{false};
         };
 
         //======================================================================
@@ -145,7 +690,11 @@ namespace ananas::Server
         class TimestampListener final : public AnnouncementListenerThread
         {
         public:
-            explicit TimestampListener(const Utils::ListenerThreadSocketParams &p);
+            /**
+             * @param ptpClock Fed every timestamp received, as of the given
+             * clock.
+             */
+            TimestampListener(const Utils::ListenerThreadSocketParams &p, PtpClock &ptpClock, Clock &clock);
 
             bool isNewTimestampAvailable();
 
@@ -157,6 +706,8 @@ namespace ananas::Server
         private:
             JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TimestampListener);
 
+            PtpClock &ptpClock;
+            Clock &clock;
             std::atomic<bool> newTimestampAvailable{false};
             std::atomic<timespec> timestamp{};
         };
@@ -196,6 +747,84 @@ namespace ananas::Server
 
         //======================================================================
 
+        /**
+         * Listens for unicast NACKs from clients, and unicasts the requested
+         * packets back from the sender's history.
+         */
+        class RetransmitListener final : public AnnouncementListenerThread
+        {
+        public:
+            RetransmitListener(const Utils::ListenerThreadSocketParams &p, juce::OwnedArray<AudioStream> &streams, Clock &clock);
+
+            bool connect() override;
+
+            [[nodiscard]] juce::var getStats() const;
+
+        protected:
+            void handlePacket() override;
+
+        private:
+            JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RetransmitListener);
+
+            struct ClientState
+            {
+                juce::String ip;
+                double tokens{Constants::RetransmitMaxBurstPackets};
+                std::optional<int64_t> lastRefillNs;
+                juce::uint64 numRequested{0};
+                juce::uint64 numSent{0};
+                juce::uint64 numUnavailable{0};
+                juce::uint64 numRateLimited{0};
+            };
+
+            /**
+             * Find a client's state, or make room for it, without allocating.
+             */
+            ClientState &getClient(const juce::String &ip);
+
+            void retransmit(const PacketHistory &history, uint16_t sequenceNumber, ClientState &client);
+
+            juce::OwnedArray<AudioStream> &streams;
+            Clock &clock;
+            std::vector<uint8_t> packetBuffer;
+            // At most RetransmitMaxClients, reserved up front.
+            std::vector<ClientState> clients;
+            mutable std::mutex clientsMutex;
+        };
+
+        //======================================================================
+
+        /**
+         * Feeds datagrams from a capture to whichever listeners were sent
+         * them, in place of the network.
+         */
+        class ReplayThread final : public AnanasThread
+        {
+        public:
+            ReplayThread(const Utils::ThreadParams &p, juce::File file, double speed, Clock &clock);
+
+            /**
+             * Take over a listener's datagrams. Call before the thread starts.
+             */
+            void addListener(AnnouncementListenerThread &listener);
+
+            bool connect() override;
+
+        protected:
+            void runImpl() override;
+
+        private:
+            JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ReplayThread);
+
+            const juce::File file;
+            const double speed;
+            Clock &clock;
+            std::unique_ptr<CaptureReader> reader;
+            juce::Array<AnnouncementListenerThread *> listeners;
+        };
+
+        //======================================================================
+
         class RebootSender final : public SenderThread
         {
         public:
@@ -249,12 +878,22 @@ namespace ananas::Server
 
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Server)
 
-        uint numChannels;
-        Fifo fifo;
+        [[nodiscard]] AudioSender *getAudioSender() const;
+
+        Clock &clock;
+        PtpClock ptpClock;
+        juce::OwnedArray<AudioStream> streams;
+        SenderMetrics metrics;
         SwitchList switches;
         ClientList clients;
         ModuleList modules;
         AuthorityInfo authority;
+        // Outlives the threads that record to it.
+        std::unique_ptr<PacketCapture> capture;
+        std::unique_ptr<StreamRecorder> recorder;
+        std::unique_ptr<OfflineRender> offlineRender;
+        bool playingRender{false};
+        bool simulated{false};
         juce::OwnedArray<AnanasThread> threads;
     };
 }
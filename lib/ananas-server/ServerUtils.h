@@ -13,6 +13,7 @@
 
 #include <AnanasUtils.h>
 #include <juce_core/juce_core.h>
+#include "ThreadPolicy.h"
 
 namespace ananas::Server
 {
@@ -44,18 +45,137 @@ namespace ananas::Server
         constexpr static size_t ClientPacketBufferSize{50};
 
         /**
-         * Capacity, in frames, of the server's FIFO buffer.
+         * Largest permissible forward error correction group. Parity for a
+         * group is sent after its last packet, so a repaired packet may be
+         * up to a group late; keep that well within the client buffer.
          */
-        constexpr static uint16_t FifoCapacityFrames{(1 << 10)};
+        constexpr static size_t MaxFecGroupSize{ClientPacketBufferSize / 2};
 
         /**
-         * Obsolete... report interval for the FIFO, i.e. how frequently to
-         * print the fill-level of the FIFO.
+         * Forward error correction parity packets go to a stream's multicast
+         * group, on the stream's port plus this offset.
          */
-        constexpr static int FifoReportIntervalMs{2000};
+        constexpr static int FecPortOffset{1};
+
+        /**
+         * How long the audio sender waits for any stream to become ready
+         * before checking whether it should exit.
+         */
+        constexpr static int SenderIdleWaitMs{100};
+
+        /**
+         * The most packets of a stream the audio thread will packetize and
+         * send in one callback, in inline mode; anything more is left to
+         * the audio sender.
+         */
+        constexpr static int InlineSendMaxPackets{8};
+
+        /**
+         * Number of sent audio packets to retain for retransmission; a little
+         * more than the client packet buffer, and a divisor of 65536.
+         */
+        constexpr static size_t RetransmitHistorySize{64};
+
+        /**
+         * Token bucket limits on retransmissions to any one client, so that
+         * a misbehaving client can't storm the server.
+         */
+        constexpr static double RetransmitMaxPacketsPerSecond{500.};
+        constexpr static double RetransmitMaxBurstPackets{32.};
+
+        /**
+         * Most clients the retransmit listener keeps a token bucket for; when
+         * a new one turns up beyond that, whichever was heard from longest
+         * ago is forgotten.
+         */
+        constexpr static size_t RetransmitMaxClients{256};
+
+        /**
+         * Default and maximum delay between the primary and redundant copies
+         * of a packet, when transmitting on two paths. The skew is spent
+         * on the send thread, so must stay well within a packet interval.
+         */
+        constexpr static long DefaultRedundantPathSkewNs{20'000};
+        constexpr static long MaxRedundantPathSkewNs{100'000};
+
+        /**
+         * How far, beyond a host block, a stream's FIFO lets the audio sender
+         * fall behind the audio thread before it overflows, and how long
+         * past a block the audio thread can be late before the FIFO
+         * underflows, unless set otherwise; see Fifo::prepare() and
+         * Server::setFifoTargetLatency().
+         */
+        constexpr static int64_t DefaultFifoTargetLatencyNs{10'000'000};
 
         constexpr static size_t ListenerBufferSize{1500};
 
+        /**
+         * Size of each recording thread's packet capture ring; a few seconds
+         * of a 64-channel stream.
+         */
+        constexpr static int CaptureChannelCapacityBytes{1 << 22};
+
+        /**
+         * How often the packet capture writer drains the rings.
+         */
+        constexpr static int CaptureWriteIntervalMs{50};
+
+        /**
+         * Size of an offline render's packet capture ring: enough for the
+         * writer to keep up with a host rendering a 64-channel stream many
+         * times faster than real time.
+         */
+        constexpr static int OfflineRenderCapacityBytes{1 << 25};
+
+        /**
+         * A StreamRecorder's per-stream ring (a few seconds of a 64-channel
+         * stream), the size of each of its writes (a multiple of any block
+         * size O_DIRECT might ask for), and how far ahead of the audio it
+         * allocates the file.
+         */
+        constexpr static int RecorderTrackCapacityBytes{1 << 24};
+        constexpr static size_t RecorderWriteSizeBytes{1 << 20};
+        constexpr static uint64_t RecorderPreallocateBytes{1 << 28};
+
+        /**
+         * How much later a datagram that a NetworkImpairment reorders is
+         * released, by default.
+         */
+        constexpr static int64_t DefaultImpairmentReorderDelayNs{1'000'000};
+
+        /**
+         * Most datagrams a NetworkImpairment will hold back at once; any more
+         * are dropped.
+         */
+        constexpr static size_t ImpairmentMaxHeldDatagrams{4096};
+
+        /**
+         * If a SourceStreamer falls this many blocks behind its schedule
+         * (e.g. the machine was suspended), it starts a new schedule from
+         * now, rather than rushing to catch up.
+         */
+        constexpr static int StreamerMaxLateBlocks{8};
+
+        /**
+         * A PtpClock fits its rate to this many of the latest PTP
+         * timestamps, and only once they span at least PtpClockMinSpanNs;
+         * a timestamp more than PtpClockMaxStepNs from where the fit puts it
+         * means the timebase has stepped, and fitting starts again. Rates
+         * further than PtpClockMaxRateDeviation from the local clock's are
+         * taken to be nonsense.
+         */
+        constexpr static size_t PtpClockWindowSize{128};
+        constexpr static int64_t PtpClockMinSpanNs{4 * NSPS};
+        constexpr static int64_t PtpClockMaxStepNs{10'000'000};
+        constexpr static double PtpClockMaxRateDeviation{500e-6};
+
+        /**
+         * How far ahead of its read position a MappedFileSource keeps the
+         * file resident, and how often it catches up.
+         */
+        constexpr static int64_t PlaybackPrefetchNs{2 * NSPS};
+        constexpr static int PlaybackPrefetchIntervalMs{20};
+
         constexpr static int PTPFollowUpMessageType{0x08};
 
         constexpr static int ClientConnectednessCheckIntervalMs{1000};
@@ -79,11 +199,54 @@ namespace ananas::Server
             "Ananas Switch Inspector",
             100
         };
+
+        inline static const Utils::ThreadParams CaptureWriterThreadParams{
+            "Ananas Capture Writer",
+            1000
+        };
+
+        inline static const Utils::ThreadParams RecorderWriterThreadParams{
+            "Ananas Recorder Writer",
+            2000
+        };
+
+        inline static const Utils::ThreadParams ReplayThreadParams{
+            "Ananas Replay",
+            100
+        };
+
+        inline static const Utils::ThreadParams SourceStreamerThreadParams{
+            "Ananas Source Streamer",
+            1000
+        };
+
+        inline static const Utils::ThreadParams PlaybackPrefetchThreadParams{
+            "Ananas Playback Prefetch",
+            1000
+        };
+
+        /**
+         * Suggested policies for the two threads whose timing sets wire
+         * jitter; see Server::setThreadPolicy(). Both sit below the
+         * kernel's threaded IRQ handlers (priority 50) so as not to hold off
+         * the NIC.
+         */
+        inline static const ThreadPolicy AudioSenderPolicy{ThreadPolicy::Scheduling::fifo, 45, -15};
+        inline static const ThreadPolicy TimestampListenerPolicy{ThreadPolicy::Scheduling::fifo, 40, -10};
+
+        /**
+         * For a SourceStreamer, which stands in for an audio device's
+         * callback; just below the sender that it feeds.
+         */
+        inline static const ThreadPolicy SourceStreamerPolicy{ThreadPolicy::Scheduling::fifo, 44, -15};
     };
 
     class Sockets
     {
     public:
+        /**
+         * The audio sender, and the first (default) stream.
+         */
         inline static const Utils::SenderThreadSocketParams AudioSenderSocketParams{
             "Ananas Audio Sender",
             100,
@@ -92,6 +255,12 @@ namespace ananas::Server
             49152
         };
 
+        /**
+         * Default multicast group for the redundant copy of the audio stream;
+         * see Server::setRedundantPath().
+         */
+        inline static const juce::StringRef AudioRedundantGroupIP{"224.4.224.7"};
+
         inline static const Utils::SenderThreadSocketParams RebootSenderSocketParams{
             "Ananas Reboot Sender",
             100,
@@ -115,6 +284,16 @@ namespace ananas::Server
             1000
         };
 
+        /**
+         * Unicast; the ip member is unused.
+         */
+        inline static const Utils::ListenerThreadSocketParams RetransmitListenerSocketParams{
+            "Ananas Retransmit Listener",
+            100,
+            "",
+            49154
+        };
+
         inline static const Utils::ListenerThreadSocketParams ClientListenerSocketParams{
             "Ananas Client Listener",
             100,
@@ -0,0 +1,103 @@
+#include "SourceStreamer.h"
+#include "Logger.h"
+#include "ServerUtils.h"
+#include "Trace.h"
+
+namespace ananas
+{
+    SourceStreamer::SourceStreamer(juce::AudioSource &source, juce::AudioSource &sink, Clock &clock)
+        : Thread(Server::Threads::SourceStreamerThreadParams.name),
+          source(source),
+          sink(sink),
+          clock(clock)
+    {
+    }
+
+    SourceStreamer::~SourceStreamer()
+    {
+        stop();
+    }
+
+    void SourceStreamer::setPolicy(const ThreadPolicy &policy)
+    {
+        this->policy = policy;
+    }
+
+    void SourceStreamer::start(const int numChannels, const int blockSize, const int sampleRate)
+    {
+        stop();
+
+        this->sampleRate = sampleRate;
+        buffer.setSize(numChannels, blockSize);
+
+        source.prepareToPlay(blockSize, sampleRate);
+        sink.prepareToPlay(blockSize, sampleRate);
+
+        startThread();
+    }
+
+    void SourceStreamer::stop()
+    {
+        if (!isThreadRunning()) {
+            return;
+        }
+
+        stopThread(Server::Threads::SourceStreamerThreadParams.timeoutMs);
+
+        sink.releaseResources();
+        source.releaseResources();
+    }
+
+    bool SourceStreamer::isStreaming() const
+    {
+        return isThreadRunning();
+    }
+
+    juce::var SourceStreamer::getStats() const
+    {
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::StreamerBlocksPropertyID, static_cast<juce::int64>(numBlocks.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::StreamerResyncsPropertyID, static_cast<juce::int64>(numResyncs.load(std::memory_order_relaxed)));
+        return object;
+    }
+
+    void SourceStreamer::run()
+    {
+        Trace::registerThread();
+
+        if (const auto errors{policy.applyToCurrentThread()[Utils::Identifiers::ThreadPolicyErrorsPropertyID].toString()};
+            errors.isNotEmpty()) {
+            ANANAS_LOG_WARNING("Thread policy not fully applied: %s", errors.toRawUTF8());
+        }
+
+        const juce::AudioSourceChannelInfo info{&buffer, 0, buffer.getNumSamples()};
+        const auto blockSize{static_cast<int64_t>(buffer.getNumSamples())};
+        const auto rate{static_cast<int64_t>(sampleRate)};
+        const auto maxLateNs{Server::Constants::StreamerMaxLateBlocks * blockSize * Server::Constants::NSPS / rate};
+
+        auto startNs{clock.now()};
+        int64_t frame{0};
+
+        while (!threadShouldExit()) {
+            source.getNextAudioBlock(info);
+            sink.getNextAudioBlock(info);
+            numBlocks.fetch_add(1, std::memory_order_relaxed);
+
+            // Whole seconds and the remainder separately, so as not to
+            // overflow, however long the stream runs.
+            frame += blockSize;
+            const auto dueNs{startNs + frame / rate * Server::Constants::NSPS + frame % rate * Server::Constants::NSPS / rate};
+
+            if (const auto nowNs{clock.now()}; nowNs - dueNs > maxLateNs) {
+                ANANAS_LOG_WARNING("Source streamer fell %lld us behind; restarting schedule.",
+                                   static_cast<long long>((nowNs - dueNs) / 1000));
+                numResyncs.fetch_add(1, std::memory_order_relaxed);
+                startNs = nowNs;
+                frame = 0;
+                continue;
+            }
+
+            clock.sleepUntil(dueNs);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef ANANASSOURCESTREAMER_H
+#define ANANASSOURCESTREAMER_H
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "Clock.h"
+#include "ThreadPolicy.h"
+
+namespace ananas
+{
+    /**
+     * Stands in for an audio device, where there isn't one: on its own
+     * thread, pulls blocks from a source and pushes them into a sink (e.g. a
+     * Server), one block per block duration by the given Clock.
+     *
+     * Blocks are scheduled from the time streaming started, in exact integer
+     * arithmetic, so the rate doesn't drift however long it runs; lateness
+     * in any one wake-up is made up on the next. A streamer that falls
+     * Constants::StreamerMaxLateBlocks behind starts a new schedule.
+     */
+    class SourceStreamer final : juce::Thread
+    {
+    public:
+        SourceStreamer(juce::AudioSource &source, juce::AudioSource &sink, Clock &clock = Clock::getSystem());
+
+        ~SourceStreamer() override;
+
+        /**
+         * Applied when the thread starts, so call before start().
+         */
+        void setPolicy(const ThreadPolicy &policy);
+
+        /**
+         * Prepare the source and sink, and start streaming.
+         * @param sampleRate A whole number of hertz.
+         */
+        void start(int numChannels, int blockSize, int sampleRate);
+
+        /**
+         * Stop streaming, and release the source and sink.
+         */
+        void stop();
+
+        [[nodiscard]] bool isStreaming() const;
+
+        /**
+         * @return Blocks streamed, and how many times the schedule was
+         * restarted after falling behind.
+         */
+        [[nodiscard]] juce::var getStats() const;
+
+    private:
+        void run() override;
+
+        juce::AudioSource &source;
+        juce::AudioSource &sink;
+        Clock &clock;
+        ThreadPolicy policy;
+
+        juce::AudioBuffer<float> buffer;
+        int sampleRate{0};
+
+        std::atomic<uint64_t> numBlocks{0};
+        std::atomic<uint64_t> numResyncs{0};
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SourceStreamer)
+    };
+}
+
+#endif //ANANASSOURCESTREAMER_H
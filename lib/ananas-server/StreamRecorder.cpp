@@ -0,0 +1,426 @@
+#include "StreamRecorder.h"
+#include <AnanasUtils.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Logger.h"
+
+namespace ananas
+{
+    namespace
+    {
+        /**
+         * Offsets and sizes in the file are kept to multiples of this, which
+         * satisfies O_DIRECT on any filesystem likely to be recorded to.
+         */
+        constexpr size_t Alignment{4096};
+
+        /**
+         * The riff, fmt and junk chunks, then the data chunk's header, padded
+         * so that the audio starts on an aligned offset.
+         */
+        constexpr size_t HeaderSize{Alignment};
+        constexpr size_t RiffChunkSize{40};
+        constexpr size_t FmtChunkSize{24 + 40};
+        constexpr size_t ChunkHeaderSize{24};
+        constexpr size_t JunkChunkSize{HeaderSize - RiffChunkSize - FmtChunkSize - ChunkHeaderSize};
+
+        constexpr uint16_t WaveFormatExtensible{0xfffe};
+        constexpr uint16_t BitsPerSample{16};
+
+        constexpr uint8_t W64RiffGuid[16]{
+            'r', 'i', 'f', 'f', 0x2e, 0x91, 0xcf, 0x11, 0xa5, 0xd6, 0x28, 0xdb, 0x04, 0xc1, 0x00, 0x00
+        };
+        constexpr uint8_t W64WaveGuid[16]{
+            'w', 'a', 'v', 'e', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a
+        };
+        constexpr uint8_t W64FmtGuid[16]{
+            'f', 'm', 't', ' ', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a
+        };
+        constexpr uint8_t W64JunkGuid[16]{
+            'j', 'u', 'n', 'k', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a
+        };
+        constexpr uint8_t W64DataGuid[16]{
+            'd', 'a', 't', 'a', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a
+        };
+        constexpr uint8_t PcmSubformatGuid[16]{
+            0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71
+        };
+
+        template<typename T>
+        void put(uint8_t *&p, const T value)
+        {
+            memcpy(p, &value, sizeof(T));
+            p += sizeof(T);
+        }
+
+        void put(uint8_t *&p, const uint8_t (&guid)[16])
+        {
+            memcpy(p, guid, sizeof(guid));
+            p += sizeof(guid);
+        }
+
+        uint64_t roundUp(const uint64_t value, const uint64_t multiple)
+        {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+
+        uint8_t *allocateAligned(const size_t numBytes)
+        {
+            auto *block{static_cast<uint8_t *>(std::aligned_alloc(Alignment, numBytes))};
+            if (block != nullptr) {
+                // Fault it in now, rather than on the writer's first pass.
+                memset(block, 0, numBytes);
+            }
+            return block;
+        }
+    }
+
+    StreamRecorder::Track::Track(juce::String name, const uint numChannels, const int capacityBytes)
+        : name(std::move(name)),
+          numChannels(numChannels),
+          ring(static_cast<size_t>(capacityBytes)),
+          fifo(capacityBytes)
+    {
+    }
+
+    StreamRecorder::Track::~Track()
+    {
+        std::free(staging);
+    }
+
+    void StreamRecorder::Track::add(const uint8_t *audio, const size_t numBytes) noexcept
+    {
+        const auto n{static_cast<int>(numBytes)};
+
+        if (fifo.getFreeSpace() < n) {
+            numDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // The packet becomes visible to the writer when the handle goes out
+        // of scope.
+        const auto handle{fifo.write(n)};
+        memcpy(ring.data() + handle.startIndex1, audio, static_cast<size_t>(handle.blockSize1));
+        memcpy(ring.data() + handle.startIndex2, audio + handle.blockSize1, static_cast<size_t>(handle.blockSize2));
+    }
+
+    //==========================================================================
+
+    StreamRecorder::StreamRecorder(juce::File file, const int trackCapacityBytes)
+        : file(std::move(file)),
+          trackCapacityBytes(trackCapacityBytes),
+          writer(*this)
+    {
+    }
+
+    StreamRecorder::~StreamRecorder()
+    {
+        stop();
+        std::free(header);
+    }
+
+    StreamRecorder::Track &StreamRecorder::addTrack(const juce::String &name, const uint numChannels)
+    {
+        jassert(!started);
+        return *tracks.add(new Track(name, numChannels, trackCapacityBytes));
+    }
+
+    bool StreamRecorder::start(const double rate)
+    {
+        if (started) return true;
+
+        sampleRate = rate;
+        failed.store(false, std::memory_order_relaxed);
+
+        if (header == nullptr && (header = allocateAligned(HeaderSize)) == nullptr) {
+            ANANAS_LOG_ERROR("Failed to allocate recording buffers.");
+            return false;
+        }
+
+        for (auto *t: tracks) {
+            if (!open(*t)) {
+                for (auto *u: tracks) {
+                    close(*u);
+                }
+                return false;
+            }
+        }
+
+        started = true;
+        writer.startThread();
+        return true;
+    }
+
+    void StreamRecorder::stop()
+    {
+        if (!started) return;
+
+        // The writer drains the rings once more on its way out.
+        writer.stopThread(Server::Threads::RecorderWriterThreadParams.timeoutMs);
+
+        for (auto *t: tracks) {
+            close(*t);
+        }
+        started = false;
+
+        const auto stats{getStats()};
+        ANANAS_LOG_INFO("Recorded %s packets; %s dropped.",
+                        stats[Utils::Identifiers::CapturePacketsPropertyID].toString().toRawUTF8(),
+                        stats[Utils::Identifiers::CaptureDroppedPropertyID].toString().toRawUTF8());
+    }
+
+    juce::File StreamRecorder::getFile() const
+    {
+        return file;
+    }
+
+    juce::var StreamRecorder::getStats() const
+    {
+        uint64_t numDropped{0};
+        for (const auto *t: tracks) {
+            numDropped += t->numDropped.load(std::memory_order_relaxed);
+        }
+
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::CaptureFilePropertyID, file.getFullPathName());
+        object->setProperty(Utils::Identifiers::CapturePacketsPropertyID, static_cast<juce::int64>(numPackets.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::CaptureBytesPropertyID, static_cast<juce::int64>(numBytes.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::CaptureDroppedPropertyID, static_cast<juce::int64>(numDropped));
+        object->setProperty(Utils::Identifiers::CaptureFailedPropertyID, failed.load(std::memory_order_relaxed));
+        return object;
+    }
+
+    bool StreamRecorder::open(Track &track)
+    {
+        track.file = tracks.size() == 1
+                         ? file
+                         : file.getSiblingFile(file.getFileNameWithoutExtension() + " "
+                                               + juce::File::createLegalFileName(track.name)).withFileExtension("w64");
+
+        const auto *path{track.file.getFullPathName().toRawUTF8()};
+        constexpr auto flags{O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC};
+
+        // Not every filesystem (e.g. tmpfs) supports O_DIRECT.
+        track.fd = ::open(path, flags | O_DIRECT, 0644);
+        track.direct = track.fd >= 0;
+        if (track.fd < 0 && errno == EINVAL) {
+            track.fd = ::open(path, flags, 0644);
+        }
+        if (track.fd < 0) {
+            ANANAS_LOG_ERROR("Failed to open recording file %s: %s", path, strerror(errno));
+            return false;
+        }
+
+        if (track.staging == nullptr && (track.staging = allocateAligned(Server::Constants::RecorderWriteSizeBytes)) == nullptr) {
+            ANANAS_LOG_ERROR("Failed to allocate recording buffers.");
+            ::close(track.fd);
+            track.fd = -1;
+            return false;
+        }
+
+        track.numStaged = 0;
+        track.numWritten = 0;
+        track.numAllocated = 0;
+        allocate(track, HeaderSize);
+
+        // Write the header even if nothing else gets written.
+        track.numInHeader = std::numeric_limits<uint64_t>::max();
+        if (!writeHeader(track)) {
+            ::close(track.fd);
+            track.fd = -1;
+            return false;
+        }
+
+        ANANAS_LOG_INFO("Recording %s to %s%s.",
+                        track.name.toRawUTF8(),
+                        path,
+                        track.direct ? " (direct)" : "");
+        return true;
+    }
+
+    void StreamRecorder::close(Track &track)
+    {
+        if (track.fd < 0) return;
+
+        if (track.numStaged > 0 && !failed.load(std::memory_order_relaxed)) {
+            // The last write is a partial block, which O_DIRECT won't take.
+            if (track.direct) {
+                fcntl(track.fd, F_SETFL, fcntl(track.fd, F_GETFL) & ~O_DIRECT);
+                track.direct = false;
+            }
+            writeStaged(track);
+        }
+
+        writeHeader(track);
+
+        // Give back whatever was allocated beyond the audio; W64 pads the
+        // data chunk to a multiple of eight bytes.
+        if (ftruncate(track.fd, static_cast<off_t>(HeaderSize + roundUp(track.numWritten, 8))) != 0) {
+            ANANAS_LOG_WARNING("Failed to trim recording file: %s", strerror(errno));
+        }
+
+        ::close(track.fd);
+        track.fd = -1;
+    }
+
+    void StreamRecorder::drain()
+    {
+        for (auto *t: tracks) {
+            drain(*t);
+            if (!failed.load(std::memory_order_relaxed)) {
+                writeHeader(*t);
+            }
+        }
+    }
+
+    void StreamRecorder::drain(Track &track)
+    {
+        // The sender only ever commits whole packets.
+        const auto numReady{track.fifo.getNumReady()};
+        if (numReady == 0) return;
+
+        if (failed.load(std::memory_order_relaxed)) {
+            track.fifo.finishedRead(numReady);
+            return;
+        }
+
+        int start1, size1, start2, size2;
+        track.fifo.prepareToRead(numReady, start1, size1, start2, size2);
+
+        for (const auto &[start, size]: {std::pair{start1, size1}, std::pair{start2, size2}}) {
+            const auto *src{track.ring.data() + start};
+            auto remaining{static_cast<size_t>(size)};
+
+            while (remaining > 0) {
+                const auto n{std::min(remaining, Server::Constants::RecorderWriteSizeBytes - track.numStaged)};
+                memcpy(track.staging + track.numStaged, src, n);
+                track.numStaged += n;
+                src += n;
+                remaining -= n;
+
+                if (track.numStaged == Server::Constants::RecorderWriteSizeBytes) {
+                    writeStaged(track);
+                }
+            }
+
+            // Hand the space back to the sender as soon as possible.
+            track.fifo.finishedRead(size);
+        }
+
+        numPackets.fetch_add(static_cast<uint64_t>(numReady) / (track.numChannels * Server::Constants::FramesPerPacket * sizeof(int16_t)),
+                             std::memory_order_relaxed);
+        numBytes.fetch_add(static_cast<uint64_t>(numReady), std::memory_order_relaxed);
+    }
+
+    bool StreamRecorder::writeStaged(Track &track)
+    {
+        const auto offset{HeaderSize + track.numWritten};
+        allocate(track, offset + track.numStaged);
+
+        const auto ok{write(track, track.staging, track.numStaged, offset)};
+        if (ok) {
+            track.numWritten += track.numStaged;
+        }
+        track.numStaged = 0;
+        return ok;
+    }
+
+    void StreamRecorder::allocate(Track &track, const uint64_t size)
+    {
+        if (size <= track.numAllocated) return;
+
+        const auto end{roundUp(size, Alignment) + Server::Constants::RecorderPreallocateBytes};
+        if (fallocate(track.fd, 0, static_cast<off_t>(track.numAllocated), static_cast<off_t>(end - track.numAllocated)) != 0) {
+            // Not fatal; the file just grows as it's written.
+            ANANAS_LOG_WARNING("Can't preallocate recording file: %s", strerror(errno));
+            track.numAllocated = std::numeric_limits<uint64_t>::max();
+            return;
+        }
+
+        track.numAllocated = end;
+    }
+
+    bool StreamRecorder::writeHeader(Track &track)
+    {
+        if (track.numInHeader == track.numWritten) return true;
+
+        const auto blockAlign{static_cast<uint16_t>(track.numChannels * sizeof(int16_t))};
+        const auto rate{static_cast<uint32_t>(sampleRate)};
+
+        memset(header, 0, HeaderSize);
+        auto *p{header};
+        put(p, W64RiffGuid);
+        put(p, static_cast<uint64_t>(HeaderSize + roundUp(track.numWritten, 8)));
+        put(p, W64WaveGuid);
+
+        put(p, W64FmtGuid);
+        put(p, static_cast<uint64_t>(FmtChunkSize));
+        put(p, WaveFormatExtensible);
+        put(p, static_cast<uint16_t>(track.numChannels));
+        put(p, rate);
+        put(p, rate * blockAlign);
+        put(p, blockAlign);
+        put(p, BitsPerSample);
+        put(p, uint16_t{22});
+        put(p, BitsPerSample);
+        // No speaker positions; these are arbitrary channels.
+        put(p, uint32_t{0});
+        put(p, PcmSubformatGuid);
+
+        put(p, W64JunkGuid);
+        put(p, static_cast<uint64_t>(JunkChunkSize));
+        p += JunkChunkSize - ChunkHeaderSize;
+
+        put(p, W64DataGuid);
+        put(p, static_cast<uint64_t>(ChunkHeaderSize + track.numWritten));
+        jassert(p == header + HeaderSize);
+
+        if (!write(track, header, HeaderSize, 0)) return false;
+
+        track.numInHeader = track.numWritten;
+        return true;
+    }
+
+    bool StreamRecorder::write(Track &track, const void *data, const size_t size, const uint64_t offset)
+    {
+        auto *bytes{static_cast<const uint8_t *>(data)};
+        size_t done{0};
+
+        while (done < size) {
+            const auto result{pwrite(track.fd, bytes + done, size - done, static_cast<off_t>(offset + done))};
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EINVAL && track.direct) {
+                    // The filesystem took O_DIRECT at open, but not this
+                    // write; carry on through the page cache.
+                    fcntl(track.fd, F_SETFL, fcntl(track.fd, F_GETFL) & ~O_DIRECT);
+                    track.direct = false;
+                    continue;
+                }
+                ANANAS_LOG_ERROR("Failed to write to recording file: %s", strerror(errno));
+                failed.store(true, std::memory_order_relaxed);
+                return false;
+            }
+            done += static_cast<size_t>(result);
+        }
+
+        return true;
+    }
+
+    //==========================================================================
+
+    StreamRecorder::Writer::Writer(StreamRecorder &owner)
+        : Thread(Server::Threads::RecorderWriterThreadParams.name),
+          owner(owner)
+    {
+    }
+
+    void StreamRecorder::Writer::run()
+    {
+        while (!threadShouldExit()) {
+            owner.drain();
+            wait(Server::Constants::CaptureWriteIntervalMs);
+        }
+        owner.drain();
+    }
+}
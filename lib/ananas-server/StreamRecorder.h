@@ -0,0 +1,146 @@
+#ifndef ANANASSTREAMRECORDER_H
+#define ANANASSTREAMRECORDER_H
+
+#include <juce_core/juce_core.h>
+#include "ServerUtils.h"
+
+namespace ananas
+{
+    /**
+     * Records exactly what the audio sender transmits — each stream's audio,
+     * as packetized: 16-bit, before any encoding — to a multichannel W64
+     * file per stream, for archiving a show.
+     *
+     * Each stream gets a Track: a preallocated, single-producer ring into
+     * which add() copies a packet's audio. A background writer moves the
+     * rings to disk in large, aligned writes (with O_DIRECT, where the
+     * filesystem allows), into files that are extended with fallocate() well
+     * ahead of the audio. If the writer falls behind and a ring fills,
+     * packets are left out of the recording (and counted), never held up.
+     */
+    class StreamRecorder
+    {
+    public:
+        class Track
+        {
+        public:
+            Track(juce::String name, uint numChannels, int capacityBytes);
+
+            ~Track();
+
+            /**
+             * Copy one packet's audio, interleaved little-endian int16, into
+             * the ring; wait-free. Call only from the sending thread.
+             */
+            void add(const uint8_t *audio, size_t numBytes) noexcept;
+
+        private:
+            friend class StreamRecorder;
+
+            const juce::String name;
+            const uint numChannels;
+            std::vector<uint8_t> ring;
+            juce::AbstractFifo fifo;
+            std::atomic<uint64_t> numDropped{0};
+
+            // The writer's.
+            juce::File file;
+            int fd{-1};
+            bool direct{false};
+            uint8_t *staging{nullptr};
+            size_t numStaged{0};
+            uint64_t numWritten{0};
+            uint64_t numInHeader{0};
+            uint64_t numAllocated{0};
+
+            JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Track)
+        };
+
+        explicit StreamRecorder(juce::File file,
+                                int trackCapacityBytes = Server::Constants::RecorderTrackCapacityBytes);
+
+        ~StreamRecorder();
+
+        /**
+         * Add a track, for one stream. Call before start().
+         */
+        Track &addTrack(const juce::String &name, uint numChannels);
+
+        /**
+         * Create the files, write their headers, and start the writer. With
+         * one track, it's recorded to the file given; with more, to one file
+         * per track alongside it, named for the track's stream.
+         */
+        bool start(double sampleRate);
+
+        /**
+         * Stop the writer, once it has written whatever is left in the rings,
+         * and finish the files.
+         */
+        void stop();
+
+        [[nodiscard]] juce::File getFile() const;
+
+        [[nodiscard]] juce::var getStats() const;
+
+    private:
+        class Writer final : public juce::Thread
+        {
+        public:
+            explicit Writer(StreamRecorder &owner);
+
+            void run() override;
+
+        private:
+            StreamRecorder &owner;
+        };
+
+        bool open(Track &track);
+
+        void close(Track &track);
+
+        /**
+         * Move everything each track has ready to its staging buffer, writing
+         * the buffer out whenever it fills.
+         */
+        void drain();
+
+        void drain(Track &track);
+
+        /**
+         * Write a track's staging buffer at the end of its file, growing the
+         * file's allocation first if need be.
+         */
+        bool writeStaged(Track &track);
+
+        /**
+         * Allocate a track's file up to at least the given size, and a good
+         * way beyond.
+         */
+        void allocate(Track &track, uint64_t size);
+
+        /**
+         * Rewrite a track's header with the sizes written so far, so that a
+         * recording cut short is still playable up to its last write.
+         */
+        bool writeHeader(Track &track);
+
+        bool write(Track &track, const void *data, size_t numBytes, uint64_t offset);
+
+        const juce::File file;
+        const int trackCapacityBytes;
+        juce::OwnedArray<Track> tracks;
+        Writer writer;
+        double sampleRate{0};
+        // Aligned, for O_DIRECT.
+        uint8_t *header{nullptr};
+        bool started{false};
+        std::atomic<uint64_t> numPackets{0};
+        std::atomic<uint64_t> numBytes{0};
+        std::atomic<bool> failed{false};
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StreamRecorder)
+    };
+}
+
+#endif //ANANASSTREAMRECORDER_H
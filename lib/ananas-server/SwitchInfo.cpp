@@ -1,5 +1,6 @@
 #include "SwitchInfo.h"
 #include "ServerUtils.h"
+#include "Logger.h"
 #include <AnanasUtils.h>
 
 namespace ananas
@@ -59,7 +60,7 @@ namespace ananas
         for (const auto &prop: obj->getProperties()) {
             if (const auto *s = prop.value.getDynamicObject()) {
                 if (s->getProperty(Utils::Identifiers::SwitchShouldRemovePropertyID)) {
-                    std::cout << "Removing " << prop.name.toString() << std::endl;
+                    ANANAS_LOG_INFO("Removing %s", prop.name.toString().toRawUTF8());
                     switches.erase(prop.name);//(index);
                     sendChangeMessage();
                     return;
@@ -75,7 +76,7 @@ namespace ananas
                 if (iter == switches.end()) {
                     SwitchInfo i{};
                     iter = switches.insert(std::make_pair(prop.name, i)).first;//(index, i)).first;
-                    std::cout << "Adding " << iter->first.toString() << std::endl;
+                    ANANAS_LOG_INFO("Adding %s", iter->first.toString().toRawUTF8());
                 }
 
                 iter->second.ip = s->getProperty(Utils::Identifiers::SwitchIpPropertyID).toString();
@@ -102,7 +103,7 @@ namespace ananas
             if (iter == switches.end()) {
                 SwitchInfo s{};
                 iter = switches.insert(std::make_pair(switchID, s)).first;
-                std::cout << "Found " << iter->first.toString() << std::endl;
+                ANANAS_LOG_INFO("Found %s", iter->first.toString().toRawUTF8());
             }
             iter->second.update(&switchInfo);
             sendChangeMessage();
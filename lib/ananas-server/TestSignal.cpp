@@ -0,0 +1,60 @@
+#include "TestSignal.h"
+
+namespace ananas
+{
+    uint64_t TestSignal::fill(juce::AudioBuffer<float> &buffer, const int startSample, const int numSamples, uint64_t frame)
+    {
+        for (auto i{0}; i < numSamples; ++i, ++frame) {
+            for (auto ch{0}; ch < buffer.getNumChannels(); ++ch) {
+                buffer.setSample(ch, startSample + i, static_cast<float>(getSample(frame, ch)) / 32768.f);
+            }
+        }
+
+        return frame;
+    }
+
+    int16_t TestSignal::getSample(const uint64_t frame, const int channel)
+    {
+        return static_cast<int16_t>(static_cast<uint16_t>(frame + static_cast<uint64_t>(channel) * ChannelOffset));
+    }
+
+    bool TestSignal::verify(const uint8_t *interleaved, const int numChannels, const int numFrames, uint16_t &firstFrame)
+    {
+        if (numChannels <= 0 || numFrames <= 0) return false;
+
+        const auto read{
+            [interleaved, numChannels](const int frame, const int channel)
+            {
+                return static_cast<int16_t>(juce::ByteOrder::littleEndianShort(&interleaved[(frame * numChannels + channel) * sizeof(int16_t)]));
+            }
+        };
+
+        firstFrame = static_cast<uint16_t>(read(0, 0));
+
+        for (auto f{0}; f < numFrames; ++f) {
+            for (auto ch{0}; ch < numChannels; ++ch) {
+                if (read(f, ch) != getSample(static_cast<uint64_t>(firstFrame) + static_cast<uint64_t>(f), ch)) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    //==========================================================================
+
+    void TestSignalSource::prepareToPlay(int, double)
+    {
+        frame = 0;
+    }
+
+    void TestSignalSource::releaseResources()
+    {
+    }
+
+    void TestSignalSource::getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill)
+    {
+        frame = TestSignal::fill(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples, frame);
+    }
+}
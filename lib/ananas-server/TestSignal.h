@@ -0,0 +1,62 @@
+#ifndef ANANASTESTSIGNAL_H
+#define ANANASTESTSIGNAL_H
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+namespace ananas
+{
+    /**
+     * A deterministic, bit-exact test signal, for checking the integrity of
+     * a stream at the receiving end (see ananas_probe).
+     *
+     * Each channel is a 16-bit ramp, one LSB per frame, offset by
+     * ChannelOffset per channel: the int16 sample for frame f of channel c is
+     * the low 16 bits of (f + c * ChannelOffset). Float samples are exact
+     * multiples of 1/32768, so they survive conversion to int16 unchanged.
+     * Any packet can be checked on its own, and any two consecutive packets
+     * for continuity.
+     *
+     * NB, this is a full-scale sawtooth at < 1 Hz; not for loudspeakers.
+     */
+    class TestSignal
+    {
+    public:
+        constexpr static uint16_t ChannelOffset{0x1000};
+
+        /**
+         * Write the signal to a buffer, starting at the given frame.
+         * @return The frame following the last one written.
+         */
+        static uint64_t fill(juce::AudioBuffer<float> &buffer, int startSample, int numSamples, uint64_t frame);
+
+        static int16_t getSample(uint64_t frame, int channel);
+
+        /**
+         * Check a packet's worth of interleaved, little-endian int16 audio.
+         * @param firstFrame Set to the (16-bit) frame of the packet's first
+         * sample, as implied by channel 0.
+         * @return true if every sample matches the signal.
+         */
+        static bool verify(const uint8_t *interleaved, int numChannels, int numFrames, uint16_t &firstFrame);
+    };
+
+    //==========================================================================
+
+    /**
+     * The test signal as an AudioSource, from frame 0 on preparing.
+     */
+    class TestSignalSource final : public juce::AudioSource
+    {
+    public:
+        void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+        void releaseResources() override;
+
+        void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override;
+
+    private:
+        uint64_t frame{0};
+    };
+}
+
+#endif //ANANASTESTSIGNAL_H
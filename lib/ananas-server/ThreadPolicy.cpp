@@ -0,0 +1,108 @@
+#include "ThreadPolicy.h"
+#include <AnanasUtils.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#if JUCE_LINUX
+#include <sys/syscall.h>
+#endif
+
+namespace ananas
+{
+    juce::var ThreadPolicy::applyToCurrentThread() const
+    {
+        const auto object{new juce::DynamicObject()};
+        juce::StringArray errors;
+
+        auto appliedScheduling{Scheduling::other};
+        auto appliedPriority{0};
+
+        if (scheduling != Scheduling::other) {
+            const auto policy{scheduling == Scheduling::fifo ? SCHED_FIFO : SCHED_RR};
+            const sched_param param{
+                juce::jlimit(sched_get_priority_min(policy), sched_get_priority_max(policy), priority)
+            };
+
+            if (const auto result{pthread_setschedparam(pthread_self(), policy, &param)}; result == 0) {
+                appliedScheduling = scheduling;
+                appliedPriority = param.sched_priority;
+            } else {
+                errors.add(schedulingToString(scheduling) + " scheduling refused: " + strerror(result));
+            }
+        }
+
+        // Niceness only means anything to normally-scheduled threads.
+        auto appliedNiceness{0};
+#if JUCE_LINUX
+        if (appliedScheduling == Scheduling::other && niceness != 0) {
+            const auto tid{static_cast<id_t>(syscall(SYS_gettid))};
+            if (setpriority(PRIO_PROCESS, tid, juce::jlimit(-20, 19, niceness)) == 0) {
+                appliedNiceness = getpriority(PRIO_PROCESS, tid);
+            } else {
+                errors.add("nice " + juce::String{niceness} + " refused: " + strerror(errno));
+            }
+        }
+
+        if (affinityMask != 0) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            for (int cpu{0}; cpu < 64; ++cpu) {
+                if (affinityMask & uint64_t{1} << cpu) CPU_SET(cpu, &cpus);
+            }
+            if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+                errors.add("CPU affinity refused: " + juce::String{strerror(errno)});
+            }
+        }
+
+        uint64_t appliedMask{0};
+        if (cpu_set_t cpus; sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+            for (int cpu{0}; cpu < 64; ++cpu) {
+                if (CPU_ISSET(cpu, &cpus)) appliedMask |= uint64_t{1} << cpu;
+            }
+        }
+#else
+        if (niceness != 0 || affinityMask != 0) {
+            errors.add("Nice and CPU affinity are only supported on Linux");
+        }
+        const uint64_t appliedMask{0};
+#endif
+
+        object->setProperty(Utils::Identifiers::ThreadSchedulingPropertyID, schedulingToString(appliedScheduling));
+        object->setProperty(Utils::Identifiers::ThreadPriorityPropertyID, appliedPriority);
+        object->setProperty(Utils::Identifiers::ThreadNicenessPropertyID, appliedNiceness);
+        object->setProperty(Utils::Identifiers::ThreadAffinityPropertyID, "0x" + juce::String::toHexString(static_cast<juce::int64>(appliedMask)));
+        object->setProperty(Utils::Identifiers::ThreadPolicyErrorsPropertyID, errors.joinIntoString("; "));
+
+        return object;
+    }
+
+    juce::String ThreadPolicy::schedulingToString(const Scheduling s)
+    {
+        switch (s) {
+            case Scheduling::fifo: return "FIFO";
+            case Scheduling::roundRobin: return "RR";
+            case Scheduling::other:
+            default: return "other";
+        }
+    }
+
+    bool lockMemory(void *data, const size_t numBytes)
+    {
+        if (data == nullptr || numBytes == 0) return true;
+
+        // mlock() faults the pages in as it locks them.
+        if (mlock(data, numBytes) == 0) return true;
+
+        // Couldn't lock; write to every page so at least there are no
+        // faults (or copy-on-write of the zero page) later.
+        static const auto pageSize{static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+        auto *bytes{static_cast<volatile uint8_t *>(data)};
+        for (size_t i{0}; i < numBytes; i += pageSize) {
+            bytes[i] = bytes[i];
+        }
+
+        return false;
+    }
+}
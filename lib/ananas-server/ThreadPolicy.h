@@ -0,0 +1,62 @@
+#ifndef ANANASTHREADPOLICY_H
+#define ANANASTHREADPOLICY_H
+
+#include <juce_core/juce_core.h>
+
+namespace ananas
+{
+    /**
+     * Scheduling class, priority and CPU affinity for one thread.
+     *
+     * Realtime scheduling and negative nice values need privileges
+     * (CAP_SYS_NICE, or an rtprio/nice entry in limits.conf); when they're
+     * refused, applyToCurrentThread() falls back as far as it can and
+     * reports what was actually applied, rather than failing.
+     */
+    struct ThreadPolicy
+    {
+        enum class Scheduling : uint8_t
+        {
+            other = 0,
+            fifo,
+            roundRobin
+        };
+
+        Scheduling scheduling{Scheduling::other};
+        /**
+         * Realtime priority, 1–99; used with Scheduling::fifo and
+         * Scheduling::roundRobin.
+         */
+        int priority{0};
+        /**
+         * Nice value, -20–19; used with Scheduling::other, and as the
+         * fallback if realtime scheduling is refused.
+         */
+        int niceness{0};
+        /**
+         * Bit n set allows the thread to run on CPU n; 0 leaves the affinity
+         * alone.
+         */
+        uint64_t affinityMask{0};
+
+        /**
+         * Apply the policy to the calling thread.
+         * @return A description of the policy that was actually applied,
+         * with any errors encountered along the way.
+         */
+        [[nodiscard]] juce::var applyToCurrentThread() const;
+
+        static juce::String schedulingToString(Scheduling s);
+    };
+
+    /**
+     * Lock a region of memory into RAM, so that the realtime threads never
+     * take a page fault on it. If locking is refused (usually
+     * RLIMIT_MEMLOCK), the pages are at least faulted in now. Call before
+     * the region is in use by another thread.
+     * @return true if the region was locked.
+     */
+    bool lockMemory(void *data, size_t numBytes);
+}
+
+#endif //ANANASTHREADPOLICY_H
@@ -0,0 +1,150 @@
+#include "Trace.h"
+
+namespace ananas
+{
+    std::mutex Trace::registryMutex;
+    std::vector<std::unique_ptr<Trace::ThreadBuffer>> Trace::threadBuffers;
+    std::atomic<Trace::ThreadBuffer *> Trace::reservedBuffer{nullptr};
+    int Trace::numReserved{0};
+
+    void Trace::record(const char *name, const int64_t startNs, const int64_t endNs)
+    {
+        auto *&buffer{getCurrentBuffer()};
+
+        if (buffer == nullptr) {
+            // Never allocate here; take the reserved ring, if there is one.
+            if (reservedBuffer.load(std::memory_order_relaxed) == nullptr) return;
+            buffer = reservedBuffer.exchange(nullptr, std::memory_order_acq_rel);
+            if (buffer == nullptr) return;
+            buffer->inUse.store(true, std::memory_order_release);
+        }
+
+        // Only this thread writes to its buffer; publish each event by
+        // bumping the count.
+        const auto n{buffer->numRecorded.load(std::memory_order_relaxed)};
+        buffer->events[n % EventsPerThread] = {name, startNs, endNs - startNs};
+        buffer->numRecorded.store(n + 1, std::memory_order_release);
+    }
+
+    void Trace::registerThread()
+    {
+#if ANANAS_TRACING
+        auto *&buffer{getCurrentBuffer()};
+        if (buffer != nullptr) return;
+
+        juce::String name;
+        if (const auto *t = juce::Thread::getCurrentThread()) {
+            name = t->getThreadName();
+        } else {
+            name = "Thread " + juce::String::toHexString(reinterpret_cast<juce::pointer_sized_int>(juce::Thread::getCurrentThreadId()));
+        }
+
+        buffer = addBuffer(name);
+        buffer->inUse.store(true, std::memory_order_release);
+#endif
+    }
+
+    void Trace::reserveThread(const juce::String &name)
+    {
+#if ANANAS_TRACING
+        // A ring that's already set aside, and not yet taken, will do, as
+        // will the calling thread's own (if the host prepares on its audio
+        // thread).
+        if (reservedBuffer.load(std::memory_order_acquire) != nullptr || getCurrentBuffer() != nullptr) return;
+
+        {
+            const std::lock_guard lock{registryMutex};
+            if (numReserved >= MaxReservedThreads) return;
+            ++numReserved;
+        }
+
+        reservedBuffer.store(addBuffer(name), std::memory_order_release);
+#else
+        juce::ignoreUnused(name);
+#endif
+    }
+
+    void Trace::setThreadName(const juce::String &name)
+    {
+#if ANANAS_TRACING
+        registerThread();
+        const std::lock_guard lock{registryMutex};
+        getCurrentBuffer()->threadName = name;
+#else
+        juce::ignoreUnused(name);
+#endif
+    }
+
+    Trace::ThreadBuffer *&Trace::getCurrentBuffer()
+    {
+        thread_local ThreadBuffer *buffer{nullptr};
+        return buffer;
+    }
+
+    Trace::ThreadBuffer *Trace::addBuffer(const juce::String &name)
+    {
+        auto newBuffer{std::make_unique<ThreadBuffer>()};
+        newBuffer->events.resize(EventsPerThread);
+        newBuffer->threadName = name;
+
+        const std::lock_guard lock{registryMutex};
+        newBuffer->threadIndex = static_cast<int>(threadBuffers.size()) + 1;
+        auto *buffer{newBuffer.get()};
+        threadBuffers.push_back(std::move(newBuffer));
+        return buffer;
+    }
+
+    bool Trace::writeChromeJson(const juce::File &file)
+    {
+        juce::FileOutputStream stream{file};
+        if (!stream.openedOk()) return false;
+        stream.setPosition(0);
+        stream.truncate();
+
+        stream << "{\"traceEvents\":[\n";
+        auto first{true};
+
+        const std::lock_guard lock{registryMutex};
+
+        for (const auto &buffer: threadBuffers) {
+            if (!buffer->inUse.load(std::memory_order_acquire)) continue;
+
+            if (!first) stream << ",\n";
+            first = false;
+            stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadIndex <<
+                    ",\"args\":{\"name\":" << juce::JSON::toString(buffer->threadName) << "}}";
+
+            // Copy out the live events, then drop any that were overwritten
+            // while copying.
+            const auto end{buffer->numRecorded.load(std::memory_order_acquire)};
+            const auto begin{end > EventsPerThread ? end - EventsPerThread : 0};
+            std::vector<Event> events;
+            events.reserve(static_cast<size_t>(end - begin));
+            for (auto i{begin}; i < end; ++i) {
+                events.push_back(buffer->events[i % EventsPerThread]);
+            }
+            const auto endAfterCopy{buffer->numRecorded.load(std::memory_order_acquire)};
+            const auto numOverwritten{
+                endAfterCopy > EventsPerThread + begin ? endAfterCopy - EventsPerThread - begin : 0
+            };
+
+            for (auto i{static_cast<size_t>(numOverwritten)}; i < events.size(); ++i) {
+                const auto &e{events[i]};
+                stream << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadIndex <<
+                        ",\"ts\":" << juce::String{static_cast<double>(e.startNs) / 1000., 3} <<
+                        ",\"dur\":" << juce::String{static_cast<double>(e.durationNs) / 1000., 3} << "}";
+            }
+        }
+
+        stream << "\n]}\n";
+        stream.flush();
+        return stream.getStatus().wasOk();
+    }
+
+    int64_t Trace::now()
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+}
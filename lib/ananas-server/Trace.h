@@ -0,0 +1,131 @@
+#ifndef ANANASTRACE_H
+#define ANANASTRACE_H
+
+#include <juce_core/juce_core.h>
+
+#ifndef ANANAS_TRACING
+#define ANANAS_TRACING 0
+#endif
+
+#define ANANAS_TRACE_CONCAT_INNER(a, b) a##b
+#define ANANAS_TRACE_CONCAT(a, b) ANANAS_TRACE_CONCAT_INNER(a, b)
+
+#if ANANAS_TRACING
+/**
+ * Record the duration of the enclosing scope as a trace event. The name must
+ * be a string literal (or otherwise outlive the trace).
+ */
+#define ANANAS_TRACE_SCOPE(name) const ananas::TraceScope ANANAS_TRACE_CONCAT(ananasTraceScope, __LINE__){name}
+#else
+#define ANANAS_TRACE_SCOPE(name)
+#endif
+
+namespace ananas
+{
+    /**
+     * A low-overhead timeline of scoped events from every thread, for
+     * viewing in chrome://tracing or https://ui.perfetto.dev.
+     *
+     * Each thread records into its own ring of the most recent
+     * EventsPerThread events. Rings are only ever allocated by
+     * registerThread() and reserveThread(), so recording is always lock-free
+     * and allocation-free; events from a thread with no ring are dropped.
+     * Instrumentation is compiled out unless ANANAS_TRACING is set (the CMake
+     * option of the same name), and then so is all of this.
+     */
+    class Trace
+    {
+    public:
+        constexpr static size_t EventsPerThread{1 << 16};
+
+        /**
+         * Rings are never freed, and a host may bring up a new audio thread
+         * on every prepare, so only so many are ever set aside; audio
+         * threads beyond these go untraced.
+         */
+        constexpr static int MaxReservedThreads{4};
+
+        static void record(const char *name, int64_t startNs, int64_t endNs);
+
+        /**
+         * Give the calling thread its ring, named after the JUCE thread, or
+         * else the thread ID; call from the thread's start path, before
+         * anything time-critical.
+         */
+        static void registerThread();
+
+        /**
+         * Set aside a ring for a thread that can't register itself, such as
+         * a host's audio thread; the first unregistered thread to record an
+         * event takes it. Call from a prepare path. Does nothing if the
+         * calling thread already has a ring, or once MaxReservedThreads
+         * rings have been set aside.
+         */
+        static void reserveThread(const juce::String &name);
+
+        /**
+         * Name the calling thread in the trace, registering it if need be.
+         */
+        static void setThreadName(const juce::String &name);
+
+        /**
+         * Write every thread's recorded events as Chrome trace event JSON.
+         * Safe to call while threads are recording; events overwritten
+         * during the dump are left out.
+         */
+        static bool writeChromeJson(const juce::File &file);
+
+        static int64_t now();
+
+    private:
+        struct Event
+        {
+            const char *name{nullptr};
+            int64_t startNs{0};
+            int64_t durationNs{0};
+        };
+
+        struct ThreadBuffer
+        {
+            juce::String threadName;
+            int threadIndex{0};
+            std::vector<Event> events;
+            std::atomic<uint64_t> numRecorded{0};
+            // Reserved rings aren't written until a thread takes them.
+            std::atomic<bool> inUse{false};
+        };
+
+        static ThreadBuffer *&getCurrentBuffer();
+
+        /**
+         * Allocate and register a ring.
+         */
+        static ThreadBuffer *addBuffer(const juce::String &name);
+
+        static std::mutex registryMutex;
+        static std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+        static std::atomic<ThreadBuffer *> reservedBuffer;
+        static int numReserved;
+    };
+
+    //==========================================================================
+
+    class TraceScope
+    {
+    public:
+        explicit TraceScope(const char *name) : name(name), startNs(Trace::now())
+        {
+        }
+
+        ~TraceScope()
+        {
+            Trace::record(name, startNs, Trace::now());
+        }
+
+    private:
+        const char *name;
+        int64_t startNs;
+    };
+}
+
+#endif //ANANASTRACE_H
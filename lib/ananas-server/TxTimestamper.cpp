@@ -0,0 +1,320 @@
+#include "TxTimestamper.h"
+#include "Packet.h"
+#include "Logger.h"
+#if JUCE_LINUX
+#include <fcntl.h>
+#include <ifaddrs.h>
+#include <linux/errqueue.h>
+#include <linux/ethtool.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+namespace ananas
+{
+    TxTimestamper::TxTimestamper(SenderMetrics &metrics)
+        : metrics(metrics)
+    {
+    }
+
+    TxTimestamper::~TxTimestamper()
+    {
+        disable();
+    }
+
+    void TxTimestamper::setMode(const Mode newMode, const int64_t clockOffsetNs)
+    {
+        mode.store(newMode, std::memory_order_relaxed);
+        clockOffset.store(clockOffsetNs, std::memory_order_relaxed);
+    }
+
+    TxTimestamper::Mode TxTimestamper::getMode() const
+    {
+        return mode.load(std::memory_order_relaxed);
+    }
+
+    bool TxTimestamper::isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    uint64_t TxTimestamper::getNumTimestamped() const
+    {
+        return numTimestamped.load(std::memory_order_relaxed);
+    }
+
+    uint64_t TxTimestamper::getNumUnmatched() const
+    {
+        return numUnmatched.load(std::memory_order_relaxed);
+    }
+
+#if JUCE_LINUX
+    bool TxTimestamper::enable(const int socketHandle, const juce::String &interfaceIP)
+    {
+        disable();
+        nextId = 0;
+        haveClockSync = false;
+        lastClockSyncNs = 0;
+
+        const auto m{getMode()};
+        if (m == Mode::off) return false;
+
+        useHardware = m == Mode::hardware && enableHardware(socketHandle, interfaceIP);
+
+        // OPT_ID numbers timestamps from zero, one per datagram sent, from
+        // here on; OPT_TSONLY saves the kernel looping the packet back too.
+        uint32_t flags{SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY};
+        flags |= useHardware
+                     ? SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE
+                     : SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+
+        if (setsockopt(socketHandle, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+            ANANAS_LOG_ERROR("Failed to enable TX timestamping: %s", strerror(errno));
+            return false;
+        }
+
+        ANANAS_LOG_INFO("TX timestamping enabled (%s).", useHardware ? "hardware" : "software");
+        enabled = true;
+        return true;
+    }
+
+    bool TxTimestamper::enableHardware(const int socketHandle, const juce::String &interfaceIP)
+    {
+        // Find the name of the interface with the given address.
+        ifaddrs *addresses;
+        if (getifaddrs(&addresses) < 0) return false;
+
+        juce::String interfaceName;
+        for (auto *a{addresses}; a != nullptr; a = a->ifa_next) {
+            if (a->ifa_addr != nullptr && a->ifa_addr->sa_family == AF_INET) {
+                const auto *in{reinterpret_cast<const sockaddr_in *>(a->ifa_addr)};
+                if (juce::String{inet_ntoa(in->sin_addr)} == interfaceIP) {
+                    interfaceName = a->ifa_name;
+                    break;
+                }
+            }
+        }
+        freeifaddrs(addresses);
+
+        if (interfaceName.isEmpty()) {
+            ANANAS_LOG_WARNING("No interface with address %s; using software TX timestamps.", interfaceIP.toRawUTF8());
+            return false;
+        }
+
+        // Switch on transmit timestamping, leaving the receive filter as it
+        // is, since ptp4l probably depends on it.
+        hwtstamp_config config{};
+        ifreq request{};
+        interfaceName.copyToUTF8(request.ifr_name, IFNAMSIZ);
+        request.ifr_data = reinterpret_cast<char *>(&config);
+
+        if (ioctl(socketHandle, SIOCGHWTSTAMP, &request) < 0) {
+            config = {};
+        }
+        const auto txType{config.tx_type};
+        config.tx_type = HWTSTAMP_TX_ON;
+
+        if (ioctl(socketHandle, SIOCSHWTSTAMP, &request) < 0) {
+            ANANAS_LOG_WARNING("Failed to enable hardware TX timestamping on %s: %s; using software TX timestamps.",
+                               interfaceName.toRawUTF8(), strerror(errno));
+            return false;
+        }
+
+        // For disable() to put back.
+        hardwareInterfaceName = interfaceName;
+        previousTxType = txType;
+
+        // Hardware timestamps are on the NIC's PTP clock, so that's the clock
+        // write times have to be moved to.
+        ethtool_ts_info info{};
+        info.cmd = ETHTOOL_GET_TS_INFO;
+        request.ifr_data = reinterpret_cast<char *>(&info);
+        if (ioctl(socketHandle, SIOCETHTOOL, &request) == 0 && info.phc_index >= 0) {
+            phcHandle = open(("/dev/ptp" + juce::String{info.phc_index}).toRawUTF8(), O_RDONLY);
+        }
+        if (phcHandle < 0) {
+            ANANAS_LOG_WARNING("Can't read the PTP hardware clock of %s; callback-to-wire times won't be recorded.",
+                               interfaceName.toRawUTF8());
+        }
+
+        return true;
+    }
+
+    void TxTimestamper::disable()
+    {
+        enabled = false;
+
+        if (phcHandle >= 0) {
+            close(phcHandle);
+            phcHandle = -1;
+        }
+
+        if (hardwareInterfaceName.isEmpty()) return;
+
+        // Any socket will do for the ioctl; the sender's may be gone.
+        if (const auto fd{socket(AF_INET, SOCK_DGRAM, 0)}; fd >= 0) {
+            hwtstamp_config config{};
+            ifreq request{};
+            hardwareInterfaceName.copyToUTF8(request.ifr_name, IFNAMSIZ);
+            request.ifr_data = reinterpret_cast<char *>(&config);
+
+            // Put back only the transmit side; the receive filter is ptp4l's.
+            if (ioctl(fd, SIOCGHWTSTAMP, &request) == 0) {
+                config.tx_type = previousTxType;
+                if (ioctl(fd, SIOCSHWTSTAMP, &request) < 0) {
+                    ANANAS_LOG_WARNING("Failed to restore hardware TX timestamping on %s: %s",
+                                       hardwareInterfaceName.toRawUTF8(), strerror(errno));
+                }
+            }
+            close(fd);
+        }
+
+        hardwareInterfaceName = {};
+    }
+
+    void TxTimestamper::syncClocks()
+    {
+        if (useHardware && phcHandle < 0) {
+            haveClockSync = false;
+            return;
+        }
+
+        // A PTP hardware clock's ID is derived from its file descriptor, as
+        // FD_TO_CLOCKID() in the kernel's testptp.c.
+        const auto clockId{
+            useHardware
+                ? static_cast<clockid_t>(~static_cast<unsigned int>(phcHandle) << 3 | 3u)
+                : CLOCK_REALTIME
+        };
+        const auto toNs{
+            [](const timespec &ts) { return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec; }
+        };
+
+        timespec before{}, clock{}, after{};
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        if (clock_gettime(clockId, &clock) < 0) {
+            haveClockSync = false;
+            return;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &after);
+
+        // Take the clock to have been read halfway between the other two.
+        timestampClockMinusMonotonicNs = toNs(clock) - (toNs(before) + toNs(after)) / 2;
+        haveClockSync = true;
+    }
+
+    void TxTimestamper::poll(const int socketHandle)
+    {
+        if (!isEnabled()) return;
+
+        if (const auto now{SenderMetrics::now()}; now - lastClockSyncNs >= ClockSyncIntervalNs) {
+            lastClockSyncNs = now;
+            syncClocks();
+        }
+
+        for (;;) {
+            char control[512];
+            msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            if (recvmsg(socketHandle, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+
+            const timespec *wireTime{nullptr};
+            const sock_extended_err *error{nullptr};
+
+            for (auto *c{CMSG_FIRSTHDR(&msg)}; c != nullptr; c = CMSG_NXTHDR(&msg, c)) {
+                if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_TIMESTAMPING) {
+                    // [0] is the software timestamp, [2] raw hardware; [1]
+                    // is unused.
+                    const auto *ts{reinterpret_cast<const timespec *>(CMSG_DATA(c))};
+                    wireTime = useHardware ? &ts[2] : &ts[0];
+                } else if ((c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR) ||
+                           (c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR)) {
+                    error = reinterpret_cast<const sock_extended_err *>(CMSG_DATA(c));
+                }
+            }
+
+            if (wireTime != nullptr && error != nullptr &&
+                error->ee_origin == SO_EE_ORIGIN_TIMESTAMPING &&
+                (wireTime->tv_sec != 0 || wireTime->tv_nsec != 0)) {
+                handleTimestamp(error->ee_data,
+                                static_cast<int64_t>(wireTime->tv_sec) * 1'000'000'000 + wireTime->tv_nsec);
+            }
+        }
+    }
+#else
+    bool TxTimestamper::enable(const int socketHandle, const juce::String &interfaceIP)
+    {
+        juce::ignoreUnused(socketHandle, interfaceIP);
+        if (getMode() != Mode::off) {
+            ANANAS_LOG_WARNING("TX timestamping is only supported on Linux.");
+        }
+        return false;
+    }
+
+    bool TxTimestamper::enableHardware(const int socketHandle, const juce::String &interfaceIP)
+    {
+        juce::ignoreUnused(socketHandle, interfaceIP);
+        return false;
+    }
+
+    void TxTimestamper::disable()
+    {
+        enabled = false;
+    }
+
+    void TxTimestamper::syncClocks()
+    {
+    }
+
+    void TxTimestamper::poll(const int socketHandle)
+    {
+        juce::ignoreUnused(socketHandle);
+    }
+#endif
+
+    void TxTimestamper::addSent(const uint8_t *data, const size_t size, const int64_t writeTimeNs)
+    {
+        if (!isEnabled()) return;
+
+        auto &packet{sent[nextId % sent.size()]};
+        packet.id = nextId++;
+        packet.isAudio = data != nullptr && size >= sizeof(AudioPacket::Header);
+        packet.writeTimeNs = writeTimeNs;
+
+        if (packet.isAudio) {
+            AudioPacket::Header header;
+            memcpy(&header, data, sizeof(AudioPacket::Header));
+            packet.presentationTimeNs = header.timestamp;
+        }
+    }
+
+    void TxTimestamper::handleTimestamp(const uint32_t id, const int64_t wireTimeNs)
+    {
+        const auto &packet{sent[id % sent.size()]};
+
+        // Too old, i.e. overwritten by a later send.
+        if (packet.id != id) {
+            numUnmatched.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        numTimestamped.fetch_add(1, std::memory_order_relaxed);
+        if (!packet.isAudio) return;
+
+        // Presentation times are in the PTP timescale.
+        metrics.wireToPresentation.record(packet.presentationTimeNs - (wireTimeNs + clockOffset.load(std::memory_order_relaxed)));
+
+        if (packet.writeTimeNs > 0 && haveClockSync) {
+            // The write time is monotonic; move it to the timestamp clock.
+            metrics.callbackToWire.record(wireTimeNs - (packet.writeTimeNs + timestampClockMinusMonotonicNs));
+        }
+    }
+}
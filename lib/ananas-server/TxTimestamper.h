@@ -0,0 +1,140 @@
+#ifndef ANANASTXTIMESTAMPER_H
+#define ANANASTXTIMESTAMPER_H
+
+#include <juce_core/juce_core.h>
+#include "Metrics.h"
+
+namespace ananas
+{
+    /**
+     * Kernel (SO_TIMESTAMPING) transmit timestamps for the audio sender's
+     * socket, for measuring when packets actually hit the wire.
+     *
+     * Every datagram written to the socket is registered, in order, with
+     * addSent(); the kernel numbers its timestamps in the same order
+     * (SOF_TIMESTAMPING_OPT_ID), so each one read back from the socket's
+     * error queue by poll() can be matched to the packet (and so its
+     * sequence number), its header (presentation) timestamp and its
+     * audio-callback write time. From
+     * these, SenderMetrics::callbackToWire and
+     * SenderMetrics::wireToPresentation are recorded.
+     *
+     * Linux only. Wire and presentation times can only be compared if the
+     * timestamp clock tracks the PTP timescale: for software timestamps,
+     * CLOCK_REALTIME (e.g. disciplined by phc2sys) plus the clock offset; for
+     * hardware timestamps, the NIC's PTP hardware clock (e.g. disciplined by
+     * ptp4l). Callback and wire times are compared in the timestamp clock's
+     * own timebase, to which write times are moved from CLOCK_MONOTONIC, so
+     * the offset doesn't come into it.
+     */
+    class TxTimestamper
+    {
+    public:
+        enum class Mode : uint8_t
+        {
+            off = 0,
+            software,
+            hardware
+        };
+
+        explicit TxTimestamper(SenderMetrics &metrics);
+
+        ~TxTimestamper();
+
+        /**
+         * Set the mode; takes effect when enable() is next called.
+         * @param clockOffsetNs Added to every kernel timestamp to bring it
+         * into the PTP timescale, for wire-to-presentation times: e.g. the
+         * TAI−UTC offset (37 s, as of writing) for software timestamps from
+         * a UTC system clock, or 0 for hardware timestamps from a PTP
+         * hardware clock that ptp4l keeps on TAI.
+         */
+        void setMode(Mode newMode, int64_t clockOffsetNs);
+
+        [[nodiscard]] Mode getMode() const;
+
+        /**
+         * Enable timestamping on a socket, in the configured mode. Hardware
+         * timestamping needs CAP_NET_ADMIN to switch on the NIC's transmit
+         * timestamping; if that's refused, falls back to software.
+         * @param interfaceIP Address of the interface the socket sends on.
+         * @return false if timestamping could not be enabled at all.
+         */
+        bool enable(int socketHandle, const juce::String &interfaceIP);
+
+        /**
+         * Put the NIC's transmit timestamping back how enable() found it.
+         * Call once the socket is done with, e.g. when the sender stops.
+         */
+        void disable();
+
+        [[nodiscard]] bool isEnabled() const;
+
+        /**
+         * Register a datagram written to the socket.
+         * @param data A serialized AudioPacket, or nullptr for any other
+         * datagram (e.g. FEC parity).
+         * @param writeTimeNs When the audio thread wrote the packet's first
+         * frame; see SenderMetrics::now().
+         */
+        void addSent(const uint8_t *data, size_t size, int64_t writeTimeNs);
+
+        /**
+         * Read any available timestamps from the socket's error queue, and
+         * record metrics for them. Never blocks.
+         */
+        void poll(int socketHandle);
+
+        [[nodiscard]] uint64_t getNumTimestamped() const;
+
+        [[nodiscard]] uint64_t getNumUnmatched() const;
+
+    private:
+        struct SentPacket
+        {
+            uint32_t id{0};
+            bool isAudio{false};
+            int64_t presentationTimeNs{0};
+            int64_t writeTimeNs{0};
+        };
+
+        /**
+         * How often poll() re-measures the timestamp clock against
+         * CLOCK_MONOTONIC.
+         */
+        constexpr static int64_t ClockSyncIntervalNs{100'000'000};
+
+        SenderMetrics &metrics;
+        std::atomic<Mode> mode{Mode::off};
+        std::atomic<int64_t> clockOffset{0};
+        std::atomic<bool> enabled{false};
+        bool useHardware{false};
+
+        // The NIC whose transmit timestamping enable() switched on, and
+        // its tx_type before that.
+        juce::String hardwareInterfaceName;
+        int previousTxType{0};
+        // The NIC's PTP hardware clock, if it has one that can be read.
+        int phcHandle{-1};
+
+        // The timestamp clock minus CLOCK_MONOTONIC, as of lastClockSyncNs;
+        // no write time can be moved to it while that's unknown.
+        bool haveClockSync{false};
+        int64_t timestampClockMinusMonotonicNs{0};
+        int64_t lastClockSyncNs{0};
+
+        std::array<SentPacket, 256> sent{};
+        uint32_t nextId{0};
+
+        std::atomic<uint64_t> numTimestamped{0};
+        std::atomic<uint64_t> numUnmatched{0};
+
+        bool enableHardware(int socketHandle, const juce::String &interfaceIP);
+
+        void syncClocks();
+
+        void handleTimestamp(uint32_t id, int64_t wireTimeNs);
+    };
+}
+
+#endif //ANANASTXTIMESTAMPER_H
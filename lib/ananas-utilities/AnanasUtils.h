@@ -114,6 +114,106 @@ namespace ananas
             inline const static juce::Identifier ClientPercentCPUPropertyID{"percentCPU"};
             inline const static juce::Identifier ClientSecondarySourceCoordinatesPropertyID{"secondarySourceCoordinates"};
 
+            inline const static juce::Identifier RetransmitRequestedPropertyID{"retransmitRequested"};
+            inline const static juce::Identifier RetransmitSentPropertyID{"retransmitSent"};
+            inline const static juce::Identifier RetransmitUnavailablePropertyID{"retransmitUnavailable"};
+            inline const static juce::Identifier RetransmitRateLimitedPropertyID{"retransmitRateLimited"};
+
+            inline const static juce::Identifier ThreadSchedulingPropertyID{"scheduling"};
+            inline const static juce::Identifier ThreadPriorityPropertyID{"priority"};
+            inline const static juce::Identifier ThreadNicenessPropertyID{"niceness"};
+            inline const static juce::Identifier ThreadAffinityPropertyID{"affinity"};
+            inline const static juce::Identifier ThreadPolicyErrorsPropertyID{"errors"};
+
+            inline const static juce::Identifier MetricsFifoResidencyPropertyID{"fifoResidencyNs"};
+            inline const static juce::Identifier MetricsConversionPropertyID{"conversionNs"};
+            inline const static juce::Identifier MetricsSendPropertyID{"sendNs"};
+            inline const static juce::Identifier MetricsInterDeparturePropertyID{"interDepartureNs"};
+            inline const static juce::Identifier MetricsCallbackToWirePropertyID{"callbackToWireNs"};
+            inline const static juce::Identifier MetricsWireToPresentationPropertyID{"wireToPresentationNs"};
+            inline const static juce::Identifier MetricsTimestampErrorPropertyID{"timestampErrorNs"};
+            inline const static juce::Identifier MetricsTimestampStepPropertyID{"timestampStepNs"};
+
+            inline const static juce::Identifier HistogramCountPropertyID{"count"};
+            inline const static juce::Identifier HistogramMinPropertyID{"min"};
+            inline const static juce::Identifier HistogramMeanPropertyID{"mean"};
+            inline const static juce::Identifier HistogramP50PropertyID{"p50"};
+            inline const static juce::Identifier HistogramP90PropertyID{"p90"};
+            inline const static juce::Identifier HistogramP99PropertyID{"p99"};
+            inline const static juce::Identifier HistogramP999PropertyID{"p99.9"};
+            inline const static juce::Identifier HistogramMaxPropertyID{"max"};
+
+            inline const static juce::Identifier ProbePacketsPropertyID{"packets"};
+            inline const static juce::Identifier ProbeBytesPropertyID{"bytes"};
+            inline const static juce::Identifier ProbeGapsPropertyID{"gaps"};
+            inline const static juce::Identifier ProbeRecoveredPropertyID{"recovered"};
+            inline const static juce::Identifier ProbeReorderedPropertyID{"reordered"};
+            inline const static juce::Identifier ProbeDuplicatesPropertyID{"duplicates"};
+            inline const static juce::Identifier ProbeStalePropertyID{"stale"};
+            inline const static juce::Identifier ProbeMalformedPropertyID{"malformed"};
+            inline const static juce::Identifier ProbeTruncatedPropertyID{"truncated"};
+            inline const static juce::Identifier ProbeCorruptPropertyID{"corrupt"};
+            inline const static juce::Identifier ProbeDiscontinuitiesPropertyID{"discontinuities"};
+            inline const static juce::Identifier ProbeUnderflowsPropertyID{"underflows"};
+            inline const static juce::Identifier ProbeOverflowsPropertyID{"overflows"};
+            inline const static juce::Identifier ProbeTimestampStepsPropertyID{"timestampSteps"};
+            inline const static juce::Identifier ProbeJitterPropertyID{"jitterNs"};
+            inline const static juce::Identifier ProbeTransitPropertyID{"transitNs"};
+            inline const static juce::Identifier ProbeTransitDeltaPropertyID{"transitDeltaNs"};
+            inline const static juce::Identifier ProbeHeadroomPropertyID{"headroomNs"};
+
+            inline const static juce::Identifier CaptureFilePropertyID{"file"};
+            inline const static juce::Identifier CapturePacketsPropertyID{"packets"};
+            inline const static juce::Identifier CaptureBytesPropertyID{"bytes"};
+            inline const static juce::Identifier CaptureDroppedPropertyID{"dropped"};
+            inline const static juce::Identifier CaptureFailedPropertyID{"failed"};
+
+            inline const static juce::Identifier ImpairmentLossPropertyID{"loss"};
+            inline const static juce::Identifier ImpairmentBurstProbabilityPropertyID{"burstProbability"};
+            inline const static juce::Identifier ImpairmentBurstLengthPropertyID{"burstLength"};
+            inline const static juce::Identifier ImpairmentDuplicatePropertyID{"duplicate"};
+            inline const static juce::Identifier ImpairmentReorderPropertyID{"reorder"};
+            inline const static juce::Identifier ImpairmentReorderDelayPropertyID{"reorderMs"};
+            inline const static juce::Identifier ImpairmentDelayPropertyID{"delayMs"};
+            inline const static juce::Identifier ImpairmentJitterPropertyID{"jitterMs"};
+            inline const static juce::Identifier ImpairmentStepsPropertyID{"steps"};
+            inline const static juce::Identifier ImpairmentDurationPropertyID{"duration"};
+            inline const static juce::Identifier ImpairmentLoopPropertyID{"loop"};
+            inline const static juce::Identifier ImpairmentSeedPropertyID{"seed"};
+            inline const static juce::Identifier ImpairmentStepPropertyID{"step"};
+            inline const static juce::Identifier ImpairmentDatagramsPropertyID{"datagrams"};
+            inline const static juce::Identifier ImpairmentLostPropertyID{"lost"};
+            inline const static juce::Identifier ImpairmentBurstLostPropertyID{"burstLost"};
+            inline const static juce::Identifier ImpairmentDuplicatedPropertyID{"duplicated"};
+            inline const static juce::Identifier ImpairmentReorderedPropertyID{"reordered"};
+            inline const static juce::Identifier ImpairmentOverflowedPropertyID{"overflowed"};
+
+            inline const static juce::Identifier FifoCapacityPropertyID{"capacity"};
+            inline const static juce::Identifier FifoFillPropertyID{"fill"};
+            inline const static juce::Identifier FifoOverflowsPropertyID{"overflows"};
+            inline const static juce::Identifier FifoOverflowFramesPropertyID{"overflowFrames"};
+            inline const static juce::Identifier FifoUnderflowsPropertyID{"underflows"};
+            inline const static juce::Identifier FifoUnderflowFramesPropertyID{"underflowFrames"};
+
+            inline const static juce::Identifier InlineSendActivePropertyID{"active"};
+            inline const static juce::Identifier InlineSendPacketsPropertyID{"packets"};
+            inline const static juce::Identifier InlineSendDeferredPropertyID{"deferred"};
+            inline const static juce::Identifier InlineSendContendedPropertyID{"contended"};
+
+            inline const static juce::Identifier StreamerBlocksPropertyID{"blocks"};
+            inline const static juce::Identifier StreamerResyncsPropertyID{"resyncs"};
+
+            inline const static juce::Identifier PtpClockLockedPropertyID{"locked"};
+            inline const static juce::Identifier PtpClockRatePpmPropertyID{"ratePpm"};
+            inline const static juce::Identifier PtpClockTimestampsPropertyID{"timestamps"};
+            inline const static juce::Identifier PtpClockResetsPropertyID{"resets"};
+
+            inline const static juce::Identifier JackCyclesPropertyID{"cycles"};
+            inline const static juce::Identifier JackXrunsPropertyID{"xruns"};
+            inline const static juce::Identifier JackBufferSizePropertyID{"bufferSize"};
+            inline const static juce::Identifier JackSampleRatePropertyID{"sampleRate"};
+            inline const static juce::Identifier JackCpuLoadPropertyID{"cpuLoad"};
+
             inline const static juce::Identifier ModulesParamID{"Modules"};
 
             inline const static juce::Identifier ModuleSecondarySource0xPropertyID{"ModuleSecondarySource0x"};
@@ -24,12 +24,36 @@ PluginProcessor::~PluginProcessor()
 
 void PluginProcessor::prepareToPlay(const double sampleRate, const int samplesPerBlock)
 {
+    // Hosts say whether they're rendering offline before preparing. If so,
+    // record what would be sent to a new file, as fast as the host renders,
+    // rather than sending it at wire speed.
+    if (isNonRealtime() || server->isRenderingOffline()) {
+        server->releaseResources();
+        server->setOfflineRenderFile(isNonRealtime() ? ananas::OfflineRender::createDefaultFile(getName()) : juce::File{});
+    }
+
     server->prepareToPlay(samplesPerBlock, sampleRate);
+    preparedSampleRate = sampleRate;
+    preparedBlockSize = samplesPerBlock;
 }
 
 void PluginProcessor::releaseResources()
 {
     server->releaseResources();
+    preparedSampleRate = 0.;
+    preparedBlockSize = 0;
+}
+
+void PluginProcessor::setNonRealtime(const bool nonRealtime) noexcept
+{
+    const auto wasNonRealtime{isNonRealtime()};
+    AudioProcessor::setNonRealtime(nonRealtime);
+
+    // Not every host prepares again between switching to offline rendering
+    // and back; if already prepared, switch the server over now.
+    if (nonRealtime != wasNonRealtime && preparedBlockSize > 0) {
+        prepareToPlay(preparedSampleRate, preparedBlockSize);
+    }
 }
 
 void PluginProcessor::processBlock(juce::AudioBuffer<float> &buffer, juce::MidiBuffer &midiMessages)
@@ -17,6 +17,8 @@ public:
 
     void releaseResources() override;
 
+    void setNonRealtime(bool nonRealtime) noexcept override;
+
     void processBlock(juce::AudioBuffer<float> &buffer, juce::MidiBuffer &midiMessages) override;
 
     void processBlock(juce::AudioBuffer<double> &buffer, juce::MidiBuffer &midiMessages) override;
@@ -72,6 +74,10 @@ private:
 
     std::unique_ptr<ananas::Server::Server> server;
 
+    // What the host last prepared with; zero if released.
+    double preparedSampleRate{0.};
+    int preparedBlockSize{0};
+
     // For handling data that is not known until runtime.
     juce::ValueTree dynamicTree;
     // For handling user-entered data that should be storable/retrievable.
@@ -0,0 +1,87 @@
+#include "BenchmarkRunner.h"
+#include <ServerUtils.h>
+
+namespace ananas::Bench
+{
+    void BenchmarkRunner::add(const juce::String &name, const juce::var &params, Body body)
+    {
+        benchmarks.push_back({name, params, std::move(body)});
+    }
+
+    juce::var BenchmarkRunner::run(const Options &options) const
+    {
+        juce::Array<juce::var> results;
+
+        for (const auto &b: benchmarks) {
+            if (options.filter.isNotEmpty() && !b.name.contains(options.filter)) continue;
+
+            std::cerr << b.name << " " << juce::JSON::toString(b.params, true) << "... " << std::flush;
+
+            // Grow the iteration count until a run takes long enough to time
+            // reliably.
+            juce::DynamicObject counters;
+            const auto targetMs{options.minTimeMs / options.numRepetitions};
+            juce::uint64 numIterations{1};
+            for (;;) {
+                const auto ns{timeRun(b.body, numIterations, counters)};
+                if (ns / 1e6 >= targetMs || numIterations >= (juce::uint64{1} << 40)) break;
+                const auto scale{ns > 0 ? targetMs * 1e6 / ns * 1.2 : 10.};
+                numIterations = std::max(numIterations + 1, static_cast<juce::uint64>(static_cast<double>(numIterations) * juce::jlimit(1.5, 10., scale)));
+            }
+
+            std::vector<double> nsPerOp;
+            for (int r{0}; r < options.numRepetitions; ++r) {
+                nsPerOp.push_back(timeRun(b.body, numIterations, counters) / static_cast<double>(numIterations));
+            }
+            std::sort(nsPerOp.begin(), nsPerOp.end());
+            const auto median{nsPerOp[nsPerOp.size() / 2]};
+
+            const auto result{new juce::DynamicObject()};
+            result->setProperty("name", b.name);
+            result->setProperty("params", b.params);
+            result->setProperty("iterations", static_cast<juce::int64>(numIterations));
+            result->setProperty("repetitions", options.numRepetitions);
+            result->setProperty("nsPerOpMedian", median);
+            result->setProperty("nsPerOpMin", nsPerOp.front());
+            result->setProperty("nsPerOpMax", nsPerOp.back());
+            result->setProperty("counters", new juce::DynamicObject(counters));
+            results.add(result);
+
+            std::cerr << juce::String{median, 1} << " ns/op" << std::endl;
+        }
+
+        const auto context{new juce::DynamicObject()};
+        context->setProperty("time", juce::Time::getCurrentTime().toISO8601(true));
+        context->setProperty("host", juce::SystemStats::getComputerName());
+        context->setProperty("cpu", juce::SystemStats::getCpuModel());
+        context->setProperty("numCpus", juce::SystemStats::getNumCpus());
+        context->setProperty("framesPerPacket", static_cast<int>(Server::Constants::FramesPerPacket));
+#if JUCE_DEBUG
+        context->setProperty("build", "debug");
+#else
+        context->setProperty("build", "release");
+#endif
+
+        const auto output{new juce::DynamicObject()};
+        output->setProperty("context", context);
+        output->setProperty("benchmarks", results);
+        return output;
+    }
+
+    juce::var BenchmarkRunner::makeParams(const std::initializer_list<std::pair<juce::Identifier, juce::var>> params)
+    {
+        const auto object{new juce::DynamicObject()};
+        for (const auto &[name, value]: params) {
+            object->setProperty(name, value);
+        }
+        return object;
+    }
+
+    double BenchmarkRunner::timeRun(const Body &body, const juce::uint64 numIterations, juce::DynamicObject &counters)
+    {
+        const auto start{std::chrono::steady_clock::now()};
+        body(numIterations, counters);
+        const auto end{std::chrono::steady_clock::now()};
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+}
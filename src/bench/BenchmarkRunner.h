@@ -0,0 +1,73 @@
+#ifndef ANANASBENCHMARKRUNNER_H
+#define ANANASBENCHMARKRUNNER_H
+
+#include <juce_core/juce_core.h>
+
+namespace ananas::Bench
+{
+    /**
+     * Keep the compiler from optimising away a value that a benchmark
+     * computes but doesn't otherwise use.
+     */
+    template<typename T>
+    void doNotOptimise(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /**
+     * A minimal micro-benchmark harness. Each benchmark body is run for a
+     * given number of iterations; the runner grows the iteration count until
+     * one run takes long enough to time reliably, then times several runs
+     * and reports the median, minimum and maximum time per iteration.
+     */
+    class BenchmarkRunner
+    {
+    public:
+        /**
+         * @param numIterations Run the operation this many times.
+         * @param counters Anything else worth reporting, e.g. a compression
+         * ratio.
+         */
+        using Body = std::function<void(juce::uint64 numIterations, juce::DynamicObject &counters)>;
+
+        struct Options
+        {
+            /**
+             * Only run benchmarks whose names contain this.
+             */
+            juce::String filter;
+            double minTimeMs{50.};
+            int numRepetitions{5};
+        };
+
+        /**
+         * @param name E.g. "Fifo/write+read".
+         * @param params Describes this instance, e.g. channel count; part of
+         * the result's identity when comparing runs.
+         */
+        void add(const juce::String &name, const juce::var &params, Body body);
+
+        /**
+         * Run the matching benchmarks, printing progress to stderr.
+         * @return Every result, and a description of the machine, as JSON.
+         */
+        juce::var run(const Options &options) const;
+
+        static juce::var makeParams(std::initializer_list<std::pair<juce::Identifier, juce::var>> params);
+
+    private:
+        struct Benchmark
+        {
+            juce::String name;
+            juce::var params;
+            Body body;
+        };
+
+        std::vector<Benchmark> benchmarks;
+
+        static double timeRun(const Body &body, juce::uint64 numIterations, juce::DynamicObject &counters);
+    };
+}
+
+#endif //ANANASBENCHMARKRUNNER_H
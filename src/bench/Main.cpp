@@ -0,0 +1,555 @@
+#include <juce_core/juce_core.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_events/juce_events.h>
+#include <AudioStream.h>
+#include <ClientInfo.h>
+#include <Codec.h>
+#include <DatagramBatch.h>
+#include <Fec.h>
+#include <Fifo.h>
+#include <Logger.h>
+#include <Packet.h>
+#include <SwitchInfo.h>
+#include <thread>
+
+#include "BenchmarkRunner.h"
+
+using namespace ananas;
+using namespace ananas::Bench;
+
+namespace
+{
+    constexpr double SampleRate{48000.};
+    const auto FramesPerPacket{static_cast<int>(Server::Constants::FramesPerPacket)};
+
+    /**
+     * Band-limited-ish test signal; noise compresses unrealistically badly,
+     * silence unrealistically well.
+     */
+    void fillWithTestSignal(juce::AudioBuffer<float> &buffer, juce::Random &random)
+    {
+        for (auto ch{0}; ch < buffer.getNumChannels(); ++ch) {
+            auto *data{buffer.getWritePointer(ch)};
+            const auto frequency{110. * (ch + 1)};
+            for (auto i{0}; i < buffer.getNumSamples(); ++i) {
+                const auto t{static_cast<double>(i) / SampleRate};
+                data[i] = static_cast<float>(.5 * std::sin(juce::MathConstants<double>::twoPi * frequency * t)
+                                             + .01 * (random.nextDouble() * 2. - 1.));
+            }
+        }
+    }
+
+    ClientAnnouncePacket makeClientAnnouncePacket(const juce::uint32 serial)
+    {
+        ClientAnnouncePacket packet{};
+        packet.serial = serial;
+        packet.samplingRate = static_cast<float>(SampleRate);
+        packet.percentCPU = 12.5f;
+        packet.presentationOffsetFrame = 256;
+        packet.presentationOffsetNs = 5333333;
+        packet.audioPTPOffsetNs = 1200;
+        packet.bufferFillPercent = 50;
+        packet.ptpLock = true;
+        return packet;
+    }
+
+    juce::var makeSwitchResponse(const int offset)
+    {
+        const auto info{new juce::DynamicObject()};
+        info->setProperty(Utils::Identifiers::SwitchClockIdPropertyId, "00:11:22:ff:fe:33:44:55");
+        info->setProperty(Utils::Identifiers::SwitchFreqDriftPropertyId, -1234);
+        info->setProperty(Utils::Identifiers::SwitchOffsetPropertyId, offset);
+        info->setProperty(Utils::Identifiers::SwitchIAmGmPropertyId, false);
+        info->setProperty(Utils::Identifiers::SwitchSlavePortPropertyId, "ether1");
+        juce::Array<juce::var> response;
+        response.add(info);
+        return response;
+    }
+
+    void addFifoBenchmarks(BenchmarkRunner &runner)
+    {
+        for (const auto numChannels: {2, 16, 64}) {
+            for (const auto blockSize: {32, 128, 512}) {
+                runner.add("Fifo/write+read",
+                           BenchmarkRunner::makeParams({{"channels", numChannels}, {"blockSize", blockSize}}),
+                           [numChannels, blockSize](const juce::uint64 n, juce::DynamicObject &counters)
+                           {
+                               // One host block in, then as many packets out
+                               // as the audio sender would read.
+                               Fifo fifo{static_cast<uint8_t>(numChannels)};
+                               fifo.prepare(blockSize, SampleRate);
+                               juce::AudioBuffer<float> block{numChannels, blockSize};
+                               juce::Random random{1};
+                               fillWithTestSignal(block, random);
+                               std::vector<uint8_t> packet(numChannels * FramesPerPacket * sizeof(int16_t));
+
+                               for (juce::uint64 i{0}; i < n; ++i) {
+                                   fifo.write(&block);
+                                   for (auto p{0}; p < blockSize / FramesPerPacket; ++p) {
+                                       fifo.read(packet.data(), FramesPerPacket);
+                                   }
+                                   doNotOptimise(packet[0]);
+                               }
+
+                               counters.setProperty("framesPerOp", blockSize);
+                           });
+            }
+        }
+
+        for (const auto numChannels: {2, 64}) {
+            runner.add("Fifo/write+overflow",
+                       BenchmarkRunner::makeParams({{"channels", numChannels}, {"blockSize", 512}}),
+                       [numChannels](const juce::uint64 n, juce::DynamicObject &counters)
+                       {
+                           // Nothing reads, so every write after the first
+                           // few overflows, as if the sender had stalled.
+                           Fifo fifo{static_cast<uint8_t>(numChannels)};
+                           fifo.prepare(512, SampleRate);
+                           fifo.setPolicies(Fifo::OverflowPolicy::dropOldest, Fifo::UnderflowPolicy::wait);
+                           juce::AudioBuffer<float> block{numChannels, 512};
+                           juce::Random random{1};
+                           fillWithTestSignal(block, random);
+
+                           for (juce::uint64 i{0}; i < n; ++i) {
+                               fifo.write(&block);
+                           }
+
+                           counters.setProperty("overflows", fifo.getStats()[Utils::Identifiers::FifoOverflowsPropertyID]);
+                       });
+        }
+    }
+
+    void addPacketBenchmarks(BenchmarkRunner &runner)
+    {
+        runner.add("AudioPacket/writeHeader", BenchmarkRunner::makeParams({{"channels", 2}}),
+                   [](const juce::uint64 n, juce::DynamicObject &)
+                   {
+                       AudioPacket packet;
+                       packet.prepare(2, FramesPerPacket, SampleRate);
+                       for (juce::uint64 i{0}; i < n; ++i) {
+                           packet.writeHeader();
+                           doNotOptimise(packet.getTime());
+                       }
+                   });
+
+        runner.add("AudioPacket/setTime", BenchmarkRunner::makeParams({{"channels", 2}}),
+                   [](const juce::uint64 n, juce::DynamicObject &)
+                   {
+                       // Track the packet clock, as a locked PTP follow-up
+                       // would, so that only the in-range path is measured.
+                       AudioPacket packet;
+                       packet.prepare(2, FramesPerPacket, SampleRate);
+                       const auto nsPerPacket{Server::Constants::NSPS * FramesPerPacket / static_cast<int>(SampleRate)};
+                       int64_t ns{Server::Constants::NSPS};
+                       int64_t diffNs;
+                       for (juce::uint64 i{0}; i < n; ++i) {
+                           packet.writeHeader();
+                           ns += nsPerPacket;
+                           const auto ptpNs{ns - Server::Constants::PacketOffsetNs};
+                           packet.setTime({static_cast<time_t>(ptpNs / Server::Constants::NSPS),
+                                           static_cast<long>(ptpNs % Server::Constants::NSPS)},
+                                          diffNs);
+                           doNotOptimise(diffNs);
+                       }
+                   });
+    }
+
+    /**
+     * Callback-to-send latency, threaded against inline; see
+     * Server::setInlineSendEnabled(). Packets go over loopback to a socket
+     * that never reads, so the kernel drops them once its buffer fills,
+     * without the send ever blocking.
+     */
+    void addSendBenchmarks(BenchmarkRunner &runner)
+    {
+        const auto setLatencyCounters{
+            [](const SenderMetrics &metrics, juce::DynamicObject &counters)
+            {
+                counters.setProperty("latencyP50Ns", static_cast<juce::int64>(metrics.fifoResidency.getValueAtPercentile(50.)));
+                counters.setProperty("latencyP99Ns", static_cast<juce::int64>(metrics.fifoResidency.getValueAtPercentile(99.)));
+                counters.setProperty("latencyMaxNs", static_cast<juce::int64>(metrics.fifoResidency.getMax()));
+            }
+        };
+
+        for (const auto numChannels: {2, 16}) {
+            for (const auto blockSize: {FramesPerPacket, 4 * FramesPerPacket}) {
+                const auto params{BenchmarkRunner::makeParams({{"channels", numChannels}, {"blockSize", blockSize}})};
+
+                runner.add("Send/threaded", params,
+                           [numChannels, blockSize, setLatencyCounters](const juce::uint64 n, juce::DynamicObject &counters)
+                           {
+                               // The audio sender's path: the write wakes a
+                               // sender thread, which reads and sends. The
+                               // "audio thread" waits for each block to go,
+                               // so that every wake-up is timed.
+                               juce::DatagramSocket receiver;
+                               receiver.bindToPort(0, "127.0.0.1");
+                               const auto port{receiver.getBoundPort()};
+                               juce::DatagramSocket socket;
+
+                               AudioStream stream{{"bench", static_cast<uint>(numChannels), "127.0.0.1", static_cast<juce::uint16>(port)}};
+                               stream.prepare(blockSize, SampleRate);
+                               juce::WaitableEvent ready;
+                               stream.getFifo().setReadyEvent(&ready);
+                               juce::AudioBuffer<float> block{numChannels, blockSize};
+                               juce::Random random{1};
+                               fillWithTestSignal(block, random);
+
+                               SenderMetrics metrics;
+                               std::atomic<juce::uint64> numSent{0};
+                               std::atomic<bool> stop{false};
+                               std::thread sender{
+                                   [&]
+                                   {
+                                       while (!stop.load()) {
+                                           if (!stream.isReady()) {
+                                               ready.wait(10);
+                                               continue;
+                                           }
+                                           size_t size;
+                                           int64_t writeTimeNs;
+                                           const auto *data{stream.readPacket(size, writeTimeNs)};
+                                           if (data == nullptr) continue;
+                                           socket.write("127.0.0.1", port, data, static_cast<int>(size));
+                                           metrics.fifoResidency.record(SenderMetrics::now() - writeTimeNs);
+                                           numSent.fetch_add(1);
+                                       }
+                                   }
+                               };
+
+                               const auto packetsPerBlock{static_cast<juce::uint64>(blockSize / FramesPerPacket)};
+                               for (juce::uint64 i{0}; i < n; ++i) {
+                                   stream.getFifo().write(&block);
+                                   while (numSent.load() < (i + 1) * packetsPerBlock) {
+                                       std::this_thread::yield();
+                                   }
+                               }
+
+                               stop = true;
+                               ready.signal();
+                               sender.join();
+
+                               setLatencyCounters(metrics, counters);
+                           });
+
+                runner.add("Send/inline", params,
+                           [numChannels, blockSize, setLatencyCounters](const juce::uint64 n, juce::DynamicObject &counters)
+                           {
+                               // The inline path: the writing thread reads
+                               // and sends, in one sendmmsg().
+                               juce::DatagramSocket receiver;
+                               receiver.bindToPort(0, "127.0.0.1");
+                               const auto port{receiver.getBoundPort()};
+                               juce::DatagramSocket socket;
+
+                               AudioStream stream{{"bench", static_cast<uint>(numChannels), "127.0.0.1", static_cast<juce::uint16>(port)}};
+                               stream.prepare(blockSize, SampleRate);
+                               juce::AudioBuffer<float> block{numChannels, blockSize};
+                               juce::Random random{1};
+                               fillWithTestSignal(block, random);
+
+                               SenderMetrics metrics;
+                               DatagramBatch batch{metrics};
+                               batch.prepare(Server::Constants::InlineSendMaxPackets,
+                                             AudioStream::getMaxPacketSize(static_cast<uint>(numChannels)),
+                                             "127.0.0.1",
+                                             port);
+                               juce::uint64 numDeferred{0};
+
+                               for (juce::uint64 i{0}; i < n; ++i) {
+                                   stream.getFifo().write(&block);
+                                   while (!batch.isFull() && stream.getFifo().isReady(FramesPerPacket)) {
+                                       size_t size;
+                                       int64_t writeTimeNs;
+                                       const auto *data{stream.readPacket(size, writeTimeNs)};
+                                       batch.add(data, size, writeTimeNs);
+                                   }
+                                   batch.send(socket.getRawSocketHandle());
+
+                                   // Nothing to hand them to; count them.
+                                   const uint8_t *data;
+                                   size_t size;
+                                   int64_t writeTimeNs;
+                                   while (batch.pop(data, size, writeTimeNs)) {
+                                       ++numDeferred;
+                                   }
+                               }
+
+                               setLatencyCounters(metrics, counters);
+                               counters.setProperty("deferred", static_cast<juce::int64>(numDeferred));
+                           });
+            }
+        }
+    }
+
+    void addConversionBenchmarks(BenchmarkRunner &runner)
+    {
+        for (const auto numChannels: {2, 16, 64}) {
+            runner.add("FormatConverter/float32ToInt16",
+                       BenchmarkRunner::makeParams({{"channels", numChannels}, {"frames", FramesPerPacket}}),
+                       [numChannels](const juce::uint64 n, juce::DynamicObject &)
+                       {
+                           // One packet's worth, as per Fifo::read().
+                           FormatConverter converter{numChannels, numChannels};
+                           juce::AudioBuffer<float> src{numChannels, FramesPerPacket};
+                           juce::Random random{1};
+                           fillWithTestSignal(src, random);
+                           std::vector<uint8_t> dest(numChannels * FramesPerPacket * sizeof(int16_t));
+
+                           for (juce::uint64 i{0}; i < n; ++i) {
+                               for (auto ch{0}; ch < numChannels; ++ch) {
+                                   converter.convertSamples(dest.data(), ch, src.getReadPointer(ch), 0, FramesPerPacket);
+                               }
+                               doNotOptimise(dest[0]);
+                           }
+                       });
+        }
+    }
+
+    void addCodecBenchmarks(BenchmarkRunner &runner)
+    {
+        for (const auto numChannels: {2, 16, 64}) {
+            // Shared by encode and decode.
+            const auto makeInput{
+                [numChannels]
+                {
+                    Fifo fifo{static_cast<uint8_t>(numChannels)};
+                    fifo.prepare(FramesPerPacket, SampleRate);
+                    juce::AudioBuffer<float> block{numChannels, FramesPerPacket};
+                    juce::Random random{1};
+                    fillWithTestSignal(block, random);
+                    fifo.write(&block);
+                    std::vector<uint8_t> packet(numChannels * FramesPerPacket * sizeof(int16_t));
+                    fifo.read(packet.data(), FramesPerPacket);
+                    return packet;
+                }
+            };
+
+            runner.add("AudioCodec/encode", BenchmarkRunner::makeParams({{"channels", numChannels}}),
+                       [numChannels, makeInput](const juce::uint64 n, juce::DynamicObject &counters)
+                       {
+                           AudioCodec codec;
+                           codec.prepare(static_cast<uint>(numChannels), FramesPerPacket);
+                           const auto input{makeInput()};
+                           std::vector<uint8_t> encoded(codec.getMaxEncodedSize());
+                           size_t size{0};
+
+                           for (juce::uint64 i{0}; i < n; ++i) {
+                               size = codec.encode(input.data(), encoded.data());
+                               doNotOptimise(size);
+                           }
+
+                           // Of one packet of the synthetic test signal; see
+                           // AudioCodec/file for real material.
+                           counters.setProperty("ratio", static_cast<double>(size) / static_cast<double>(input.size()));
+                       });
+
+            runner.add("AudioCodec/decode", BenchmarkRunner::makeParams({{"channels", numChannels}}),
+                       [numChannels, makeInput](const juce::uint64 n, juce::DynamicObject &)
+                       {
+                           AudioCodec codec;
+                           codec.prepare(static_cast<uint>(numChannels), FramesPerPacket);
+                           const auto input{makeInput()};
+                           std::vector<uint8_t> encoded(codec.getMaxEncodedSize());
+                           const auto size{codec.encode(input.data(), encoded.data())};
+                           std::vector<uint8_t> decoded(input.size());
+
+                           for (juce::uint64 i{0}; i < n; ++i) {
+                               const auto ok{codec.decode(encoded.data(), size, decoded.data())};
+                               doNotOptimise(ok);
+                           }
+                       });
+        }
+
+        runner.add("FecEncoder/addPacket", BenchmarkRunner::makeParams({{"channels", 16}, {"k", 8}, {"m", 2}}),
+                   [](const juce::uint64 n, juce::DynamicObject &)
+                   {
+                       const auto size{sizeof(AudioPacket::Header) + 16 * FramesPerPacket * sizeof(int16_t)};
+                       FecEncoder fec;
+                       fec.prepare(8, 2, size);
+                       std::vector<uint8_t> packet(size, 0x5a);
+
+                       for (juce::uint64 i{0}; i < n; ++i) {
+                           const auto complete{fec.addPacket(packet.data(), packet.size())};
+                           doNotOptimise(complete);
+                       }
+                   });
+    }
+
+    /**
+     * Not a timing: each op encodes every whole packet of an audio file, and reports the encoded size as a fraction of
+     * the raw int16 audio ("ratio") and the fraction of packets that fell
+     * back to raw ("rawFraction").
+     */
+    void addCodecFileBenchmark(BenchmarkRunner &runner, const juce::File &file)
+    {
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+        const std::shared_ptr<juce::AudioFormatReader> reader{formatManager.createReaderFor(file)};
+        if (reader == nullptr) {
+            std::cerr << "Can't read " << file.getFullPathName() << "; skipping AudioCodec/file" << std::endl;
+            return;
+        }
+
+        // Fifo's channel count is a uint8_t.
+        const auto numChannels{juce::jmin(static_cast<int>(reader->numChannels), 255)};
+        const auto numPackets{reader->lengthInSamples / FramesPerPacket};
+
+        runner.add("AudioCodec/file",
+                   BenchmarkRunner::makeParams({{"file", file.getFileName()}, {"channels", numChannels}, {"packets", numPackets}}),
+                   [reader, numChannels, numPackets](const juce::uint64 n, juce::DynamicObject &counters)
+                   {
+                       constexpr int PacketsPerRead{256};
+
+                       AudioCodec codec;
+                       codec.prepare(static_cast<uint>(numChannels), FramesPerPacket);
+                       Fifo fifo{static_cast<uint8_t>(numChannels)};
+                       fifo.prepare(PacketsPerRead * FramesPerPacket, reader->sampleRate);
+                       juce::AudioBuffer<float> block{numChannels, PacketsPerRead * FramesPerPacket};
+                       std::vector<uint8_t> packet(static_cast<size_t>(numChannels * FramesPerPacket) * sizeof(int16_t));
+                       std::vector<uint8_t> encoded(codec.getMaxEncodedSize());
+                       size_t encodedBytes{0}, rawBytes{0};
+                       juce::int64 numRaw{0};
+
+                       for (juce::uint64 i{0}; i < n; ++i) {
+                           for (juce::int64 p{0}; p < numPackets; p += PacketsPerRead) {
+                               const auto numToRead{static_cast<int>(juce::jmin(juce::int64{PacketsPerRead}, numPackets - p))};
+                               block.setSize(numChannels, numToRead * FramesPerPacket, false, false, true);
+                               reader->read(&block, 0, block.getNumSamples(), p * FramesPerPacket, true, true);
+                               fifo.write(&block);
+
+                               for (auto j{0}; j < numToRead; ++j) {
+                                   fifo.read(packet.data(), FramesPerPacket);
+                                   const auto size{codec.encode(packet.data(), encoded.data())};
+                                   encodedBytes += size;
+                                   rawBytes += packet.size();
+                                   numRaw += encoded[0] == static_cast<uint8_t>(AudioCodec::Mode::raw) ? 1 : 0;
+                               }
+                           }
+                       }
+
+                       counters.setProperty("ratio", static_cast<double>(encodedBytes) / static_cast<double>(juce::jmax(size_t{1}, rawBytes)));
+                       counters.setProperty("rawFraction",
+                                            static_cast<double>(numRaw) / static_cast<double>(juce::jmax(juce::uint64{1}, n * static_cast<juce::uint64>(numPackets))));
+                   });
+    }
+
+    void addClientListBenchmarks(BenchmarkRunner &runner)
+    {
+        for (const auto numClients: {10, 100, 1000}) {
+            runner.add("ClientList/handlePacket", BenchmarkRunner::makeParams({{"clients", numClients}}),
+                       [numClients](const juce::uint64 n, juce::DynamicObject &)
+                       {
+                           // Announcements from clients that are already
+                           // known; the steady state.
+                           ClientList clients;
+                           juce::StringArray ips;
+                           std::vector<ClientAnnouncePacket> packets;
+                           for (auto c{0}; c < numClients; ++c) {
+                               ips.add("192.168." + juce::String{c / 256 + 10} + "." + juce::String{c % 256});
+                               packets.push_back(makeClientAnnouncePacket(static_cast<juce::uint32>(c)));
+                               clients.handlePacket(ips[c], &packets.back());
+                           }
+
+                           for (juce::uint64 i{0}; i < n; ++i) {
+                               const auto c{static_cast<int>(i % static_cast<juce::uint64>(numClients))};
+                               clients.handlePacket(ips[c], &packets[static_cast<size_t>(c)]);
+                           }
+                       });
+
+            runner.add("ClientList/toVar", BenchmarkRunner::makeParams({{"clients", numClients}}),
+                       [numClients](const juce::uint64 n, juce::DynamicObject &)
+                       {
+                           ClientList clients;
+                           for (auto c{0}; c < numClients; ++c) {
+                               const auto packet{makeClientAnnouncePacket(static_cast<juce::uint32>(c))};
+                               clients.handlePacket("192.168." + juce::String{c / 256 + 10} + "." + juce::String{c % 256}, &packet);
+                           }
+
+                           for (juce::uint64 i{0}; i < n; ++i) {
+                               const auto v{clients.toVar()};
+                               doNotOptimise(v.getDynamicObject());
+                           }
+                       });
+        }
+    }
+
+    void addSwitchListBenchmarks(BenchmarkRunner &runner)
+    {
+        for (const auto numSwitches: {1, 8}) {
+            runner.add("SwitchList/handleResponse", BenchmarkRunner::makeParams({{"switches", numSwitches}}),
+                       [numSwitches](const juce::uint64 n, juce::DynamicObject &)
+                       {
+                           SwitchList switches;
+                           std::vector<juce::Identifier> ids;
+                           std::vector<juce::var> responses;
+                           for (auto s{0}; s < numSwitches; ++s) {
+                               ids.emplace_back("switch" + juce::String{s});
+                               responses.push_back(makeSwitchResponse(s * 10));
+                               switches.handleResponse(ids.back(), responses.back());
+                           }
+
+                           for (juce::uint64 i{0}; i < n; ++i) {
+                               const auto s{static_cast<size_t>(i % static_cast<juce::uint64>(numSwitches))};
+                               switches.handleResponse(ids[s], responses[s]);
+                           }
+                       });
+        }
+    }
+}
+
+int main(const int argc, char *argv[])
+{
+    // ClientList and SwitchList need a message manager for their
+    // timers and change messages, though none are dispatched.
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    // Keep "Client x connected." etc. out of the timings and the output.
+    Logger::setLevel(Logger::Level::warning);
+
+    BenchmarkRunner::Options options;
+    juce::File outputFile, codecFile;
+
+    for (auto i{1}; i < argc; ++i) {
+        const juce::String arg{argv[i]};
+        if (arg.startsWith("--filter=")) {
+            options.filter = arg.fromFirstOccurrenceOf("=", false, false);
+        } else if (arg.startsWith("--output=") || arg.startsWith("-o=")) {
+            outputFile = juce::File::getCurrentWorkingDirectory().getChildFile(arg.fromFirstOccurrenceOf("=", false, false));
+        } else if (arg.startsWith("--min-time=")) {
+            options.minTimeMs = juce::jmax(1., arg.fromFirstOccurrenceOf("=", false, false).getDoubleValue());
+        } else if (arg.startsWith("--repetitions=")) {
+            options.numRepetitions = juce::jmax(1, arg.fromFirstOccurrenceOf("=", false, false).getIntValue());
+        } else if (arg.startsWith("--codec-file=")) {
+            codecFile = juce::File::getCurrentWorkingDirectory().getChildFile(arg.fromFirstOccurrenceOf("=", false, false));
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                    << " [--filter=substring] [--output=file.json] [--min-time=ms] [--repetitions=n] [--codec-file=audio]"
+                    << std::endl;
+            return 1;
+        }
+    }
+
+    BenchmarkRunner runner;
+    addFifoBenchmarks(runner);
+    addPacketBenchmarks(runner);
+    addSendBenchmarks(runner);
+    addConversionBenchmarks(runner);
+    addCodecBenchmarks(runner);
+    if (codecFile != juce::File{}) {
+        addCodecFileBenchmark(runner, codecFile);
+    }
+    addClientListBenchmarks(runner);
+    addSwitchListBenchmarks(runner);
+
+    const auto json{juce::JSON::toString(runner.run(options))};
+
+    if (outputFile == juce::File{}) {
+        std::cout << json << std::endl;
+    } else if (!outputFile.replaceWithText(json)) {
+        std::cerr << "Failed to write " << outputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -30,12 +30,128 @@ public:
         cli.addCommand({
             "--file|-f",
             "--file|-f",
-            "Plays back the given audio (.wav, .aif) file",
-            juce::String{},
+            "Plays back the given audio (.wav, .aif) file, or offline render (.pcapng)",
+            "Plays back the given audio (.wav, .aif) file, or offline render "
+            "(.pcapng).\n"
+            "\n"
+            "With --realtime|-r, runs the audio sender and timestamp listener "
+            "threads at realtime priority and locks stream memory into RAM, "
+            "where permitted.\n"
+            "With --stats|-s=<seconds>, prints packet latency and jitter "
+            "histograms for each interval.\n"
+            "With --tx-timestamps=software|hardware[,<offset-ns>], measures "
+            "callback-to-wire and wire-to-presentation times from kernel "
+            "transmit timestamps; the offset brings them into the PTP "
+            "timescale.\n"
+            "With --trace=<file>, writes a Chrome/Perfetto timeline of the "
+            "server's threads to file on exit (needs ANANAS_TRACING).\n"
+            "With --loopback, the stream is also delivered to receivers on "
+            "this host, e.g. ananas_probe.\n"
+            "With --test-signal, sends a bit-exact test signal instead of the "
+            "file, for ananas_probe --test-signal to verify.\n"
+            "With --capture=<file>, records every packet the server sends "
+            "and receives to a pcapng file.\n"
+            "With --record=<file>, records the audio as sent to a W64 file.\n"
+            "With --fifo=<overflow>[,<underflow>], sets what the stream FIFO "
+            "does when overfull (drop-newest, drop-oldest) and when the "
+            "audio stops (wait, silence).\n"
+            "With --fifo-latency=<ms>, sets how far the sender may fall "
+            "behind, and the audio be late, before the stream FIFO "
+            "overflows or underflows (default 10).\n"
+            "With --inline-send, packetizes and sends on the audio thread "
+            "rather than the audio sender thread, where possible.\n"
+            "With --replay=<file>[,<speed>], feeds the server's listeners "
+            "from a capture rather than the network; speed 0 replays as fast "
+            "as possible.\n"
+            "With --impair=<file>, drops, duplicates, delays and reorders the "
+            "server's datagrams as the scenario file says (see "
+            "resources/impairment).\n"
+            "With --no-device, opens no audio device; the file is streamed "
+            "from a background thread, paced by the PTP timebase.\n"
+            "With --channels=<n>, streams n channels (default 2).\n"
+            "With --channel-map=<map>, plays the given file channels, e.g. "
+            "0-31, or 3,2,-,0 (- for silence); WAV, RF64 and W64 files are "
+            "played straight from a memory mapping.",
             [this](const juce::ArgumentList &a)
             {
                 const auto file{juce::File(a.getFileForOption("--file|-f"))};
-                mainComponent = std::make_unique<MainComponent>(file);
+
+                MainComponent::Options options;
+                options.realtime = a.containsOption("--realtime|-r");
+                if (a.containsOption("--stats|-s")) {
+                    options.statsIntervalS = a.getValueForOption("--stats|-s").getIntValue();
+                }
+                if (a.containsOption("--tx-timestamps")) {
+                    const auto value{a.getValueForOption("--tx-timestamps")};
+                    options.txTimestamping = value.upToFirstOccurrenceOf(",", false, false) == "hardware"
+                                                 ? ananas::TxTimestamper::Mode::hardware
+                                                 : ananas::TxTimestamper::Mode::software;
+                    options.txTimestampClockOffsetNs = value.fromFirstOccurrenceOf(",", false, false).getLargeIntValue();
+                }
+
+                if (a.containsOption("--trace")) {
+                    options.traceFile = juce::File::getCurrentWorkingDirectory().getChildFile(a.getValueForOption("--trace"));
+                }
+
+                options.multicastLoopback = a.containsOption("--loopback");
+                options.testSignal = a.containsOption("--test-signal");
+
+                if (a.containsOption("--capture")) {
+                    options.captureFile = juce::File::getCurrentWorkingDirectory().getChildFile(a.getValueForOption("--capture"));
+                }
+                if (a.containsOption("--record")) {
+                    options.recordFile = juce::File::getCurrentWorkingDirectory().getChildFile(a.getValueForOption("--record"));
+                }
+                if (a.containsOption("--fifo")) {
+                    const auto value{a.getValueForOption("--fifo")};
+                    const auto overflow{ananas::Fifo::parseOverflowPolicy(value.upToFirstOccurrenceOf(",", false, false))};
+                    const auto underflow{
+                        value.contains(",")
+                            ? ananas::Fifo::parseUnderflowPolicy(value.fromFirstOccurrenceOf(",", false, false))
+                            : std::optional{options.fifoUnderflow}
+                    };
+                    if (!overflow.has_value() || !underflow.has_value()) {
+                        juce::ConsoleApplication::fail("Can't parse --fifo");
+                    }
+                    options.fifoOverflow = *overflow;
+                    options.fifoUnderflow = *underflow;
+                }
+                if (a.containsOption("--fifo-latency")) {
+                    const auto ms{a.getValueForOption("--fifo-latency").getDoubleValue()};
+                    if (ms < 0.) {
+                        juce::ConsoleApplication::fail("--fifo-latency can't be negative");
+                    }
+                    options.fifoTargetLatencyNs = static_cast<int64_t>(ms * 1'000'000.);
+                }
+                options.inlineSend = a.containsOption("--inline-send");
+                if (a.containsOption("--replay")) {
+                    const auto value{a.getValueForOption("--replay")};
+                    options.replayFile = juce::File::getCurrentWorkingDirectory().getChildFile(value.upToFirstOccurrenceOf(",", false, false));
+                    if (value.contains(",")) {
+                        options.replaySpeed = value.fromFirstOccurrenceOf(",", false, false).getDoubleValue();
+                    }
+                }
+                if (a.containsOption("--impair")) {
+                    options.impairmentFile = juce::File::getCurrentWorkingDirectory().getChildFile(a.getValueForOption("--impair"));
+                }
+
+                options.noDevice = a.containsOption("--no-device");
+
+                if (a.containsOption("--channels")) {
+                    options.numChannels = a.getValueForOption("--channels").getIntValue();
+                    if (options.numChannels < 1) {
+                        juce::ConsoleApplication::fail("--channels must be positive");
+                    }
+                }
+                if (a.containsOption("--channel-map")) {
+                    const auto map{ananas::MappedFileSource::parseChannelMap(a.getValueForOption("--channel-map"))};
+                    if (!map.has_value()) {
+                        juce::ConsoleApplication::fail("Can't parse --channel-map");
+                    }
+                    options.channelMap = *map;
+                }
+
+                mainComponent = std::make_unique<MainComponent>(file, options);
             }
         });
 
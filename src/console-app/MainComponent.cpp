@@ -1,39 +1,151 @@
 #include "MainComponent.h"
+#include <iomanip>
 
-MainComponent::MainComponent(const juce::File &file) : server(2)
+MainComponent::MainComponent(const juce::File &file, const Options &options) : server(static_cast<uint>(options.numChannels)),
+                                                                                  traceFile(options.traceFile),
+                                                                                  numChannels(options.numChannels)
 {
-    // for (auto type: deviceManager.getAvailableDeviceTypes()) {
-    //     for (auto name: type->getDeviceNames()) {
-    //         DBG(name);
-    //     }
-    // }
+#if ANANAS_TRACING
+    ananas::Trace::setThreadName("Message thread");
+#else
+    if (traceFile != juce::File{}) {
+        std::cerr << "Tracing is compiled out; rebuild with -DANANAS_TRACING=ON to record a trace." << std::endl;
+    }
+#endif
 
-    // Apply desired audio settings.
-    setAudioChannels(0, 2);
-    auto setup{deviceManager.getAudioDeviceSetup()};
-    setup.sampleRate = kSampleRate;
-    setup.bufferSize = kNumFrames;
+    // These must happen before the server's threads are started.
+    if (options.realtime) {
+        using namespace ananas::Server;
+        server.setThreadPolicy(Sockets::AudioSenderSocketParams.name, Threads::AudioSenderPolicy);
+        server.setThreadPolicy(Sockets::TimestampListenerSocketParams.name, Threads::TimestampListenerPolicy);
+        server.setMemoryLocked(true);
+    }
 
-    setup.outputDeviceName = "Teensy Ananas, USB Audio; Front output / input";
+    server.setTxTimestamping(options.txTimestamping, options.txTimestampClockOffsetNs);
+    server.setMulticastLoopback(options.multicastLoopback);
 
-    std::cerr << deviceManager.setAudioDeviceSetup(setup, true) << std::endl;
+    if (options.captureFile != juce::File{}) {
+        server.setCaptureFile(options.captureFile);
+    }
+    server.setFifoPolicies(options.fifoOverflow, options.fifoUnderflow);
+    server.setFifoTargetLatency(options.fifoTargetLatencyNs);
+    server.setInlineSendEnabled(options.inlineSend);
 
-    // Load the provided audio file.
+    if (options.recordFile != juce::File{}) {
+        server.setRecordingFile(options.recordFile);
+    }
+    if (options.replayFile != juce::File{}) {
+        server.setReplayFile(options.replayFile, options.replaySpeed);
+    }
+
+    if (options.impairmentFile != juce::File{}) {
+        const auto scenario{juce::JSON::parse(options.impairmentFile)};
+        if (const auto *obj = scenario.getDynamicObject()) {
+            for (const auto &prop: obj->getProperties()) {
+                if (!server.setImpairment(prop.name.toString(), ananas::ImpairmentScript::fromVar(prop.value))) {
+                    std::cerr << "No thread named " << prop.name.toString() << " to impair." << std::endl;
+                }
+            }
+        } else {
+            std::cerr << "Can't read impairment scenario " << options.impairmentFile.getFullPathName() << std::endl;
+        }
+    }
+
+    // Load the provided audio file: straight from a memory mapping, where
+    // it's a format that allows, otherwise read ahead on a background
+    // thread; resampled if need be.
     formatManager.registerBasicFormats();
-    if (auto *reader = formatManager.createReaderFor(file)) {
+    juce::String mapError;
+    auto playingRender{false};
+    if (options.testSignal) {
+        std::cout << "Sending test signal" << std::endl;
+        source = &testSignalSource;
+    } else if (file.hasFileExtension("pcapng")) {
+        // An offline render from one of the plugins: already packetized, so
+        // the server just sends it.
+        std::cout << "Playing render " << file.getFullPathName() << std::endl;
+        server.setRenderPlaybackFile(file);
+        playingRender = true;
+    } else if (mappedSource = ananas::MappedFileSource::open(file, mapError); mappedSource != nullptr) {
+        std::cout << "Mapping file " << file.getFullPathName() << " (" << mappedSource->getNumChannels() << " channels)" << std::endl;
+        mappedSource->setChannelMap(options.channelMap);
+        mappedSource->setLooping(true);
+        source = mappedSource.get();
+
+        if (!juce::approximatelyEqual(mappedSource->getSampleRate(), kSampleRate)) {
+            resampler = std::make_unique<juce::ResamplingAudioSource>(mappedSource.get(), false, numChannels);
+            resampler->setResamplingRatio(mappedSource->getSampleRate() / kSampleRate);
+            source = resampler.get();
+        }
+    } else if (auto *reader = formatManager.createReaderFor(file)) {
+        if (!options.channelMap.empty()) {
+            std::cerr << "Can't map file (" << mapError << "); ignoring the channel map." << std::endl;
+        }
         std::cout << "Loading file " << file.getFullPathName() << std::endl;
+        const auto fileSampleRate{reader->sampleRate};
         readerSource = std::make_unique<juce::AudioFormatReaderSource>(reader, true);
         readerSource->setLooping(true);
-        transport.setSource(readerSource.get());
+        readAheadThread.startThread();
+        transport.setSource(readerSource.get(), kReadAheadFrames, &readAheadThread, fileSampleRate);
         transport.start();
+        source = &transport;
     } else {
         jassertfalse;
     }
+
+    if (options.noDevice) {
+        // No sound card to clock the stream, so pace it by PTP, and so
+        // avoid drifting against the clients.
+        if (source != nullptr) {
+            std::cout << "Streaming without an audio device" << std::endl;
+            streamer = std::make_unique<ananas::SourceStreamer>(*source, server, server.getPtpClock());
+            if (options.realtime) {
+                streamer->setPolicy(ananas::Server::Threads::SourceStreamerPolicy);
+            }
+            streamer->start(numChannels, kNumFrames, static_cast<int>(kSampleRate));
+        } else if (playingRender) {
+            // Nothing to stream; the server paces the render itself.
+            server.prepareToPlay(kNumFrames, kSampleRate);
+        }
+    } else {
+        // for (auto type: deviceManager.getAvailableDeviceTypes()) {
+        //     for (auto name: type->getDeviceNames()) {
+        //         DBG(name);
+        //     }
+        // }
+
+        // Apply desired audio settings.
+        setAudioChannels(0, numChannels);
+        auto setup{deviceManager.getAudioDeviceSetup()};
+        setup.sampleRate = kSampleRate;
+        setup.bufferSize = kNumFrames;
+
+        setup.outputDeviceName = "Teensy Ananas, USB Audio; Front output / input";
+
+        std::cerr << deviceManager.setAudioDeviceSetup(setup, true) << std::endl;
+    }
+
+    if (options.statsIntervalS > 0) {
+        startTimer(options.statsIntervalS * 1000);
+    }
 }
 
 MainComponent::~MainComponent()
 {
+    stopTimer();
+    // Stopping the streamer releases the source and server.
+    streamer.reset();
     shutdownAudio();
+
+#if ANANAS_TRACING
+    if (traceFile != juce::File{}) {
+        if (ananas::Trace::writeChromeJson(traceFile)) {
+            std::cout << "Trace written to " << traceFile.getFullPathName() << std::endl;
+        } else {
+            std::cerr << "Failed to write trace to " << traceFile.getFullPathName() << std::endl;
+        }
+    }
+#endif
 }
 
 void MainComponent::prepareToPlay(const int samplesPerBlockExpected, const double sampleRate)
@@ -47,7 +159,7 @@ void MainComponent::prepareToPlay(const int samplesPerBlockExpected, const doubl
 
     // Don't prepare to play until audio device setup has been updated.
     if (samplesPerBlockExpected == kNumFrames) {
-        transport.prepareToPlay(samplesPerBlockExpected, sampleRate);
+        if (source != nullptr) source->prepareToPlay(samplesPerBlockExpected, sampleRate);
         server.prepareToPlay(samplesPerBlockExpected, sampleRate);
     }
 }
@@ -55,6 +167,8 @@ void MainComponent::prepareToPlay(const int samplesPerBlockExpected, const doubl
 void MainComponent::releaseResources()
 {
     formatManager.clearFormats();
+    if (resampler) resampler->releaseResources();
+    if (mappedSource) mappedSource->releaseResources();
     if (readerSource) readerSource->releaseResources();
     transport.setSource(nullptr);
     transport.releaseResources();
@@ -62,9 +176,9 @@ void MainComponent::releaseResources()
 
 void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill)
 {
-    if (readerSource != nullptr) {
-        // Write the latest audio file samples to the buffer.
-        transport.getNextAudioBlock(bufferToFill);
+    if (source != nullptr) {
+        // Write the latest audio file (or test signal) samples to the buffer.
+        source->getNextAudioBlock(bufferToFill);
     } else {
         bufferToFill.clearActiveBufferRegion();
     }
@@ -77,3 +191,49 @@ void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo &buffer
     // nonetheless, pass it to the server to be written to the outgoing queue.
     server.getNextAudioBlock(bufferToFill);
 }
+
+void MainComponent::timerCallback()
+{
+    using ananas::Utils;
+
+    // One line per histogram, in microseconds; then start a new interval.
+    const auto metrics{server.getMetrics()};
+
+    if (const auto *obj = metrics.getDynamicObject()) {
+        for (const auto &prop: obj->getProperties()) {
+            const auto &h{prop.value};
+            const auto us{[&h](const juce::Identifier &id) { return juce::String{static_cast<double>(h[id]) / 1000., 1}; }};
+
+            std::cout << std::setw(18) << prop.name.toString() <<
+                    " n=" << h[Utils::Identifiers::HistogramCountPropertyID].toString() <<
+                    " min=" << us(Utils::Identifiers::HistogramMinPropertyID) <<
+                    " p50=" << us(Utils::Identifiers::HistogramP50PropertyID) <<
+                    " p99=" << us(Utils::Identifiers::HistogramP99PropertyID) <<
+                    " p99.9=" << us(Utils::Identifiers::HistogramP999PropertyID) <<
+                    " max=" << us(Utils::Identifiers::HistogramMaxPropertyID) << " us" << std::endl;
+        }
+    }
+
+    if (streamer != nullptr) {
+        std::cout << std::setw(18) << "streamer" << " " << juce::JSON::toString(streamer->getStats(), true) << std::endl;
+        std::cout << std::setw(18) << "ptpClock" << " " << juce::JSON::toString(server.getPtpClock().getStats(), true) << std::endl;
+    }
+
+    if (const auto *obj = server.getFifoStats().getDynamicObject()) {
+        for (const auto &prop: obj->getProperties()) {
+            std::cout << std::setw(18) << ("fifo " + prop.name.toString()) << " " << juce::JSON::toString(prop.value, true) << std::endl;
+        }
+    }
+
+    if (const auto stats{server.getInlineSendStats()}; !stats.isVoid()) {
+        std::cout << std::setw(18) << "inlineSend" << " " << juce::JSON::toString(stats, true) << std::endl;
+    }
+
+    if (const auto *obj = server.getImpairmentStats().getDynamicObject()) {
+        for (const auto &prop: obj->getProperties()) {
+            std::cout << std::setw(18) << prop.name.toString() << " " << juce::JSON::toString(prop.value, true) << std::endl;
+        }
+    }
+
+    server.resetMetrics();
+}
@@ -2,11 +2,90 @@
 #define MAINCOMPONENT_H
 
 #include <juce_audio_utils/juce_audio_utils.h>
+#include <MappedFileSource.h>
 #include <Server.h>
+#include <SourceStreamer.h>
+#include <TestSignal.h>
 
-class MainComponent final : public juce::AudioAppComponent {
+class MainComponent final : public juce::AudioAppComponent,
+                            juce::Timer {
 public:
-    explicit MainComponent(const juce::File &file);
+    struct Options
+    {
+        /**
+         * Run the timing-critical server threads at realtime priority, and
+         * lock stream memory.
+         */
+        bool realtime{false};
+        /**
+         * If greater than zero, print the server's packet metrics every this
+         * many seconds.
+         */
+        int statsIntervalS{0};
+        ananas::TxTimestamper::Mode txTimestamping{ananas::TxTimestamper::Mode::off};
+        int64_t txTimestampClockOffsetNs{0};
+        /**
+         * If set, write a Chrome trace of the server's threads here on exit.
+         */
+        juce::File traceFile;
+        /**
+         * Also deliver the stream to receivers on this host, e.g.
+         * ananas_probe.
+         */
+        bool multicastLoopback{false};
+        /**
+         * Send ananas::TestSignal instead of the file.
+         */
+        bool testSignal{false};
+        /**
+         * If set, record the server's traffic to this pcapng file.
+         */
+        juce::File captureFile;
+        /**
+         * If set, record the audio sent to this W64 file.
+         */
+        juce::File recordFile;
+        /**
+         * What the stream FIFO does when overfull, and when the audio stops.
+         */
+        ananas::Fifo::OverflowPolicy fifoOverflow{ananas::Fifo::OverflowPolicy::dropNewest};
+        ananas::Fifo::UnderflowPolicy fifoUnderflow{ananas::Fifo::UnderflowPolicy::wait};
+        /**
+         * See Server::setFifoTargetLatency().
+         */
+        int64_t fifoTargetLatencyNs{ananas::Server::Constants::DefaultFifoTargetLatencyNs};
+        /**
+         * Send on the audio thread; see Server::setInlineSendEnabled().
+         */
+        bool inlineSend{false};
+        /**
+         * If set, feed the server's listeners from this capture instead of
+         * the network.
+         */
+        juce::File replayFile;
+        double replaySpeed{1.};
+        /**
+         * If set, impair the server's traffic as this file says: a JSON
+         * object of ananas::ImpairmentScripts, keyed by thread name.
+         */
+        juce::File impairmentFile;
+        /**
+         * Don't open an audio device; stream from a background thread
+         * instead, paced by the PTP timebase.
+         */
+        bool noDevice{false};
+        /**
+         * How many channels to stream.
+         */
+        int numChannels{2};
+        /**
+         * Which file channel each streamed channel plays; see
+         * ananas::MappedFileSource::setChannelMap(). Empty for one-to-one.
+         */
+        std::vector<int> channelMap;
+    };
+
+    MainComponent(const juce::File &file, const Options &options);
 
     ~MainComponent() override;
 
@@ -16,14 +95,36 @@ public:
 
     void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override;
 
+    void timerCallback() override;
+
 private:
     static constexpr int kNumFrames{128};
     static constexpr double kSampleRate{AUDIO_SAMPLE_RATE};
+    static constexpr int kReadAheadFrames{1 << 15};
 
+    /**
+     * Plays the file, if it's a WAV, RF64 or W64 it can map; otherwise, the
+     * reader and transport do.
+     */
+    std::unique_ptr<ananas::MappedFileSource> mappedSource;
+    std::unique_ptr<juce::ResamplingAudioSource> resampler;
     juce::AudioFormatManager formatManager;
+    juce::TimeSliceThread readAheadThread{"Ananas File Reader"};
     std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
     juce::AudioTransportSource transport;
+    ananas::TestSignalSource testSignalSource;
+    /**
+     * The mapped file (perhaps resampled), the file transport, the test
+     * signal, or nothing.
+     */
+    juce::AudioSource *source{nullptr};
     ananas::Server::Server server;
+    /**
+     * Stands in for the audio device, with Options::noDevice.
+     */
+    std::unique_ptr<ananas::SourceStreamer> streamer;
+    juce::File traceFile;
+    int numChannels;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
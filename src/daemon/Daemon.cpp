@@ -0,0 +1,395 @@
+#include "Daemon.h"
+#include <TestSignal.h>
+
+namespace ananas
+{
+    namespace
+    {
+        const juce::Identifier SourceID{"source"};
+        const juce::Identifier ChannelsID{"channels"};
+        const juce::Identifier ChannelMapID{"channelMap"};
+        const juce::Identifier SampleRateID{"sampleRate"};
+        const juce::Identifier BlockSizeID{"blockSize"};
+        const juce::Identifier PtpPacingID{"ptpPacing"};
+        const juce::Identifier RealtimeID{"realtime"};
+        const juce::Identifier LockMemoryID{"lockMemory"};
+        const juce::Identifier LoopbackID{"loopback"};
+        const juce::Identifier CompressionID{"compression"};
+        const juce::Identifier FecDataID{"fecData"};
+        const juce::Identifier FecParityID{"fecParity"};
+        const juce::Identifier CaptureID{"capture"};
+        const juce::Identifier RecordID{"record"};
+        const juce::Identifier ImpairmentID{"impairment"};
+        const juce::Identifier FifoOverflowID{"fifoOverflow"};
+        const juce::Identifier FifoUnderflowID{"fifoUnderflow"};
+        const juce::Identifier FifoLatencyID{"fifoLatencyMs"};
+        const juce::Identifier InlineSendID{"inlineSend"};
+        const juce::Identifier StatsIntervalID{"statsInterval"};
+        const juce::Identifier LogLevelID{"logLevel"};
+
+        const juce::Identifier MetricsID{"metrics"};
+        const juce::Identifier StreamerID{"streamer"};
+        const juce::Identifier PtpClockID{"ptpClock"};
+        const juce::Identifier FifoID{"fifo"};
+
+        class SilentSource final : public juce::AudioSource
+        {
+        public:
+            void prepareToPlay(int, double) override
+            {
+            }
+
+            void releaseResources() override
+            {
+            }
+
+            void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override
+            {
+                bufferToFill.clearActiveBufferRegion();
+            }
+        };
+    }
+
+    bool DaemonConfig::load(const juce::File &file, DaemonConfig &config, juce::String &error)
+    {
+        if (!file.existsAsFile()) {
+            error = "No such file: " + file.getFullPathName();
+            return false;
+        }
+
+        juce::var json;
+        if (const auto result{juce::JSON::parse(file.loadFileAsString(), json)}; result.failed()) {
+            error = result.getErrorMessage();
+            return false;
+        }
+        if (!json.isObject()) {
+            error = "Expected a JSON object";
+            return false;
+        }
+
+        const auto resolve{
+            [&file](const juce::var &path)
+            {
+                return path.toString().isEmpty() ? juce::File{} : file.getParentDirectory().getChildFile(path.toString());
+            }
+        };
+
+        DaemonConfig c;
+        c.source = json[SourceID].toString();
+        if (c.source.isNotEmpty() && c.source != SourceTestSignal) {
+            c.source = resolve(c.source).getFullPathName();
+        }
+        c.numChannels = json.getProperty(ChannelsID, c.numChannels);
+        if (const auto spec{json[ChannelMapID].toString()}; spec.isNotEmpty()) {
+            const auto map{MappedFileSource::parseChannelMap(spec)};
+            if (!map.has_value()) {
+                error = "Can't parse channelMap: " + spec;
+                return false;
+            }
+            c.channelMap = *map;
+        }
+        c.sampleRate = json.getProperty(SampleRateID, c.sampleRate);
+        c.blockSize = json.getProperty(BlockSizeID, c.blockSize);
+        c.ptpPacing = json.getProperty(PtpPacingID, c.ptpPacing);
+        c.realtime = json.getProperty(RealtimeID, c.realtime);
+        c.lockMemory = json.getProperty(LockMemoryID, c.lockMemory);
+        c.multicastLoopback = json.getProperty(LoopbackID, c.multicastLoopback);
+        c.compression = json.getProperty(CompressionID, c.compression);
+        c.fecNumData = json.getProperty(FecDataID, c.fecNumData);
+        c.fecNumParity = json.getProperty(FecParityID, c.fecNumParity);
+        c.captureFile = resolve(json[CaptureID]);
+        c.recordFile = resolve(json[RecordID]);
+        c.impairmentFile = resolve(json[ImpairmentID]);
+        if (const auto name{json[FifoOverflowID].toString()}; name.isNotEmpty()) {
+            const auto policy{Fifo::parseOverflowPolicy(name)};
+            if (!policy.has_value()) {
+                error = "Unknown fifoOverflow: " + name;
+                return false;
+            }
+            c.fifoOverflow = *policy;
+        }
+        if (const auto name{json[FifoUnderflowID].toString()}; name.isNotEmpty()) {
+            const auto policy{Fifo::parseUnderflowPolicy(name)};
+            if (!policy.has_value()) {
+                error = "Unknown fifoUnderflow: " + name;
+                return false;
+            }
+            c.fifoUnderflow = *policy;
+        }
+        if (json.hasProperty(FifoLatencyID)) {
+            c.fifoTargetLatencyNs = static_cast<int64_t>(static_cast<double>(json[FifoLatencyID]) * 1'000'000.);
+        }
+        c.inlineSend = json.getProperty(InlineSendID, c.inlineSend);
+        c.statsIntervalS = json.getProperty(StatsIntervalID, c.statsIntervalS);
+
+        if (const auto level{json[LogLevelID].toString()}; level.isNotEmpty()) {
+            if (level == "debug") c.logLevel = Logger::Level::debug;
+            else if (level == "info") c.logLevel = Logger::Level::info;
+            else if (level == "warning") c.logLevel = Logger::Level::warning;
+            else if (level == "error") c.logLevel = Logger::Level::error;
+            else {
+                error = "Unknown log level: " + level;
+                return false;
+            }
+        }
+
+        if (c.numChannels < 1 || c.sampleRate < 1 || c.blockSize < 1 || c.statsIntervalS < 0 || c.fifoTargetLatencyNs < 0) {
+            error = "channels, sampleRate and blockSize must be positive, and statsInterval and fifoLatencyMs not negative";
+            return false;
+        }
+
+        config = c;
+        return true;
+    }
+
+    bool DaemonConfig::needsRestart(const DaemonConfig &other) const
+    {
+        return source != other.source
+               || numChannels != other.numChannels
+               || channelMap != other.channelMap
+               || sampleRate != other.sampleRate
+               || blockSize != other.blockSize
+               || ptpPacing != other.ptpPacing
+               || realtime != other.realtime
+               || lockMemory != other.lockMemory
+               || multicastLoopback != other.multicastLoopback
+               || captureFile != other.captureFile
+               || recordFile != other.recordFile
+               || fifoOverflow != other.fifoOverflow
+               || fifoUnderflow != other.fifoUnderflow
+               || fifoTargetLatencyNs != other.fifoTargetLatencyNs
+               || inlineSend != other.inlineSend
+               || impairmentFile != other.impairmentFile;
+    }
+
+    //==========================================================================
+
+    Daemon::Daemon(juce::File configFile, EventLoop &loop)
+        : configFile(std::move(configFile)),
+          loop(loop),
+          statsReporter(*this)
+    {
+        formatManager.registerBasicFormats();
+    }
+
+    Daemon::~Daemon()
+    {
+        stop();
+    }
+
+    bool Daemon::start()
+    {
+        juce::String error;
+        if (!DaemonConfig::load(configFile, config, error)) {
+            ANANAS_LOG_ERROR("Can't load config %s: %s", configFile.getFullPathName().toRawUTF8(), error.toRawUTF8());
+            return false;
+        }
+
+        startServer();
+        return true;
+    }
+
+    void Daemon::reload()
+    {
+        DaemonConfig newConfig;
+        juce::String error;
+        if (!DaemonConfig::load(configFile, newConfig, error)) {
+            ANANAS_LOG_ERROR("Can't reload config %s: %s; keeping the current one.",
+                             configFile.getFullPathName().toRawUTF8(), error.toRawUTF8());
+            return;
+        }
+
+        const auto restart{config.needsRestart(newConfig)};
+        config = newConfig;
+
+        if (restart) {
+            ANANAS_LOG_INFO("Config reloaded; restarting server.");
+            stopServer();
+            startServer();
+        } else {
+            ANANAS_LOG_INFO("Config reloaded.");
+            applyLiveSettings();
+        }
+    }
+
+    void Daemon::stop()
+    {
+        stopServer();
+    }
+
+    void Daemon::startServer()
+    {
+        server = std::make_unique<Server::Server>(static_cast<uint>(config.numChannels), loop);
+
+        // These must happen before the server's threads are started.
+        if (config.realtime) {
+            server->setThreadPolicy(Server::Sockets::AudioSenderSocketParams.name, Server::Threads::AudioSenderPolicy);
+            server->setThreadPolicy(Server::Sockets::TimestampListenerSocketParams.name, Server::Threads::TimestampListenerPolicy);
+        }
+        server->setMemoryLocked(config.lockMemory);
+        server->setFifoPolicies(config.fifoOverflow, config.fifoUnderflow);
+        server->setFifoTargetLatency(config.fifoTargetLatencyNs);
+        server->setMulticastLoopback(config.multicastLoopback);
+        server->setInlineSendEnabled(config.inlineSend);
+
+        if (config.captureFile != juce::File{}) {
+            server->setCaptureFile(config.captureFile);
+        }
+
+        if (config.recordFile != juce::File{}) {
+            server->setRecordingFile(config.recordFile);
+        }
+
+        if (juce::File{config.source}.hasFileExtension("pcapng")) {
+            server->setRenderPlaybackFile(juce::File{config.source});
+        }
+
+        if (config.impairmentFile != juce::File{}) {
+            const auto scenario{juce::JSON::parse(config.impairmentFile)};
+            if (const auto *obj = scenario.getDynamicObject()) {
+                for (const auto &prop: obj->getProperties()) {
+                    if (!server->setImpairment(prop.name.toString(), ImpairmentScript::fromVar(prop.value))) {
+                        ANANAS_LOG_WARNING("No thread named %s to impair.", prop.name.toString().toRawUTF8());
+                    }
+                }
+            } else {
+                ANANAS_LOG_WARNING("Can't read impairment scenario %s", config.impairmentFile.getFullPathName().toRawUTF8());
+            }
+        }
+
+        applyLiveSettings();
+
+        if (!createSource()) {
+            ANANAS_LOG_ERROR("Can't read %s; sending silence.", config.source.toRawUTF8());
+        }
+
+        streamer = std::make_unique<SourceStreamer>(*source,
+                                                    *server,
+                                                    config.ptpPacing ? static_cast<Clock &>(server->getPtpClock()) : loop);
+        if (config.realtime) {
+            streamer->setPolicy(Server::Threads::SourceStreamerPolicy);
+        }
+        streamer->start(config.numChannels, config.blockSize, config.sampleRate);
+    }
+
+    void Daemon::stopServer()
+    {
+        statsReporter.stopTimer();
+
+        // Stopping the streamer releases the source and server.
+        streamer.reset();
+        server.reset();
+
+        source = nullptr;
+        resampler.reset();
+        mappedSource.reset();
+        transport.setSource(nullptr);
+        readerSource.reset();
+        readAheadThread.stopThread(1000);
+        generator.reset();
+    }
+
+    void Daemon::applyLiveSettings()
+    {
+        Logger::setLevel(config.logLevel);
+
+        if (server != nullptr) {
+            server->setCompressionEnabled(config.compression);
+            server->setFecParams(config.fecNumData, config.fecNumParity);
+        }
+
+        if (config.statsIntervalS > 0) {
+            statsReporter.startTimer(config.statsIntervalS * 1000);
+        } else {
+            statsReporter.stopTimer();
+        }
+    }
+
+    bool Daemon::createSource()
+    {
+        if (config.source == DaemonConfig::SourceTestSignal) {
+            generator = std::make_unique<TestSignalSource>();
+            source = generator.get();
+            return true;
+        }
+
+        if (server->isPlayingRender()) {
+            // The server sends the render itself; keep it clocked.
+            generator = std::make_unique<SilentSource>();
+            source = generator.get();
+            ANANAS_LOG_INFO("Playing render %s", config.source.toRawUTF8());
+            return true;
+        }
+
+        if (config.source.isNotEmpty()) {
+            // Straight from a memory mapping if possible; otherwise read
+            // ahead on a background thread, as the streamer's thread mustn't
+            // wait on the disk.
+            juce::String error;
+            if (mappedSource = MappedFileSource::open(juce::File{config.source}, error); mappedSource != nullptr) {
+                mappedSource->setChannelMap(config.channelMap);
+                mappedSource->setLooping(true);
+                source = mappedSource.get();
+
+                if (!juce::approximatelyEqual(mappedSource->getSampleRate(), static_cast<double>(config.sampleRate))) {
+                    resampler = std::make_unique<juce::ResamplingAudioSource>(source, false, config.numChannels);
+                    resampler->setResamplingRatio(mappedSource->getSampleRate() / config.sampleRate);
+                    source = resampler.get();
+                }
+            } else if (auto *reader = formatManager.createReaderFor(juce::File{config.source})) {
+                if (!config.channelMap.empty()) {
+                    ANANAS_LOG_WARNING("Can't map %s (%s); ignoring the channel map.",
+                                       config.source.toRawUTF8(), error.toRawUTF8());
+                }
+                const auto fileSampleRate{reader->sampleRate};
+                readerSource = std::make_unique<juce::AudioFormatReaderSource>(reader, true);
+                readerSource->setLooping(true);
+                readAheadThread.startThread();
+                transport.setSource(readerSource.get(), ReadAheadFrames, &readAheadThread, fileSampleRate, config.numChannels);
+                transport.start();
+                source = &transport;
+            }
+
+            if (source != nullptr) {
+                ANANAS_LOG_INFO("Streaming %s", config.source.toRawUTF8());
+                return true;
+            }
+        }
+
+        generator = std::make_unique<SilentSource>();
+        source = generator.get();
+        return config.source.isEmpty();
+    }
+
+    //==========================================================================
+
+    Daemon::StatsReporter::StatsReporter(Daemon &daemon)
+        : ClockTimer(daemon.loop),
+          daemon(daemon)
+    {
+    }
+
+    void Daemon::StatsReporter::timerCallback()
+    {
+        auto *server{daemon.server.get()};
+        if (server == nullptr) {
+            return;
+        }
+
+        // One line of JSON per interval, for the journal; then start a new
+        // interval.
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(MetricsID, server->getMetrics());
+        object->setProperty(StreamerID, daemon.streamer->getStats());
+        object->setProperty(PtpClockID, server->getPtpClock().getStats());
+        object->setProperty(CaptureID, server->getCaptureStats());
+        object->setProperty(RecordID, server->getRecordingStats());
+        object->setProperty(FifoID, server->getFifoStats());
+        object->setProperty(InlineSendID, server->getInlineSendStats());
+        object->setProperty(ImpairmentID, server->getImpairmentStats());
+
+        std::cout << juce::JSON::toString(juce::var{object}, true) << std::endl;
+
+        server->resetMetrics();
+    }
+}
@@ -0,0 +1,158 @@
+#ifndef ANANASDAEMON_H
+#define ANANASDAEMON_H
+
+#include <juce_audio_devices/juce_audio_devices.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <EventLoop.h>
+#include <Logger.h>
+#include <MappedFileSource.h>
+#include <Server.h>
+#include <SourceStreamer.h>
+
+namespace ananas
+{
+    /**
+     * ananasd's settings, as read from its JSON config file; see ananasd.json.
+     */
+    struct DaemonConfig
+    {
+        /**
+         * An audio file to loop, SourceTestSignal, or empty for silence.
+         */
+        juce::String source;
+        int numChannels{2};
+        /**
+         * Which channel of the source file each channel plays; see
+         * MappedFileSource::setChannelMap(). Empty for one-to-one.
+         */
+        std::vector<int> channelMap;
+        int sampleRate{48000};
+        int blockSize{128};
+        /**
+         * Pace the stream by the PTP timebase rather than the local clock.
+         */
+        bool ptpPacing{true};
+        bool realtime{false};
+        bool lockMemory{false};
+        bool multicastLoopback{false};
+        bool compression{false};
+        int fecNumData{0};
+        int fecNumParity{0};
+        juce::File captureFile;
+        juce::File recordFile;
+        juce::File impairmentFile;
+        Fifo::OverflowPolicy fifoOverflow{Fifo::OverflowPolicy::dropNewest};
+        Fifo::UnderflowPolicy fifoUnderflow{Fifo::UnderflowPolicy::wait};
+        int64_t fifoTargetLatencyNs{Server::Constants::DefaultFifoTargetLatencyNs};
+        /**
+         * Send from the streamer's thread; see Server::setInlineSendEnabled().
+         */
+        bool inlineSend{false};
+        int statsIntervalS{0};
+        Logger::Level logLevel{Logger::Level::info};
+
+        inline static const juce::String SourceTestSignal{"test-signal"};
+
+        /**
+         * Relative paths are taken relative to the config file.
+         * @return false, with a description in error, if the file can't be
+         * read or doesn't make sense.
+         */
+        static bool load(const juce::File &file, DaemonConfig &config, juce::String &error);
+
+        /**
+         * @return true if going from this config to another means restarting
+         * the server, rather than just applying the difference.
+         */
+        [[nodiscard]] bool needsRestart(const DaemonConfig &other) const;
+    };
+
+    //==========================================================================
+
+    /**
+     * A Server, fed from a file or test signal by a SourceStreamer, with
+     * housekeeping and statistics on an EventLoop; no audio device or
+     * message thread involved. Everything other than the constructor is to
+     * be called on the loop's thread.
+     */
+    class Daemon
+    {
+    public:
+        Daemon(juce::File configFile, EventLoop &loop);
+
+        ~Daemon();
+
+        /**
+         * Read the config file and start streaming.
+         */
+        bool start();
+
+        /**
+         * Read the config file again and apply any changes, restarting the
+         * server only if need be. A config that can't be read is ignored,
+         * and the current one kept.
+         */
+        void reload();
+
+        void stop();
+
+    private:
+        class StatsReporter final : public ClockTimer
+        {
+        public:
+            explicit StatsReporter(Daemon &daemon);
+
+            void timerCallback() override;
+
+        private:
+            Daemon &daemon;
+        };
+
+        void startServer();
+
+        void stopServer();
+
+        /**
+         * Apply whatever can be changed while streaming.
+         */
+        void applyLiveSettings();
+
+        /**
+         * @return false if the source file can't be read, in which case
+         * the source is silence.
+         */
+        bool createSource();
+
+        const juce::File configFile;
+        EventLoop &loop;
+        DaemonConfig config;
+
+        /**
+         * How far ahead of the streamer a file that can't be mapped is read.
+         */
+        constexpr static int ReadAheadFrames{1 << 15};
+
+        juce::AudioFormatManager formatManager;
+        std::unique_ptr<MappedFileSource> mappedSource;
+        std::unique_ptr<juce::ResamplingAudioSource> resampler;
+        /**
+         * Reads, and resamples, a file that can't be mapped, off the
+         * streamer's thread.
+         */
+        juce::TimeSliceThread readAheadThread{"Ananas File Reader"};
+        std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
+        juce::AudioTransportSource transport;
+        std::unique_ptr<juce::AudioSource> generator;
+        /**
+         * Whichever of the above is at the end of the chain.
+         */
+        juce::AudioSource *source{nullptr};
+        std::unique_ptr<Server::Server> server;
+        std::unique_ptr<SourceStreamer> streamer;
+        StatsReporter statsReporter;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Daemon)
+    };
+}
+
+#endif //ANANASDAEMON_H
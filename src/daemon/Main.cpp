@@ -0,0 +1,127 @@
+#include "Daemon.h"
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace ananas;
+
+namespace
+{
+    const juce::String DefaultConfigPath{"/etc/ananas/ananasd.json"};
+
+    void printUsage(const char *name)
+    {
+        std::cerr << "Usage: " << name << " [--config=file] [--check]" << std::endl;
+    }
+
+    /**
+     * Tell systemd about a change of state (Type=notify), if it's listening;
+     * see sd_notify(3). Saves depending on libsystemd for one datagram.
+     */
+    void notifySystemd(const char *state)
+    {
+        const auto *path{getenv("NOTIFY_SOCKET")};
+        if (path == nullptr || (path[0] != '/' && path[0] != '@')) {
+            return;
+        }
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        const auto length{std::min(strlen(path), sizeof(address.sun_path) - 1)};
+        memcpy(address.sun_path, path, length);
+        if (address.sun_path[0] == '@') {
+            // An abstract socket.
+            address.sun_path[0] = '\0';
+        }
+
+        const auto fd{socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)};
+        if (fd < 0) {
+            return;
+        }
+        sendto(fd, state, strlen(state), MSG_NOSIGNAL,
+               reinterpret_cast<const sockaddr *>(&address),
+               static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + length));
+        close(fd);
+    }
+}
+
+int main(const int argc, char *argv[])
+{
+    auto configFile{juce::File{DefaultConfigPath}};
+    auto checkOnly{false};
+
+    for (auto i{1}; i < argc; ++i) {
+        const juce::String arg{argv[i]};
+
+        if (arg.startsWith("--config=")) {
+            configFile = juce::File::getCurrentWorkingDirectory().getChildFile(arg.fromFirstOccurrenceOf("=", false, false));
+        } else if (arg == "--check") {
+            checkOnly = true;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (checkOnly) {
+        DaemonConfig config;
+        juce::String error;
+        if (!DaemonConfig::load(configFile, config, error)) {
+            std::cerr << configFile.getFullPathName() << ": " << error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Block the signals of interest in every thread (threads inherit the
+    // mask, so before any are started), and take them synchronously on one
+    // thread of our own, which can then safely hand them to the loop.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    EventLoop loop;
+    Daemon daemon{configFile, loop};
+
+    if (!daemon.start()) {
+        return 1;
+    }
+
+    std::thread signalThread{
+        [&loop, &daemon, signals]
+        {
+            for (;;) {
+                auto signal{0};
+                if (sigwait(&signals, &signal) != 0) {
+                    continue;
+                }
+
+                if (signal == SIGHUP) {
+                    loop.post([&daemon]
+                    {
+                        notifySystemd("RELOADING=1");
+                        daemon.reload();
+                        notifySystemd("READY=1");
+                    });
+                } else {
+                    loop.quit();
+                    return;
+                }
+            }
+        }
+    };
+
+    notifySystemd("READY=1");
+    loop.run();
+    notifySystemd("STOPPING=1");
+
+    signalThread.join();
+    daemon.stop();
+
+    return 0;
+}
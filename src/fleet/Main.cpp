@@ -0,0 +1,356 @@
+#include <juce_core/juce_core.h>
+#include <ClientFleet.h>
+#include <Clock.h>
+#include <Logger.h>
+#include <Server.h>
+#include <arpa/inet.h>
+#include <csignal>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace ananas;
+
+namespace
+{
+    constexpr int BatchSize{64};
+    constexpr int ReportIntervalS{5};
+    constexpr int SimulatedReportIntervalS{60};
+    constexpr int DefaultSimulatedDurationS{3600};
+
+    std::atomic<bool> shouldExit{false};
+
+    struct Options
+    {
+        FleetParams fleet;
+        /**
+         * Client n sends from this address plus n; authorities follow the
+         * clients. Any 127/8 address is local on Linux; otherwise, e.g. on
+         * a veth pair, the addresses must be assigned to the interface.
+         */
+        juce::String sourceIP{"127.1.0.1"};
+        /**
+         * Unicast to the server's listeners on this host by default; or the
+         * announcement multicast group.
+         */
+        juce::String destinationIP{"127.0.0.1"};
+        juce::String interfaceIP;
+        int durationS{0};
+        /**
+         * Deliver announcements straight to a ClientList in simulated time,
+         * rather than to a socket.
+         */
+        bool simulate{false};
+    };
+
+    void printUsage(const char *name)
+    {
+        std::cerr << "Usage: " << name << " [--clients=n] [--authorities=n] [--rate=hz] [--jitter=fraction]"
+                " [--authority-rate=hz] [--mix=client:w,wfs:w,ambisonics:w,passthrough:w]"
+                " [--churn=per-minute] [--downtime=seconds] [--drift=ns-per-s] [--fill-step=percent]"
+                " [--source=ip] [--destination=ip] [--interface=ip] [--duration=seconds] [--seed=n]"
+                " [--simulate]" << std::endl;
+    }
+
+    bool parseMix(const juce::String &value, FleetParams &params)
+    {
+        params.firmwareMix.clear();
+
+        for (const auto &entry: juce::StringArray::fromTokens(value, ",", "")) {
+            const auto name{entry.upToFirstOccurrenceOf(":", false, false).trim()};
+            const auto weight{entry.fromFirstOccurrenceOf(":", false, false).getDoubleValue()};
+
+            if (name == "client") params.firmwareMix.emplace_back(Utils::FirmwareType::client, weight);
+            else if (name == "wfs") params.firmwareMix.emplace_back(Utils::FirmwareType::wfsModule, weight);
+            else if (name == "ambisonics") params.firmwareMix.emplace_back(Utils::FirmwareType::ambisonicsModule, weight);
+            else if (name == "passthrough") params.firmwareMix.emplace_back(Utils::FirmwareType::passthrough, weight);
+            else return false;
+        }
+
+        return !params.firmwareMix.empty();
+    }
+
+    bool parseOptions(const int argc, char *argv[], Options &options)
+    {
+        auto &fleet{options.fleet};
+
+        for (auto i{1}; i < argc; ++i) {
+            const juce::String arg{argv[i]};
+            const auto value{arg.fromFirstOccurrenceOf("=", false, false)};
+
+            if (arg.startsWith("--clients=")) {
+                fleet.numClients = juce::jmax(0, value.getIntValue());
+            } else if (arg.startsWith("--authorities=")) {
+                fleet.numAuthorities = juce::jmax(0, value.getIntValue());
+            } else if (arg.startsWith("--rate=")) {
+                fleet.announceRateHz = juce::jmax(.01, value.getDoubleValue());
+            } else if (arg.startsWith("--jitter=")) {
+                fleet.announceJitter = juce::jlimit(0., .9, value.getDoubleValue());
+            } else if (arg.startsWith("--authority-rate=")) {
+                fleet.authorityRateHz = juce::jmax(.01, value.getDoubleValue());
+            } else if (arg.startsWith("--mix=")) {
+                if (!parseMix(value, fleet)) return false;
+            } else if (arg.startsWith("--churn=")) {
+                fleet.churnPerMinute = juce::jmax(0., value.getDoubleValue());
+            } else if (arg.startsWith("--downtime=")) {
+                fleet.meanDowntimeS = juce::jmax(0., value.getDoubleValue());
+            } else if (arg.startsWith("--drift=")) {
+                fleet.offsetDriftNsPerS = value.getDoubleValue();
+            } else if (arg.startsWith("--fill-step=")) {
+                fleet.bufferFillStepPercent = juce::jmax(0., value.getDoubleValue());
+            } else if (arg.startsWith("--source=")) {
+                options.sourceIP = value;
+            } else if (arg.startsWith("--destination=")) {
+                options.destinationIP = value;
+            } else if (arg.startsWith("--interface=")) {
+                options.interfaceIP = value;
+            } else if (arg.startsWith("--duration=")) {
+                options.durationS = juce::jmax(0, value.getIntValue());
+            } else if (arg.startsWith("--seed=")) {
+                fleet.seed = value.getLargeIntValue();
+            } else if (arg == "--simulate") {
+                options.simulate = true;
+            } else {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    int64_t getMonotonicNs()
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * Server::Constants::NSPS + ts.tv_nsec;
+    }
+
+    /**
+     * Play the fleet into the listeners of a simulated Server running on a
+     * VirtualClock, as fast as they'll go. Reports go to stdout once a
+     * simulated minute, and are the same, line for line, for the same
+     * options and seed.
+     */
+    int simulate(const Options &options, const in_addr sourceBase)
+    {
+        // Keep per-client connect/disconnect messages out of the way.
+        Logger::setLevel(Logger::Level::warning);
+
+        const auto &fleetParams{options.fleet};
+        const auto durationNs{
+            static_cast<int64_t>(options.durationS > 0 ? options.durationS : DefaultSimulatedDurationS) * Server::Constants::NSPS
+        };
+
+        VirtualClock clock;
+        clock.setDrivingThread();
+        Server::Server server{2, clock};
+        server.setSimulated(true);
+        ClientFleet fleet{fleetParams};
+
+        // One address per client, then per authority, as on the wire.
+        std::vector<juce::String> sourceIPs;
+        for (auto i{0}; i < fleetParams.numClients + fleetParams.numAuthorities; ++i) {
+            const in_addr address{htonl(ntohl(sourceBase.s_addr) + static_cast<uint32_t>(i))};
+            char text[INET_ADDRSTRLEN]{};
+            inet_ntop(AF_INET, &address, text, sizeof(text));
+            sourceIPs.emplace_back(text);
+        }
+
+        const ClientFleet::Sink deliver{
+            [&](const ClientFleet::Source source, const int index, const void *data, const size_t size)
+            {
+                if (source == ClientFleet::Source::client) {
+                    server.simulateDatagram(Server::Sockets::ClientListenerSocketParams.name,
+                                            static_cast<const uint8_t *>(data),
+                                            size,
+                                            sourceIPs[static_cast<size_t>(index)],
+                                            Server::Sockets::ClientListenerSocketParams.localPort);
+                } else {
+                    server.simulateDatagram(Server::Sockets::AuthorityListenerSocketParams.name,
+                                            static_cast<const uint8_t *>(data),
+                                            size,
+                                            sourceIPs[static_cast<size_t>(fleetParams.numClients + index)],
+                                            Server::Sockets::AuthorityListenerSocketParams.localPort);
+                }
+            }
+        };
+
+        std::cerr << "Simulating " << fleetParams.numClients << " clients and " << fleetParams.numAuthorities <<
+                " authorities for " << durationNs / Server::Constants::NSPS << " s" << std::endl;
+
+        const auto wallStartMs{juce::Time::getMillisecondCounterHiRes()};
+        uint64_t numAnnouncements{static_cast<uint64_t>(fleet.advance(0, deliver))};
+        auto nextReportNs{SimulatedReportIntervalS * Server::Constants::NSPS};
+
+        while (clock.now() < durationNs && !shouldExit.load()) {
+            // Step straight to whatever happens next: an announcement, a
+            // connectedness check, or a report.
+            const auto next{std::min({fleet.getNextDueNs(), clock.getNextTimerDueNs(), nextReportNs, durationNs})};
+            clock.advanceTo(next);
+            numAnnouncements += static_cast<uint64_t>(fleet.advance(next, deliver));
+
+            if (next >= nextReportNs) {
+                std::cout << "t=" << next / Server::Constants::NSPS << "s" <<
+                        " announcements=" << numAnnouncements <<
+                        " listed=" << server.getClientList()->getCount() <<
+                        " connected=" << fleet.getNumConnected() << "/" << fleetParams.numClients <<
+                        " disconnections=" << fleet.getNumDisconnections() << std::endl;
+                nextReportNs += SimulatedReportIntervalS * Server::Constants::NSPS;
+            }
+        }
+
+        std::cerr << "Simulated " << clock.now() / Server::Constants::NSPS << " s in " <<
+                juce::String{(juce::Time::getMillisecondCounterHiRes() - wallStartMs) / 1000., 2} << " s" << std::endl;
+
+        return 0;
+    }
+
+    /**
+     * One announcement, ready for sendmmsg(), with its source address in an
+     * IP_PKTINFO control message; one socket serves the whole fleet.
+     */
+    struct Message
+    {
+        sockaddr_in destination{};
+        std::array<uint8_t, 64> data{};
+        size_t size{0};
+        alignas(cmsghdr) std::array<uint8_t, CMSG_SPACE(sizeof(in_pktinfo))> control{};
+        iovec iov{};
+    };
+}
+
+int main(const int argc, char *argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    in_addr sourceBase{}, destination{}, interfaceAddress{};
+    if (inet_pton(AF_INET, options.sourceIP.toRawUTF8(), &sourceBase) != 1
+        || inet_pton(AF_INET, options.destinationIP.toRawUTF8(), &destination) != 1
+        || (options.interfaceIP.isNotEmpty() && inet_pton(AF_INET, options.interfaceIP.toRawUTF8(), &interfaceAddress) != 1)) {
+        std::cerr << "Invalid address" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, [](int) { shouldExit.store(true); });
+    std::signal(SIGTERM, [](int) { shouldExit.store(true); });
+
+    if (options.simulate) {
+        return simulate(options, sourceBase);
+    }
+
+    const auto fd{socket(AF_INET, SOCK_DGRAM, 0)};
+    if (fd < 0) {
+        std::cerr << "Failed to create socket: " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    if (IN_MULTICAST(ntohl(destination.s_addr))) {
+        constexpr unsigned char loop{1};
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        if (options.interfaceIP.isNotEmpty()) {
+            setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interfaceAddress, sizeof(interfaceAddress));
+        }
+    }
+
+    const auto &fleetParams{options.fleet};
+    ClientFleet fleet{fleetParams};
+    std::vector<Message> pending;
+    std::vector<mmsghdr> headers;
+    uint64_t numSent{0}, numFailed{0};
+
+    const ClientFleet::Sink enqueue{
+        [&](const ClientFleet::Source source, const int index, const void *data, const size_t size)
+        {
+            auto &m{pending.emplace_back()};
+
+            m.destination.sin_family = AF_INET;
+            m.destination.sin_addr = destination;
+            m.destination.sin_port = htons(source == ClientFleet::Source::client
+                                               ? Server::Sockets::ClientListenerSocketParams.localPort
+                                               : Server::Sockets::AuthorityListenerSocketParams.localPort);
+
+            jassert(size <= m.data.size());
+            m.size = std::min(size, m.data.size());
+            memcpy(m.data.data(), data, m.size);
+
+            const auto sourceIndex{source == ClientFleet::Source::client ? index : fleetParams.numClients + index};
+            auto *c{reinterpret_cast<cmsghdr *>(m.control.data())};
+            c->cmsg_level = IPPROTO_IP;
+            c->cmsg_type = IP_PKTINFO;
+            c->cmsg_len = CMSG_LEN(sizeof(in_pktinfo));
+            in_pktinfo info{};
+            info.ipi_spec_dst.s_addr = htonl(ntohl(sourceBase.s_addr) + static_cast<uint32_t>(sourceIndex));
+            memcpy(CMSG_DATA(c), &info, sizeof(info));
+        }
+    };
+
+    std::cerr << "Announcing " << fleetParams.numClients << " clients and " << fleetParams.numAuthorities <<
+            " authorities from " << options.sourceIP << " to " << options.destinationIP << std::endl;
+
+    const auto startNs{getMonotonicNs()};
+    auto nextReportNs{startNs + ReportIntervalS * Server::Constants::NSPS};
+
+    while (!shouldExit.load()) {
+        const auto now{getMonotonicNs()};
+
+        pending.clear();
+        fleet.advance(now, enqueue);
+
+        // Addresses within pending are stable from here on.
+        headers.resize(pending.size());
+        for (size_t i{0}; i < pending.size(); ++i) {
+            auto &m{pending[i]};
+            m.iov = {m.data.data(), m.size};
+            headers[i] = {};
+            headers[i].msg_hdr.msg_name = &m.destination;
+            headers[i].msg_hdr.msg_namelen = sizeof(m.destination);
+            headers[i].msg_hdr.msg_iov = &m.iov;
+            headers[i].msg_hdr.msg_iovlen = 1;
+            headers[i].msg_hdr.msg_control = m.control.data();
+            headers[i].msg_hdr.msg_controllen = m.control.size();
+        }
+
+        for (size_t i{0}; i < headers.size();) {
+            const auto n{static_cast<unsigned>(std::min<size_t>(BatchSize, headers.size() - i))};
+            const auto result{sendmmsg(fd, &headers[i], n, 0)};
+            if (result <= 0) {
+                // Skip the message that failed, e.g. a source address that
+                // isn't assigned to any interface.
+                if (numFailed++ == 0) {
+                    std::cerr << "Send failed: " << strerror(errno) << std::endl;
+                }
+                ++i;
+                continue;
+            }
+            numSent += static_cast<uint64_t>(result);
+            i += static_cast<size_t>(result);
+        }
+
+        if (now >= nextReportNs) {
+            std::cerr << "sent=" << numSent << " failed=" << numFailed <<
+                    " connected=" << fleet.getNumConnected() << "/" << fleetParams.numClients <<
+                    " disconnections=" << fleet.getNumDisconnections() << std::endl;
+            nextReportNs += ReportIntervalS * Server::Constants::NSPS;
+
+            if (options.durationS > 0 && now - startNs >= options.durationS * Server::Constants::NSPS) {
+                break;
+            }
+        }
+
+        // Sleep until the next announcement (or report) is due.
+        const auto wakeNs{std::min(fleet.getNextDueNs(), nextReportNs)};
+        const timespec wake{
+            static_cast<time_t>(wakeNs / Server::Constants::NSPS),
+            static_cast<long>(wakeNs % Server::Constants::NSPS)
+        };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr);
+    }
+
+    close(fd);
+
+    return 0;
+}
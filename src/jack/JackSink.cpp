@@ -0,0 +1,172 @@
+#include "JackSink.h"
+#include <AnanasUtils.h>
+#include <Logger.h>
+
+namespace ananas
+{
+    JackSink::JackSink(juce::AudioSource &sink, const int numChannels)
+        : sink(sink),
+          numChannels(numChannels)
+    {
+    }
+
+    JackSink::~JackSink()
+    {
+        close();
+    }
+
+    bool JackSink::open(const juce::String &clientName, juce::String &error)
+    {
+        close();
+
+        jack_status_t status{};
+        client = jack_client_open(clientName.toRawUTF8(), JackNoStartServer, &status);
+        if (client == nullptr) {
+            error = "Can't connect to a JACK server (status 0x" + juce::String::toHexString(static_cast<int>(status)) + ")";
+            return false;
+        }
+
+        for (auto ch{0}; ch < numChannels; ++ch) {
+            const auto name{"in_" + juce::String{ch + 1}};
+            auto *port{jack_port_register(client, name.toRawUTF8(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput | JackPortIsTerminal, 0)};
+            if (port == nullptr) {
+                error = "Can't register port " + name;
+                close();
+                return false;
+            }
+            ports.push_back(port);
+        }
+
+        jack_set_process_callback(client, process, this);
+        jack_set_buffer_size_callback(client, bufferSizeChanged, this);
+        jack_set_xrun_callback(client, xrun, this);
+        jack_on_shutdown(client, shutdown, this);
+
+        sampleRate = static_cast<int>(jack_get_sample_rate(client));
+        bufferSize = static_cast<int>(jack_get_buffer_size(client));
+        buffer.setSize(numChannels, bufferSize);
+
+        // Ready before the first cycle.
+        sink.prepareToPlay(bufferSize, sampleRate);
+        prepared = true;
+
+        if (jack_activate(client) != 0) {
+            error = "Can't activate the JACK client";
+            close();
+            return false;
+        }
+
+        ANANAS_LOG_INFO("JACK client %s: %d channels, %d Hz, %d frames",
+                        jack_get_client_name(client), numChannels, sampleRate.load(), bufferSize.load());
+        return true;
+    }
+
+    void JackSink::close()
+    {
+        if (client != nullptr) {
+            // Waits for the process callback to return.
+            jack_deactivate(client);
+            jack_client_close(client);
+            client = nullptr;
+        }
+        ports.clear();
+
+        if (prepared) {
+            sink.releaseResources();
+            prepared = false;
+        }
+    }
+
+    bool JackSink::connectFrom(const juce::String &pattern)
+    {
+        if (client == nullptr) {
+            return false;
+        }
+
+        auto **sources{jack_get_ports(client, pattern.toRawUTF8(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput)};
+        if (sources == nullptr) {
+            return false;
+        }
+
+        auto ok{true};
+        for (size_t i{0}; sources[i] != nullptr && i < ports.size(); ++i) {
+            if (const auto result{jack_connect(client, sources[i], jack_port_name(ports[i]))};
+                result != 0 && result != EEXIST) {
+                ANANAS_LOG_WARNING("Can't connect %s to %s", sources[i], jack_port_name(ports[i]));
+                ok = false;
+            }
+        }
+
+        jack_free(sources);
+        return ok;
+    }
+
+    void JackSink::setShutdownCallback(std::function<void()> callback)
+    {
+        onShutdown = std::move(callback);
+    }
+
+    juce::var JackSink::getStats() const
+    {
+        const auto object{new juce::DynamicObject()};
+        object->setProperty(Utils::Identifiers::JackCyclesPropertyID, static_cast<juce::int64>(numCycles.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::JackXrunsPropertyID, static_cast<juce::int64>(numXruns.load(std::memory_order_relaxed)));
+        object->setProperty(Utils::Identifiers::JackBufferSizePropertyID, bufferSize.load(std::memory_order_relaxed));
+        object->setProperty(Utils::Identifiers::JackSampleRatePropertyID, sampleRate.load(std::memory_order_relaxed));
+        object->setProperty(Utils::Identifiers::JackCpuLoadPropertyID, client != nullptr ? jack_cpu_load(client) : 0.f);
+        return object;
+    }
+
+    int JackSink::process(const jack_nframes_t numFrames, void *arg)
+    {
+        auto &self{*static_cast<JackSink *>(arg)};
+        const auto n{static_cast<int>(numFrames)};
+
+        // JACK always processes whole periods, so this doesn't change the
+        // size, and if it did, it'd be to shrink, which doesn't allocate.
+        self.buffer.setSize(self.numChannels, n, false, false, true);
+
+        for (auto ch{0}; ch < self.numChannels; ++ch) {
+            const auto *in{static_cast<const float *>(jack_port_get_buffer(self.ports[static_cast<size_t>(ch)], numFrames))};
+            juce::FloatVectorOperations::copy(self.buffer.getWritePointer(ch), in, n);
+        }
+
+        const juce::AudioSourceChannelInfo info{&self.buffer, 0, n};
+        self.sink.getNextAudioBlock(info);
+
+        self.numCycles.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    int JackSink::bufferSizeChanged(const jack_nframes_t numFrames, void *arg)
+    {
+        auto &self{*static_cast<JackSink *>(arg)};
+
+        // Also called on activation, with the size open() prepared for.
+        if (static_cast<int>(numFrames) == self.bufferSize.load()) return 0;
+
+        // Not called during a cycle, so free to allocate, and to prepare the
+        // sink again, e.g. to size a Server's FIFOs for the new period.
+        self.bufferSize = static_cast<int>(numFrames);
+        self.buffer.setSize(self.numChannels, self.bufferSize);
+        if (self.prepared) {
+            self.sink.releaseResources();
+            self.sink.prepareToPlay(self.bufferSize, self.sampleRate);
+        }
+        ANANAS_LOG_INFO("JACK buffer size now %d frames", self.bufferSize.load());
+        return 0;
+    }
+
+    int JackSink::xrun(void *arg)
+    {
+        static_cast<JackSink *>(arg)->numXruns.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    void JackSink::shutdown(void *arg)
+    {
+        if (const auto &callback{static_cast<JackSink *>(arg)->onShutdown}) {
+            callback();
+        }
+    }
+}
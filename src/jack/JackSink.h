@@ -0,0 +1,87 @@
+#ifndef ANANASJACKSINK_H
+#define ANANASJACKSINK_H
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <jack/jack.h>
+
+namespace ananas
+{
+    /**
+     * A JACK client with an input port per channel, whose process callback
+     * feeds whatever's routed to it into a sink (e.g. a Server), so JACK's
+     * graph, rather than a sound card or a SourceStreamer, clocks the
+     * stream.
+     *
+     * The process callback only copies the port buffers into a buffer
+     * allocated up front (JACK may hand out new port buffers every cycle,
+     * and wrapping more than a few dozen of them in an AudioBuffer would
+     * allocate) and calls the sink: no allocation, locks or system calls
+     * beyond the sink's own.
+     */
+    class JackSink
+    {
+    public:
+        JackSink(juce::AudioSource &sink, int numChannels);
+
+        ~JackSink();
+
+        /**
+         * Connect to a running JACK server, register ports in_1...in_n,
+         * prepare the sink and start processing.
+         * @return false, with a description in error, if any of that fails.
+         */
+        bool open(const juce::String &clientName, juce::String &error);
+
+        /**
+         * Stop processing, disconnect from the server, and release the sink.
+         */
+        void close();
+
+        /**
+         * Connect the output ports matching a regular expression (e.g.
+         * "system:capture_.*", or a client's name) to the input ports, in
+         * order, as far as they go.
+         * @return false if nothing matched, or a connection failed.
+         */
+        bool connectFrom(const juce::String &pattern);
+
+        /**
+         * Called, from a JACK thread, if the JACK server shuts down or
+         * throws the client out. Set before open().
+         */
+        void setShutdownCallback(std::function<void()> callback);
+
+        /**
+         * @return Cycles processed, xruns, the buffer size and sample rate,
+         * and JACK's DSP load, in percent.
+         */
+        [[nodiscard]] juce::var getStats() const;
+
+    private:
+        static int process(jack_nframes_t numFrames, void *arg);
+
+        static int bufferSizeChanged(jack_nframes_t numFrames, void *arg);
+
+        static int xrun(void *arg);
+
+        static void shutdown(void *arg);
+
+        juce::AudioSource &sink;
+        const int numChannels;
+
+        jack_client_t *client{nullptr};
+        std::vector<jack_port_t *> ports;
+        juce::AudioBuffer<float> buffer;
+        bool prepared{false};
+        std::function<void()> onShutdown;
+
+        std::atomic<uint64_t> numCycles{0};
+        std::atomic<uint64_t> numXruns{0};
+        std::atomic<int> bufferSize{0};
+        std::atomic<int> sampleRate{0};
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(JackSink)
+    };
+}
+
+#endif //ANANASJACKSINK_H
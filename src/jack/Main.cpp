@@ -0,0 +1,150 @@
+#include "JackSink.h"
+#include <EventLoop.h>
+#include <Logger.h>
+#include <Server.h>
+#include <csignal>
+#include <thread>
+
+using namespace ananas;
+
+namespace
+{
+    const juce::Identifier MetricsID{"metrics"};
+    const juce::Identifier JackID{"jack"};
+
+    void printUsage(const char *name)
+    {
+        std::cerr << "Usage: " << name << " [--name=client] [--channels=n] [--connect=pattern]"
+                " [--realtime] [--loopback] [--stats=seconds]" << std::endl;
+    }
+
+    /**
+     * One line of JSON per interval: the server's metrics, and the JACK
+     * client's.
+     */
+    class StatsReporter final : public ClockTimer
+    {
+    public:
+        StatsReporter(Clock &clock, Server::Server &server, JackSink &sink)
+            : ClockTimer(clock),
+              server(server),
+              sink(sink)
+        {
+        }
+
+        void timerCallback() override
+        {
+            const auto object{new juce::DynamicObject()};
+            object->setProperty(MetricsID, server.getMetrics());
+            object->setProperty(JackID, sink.getStats());
+
+            std::cout << juce::JSON::toString(juce::var{object}, true) << std::endl;
+
+            server.resetMetrics();
+        }
+
+    private:
+        Server::Server &server;
+        JackSink &sink;
+    };
+}
+
+int main(const int argc, char *argv[])
+{
+    juce::String clientName{"ananas"};
+    auto numChannels{2};
+    juce::String connectPattern;
+    auto realtime{false};
+    auto loopback{false};
+    auto statsIntervalS{0};
+
+    for (auto i{1}; i < argc; ++i) {
+        const juce::String arg{argv[i]};
+        const auto value{arg.fromFirstOccurrenceOf("=", false, false)};
+
+        if (arg.startsWith("--name=")) {
+            clientName = value;
+        } else if (arg.startsWith("--channels=")) {
+            numChannels = value.getIntValue();
+        } else if (arg.startsWith("--connect=")) {
+            connectPattern = value;
+        } else if (arg == "--realtime") {
+            realtime = true;
+        } else if (arg == "--loopback") {
+            loopback = true;
+        } else if (arg.startsWith("--stats=")) {
+            statsIntervalS = value.getIntValue();
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (numChannels < 1 || clientName.isEmpty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // As ananasd: take the signals on a thread of our own, and hand them to
+    // the loop.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    EventLoop loop;
+    Server::Server server{static_cast<uint>(numChannels), loop};
+
+    // These must happen before the server's threads are started. JACK runs
+    // its own process thread at realtime priority, where permitted.
+    if (realtime) {
+        server.setThreadPolicy(Server::Sockets::AudioSenderSocketParams.name, Server::Threads::AudioSenderPolicy);
+        server.setThreadPolicy(Server::Sockets::TimestampListenerSocketParams.name, Server::Threads::TimestampListenerPolicy);
+        server.setMemoryLocked(true);
+    }
+    server.setMulticastLoopback(loopback);
+
+    JackSink sink{server, numChannels};
+    sink.setShutdownCallback([&loop]
+    {
+        ANANAS_LOG_ERROR("JACK server went away; exiting.");
+        loop.quit();
+    });
+
+    if (juce::String error; !sink.open(clientName, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    if (connectPattern.isNotEmpty() && !sink.connectFrom(connectPattern)) {
+        ANANAS_LOG_WARNING("Couldn't connect all ports matching %s", connectPattern.toRawUTF8());
+    }
+
+    StatsReporter statsReporter{loop, server, sink};
+    if (statsIntervalS > 0) {
+        statsReporter.startTimer(statsIntervalS * 1000);
+    }
+
+    std::thread signalThread{
+        [&loop, signals]
+        {
+            auto signal{0};
+            while (sigwait(&signals, &signal) != 0) {
+            }
+            loop.quit();
+        }
+    };
+
+    loop.run();
+
+    statsReporter.stopTimer();
+    sink.close();
+
+    // If the loop quit for any other reason, the signal thread is still
+    // waiting; wake it.
+    pthread_kill(signalThread.native_handle(), SIGTERM);
+    signalThread.join();
+
+    return 0;
+}
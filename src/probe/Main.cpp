@@ -0,0 +1,323 @@
+#include <juce_core/juce_core.h>
+#include <ServerUtils.h>
+#include <ThreadPolicy.h>
+#include <arpa/inet.h>
+#include <csignal>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "StreamProbe.h"
+
+using namespace ananas;
+
+namespace
+{
+    constexpr int BatchSize{64};
+    constexpr int ReceiveTimeoutMs{100};
+    constexpr int ReceiveBufferBytes{1 << 22};
+
+    std::atomic<bool> shouldExit{false};
+
+    struct Options
+    {
+        juce::String groupIP{Server::Sockets::AudioSenderSocketParams.ip};
+        int port{Server::Sockets::AudioSenderSocketParams.remotePort};
+        juce::String interfaceIP{"0.0.0.0"};
+        int reportIntervalS{1};
+        int durationS{0};
+        int cpu{-1};
+        bool json{false};
+        StreamProbe::Options probe;
+    };
+
+    void printUsage(const char *name)
+    {
+        std::cerr << "Usage: " << name << " [--group=ip] [--port=port] [--interface=ip]"
+                " [--compressed] [--test-signal] [--fec] [--buffer=packets] [--sample-rate=hz]"
+                " [--interval=seconds] [--duration=seconds] [--cpu=n] [--json]" << std::endl;
+    }
+
+    bool parseOptions(const int argc, char *argv[], Options &options)
+    {
+        for (auto i{1}; i < argc; ++i) {
+            const juce::String arg{argv[i]};
+            const auto value{arg.fromFirstOccurrenceOf("=", false, false)};
+
+            if (arg.startsWith("--group=")) {
+                options.groupIP = value;
+            } else if (arg.startsWith("--port=")) {
+                options.port = value.getIntValue();
+            } else if (arg.startsWith("--interface=")) {
+                options.interfaceIP = value;
+            } else if (arg == "--compressed") {
+                options.probe.compressed = true;
+            } else if (arg == "--test-signal") {
+                options.probe.testSignal = true;
+            } else if (arg == "--fec") {
+                options.probe.fec = true;
+            } else if (arg.startsWith("--buffer=")) {
+                options.probe.bufferSizePackets = juce::jmax(1, value.getIntValue());
+            } else if (arg.startsWith("--sample-rate=")) {
+                options.probe.sampleRate = juce::jmax(1., value.getDoubleValue());
+            } else if (arg.startsWith("--interval=")) {
+                options.reportIntervalS = juce::jmax(1, value.getIntValue());
+            } else if (arg.startsWith("--duration=")) {
+                options.durationS = juce::jmax(0, value.getIntValue());
+            } else if (arg.startsWith("--cpu=")) {
+                options.cpu = value.getIntValue();
+            } else if (arg == "--json") {
+                options.json = true;
+            } else {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    int openSocket(const Options &options, const int port)
+    {
+        const auto fd{socket(AF_INET, SOCK_DGRAM, 0)};
+        if (fd < 0) return -1;
+
+        const auto fail{
+            [fd](const char *what)
+            {
+                std::cerr << what << ": " << strerror(errno) << std::endl;
+                close(fd);
+                return -1;
+            }
+        };
+
+        constexpr int enable{1};
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+
+        // Kernel receive timestamps, so that jitter measures the network
+        // rather than this process's scheduling.
+        if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) < 0) {
+            return fail("Failed to enable receive timestamps");
+        }
+
+        // Ride out scheduling hiccups without dropping at the socket.
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &ReceiveBufferBytes, sizeof(ReceiveBufferBytes));
+
+        const timeval timeout{0, ReceiveTimeoutMs * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+            return fail("Failed to bind socket");
+        }
+
+        ip_mreq membership{};
+        if (inet_pton(AF_INET, options.groupIP.toRawUTF8(), &membership.imr_multiaddr) != 1
+            || inet_pton(AF_INET, options.interfaceIP.toRawUTF8(), &membership.imr_interface) != 1) {
+            std::cerr << "Invalid group or interface address" << std::endl;
+            close(fd);
+            return -1;
+        }
+        if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0) {
+            return fail("Failed to join multicast group");
+        }
+
+        return fd;
+    }
+
+    int64_t getRealtimeNs()
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return ts.tv_sec * Server::Constants::NSPS + ts.tv_nsec;
+    }
+
+    void report(const StreamProbe &probe, const bool json)
+    {
+        using Ids = Utils::Identifiers;
+        const auto stats{probe.toVar()};
+
+        if (json) {
+            std::cout << juce::JSON::toString(stats, true) << std::endl;
+            return;
+        }
+
+        const auto us{
+            [&stats](const juce::Identifier &histogram, const juce::Identifier &id)
+            {
+                return juce::String{static_cast<double>(stats[histogram][id]) / 1000., 1};
+            }
+        };
+
+        std::cout << "packets=" << stats[Ids::ProbePacketsPropertyID].toString() <<
+                " gaps=" << stats[Ids::ProbeGapsPropertyID].toString() <<
+                " recovered=" << stats[Ids::ProbeRecoveredPropertyID].toString() <<
+                " dup=" << stats[Ids::ProbeDuplicatesPropertyID].toString() <<
+                " stale=" << stats[Ids::ProbeStalePropertyID].toString() <<
+                " malformed=" << stats[Ids::ProbeMalformedPropertyID].toString() <<
+                " truncated=" << stats[Ids::ProbeTruncatedPropertyID].toString() <<
+                " corrupt=" << stats[Ids::ProbeCorruptPropertyID].toString() <<
+                " discont=" << stats[Ids::ProbeDiscontinuitiesPropertyID].toString() <<
+                " under=" << stats[Ids::ProbeUnderflowsPropertyID].toString() <<
+                " over=" << stats[Ids::ProbeOverflowsPropertyID].toString() <<
+                " steps=" << stats[Ids::ProbeTimestampStepsPropertyID].toString() <<
+                " | jitter=" << juce::String{static_cast<double>(stats[Ids::ProbeJitterPropertyID]) / 1000., 1} <<
+                " transit p99=" << us(Ids::ProbeTransitPropertyID, Ids::HistogramP99PropertyID) <<
+                " max=" << us(Ids::ProbeTransitPropertyID, Ids::HistogramMaxPropertyID) <<
+                " | headroom min=" << us(Ids::ProbeHeadroomPropertyID, Ids::HistogramMinPropertyID) <<
+                " p50=" << us(Ids::ProbeHeadroomPropertyID, Ids::HistogramP50PropertyID) <<
+                " max=" << us(Ids::ProbeHeadroomPropertyID, Ids::HistogramMaxPropertyID) << " us" << std::endl;
+    }
+}
+
+int main(const int argc, char *argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.cpu >= 0) {
+        ThreadPolicy policy;
+        policy.affinityMask = uint64_t{1} << options.cpu;
+        std::cerr << juce::JSON::toString(policy.applyToCurrentThread(), true) << std::endl;
+    }
+
+    const auto fd{openSocket(options, options.port)};
+    if (fd < 0) return 1;
+
+    auto fecFd{-1};
+    if (options.probe.fec) {
+        fecFd = openSocket(options, options.port + Server::Constants::FecPortOffset);
+        if (fecFd < 0) {
+            close(fd);
+            return 1;
+        }
+    }
+
+    std::signal(SIGINT, [](int) { shouldExit.store(true); });
+    std::signal(SIGTERM, [](int) { shouldExit.store(true); });
+
+    std::cerr << "Listening on " << options.groupIP << ":" << options.port <<
+            " via " << options.interfaceIP;
+    if (fecFd >= 0) {
+        std::cerr << ", parity on port " << options.port + Server::Constants::FecPortOffset;
+    }
+    std::cerr << std::endl;
+
+    StreamProbe probe{options.probe};
+
+    // Receive in batches, so that one core keeps up at line rate.
+    constexpr auto ControlSize{CMSG_SPACE(sizeof(timespec))};
+    const auto slotSize{StreamProbe::getMaxDatagramSize()};
+    std::vector<uint8_t> buffers(BatchSize * slotSize);
+    std::vector<uint8_t> control(BatchSize * ControlSize);
+    std::array<iovec, BatchSize> iovecs{};
+    std::array<mmsghdr, BatchSize> messages{};
+
+    for (auto i{0}; i < BatchSize; ++i) {
+        iovecs[i] = {&buffers[i * slotSize], slotSize};
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_control = &control[i * ControlSize];
+    }
+
+    const auto startNs{getRealtimeNs()};
+    auto nextReportNs{startNs + options.reportIntervalS * Server::Constants::NSPS};
+
+    const auto receive{
+        [&messages](const int socket, const int flags) -> int
+        {
+            for (auto &m: messages) {
+                m.msg_hdr.msg_controllen = ControlSize;
+            }
+
+            const auto numReceived{recvmmsg(socket, messages.data(), BatchSize, flags, nullptr)};
+
+            if (numReceived < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "Receive failed: " << strerror(errno) << std::endl;
+                return -1;
+            }
+
+            return std::max(0, numReceived);
+        }
+    };
+
+    while (!shouldExit.load()) {
+        // With parity to receive too, wait on both sockets, then take what's
+        // there from each without blocking; audio first, since a group's
+        // parity follows its data.
+        auto audioReady{true}, parityReady{false};
+        if (fecFd >= 0) {
+            std::array<pollfd, 2> fds{{{fd, POLLIN, 0}, {fecFd, POLLIN, 0}}};
+            poll(fds.data(), fds.size(), ReceiveTimeoutMs);
+            audioReady = (fds[0].revents & POLLIN) != 0;
+            parityReady = (fds[1].revents & POLLIN) != 0;
+        }
+
+        const auto numReceived{audioReady ? receive(fd, fecFd >= 0 ? MSG_DONTWAIT : MSG_WAITFORONE) : 0};
+        if (numReceived < 0) break;
+
+        for (auto i{0}; i < numReceived; ++i) {
+            auto &header{messages[i].msg_hdr};
+            if ((header.msg_flags & MSG_TRUNC) != 0) {
+                probe.handleTruncatedPacket();
+                continue;
+            }
+
+            auto arrivalNs{int64_t{0}};
+
+            for (auto *c{CMSG_FIRSTHDR(&header)}; c != nullptr; c = CMSG_NXTHDR(&header, c)) {
+                if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+                    timespec ts{};
+                    memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+                    arrivalNs = ts.tv_sec * Server::Constants::NSPS + ts.tv_nsec;
+                }
+            }
+
+            probe.handlePacket(static_cast<const uint8_t *>(iovecs[i].iov_base),
+                               messages[i].msg_len,
+                               arrivalNs > 0 ? arrivalNs : getRealtimeNs());
+        }
+
+        if (parityReady) {
+            const auto numParity{receive(fecFd, MSG_DONTWAIT)};
+            if (numParity < 0) break;
+
+            for (auto i{0}; i < numParity; ++i) {
+                if ((messages[i].msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+                    probe.handleTruncatedPacket();
+                    continue;
+                }
+                probe.handleParityPacket(static_cast<const uint8_t *>(iovecs[i].iov_base), messages[i].msg_len);
+            }
+        }
+
+        if (const auto now{getRealtimeNs()}; now >= nextReportNs) {
+            report(probe, options.json);
+            probe.reset();
+            nextReportNs += options.reportIntervalS * Server::Constants::NSPS;
+
+            if (options.durationS > 0 && now - startNs >= options.durationS * Server::Constants::NSPS) {
+                break;
+            }
+        }
+    }
+
+    // Whatever was left of the last interval.
+    if (shouldExit.load()) {
+        report(probe, options.json);
+    }
+
+    close(fd);
+    if (fecFd >= 0) {
+        close(fecFd);
+    }
+
+    return 0;
+}
@@ -0,0 +1,262 @@
+#include "StreamProbe.h"
+#include <AudioStream.h>
+#include <TestSignal.h>
+
+namespace ananas
+{
+    StreamProbe::StreamProbe(const Options &options)
+        : options(options)
+    {
+        if (options.fec) {
+            fecDecoder.prepare(AudioStream::getMaxPacketSize(std::numeric_limits<uint8_t>::max()));
+            repaired.resize(AudioStream::getMaxPacketSize(std::numeric_limits<uint8_t>::max()));
+        }
+    }
+
+    size_t StreamProbe::getMaxDatagramSize()
+    {
+        return sizeof(Fec::Header) + AudioStream::getMaxPacketSize(std::numeric_limits<uint8_t>::max());
+    }
+
+    void StreamProbe::handlePacket(const uint8_t *data, const size_t size, const int64_t arrivalNs)
+    {
+        handleDataPacket(data, size, arrivalNs, false);
+    }
+
+    void StreamProbe::handleParityPacket(const uint8_t *data, const size_t size)
+    {
+        if (!options.fec) return;
+
+        if (size_t repairedSize{0}; fecDecoder.addParityPacket(data, size, repaired.data(), repairedSize)) {
+            handleDataPacket(repaired.data(), repairedSize, 0, true);
+        }
+    }
+
+    void StreamProbe::handleTruncatedPacket()
+    {
+        ++counters.truncated;
+    }
+
+    void StreamProbe::handleDataPacket(const uint8_t *data, const size_t size, const int64_t arrivalNs, const bool isRepair)
+    {
+        if (size < sizeof(AudioPacket::Header)) {
+            ++counters.malformed;
+            return;
+        }
+
+        AudioPacket::Header header;
+        memcpy(&header, data, sizeof(AudioPacket::Header));
+
+        if (!isRepair) {
+            ++counters.packets;
+            counters.bytes += size;
+        }
+
+        int64_t sequenceNumber;
+        auto inOrder{false};
+        if (!trackSequenceNumber(header.sequenceNumber, isRepair, sequenceNumber, inOrder)) return;
+
+        if (isRepair) {
+            // The decoder keeps its own repairs.
+            ++counters.recovered;
+        } else {
+            if (options.fec) {
+                fecDecoder.addDataPacket(data, size);
+            }
+            trackTiming(header.timestamp, arrivalNs, inOrder);
+        }
+        checkPayload(header, &data[sizeof(AudioPacket::Header)], size - sizeof(AudioPacket::Header), sequenceNumber);
+    }
+
+    bool StreamProbe::trackSequenceNumber(const uint16_t sequenceNumber, const bool isRepair, int64_t &extended, bool &inOrder)
+    {
+        const auto slot{
+            [this](const int64_t s) -> bool & { return received[static_cast<size_t>(s % SequenceWindow)]; }
+        };
+
+        if (!started) {
+            started = true;
+            highestSequenceNumber = sequenceNumber;
+            slot(highestSequenceNumber) = true;
+            extended = highestSequenceNumber;
+            return true;
+        }
+
+        // Extend to 64 bits relative to the highest sequence number so far;
+        // a forward jump of more than half the sequence space reads as a
+        // (stale) step backwards.
+        const auto delta{static_cast<int16_t>(static_cast<uint16_t>(sequenceNumber - static_cast<uint16_t>(highestSequenceNumber)))};
+        extended = highestSequenceNumber + delta;
+
+        if (delta > 0) {
+            // Anything skipped is missing until it turns up.
+            for (auto s{highestSequenceNumber + 1}; s < extended && s <= highestSequenceNumber + SequenceWindow; ++s) {
+                slot(s) = false;
+            }
+            // A repair stands in for a packet that never arrived.
+            counters.gaps += static_cast<uint64_t>(isRepair ? delta : delta - 1);
+            highestSequenceNumber = extended;
+            slot(extended) = true;
+            inOrder = delta == 1;
+            return true;
+        }
+
+        if (highestSequenceNumber - extended >= SequenceWindow) {
+            ++counters.stale;
+            return false;
+        }
+
+        if (slot(extended)) {
+            ++counters.duplicates;
+            return false;
+        }
+
+        // A late arrival fills its gap too, but only a repair counts as
+        // recovered.
+        slot(extended) = true;
+        if (!isRepair) {
+            ++counters.reordered;
+        }
+        return true;
+    }
+
+    void StreamProbe::trackTiming(const int64_t timestampNs, const int64_t arrivalNs, const bool inOrder)
+    {
+        const auto transitNs{arrivalNs - timestampNs};
+        const auto bufferNs{getBufferDurationNs()};
+
+        // The client plays each packet at its timestamp; start out with half
+        // a buffer in hand.
+        if (!anchored) {
+            anchored = true;
+            anchorTimestampNs = timestampNs;
+            anchorArrivalNs = arrivalNs;
+        }
+
+        const auto headroomNs{(timestampNs - anchorTimestampNs) - (arrivalNs - anchorArrivalNs) + bufferNs / 2};
+
+        if (headroomNs < -2 * bufferNs || headroomNs > 3 * bufferNs) {
+            // The server has stepped its timestamps (e.g. it has just
+            // started following PTP); a client would resynchronise, and so
+            // does the emulation.
+            ++counters.timestampSteps;
+            anchorTimestampNs = timestampNs;
+            anchorArrivalNs = arrivalNs;
+            minTransitNs = transitNs;
+            lastTransitNs = transitNs;
+            return;
+        }
+
+        if (headroomNs < 0) {
+            ++counters.underflows;
+        } else if (headroomNs > bufferNs) {
+            ++counters.overflows;
+        }
+        headroom.record(headroomNs);
+
+        minTransitNs = std::min(minTransitNs, transitNs);
+        transit.record(transitNs - minTransitNs);
+
+        if (inOrder) {
+            const auto d{std::abs(transitNs - lastTransitNs)};
+            transitDelta.record(d);
+            jitterNs += (static_cast<double>(d) - jitterNs) / 16.;
+        }
+        lastTransitNs = transitNs;
+    }
+
+    void StreamProbe::checkPayload(const AudioPacket::Header &header,
+                                   const uint8_t *payload,
+                                   const size_t payloadSize,
+                                   const int64_t sequenceNumber)
+    {
+        const auto pcmSize{static_cast<size_t>(header.numChannels) * header.numFrames * sizeof(int16_t)};
+
+        if (header.numChannels != numChannels || header.numFrames != numFrames) {
+            numChannels = header.numChannels;
+            numFrames = header.numFrames;
+            codec.prepare(numChannels, numFrames);
+            pcm.resize(pcmSize);
+            haveReferenceFrame = false;
+        }
+
+        const uint8_t *audio{payload};
+
+        if (options.compressed) {
+            if (!codec.decode(payload, payloadSize, pcm.data())) {
+                ++counters.malformed;
+                return;
+            }
+            audio = pcm.data();
+        } else if (payloadSize != pcmSize) {
+            ++counters.malformed;
+            return;
+        }
+
+        if (!options.testSignal) return;
+
+        uint16_t firstFrame;
+        if (!TestSignal::verify(audio, numChannels, numFrames, firstFrame)) {
+            ++counters.corrupt;
+            return;
+        }
+
+        // Packets n apart should carry audio n packets apart; if not, the
+        // server dropped or repeated some between the FIFO and the wire.
+        if (haveReferenceFrame) {
+            const auto expected{
+                static_cast<uint16_t>(referenceFrame + (sequenceNumber - referenceSequenceNumber) * numFrames)
+            };
+            if (firstFrame != expected) {
+                ++counters.discontinuities;
+            }
+        }
+
+        if (!haveReferenceFrame || sequenceNumber > referenceSequenceNumber) {
+            haveReferenceFrame = true;
+            referenceSequenceNumber = sequenceNumber;
+            referenceFrame = firstFrame;
+        }
+    }
+
+    int64_t StreamProbe::getBufferDurationNs() const
+    {
+        const auto framesPerPacket{numFrames > 0 ? numFrames : static_cast<int>(Server::Constants::FramesPerPacket)};
+        return static_cast<int64_t>(static_cast<double>(Server::Constants::NSPS) * framesPerPacket * options.bufferSizePackets / options.sampleRate);
+    }
+
+    juce::var StreamProbe::toVar() const
+    {
+        using Ids = Utils::Identifiers;
+        const auto object{new juce::DynamicObject()};
+
+        object->setProperty(Ids::ProbePacketsPropertyID, static_cast<juce::int64>(counters.packets));
+        object->setProperty(Ids::ProbeBytesPropertyID, static_cast<juce::int64>(counters.bytes));
+        object->setProperty(Ids::ProbeGapsPropertyID, static_cast<juce::int64>(counters.gaps));
+        object->setProperty(Ids::ProbeRecoveredPropertyID, static_cast<juce::int64>(counters.recovered));
+        object->setProperty(Ids::ProbeReorderedPropertyID, static_cast<juce::int64>(counters.reordered));
+        object->setProperty(Ids::ProbeDuplicatesPropertyID, static_cast<juce::int64>(counters.duplicates));
+        object->setProperty(Ids::ProbeStalePropertyID, static_cast<juce::int64>(counters.stale));
+        object->setProperty(Ids::ProbeMalformedPropertyID, static_cast<juce::int64>(counters.malformed));
+        object->setProperty(Ids::ProbeTruncatedPropertyID, static_cast<juce::int64>(counters.truncated));
+        object->setProperty(Ids::ProbeCorruptPropertyID, static_cast<juce::int64>(counters.corrupt));
+        object->setProperty(Ids::ProbeDiscontinuitiesPropertyID, static_cast<juce::int64>(counters.discontinuities));
+        object->setProperty(Ids::ProbeUnderflowsPropertyID, static_cast<juce::int64>(counters.underflows));
+        object->setProperty(Ids::ProbeOverflowsPropertyID, static_cast<juce::int64>(counters.overflows));
+        object->setProperty(Ids::ProbeTimestampStepsPropertyID, static_cast<juce::int64>(counters.timestampSteps));
+        object->setProperty(Ids::ProbeJitterPropertyID, jitterNs);
+        object->setProperty(Ids::ProbeTransitPropertyID, transit.toVar());
+        object->setProperty(Ids::ProbeTransitDeltaPropertyID, transitDelta.toVar());
+        object->setProperty(Ids::ProbeHeadroomPropertyID, headroom.toVar());
+
+        return object;
+    }
+
+    void StreamProbe::reset()
+    {
+        counters = {};
+        transit.reset();
+        transitDelta.reset();
+        headroom.reset();
+    }
+}
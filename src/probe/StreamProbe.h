@@ -0,0 +1,175 @@
+#ifndef ANANASSTREAMPROBE_H
+#define ANANASSTREAMPROBE_H
+
+#include <juce_core/juce_core.h>
+#include <Codec.h>
+#include <Fec.h>
+#include <Metrics.h>
+#include <Packet.h>
+#include <ServerUtils.h>
+
+namespace ananas
+{
+    /**
+     * Stream quality measurement for one received audio stream, as a client
+     * would see it: sequence gaps, reordering and duplicates, and, given the
+     * stream's parity packets, which gaps FEC repairs; arrival jitter
+     * against header timestamps; integrity of the test signal (see
+     * TestSignal), if that's what's being sent; and the occupancy of an
+     * emulated client packet buffer.
+     *
+     * The emulated buffer plays each packet at its header timestamp, offset
+     * so that the first packet arrives with the buffer half full, which is
+     * where PacketOffsetNs aims to keep real clients. A packet that arrives
+     * after its play time would have underflowed the buffer; one that
+     * arrives more than a buffer ahead would have overflowed it.
+     *
+     * Not thread-safe; call everything from the receiving thread.
+     */
+    class StreamProbe
+    {
+    public:
+        struct Options
+        {
+            /**
+             * Payloads are AudioCodec-encoded.
+             */
+            bool compressed{false};
+            /**
+             * Check payloads against TestSignal.
+             */
+            bool testSignal{false};
+            /**
+             * Parity packets are passed to handleParityPacket(), and used to
+             * repair gaps, as a client would.
+             */
+            bool fec{false};
+            int bufferSizePackets{static_cast<int>(Server::Constants::ClientPacketBufferSize)};
+            double sampleRate{48000.};
+        };
+
+        /**
+         * How far back, in packets, reordered and duplicate packets are
+         * recognised; anything older is counted as stale.
+         */
+        constexpr static int SequenceWindow{1024};
+
+        explicit StreamProbe(const Options &options);
+
+        /**
+         * The largest datagram a stream can send: parity for an uncompressed
+         * packet of as many channels as a header can describe. Receive into
+         * buffers at least this big.
+         */
+        static size_t getMaxDatagramSize();
+
+        /**
+         * @param arrivalNs The packet's receive time, in the same timescale
+         * as its header timestamp (or at least one running at the same rate).
+         */
+        void handlePacket(const uint8_t *data, size_t size, int64_t arrivalNs);
+
+        /**
+         * Pass a packet from the stream's FEC port; if it repairs a missing
+         * packet, that's handled as if it had just arrived, though without
+         * contributing to the timing statistics.
+         */
+        void handleParityPacket(const uint8_t *data, size_t size);
+
+        /**
+         * Count a datagram that didn't fit its receive buffer, audio or
+         * parity; it's otherwise ignored.
+         */
+        void handleTruncatedPacket();
+
+        /**
+         * @return Counters and histograms since the last reset.
+         */
+        [[nodiscard]] juce::var toVar() const;
+
+        /**
+         * Start a new measurement interval. Sequence and buffer state carry
+         * over.
+         */
+        void reset();
+
+    private:
+        struct Counters
+        {
+            uint64_t packets{0};
+            uint64_t bytes{0};
+            // Packets missing when a later one arrived.
+            uint64_t gaps{0};
+            // Gaps filled by FEC repair; the probe doesn't ask for
+            // retransmissions, so sees none.
+            uint64_t recovered{0};
+            // Gaps filled by the packet itself, arriving late.
+            uint64_t reordered{0};
+            uint64_t duplicates{0};
+            uint64_t stale{0};
+            uint64_t malformed{0};
+            // Datagrams bigger than the receive buffer.
+            uint64_t truncated{0};
+            uint64_t corrupt{0};
+            uint64_t discontinuities{0};
+            uint64_t underflows{0};
+            uint64_t overflows{0};
+            uint64_t timestampSteps{0};
+        };
+
+        const Options options;
+        Counters counters;
+
+        // Arrival minus header timestamp, relative to the lowest seen.
+        Histogram transit;
+        // Change in transit time between consecutive packets.
+        Histogram transitDelta;
+        // Time left before the packet would be played out.
+        Histogram headroom;
+        // RFC 3550 interarrival jitter estimate.
+        double jitterNs{0.};
+
+        bool started{false};
+        int64_t highestSequenceNumber{0};
+        std::array<bool, SequenceWindow> received{};
+        int64_t lastTransitNs{0};
+        int64_t minTransitNs{std::numeric_limits<int64_t>::max()};
+
+        bool anchored{false};
+        int64_t anchorTimestampNs{0};
+        int64_t anchorArrivalNs{0};
+
+        FecDecoder fecDecoder;
+        std::vector<uint8_t> repaired;
+
+        uint8_t numChannels{0};
+        uint16_t numFrames{0};
+        AudioCodec codec;
+        std::vector<uint8_t> pcm;
+        // The last packet whose test signal checked out.
+        bool haveReferenceFrame{false};
+        int64_t referenceSequenceNumber{0};
+        uint16_t referenceFrame{0};
+
+        void handleDataPacket(const uint8_t *data, size_t size, int64_t arrivalNs, bool isRepair);
+
+        /**
+         * @param isRepair The packet was reconstructed from parity, rather
+         * than received.
+         * @param extended Set to the sequence number, extended to 64 bits.
+         * @param inOrder Set to true if the packet directly follows the
+         * previous highest.
+         * @return true if the packet is new, i.e. neither a duplicate nor
+         * stale.
+         */
+        bool trackSequenceNumber(uint16_t sequenceNumber, bool isRepair, int64_t &extended, bool &inOrder);
+
+        void trackTiming(int64_t timestampNs, int64_t arrivalNs, bool inOrder);
+
+        void checkPayload(const AudioPacket::Header &header, const uint8_t *payload, size_t payloadSize, int64_t sequenceNumber);
+
+        [[nodiscard]] int64_t getBufferDurationNs() const;
+    };
+}
+
+#endif //ANANASSTREAMPROBE_H
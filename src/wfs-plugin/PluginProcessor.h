@@ -22,6 +22,8 @@ public:
 
     void releaseResources() override;
 
+    void setNonRealtime(bool nonRealtime) noexcept override;
+
     void processBlock(juce::AudioBuffer<float> &buffer, juce::MidiBuffer &midiMessages) override;
 
     void processBlock(juce::AudioBuffer<double> &buffer, juce::MidiBuffer &midiMessages) override;
@@ -81,6 +83,10 @@ private:
 
     std::unique_ptr<ananas::Server::Server> server;
 
+    // What the host last prepared with; zero if released.
+    double preparedSampleRate{0.};
+    int preparedBlockSize{0};
+
     // For handling (audio) parameters that are known at compile time.
     juce::AudioProcessorValueTreeState apvts;
     // For handling data that is not known until runtime.
@@ -0,0 +1,195 @@
+#include <juce_core/juce_core.h>
+#include <Codec.h>
+#include <ServerUtils.h>
+#include <TestSignal.h>
+
+namespace ananas
+{
+    /**
+     * AudioCodec is lossless: whatever goes in comes back byte for byte,
+     * by way of prediction, escaped residuals, or the raw fallback; and a
+     * payload that's been cut short or made up is rejected, not decoded.
+     */
+    class CodecTests final : public juce::UnitTest
+    {
+    public:
+        CodecTests() : UnitTest("Codec round trip", "ananas")
+        {
+        }
+
+        void runTest() override
+        {
+            random = getRandom();
+
+            beginTest("Every signal comes back byte for byte");
+            for (const auto numChannels: {2, 16, 64}) {
+                for (const auto &[name, signal]: getSignals()) {
+                    AudioCodec codec;
+                    codec.prepare(static_cast<uint>(numChannels), FramesPerPacket);
+                    for (auto p{0}; p < NumPackets; ++p) {
+                        roundTrip(codec, numChannels, signal, p * FramesPerPacket, name + ", " + juce::String{numChannels} + " channels");
+                    }
+                }
+            }
+
+            beginTest("Silence is predicted; full-scale noise falls back to raw");
+            for (const auto numChannels: {2, 16, 64}) {
+                const auto what{juce::String{numChannels} + " channels"};
+                AudioCodec codec;
+                codec.prepare(static_cast<uint>(numChannels), FramesPerPacket);
+
+                const auto silence{roundTrip(codec, numChannels, [](int64_t, int) { return int16_t{0}; }, 0, what)};
+                expectEquals(static_cast<int>(silence[0]), static_cast<int>(AudioCodec::Mode::predictive), what + ": silence mode");
+                expectLessThan(silence.size(), getRawSize(numChannels), what + ": silence size");
+
+                const auto noise{roundTrip(codec, numChannels, getNoise(), 0, what)};
+                expectEquals(static_cast<int>(noise[0]), static_cast<int>(AudioCodec::Mode::raw), what + ": noise mode");
+                expectEquals(noise.size(), 1 + getRawSize(numChannels), what + ": noise size");
+            }
+
+            beginTest("A residual too big for its Rice parameter is escaped");
+            for (const auto numChannels: {2, 16, 64}) {
+                const auto what{juce::String{numChannels} + " channels"};
+                AudioCodec codec;
+                codec.prepare(static_cast<uint>(numChannels), FramesPerPacket);
+
+                // One full-scale sample in each channel's silence: order 0,
+                // Rice parameter 11, so the spike's quotient is 31, past the
+                // escape. Per channel, 15 residuals of 12 bits, and the spike
+                // in 24 + 20, make exactly 28 bytes; unescaped, it'd be 223
+                // bits.
+                const auto encoded{
+                    roundTrip(codec, numChannels, [](const int64_t frame, int) { return static_cast<int16_t>(frame == 8 ? 32767 : 0); }, 0, what)
+                };
+                expectEquals(static_cast<int>(encoded[0]), static_cast<int>(AudioCodec::Mode::predictive), what + ": mode");
+                expectEquals(encoded.size(), static_cast<size_t>(1 + numChannels + 28 * numChannels), what + ": size");
+            }
+
+            beginTest("Truncated payloads are rejected");
+            for (const auto numChannels: {2, 16, 64}) {
+                AudioCodec codec;
+                codec.prepare(static_cast<uint>(numChannels), FramesPerPacket);
+                std::vector<uint8_t> decoded(getRawSize(numChannels));
+
+                for (const auto &[name, signal]: getSignals()) {
+                    const auto what{name + ", " + juce::String{numChannels} + " channels"};
+                    const auto encoded{encode(codec, makePacket(numChannels, signal, 0))};
+                    auto numAccepted{0};
+                    for (size_t size{0}; size < encoded.size(); ++size) {
+                        numAccepted += codec.decode(encoded.data(), size, decoded.data()) ? 1 : 0;
+                    }
+                    expectEquals(numAccepted, 0, what + ": truncations accepted");
+                }
+            }
+
+            beginTest("Garbage payloads are rejected");
+            for (const auto numChannels: {2, 16, 64}) {
+                const auto what{juce::String{numChannels} + " channels"};
+                AudioCodec codec;
+                codec.prepare(static_cast<uint>(numChannels), FramesPerPacket);
+                std::vector<uint8_t> decoded(getRawSize(numChannels));
+
+                // Long enough for any parameters; a bitstream of zeros is
+                // all-zero residuals.
+                std::vector<uint8_t> payload(1 + getRawSize(numChannels), 0);
+                payload[0] = static_cast<uint8_t>(AudioCodec::Mode::predictive);
+                expect(codec.decode(payload.data(), payload.size(), decoded.data()), what + ": zeros decode");
+
+                for (auto mode{2}; mode < 256; ++mode) {
+                    payload[0] = static_cast<uint8_t>(mode);
+                    expect(!codec.decode(payload.data(), payload.size(), decoded.data()), what + ": mode " + juce::String{mode});
+                }
+                payload[0] = static_cast<uint8_t>(AudioCodec::Mode::predictive);
+
+                for (auto order{AudioCodec::MaxOrder + 1}; order < 8; ++order) {
+                    payload[1] = static_cast<uint8_t>(order << 5);
+                    expect(!codec.decode(payload.data(), payload.size(), decoded.data()), what + ": order " + juce::String{order});
+                }
+
+                // Beyond the largest the encoder uses, where q << k could
+                // overflow.
+                for (auto k{19}; k < 32; ++k) {
+                    payload[1] = static_cast<uint8_t>(k);
+                    expect(!codec.decode(payload.data(), payload.size(), decoded.data()), what + ": Rice parameter " + juce::String{k});
+                }
+                payload[1] = 0;
+
+                // Every residual escaped, and far out of range.
+                std::fill(payload.begin() + 1 + numChannels, payload.end(), uint8_t{0xff});
+                expect(!codec.decode(payload.data(), payload.size(), decoded.data()), what + ": all ones");
+
+                payload[0] = static_cast<uint8_t>(AudioCodec::Mode::raw);
+                payload.push_back(0);
+                expect(!codec.decode(payload.data(), payload.size(), decoded.data()), what + ": raw, too long");
+            }
+        }
+
+    private:
+        using Signal = std::function<int16_t(int64_t frame, int channel)>;
+
+        constexpr static int FramesPerPacket{static_cast<int>(Server::Constants::FramesPerPacket)};
+        constexpr static int NumPackets{200};
+
+        juce::Random random;
+
+        static size_t getRawSize(const int numChannels)
+        {
+            return static_cast<size_t>(numChannels * FramesPerPacket) * sizeof(int16_t);
+        }
+
+        Signal getNoise()
+        {
+            return [this](int64_t, int) { return static_cast<int16_t>(random.nextInt(65536) - 32768); };
+        }
+
+        std::vector<std::pair<juce::String, Signal> > getSignals()
+        {
+            return {
+                {"test signal", [](const int64_t frame, const int channel) { return TestSignal::getSample(static_cast<uint64_t>(frame), channel); }},
+                {"full-scale noise", getNoise()},
+                {"alternating full scale", [](const int64_t frame, int) { return static_cast<int16_t>(frame % 2 == 0 ? 32767 : -32767); }},
+                {"silence", [](int64_t, int) { return int16_t{0}; }}
+            };
+        }
+
+        /**
+         * @return A packet of a signal: interleaved, little-endian int16.
+         */
+        static std::vector<uint8_t> makePacket(const int numChannels, const Signal &signal, const int64_t firstFrame)
+        {
+            std::vector<uint8_t> packet(getRawSize(numChannels));
+            for (auto f{0}; f < FramesPerPacket; ++f) {
+                for (auto ch{0}; ch < numChannels; ++ch) {
+                    const auto sample{signal(firstFrame + f, ch)};
+                    memcpy(&packet[static_cast<size_t>(f * numChannels + ch) * sizeof(int16_t)], &sample, sizeof(int16_t));
+                }
+            }
+            return packet;
+        }
+
+        static std::vector<uint8_t> encode(AudioCodec &codec, const std::vector<uint8_t> &packet)
+        {
+            std::vector<uint8_t> encoded(codec.getMaxEncodedSize());
+            encoded.resize(codec.encode(packet.data(), encoded.data()));
+            return encoded;
+        }
+
+        /**
+         * Encode a packet of a signal, and expect it to decode to exactly
+         * what went in.
+         * @return The encoded payload.
+         */
+        std::vector<uint8_t> roundTrip(AudioCodec &codec, const int numChannels, const Signal &signal, const int64_t firstFrame, const juce::String &what)
+        {
+            const auto packet{makePacket(numChannels, signal, firstFrame)};
+            auto encoded{encode(codec, packet)};
+
+            std::vector<uint8_t> decoded(packet.size());
+            expect(codec.decode(encoded.data(), encoded.size(), decoded.data()), what + ": decodes");
+            expect(decoded == packet, what + ": byte-identical");
+            return encoded;
+        }
+    };
+
+    static CodecTests codecTests;
+}
@@ -0,0 +1,209 @@
+#include <juce_core/juce_core.h>
+#include <Fec.h>
+#include <Packet.h>
+#include <ServerUtils.h>
+
+namespace ananas
+{
+    /**
+     * Encoder to decoder, in process: groups of audio packets go through a
+     * FecEncoder, some are dropped, and the rest, then the parity, go to a
+     * FecDecoder, which should put back exactly what was dropped.
+     */
+    class FecTests final : public juce::UnitTest
+    {
+    public:
+        FecTests() : UnitTest("FEC loopback", "ananas")
+        {
+        }
+
+        void runTest() override
+        {
+            // Start near the top of the sequence space, so that groups wrap.
+            constexpr uint16_t firstSequenceNumber{65500};
+            constexpr int numGroups{40};
+
+            random = getRandom();
+
+            beginTest("One loss per group is repaired byte for byte");
+            for (const auto &[k, m]: std::vector<std::pair<int, int> >{{2, 1}, {5, 1}, {8, 2}, {10, 5}, {MaxK, 1}}) {
+                runLoopback(k, m, numGroups, firstSequenceNumber, [k = k](const int group, const int i)
+                {
+                    return i == group % k;
+                }, Repairs::all);
+            }
+
+            beginTest("A burst of as many losses as parity packets is repaired");
+            for (const auto &[k, m]: std::vector<std::pair<int, int> >{{4, 2}, {8, 4}, {10, 5}, {6, 6}}) {
+                runLoopback(k, m, numGroups, firstSequenceNumber, [k = k, m = m](const int group, const int i)
+                {
+                    const auto start{group % (k - m + 1)};
+                    return i >= start && i < start + m;
+                }, Repairs::all);
+            }
+
+            beginTest("Two losses under one parity packet are not repaired");
+            runLoopback(8, 1, numGroups, firstSequenceNumber, [](const int group, const int i)
+            {
+                return i == group % 7 || i == group % 7 + 1;
+            }, Repairs::none);
+
+            beginTest("Nothing is repaired when nothing is lost");
+            runLoopback(8, 2, numGroups, firstSequenceNumber, [](int, int) { return false; }, Repairs::none);
+
+            beginTest("Random loss is repaired exactly where each parity packet lost at most one");
+            for (const auto &[k, m]: std::vector<std::pair<int, int> >{{4, 1}, {8, 2}, {10, 5}, {MaxK, 4}}) {
+                constexpr int numRandomGroups{500};
+                constexpr float lossRate{.15f};
+
+                juce::Random lossRandom{static_cast<juce::int64>(k * 100 + m)};
+                std::vector<std::vector<int> > lossesPerClass(numRandomGroups, std::vector<int>(static_cast<size_t>(m), 0));
+
+                runLoopback(k, m, numRandomGroups, firstSequenceNumber, [&, m = m](const int group, const int i)
+                {
+                    const auto drop{lossRandom.nextFloat() < lossRate};
+                    lossesPerClass[static_cast<size_t>(group)][static_cast<size_t>(i % m)] += drop ? 1 : 0;
+                    return drop;
+                }, Repairs::byClass);
+
+                // Both outcomes should have come up.
+                auto numRepairable{0}, numUnrepairable{0};
+                for (const auto &losses: lossesPerClass) {
+                    const auto mostLost{*std::max_element(losses.begin(), losses.end())};
+                    numRepairable += mostLost == 1 ? 1 : 0;
+                    numUnrepairable += mostLost > 1 ? 1 : 0;
+                }
+                const auto what{"K=" + juce::String{k} + ", M=" + juce::String{m}};
+                expectGreaterThan(numRepairable, 0, what + ": groups fully repairable");
+                expectGreaterThan(numUnrepairable, 0, what + ": groups not fully repairable");
+            }
+        }
+
+    private:
+        constexpr static int MaxK{static_cast<int>(Server::Constants::MaxFecGroupSize)};
+        constexpr static size_t MaxPacketSize{Server::Constants::ListenerBufferSize};
+
+        /**
+         * What the decoder should repair of each group's losses.
+         */
+        enum class Repairs
+        {
+            // Every dropped packet.
+            all,
+            // Nothing.
+            none,
+            // Each packet that was the only one lost of those under its
+            // parity packet (i % M), and so the whole group exactly when
+            // every parity packet lost at most one.
+            byClass
+        };
+
+        juce::Random random;
+
+        /**
+         * An audio packet with a random payload of random size, as a
+         * compressed stream would send.
+         */
+        std::vector<uint8_t> makePacket(const uint16_t sequenceNumber)
+        {
+            const auto size{
+                sizeof(AudioPacket::Header) + 1 + static_cast<size_t>(random.nextInt(static_cast<int>(MaxPacketSize - sizeof(AudioPacket::Header))))
+            };
+            std::vector<uint8_t> packet(size);
+
+            AudioPacket::Header header;
+            header.sequenceNumber = sequenceNumber;
+            header.timestamp = random.nextInt64();
+            header.numChannels = 2;
+            header.numFrames = static_cast<uint16_t>(Server::Constants::FramesPerPacket);
+            memcpy(packet.data(), &header, sizeof(AudioPacket::Header));
+
+            for (auto i{sizeof(AudioPacket::Header)}; i < size; ++i) {
+                packet[i] = static_cast<uint8_t>(random.nextInt(256));
+            }
+
+            return packet;
+        }
+
+        /**
+         * @param shouldDrop Whether to drop data packet i of a group.
+         * @param expectedRepairs Which dropped packets should come back; any
+         * that do should be byte-identical to what was dropped.
+         */
+        void runLoopback(const int k,
+                         const int m,
+                         const int numGroups,
+                         const uint16_t firstSequenceNumber,
+                         const std::function<bool(int group, int i)> &shouldDrop,
+                         const Repairs expectedRepairs)
+        {
+            const auto what{"K=" + juce::String{k} + ", M=" + juce::String{m}};
+
+            FecEncoder encoder;
+            encoder.prepare(k, m, MaxPacketSize);
+            expectEquals(encoder.getNumParityPackets(), m, what);
+
+            FecDecoder decoder;
+            decoder.prepare(MaxPacketSize);
+
+            std::vector<uint8_t> recovered(MaxPacketSize);
+            auto sequenceNumber{firstSequenceNumber};
+
+            for (auto group{0}; group < numGroups; ++group) {
+                std::map<uint16_t, std::vector<uint8_t> > dropped;
+                std::vector<int> lossesPerClass(static_cast<size_t>(m), 0);
+                auto complete{false};
+
+                for (auto i{0}; i < k; ++i, ++sequenceNumber) {
+                    const auto packet{makePacket(sequenceNumber)};
+                    complete = encoder.addPacket(packet.data(), packet.size());
+                    expect(complete == (i == k - 1), what + ": group completes on its last packet");
+
+                    if (shouldDrop(group, i)) {
+                        dropped[sequenceNumber] = packet;
+                        ++lossesPerClass[static_cast<size_t>(i % m)];
+                    } else {
+                        decoder.addDataPacket(packet.data(), packet.size());
+                    }
+                }
+
+                if (!complete) return;
+
+                auto numRepaired{0};
+                for (auto p{0}; p < encoder.getNumParityPackets(); ++p) {
+                    size_t recoveredSize{0};
+                    if (!decoder.addParityPacket(encoder.getParityPacket(p), encoder.getParityPacketSize(p), recovered.data(), recoveredSize)) {
+                        continue;
+                    }
+
+                    ++numRepaired;
+
+                    AudioPacket::Header header;
+                    memcpy(&header, recovered.data(), sizeof(AudioPacket::Header));
+
+                    const auto it{dropped.find(header.sequenceNumber)};
+                    expect(it != dropped.end(), what + ": repaired packet " + juce::String{static_cast<int>(header.sequenceNumber)} + " was dropped");
+                    if (it == dropped.end()) continue;
+
+                    expectEquals(static_cast<int>(recoveredSize), static_cast<int>(it->second.size()), what + ": repaired size");
+                    expect(recoveredSize == it->second.size()
+                           && memcmp(recovered.data(), it->second.data(), recoveredSize) == 0,
+                           what + ": repaired packet " + juce::String{static_cast<int>(header.sequenceNumber)} + " is byte-identical");
+                }
+
+                const auto numRepairable{static_cast<int>(std::count(lossesPerClass.begin(), lossesPerClass.end(), 1))};
+                const auto numExpected{
+                    expectedRepairs == Repairs::all ? static_cast<int>(dropped.size()) : expectedRepairs == Repairs::none ? 0 : numRepairable
+                };
+                expectEquals(numRepaired, numExpected, what + ": repairs in group " + juce::String{group});
+                if (expectedRepairs == Repairs::byClass) {
+                    const auto fullyRepairable{std::all_of(lossesPerClass.begin(), lossesPerClass.end(), [](const int n) { return n <= 1; })};
+                    expectEquals(numRepaired == static_cast<int>(dropped.size()), fullyRepairable,
+                                 what + ": group " + juce::String{group} + " fully repaired");
+                }
+            }
+        }
+    };
+
+    static FecTests fecTests;
+}
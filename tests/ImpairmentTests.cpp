@@ -0,0 +1,186 @@
+#include <juce_core/juce_core.h>
+#include "PtpScenario.h"
+
+namespace ananas
+{
+    /**
+     * The scenarios in resources/impairment, each played for ten simulated
+     * minutes through a PtpScenario, with what the README says to expect of
+     * them: how often, and how far, the packet clock steps, and that clients
+     * hear no discontinuity but those steps.
+     */
+    class ImpairmentTests final : public juce::UnitTest
+    {
+    public:
+        ImpairmentTests() : UnitTest("Impairment scenarios", "ananas")
+        {
+        }
+
+        void runTest() override
+        {
+            beginTest("Every scenario is covered");
+            for (const auto &file: juce::File{ANANAS_IMPAIRMENT_DIR}.findChildFiles(juce::File::findFiles, false, "*.json")) {
+                expect(Scenarios.contains(file.getFileNameWithoutExtension()), file.getFileName() + " has no test");
+            }
+
+            beginTest("ptp-jitter-within-buffer: no steps");
+            {
+                const auto scenario{play("ptp-jitter-within-buffer")};
+                expectEquals(scenario->getNumSteps(), int64_t{0}, "steps");
+                expectLessThan(getMetric(*scenario, Utils::Identifiers::MetricsTimestampErrorPropertyID, Utils::Identifiers::HistogramMaxPropertyID),
+                               PtpScenario::HalfClientBufferNs, "largest error");
+                expectContinuous(*scenario);
+            }
+
+            beginTest("ptp-jitter-beyond-buffer: steps no bigger than the jitter");
+            {
+                const auto scenario{play("ptp-jitter-beyond-buffer")};
+                const auto profile{getProfile("ptp-jitter-beyond-buffer", Server::Sockets::TimestampListenerSocketParams.name)};
+                expectGreaterThan(scenario->getNumSteps(), int64_t{0}, "steps");
+                expectGreaterThan(getMetric(*scenario, Utils::Identifiers::MetricsTimestampStepPropertyID, Utils::Identifiers::HistogramMinPropertyID),
+                                  PtpScenario::HalfClientBufferNs, "smallest step");
+                expectLessThan(getMetric(*scenario, Utils::Identifiers::MetricsTimestampStepPropertyID, Utils::Identifiers::HistogramMaxPropertyID),
+                               profile.jitterNs + getBlockNs() + MarginNs, "largest step");
+                expectContinuous(*scenario);
+            }
+
+            beginTest("ptp-outage: no steps across the outages");
+            {
+                const auto scenario{play("ptp-outage")};
+                expectEquals(scenario->getNumSteps(), int64_t{0}, "steps");
+                expectLessThan(getMetric(*scenario, Utils::Identifiers::MetricsTimestampErrorPropertyID, Utils::Identifiers::HistogramMaxPropertyID),
+                               PtpScenario::HalfClientBufferNs, "largest error");
+                expectGreaterThan(getImpairmentCount(*scenario, Server::Sockets::TimestampListenerSocketParams.name, Utils::Identifiers::ImpairmentLostPropertyID),
+                                  int64_t{0}, "Follow_Ups lost");
+                expectContinuous(*scenario);
+            }
+
+            beginTest("ptp-reorder-duplicate: runs of late Follow_Ups step the packet clock by the reorder delay");
+            {
+                const auto scenario{play("ptp-reorder-duplicate")};
+                const auto profile{getProfile("ptp-reorder-duplicate", Server::Sockets::TimestampListenerSocketParams.name)};
+                expectGreaterThan(scenario->getNumSteps(), int64_t{0}, "steps");
+                expectGreaterThan(getMetric(*scenario, Utils::Identifiers::MetricsTimestampStepPropertyID, Utils::Identifiers::HistogramMinPropertyID),
+                                  profile.reorderDelayNs - getBlockNs() - MarginNs, "smallest step");
+                expectLessThan(getMetric(*scenario, Utils::Identifiers::MetricsTimestampStepPropertyID, Utils::Identifiers::HistogramMaxPropertyID),
+                               profile.reorderDelayNs + getBlockNs() + MarginNs, "largest step");
+                expectContinuous(*scenario);
+            }
+
+            beginTest("audio-random-loss: gaps at the loss rate");
+            {
+                const auto scenario{play("audio-random-loss")};
+                const auto profile{getProfile("audio-random-loss", Server::Sockets::AudioSenderSocketParams.name)};
+                const auto &reception{scenario->getReception()};
+                expectEquals(scenario->getNumSteps(), int64_t{0}, "steps");
+                expectWithinAbsoluteError(static_cast<double>(reception.numMissing) / static_cast<double>(reception.numPackets + reception.numMissing),
+                                          profile.loss, .001, "packets missing");
+                expectContinuous(*scenario);
+            }
+
+            beginTest("audio-burst-loss: gaps in runs of the burst length");
+            {
+                const auto scenario{play("audio-burst-loss")};
+                const auto profile{getProfile("audio-burst-loss", Server::Sockets::AudioSenderSocketParams.name)};
+                const auto &reception{scenario->getReception()};
+                expectEquals(scenario->getNumSteps(), int64_t{0}, "steps");
+                expectGreaterThan(reception.numGaps, int64_t{0}, "gaps");
+                expectWithinAbsoluteError(static_cast<double>(reception.numMissing) / static_cast<double>(std::max(int64_t{1}, reception.numGaps)),
+                                          profile.burstLength, 1., "mean gap");
+                expectContinuous(*scenario);
+            }
+
+            beginTest("audio-jitter-reorder: packets arrive late, in time order");
+            {
+                const auto scenario{play("audio-jitter-reorder")};
+                expectEquals(scenario->getNumSteps(), int64_t{0}, "steps");
+                expectGreaterThan(scenario->getReception().numLate, int64_t{0}, "late packets");
+                expectContinuous(*scenario);
+            }
+
+            beginTest("stress: no discontinuity but the steps");
+            {
+                const auto scenario{play("stress")};
+                expectGreaterThan(scenario->getReception().numMissing, int64_t{0}, "packets missing");
+                expectGreaterThan(scenario->getReception().numLate, int64_t{0}, "late packets");
+                expectContinuous(*scenario);
+            }
+        }
+
+    private:
+        inline static const juce::StringArray Scenarios{
+            "ptp-jitter-within-buffer",
+            "ptp-jitter-beyond-buffer",
+            "ptp-outage",
+            "ptp-reorder-duplicate",
+            "audio-random-loss",
+            "audio-burst-loss",
+            "audio-jitter-reorder",
+            "stress"
+        };
+
+        constexpr static int64_t DurationNs{10 * 60 * Server::Constants::NSPS};
+
+        /**
+         * Slack for the lag of the packet clock behind the audio written.
+         */
+        constexpr static int64_t MarginNs{1'000'000};
+
+        static int64_t getBlockNs()
+        {
+            return PtpScenario::Params{}.blockSize * Server::Constants::NSPS / 48000;
+        }
+
+        static juce::var load(const juce::String &name)
+        {
+            return juce::JSON::parse(juce::File{ANANAS_IMPAIRMENT_DIR}.getChildFile(name + ".json"));
+        }
+
+        /**
+         * @return The (first) profile a scenario gives a thread.
+         */
+        static ImpairmentProfile getProfile(const juce::String &name, const juce::String &threadName)
+        {
+            return ImpairmentScript::fromVar(load(name)[juce::Identifier{threadName}]).steps.front().profile;
+        }
+
+        static int64_t getMetric(const PtpScenario &scenario, const juce::Identifier &histogram, const juce::Identifier &statistic)
+        {
+            return static_cast<juce::int64>(scenario.getMetric(histogram, statistic));
+        }
+
+        static int64_t getImpairmentCount(PtpScenario &scenario, const juce::String &threadName, const juce::Identifier &count)
+        {
+            return static_cast<juce::int64>(scenario.getServer().getImpairmentStats()[juce::Identifier{threadName}][count]);
+        }
+
+        /**
+         * Play a scenario, once the packet clock has locked, with the audio
+         * on a local clock that keeps time with the grandmaster.
+         */
+        std::unique_ptr<PtpScenario> play(const juce::String &name)
+        {
+            PtpScenario::Params params;
+            params.impairments = load(name);
+            expect(params.impairments.isObject(), name + " parses");
+
+            auto scenario{std::make_unique<PtpScenario>(params)};
+            scenario->runUntil(PtpScenario::LockedByNs);
+            scenario->resetMetrics();
+            scenario->runUntil(DurationNs);
+            return scenario;
+        }
+
+        /**
+         * Clients should hear a discontinuity at each step of the packet
+         * clock, and nowhere else.
+         */
+        void expectContinuous(const PtpScenario &scenario)
+        {
+            expectGreaterThan(scenario.getReception().numPackets, int64_t{0}, "packets received");
+            expectEquals(scenario.getReception().numDiscontinuities, scenario.getNumSteps(), "discontinuities");
+        }
+    };
+
+    static ImpairmentTests impairmentTests;
+}
@@ -0,0 +1,24 @@
+#include <juce_core/juce_core.h>
+
+/**
+ * Runs every juce::UnitTest linked in (or those in the category given as the
+ * only argument), and fails if any expectation did.
+ */
+int main(const int argc, char *argv[])
+{
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+
+    if (argc > 1) {
+        runner.runTestsInCategory(argv[1]);
+    } else {
+        runner.runAllTests();
+    }
+
+    auto numFailures{0};
+    for (auto i{0}; i < runner.getNumResults(); ++i) {
+        numFailures += runner.getResult(i)->failures;
+    }
+
+    return numFailures > 0 ? 1 : 0;
+}
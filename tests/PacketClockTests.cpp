@@ -0,0 +1,92 @@
+#include <juce_core/juce_core.h>
+#include <Packet.h>
+#include <ServerUtils.h>
+#include <numeric>
+#include <vector>
+
+namespace ananas
+{
+    /**
+     * The packet clock keeps exact time: the k-th header timestamp after the
+     * first is floor(k * FramesPerPacket * NSPS / sampleRate) ns on, for
+     * every packet of a day-long stream, at every sample rate; and a step to
+     * PTP time starts it afresh.
+     */
+    class PacketClockTests final : public juce::UnitTest
+    {
+    public:
+        PacketClockTests() : UnitTest("Packet clock", "ananas")
+        {
+        }
+
+        void runTest() override
+        {
+            beginTest("Every timestamp of a day is exact");
+            for (const int64_t sampleRate: {44100, 48000, 88200, 96000, 176400, 192000}) {
+                AudioPacket packet;
+                packet.prepare(2, FramesPerPacket, static_cast<double>(sampleRate));
+                expectTimestamps(packet, sampleRate, 0, 24 * 3600 * sampleRate / FramesPerPacket);
+            }
+
+            beginTest("A step to PTP time clears the remainder");
+            for (const int64_t sampleRate: {44100, 88200, 176400}) {
+                AudioPacket packet;
+                packet.prepare(2, FramesPerPacket, static_cast<double>(sampleRate));
+
+                // Leave a fraction of a nanosecond behind.
+                packet.writeHeader();
+                expectNotEquals(Server::Constants::NSPS * FramesPerPacket % sampleRate, int64_t{0}, "a remainder to clear");
+
+                // Far out of line, so the third reading steps.
+                constexpr int64_t ptpNs{1000 * Server::Constants::NSPS};
+                const timespec ts{static_cast<time_t>(ptpNs / Server::Constants::NSPS), static_cast<long>(ptpNs % Server::Constants::NSPS)};
+                int64_t diffNs;
+                expect(!packet.setTime(ts, diffNs) && !packet.setTime(ts, diffNs) && packet.setTime(ts, diffNs), "steps on the third reading");
+                expectEquals(packet.getTime(), ptpNs + Server::Constants::PacketOffsetNs, "stepped to");
+
+                expectTimestamps(packet, sampleRate, ptpNs + Server::Constants::PacketOffsetNs, 3600 * sampleRate / FramesPerPacket);
+            }
+        }
+
+    private:
+        constexpr static int FramesPerPacket{static_cast<int>(Server::Constants::FramesPerPacket)};
+
+        /**
+         * Write headers, and expect the k-th to be stamped exactly
+         * floor(k * FramesPerPacket * NSPS / sampleRate) ns after startNs.
+         */
+        void expectTimestamps(AudioPacket &packet, const int64_t sampleRate, const int64_t startNs, const int64_t numPackets)
+        {
+            const auto what{juce::String{sampleRate} + " Hz"};
+
+            // k * FramesPerPacket * NSPS overflows 64 bits within the day, so
+            // split k into whole cycles of the remainder, each a whole number
+            // of nanoseconds, and the packets into the cycle.
+            const auto nsFramesPerPacket{Server::Constants::NSPS * FramesPerPacket};
+            const auto cycle{sampleRate / std::gcd(nsFramesPerPacket, sampleRate)};
+            const auto nsPerCycle{cycle * nsFramesPerPacket / sampleRate};
+            std::vector<int64_t> nsIntoCycle(static_cast<size_t>(cycle));
+            for (int64_t r{0}; r < cycle; ++r) {
+                nsIntoCycle[static_cast<size_t>(r)] = r * nsFramesPerPacket / sampleRate;
+            }
+
+            auto cycleStartNs{startNs};
+            int64_t r{0}, numWrong{0}, firstWrong{0};
+            for (int64_t k{1}; k <= numPackets; ++k) {
+                if (++r == cycle) {
+                    r = 0;
+                    cycleStartNs += nsPerCycle;
+                }
+
+                packet.writeHeader();
+                if (packet.getTime() != cycleStartNs + nsIntoCycle[static_cast<size_t>(r)] && numWrong++ == 0) {
+                    firstWrong = k;
+                }
+            }
+
+            expectEquals(numWrong, int64_t{0}, what + ": wrong timestamps, the first at packet " + juce::String{firstWrong});
+        }
+    };
+
+    static PacketClockTests packetClockTests;
+}
@@ -0,0 +1,169 @@
+#include "PtpScenario.h"
+
+namespace ananas
+{
+    PtpScenario::PtpScenario(const Params &params)
+        : params(params),
+          server(2, clock),
+          grandmaster(*this, clock),
+          block(2, params.blockSize)
+    {
+        // Everything happens on this thread, the audio sender's pacing
+        // included.
+        clock.setDrivingThread();
+
+        block.clear();
+        server.setSimulated(true, [this](const juce::String &threadName, const uint8_t *data, const size_t size, const juce::String &, const int toPort)
+        {
+            if (threadName == Server::Sockets::AudioSenderSocketParams.name && toPort == Server::Sockets::AudioSenderSocketParams.remotePort) {
+                receive(data, size);
+            }
+        });
+
+        if (auto *impairments = params.impairments.getDynamicObject()) {
+            for (const auto &[name, script]: impairments->getProperties()) {
+                server.setImpairment(name.toString(), ImpairmentScript::fromVar(script));
+            }
+        }
+
+        server.prepareToPlay(params.blockSize, params.sampleRate);
+
+        grandmaster.startTimer(FollowUpIntervalMs);
+    }
+
+    PtpScenario::~PtpScenario()
+    {
+        grandmaster.stopTimer();
+        server.releaseResources();
+    }
+
+    void PtpScenario::runUntil(const int64_t timeNs)
+    {
+        // Follow_Up messages go out as the grandmaster's timer falls due,
+        // whichever sleep takes the clock past it.
+        Clock &pacer{params.paceByPtpClock ? static_cast<Clock &>(server.getPtpClock()) : clock};
+        const auto sampleRateHz{static_cast<int64_t>(std::llround(params.sampleRate))};
+        juce::AudioSourceChannelInfo info{&block, 0, params.blockSize};
+
+        while (clock.now() < timeNs) {
+            pacer.sleepUntil(numBlocks * params.blockSize * Server::Constants::NSPS / sampleRateHz);
+            server.writeToStream(0, info);
+            // As the sender would, send until there's nothing left.
+            while (server.runSimulation() > 0) {}
+            ++numBlocks;
+        }
+    }
+
+    int64_t PtpScenario::now() const
+    {
+        return clock.now();
+    }
+
+    Server::Server &PtpScenario::getServer()
+    {
+        return server;
+    }
+
+    int64_t PtpScenario::getNumSteps() const
+    {
+        return static_cast<juce::int64>(getMetric(Utils::Identifiers::MetricsTimestampStepPropertyID, Utils::Identifiers::HistogramCountPropertyID));
+    }
+
+    juce::var PtpScenario::getMetric(const juce::Identifier &histogram, const juce::Identifier &statistic) const
+    {
+        return server.getMetrics()[histogram][statistic];
+    }
+
+    const PtpScenario::Reception &PtpScenario::getReception() const
+    {
+        return reception;
+    }
+
+    void PtpScenario::resetMetrics()
+    {
+        server.resetMetrics();
+        reception = {};
+    }
+
+    int64_t PtpScenario::toGrandmasterTime(const int64_t localNs) const
+    {
+        return GrandmasterEpochNs
+               + localNs
+               + static_cast<int64_t>(std::llround(static_cast<double>(localNs) * params.grandmasterDriftPpm * 1e-6))
+               + (params.stepNs != 0 && localNs >= params.stepAtNs ? params.stepNs : 0);
+    }
+
+    void PtpScenario::receive(const uint8_t *data, const size_t size)
+    {
+        if (size < sizeof(AudioPacket::Header)) return;
+
+        AudioPacket::Header header;
+        memcpy(&header, data, sizeof(AudioPacket::Header));
+        ++reception.numPackets;
+
+        if (!lastHeader.has_value()) {
+            lastHeader = header;
+            return;
+        }
+
+        const auto ahead{static_cast<int16_t>(header.sequenceNumber - lastHeader->sequenceNumber)};
+        if (ahead <= 0) {
+            ++reception.numLate;
+            return;
+        }
+
+        if (ahead > 1) {
+            ++reception.numGaps;
+            reception.numMissing += ahead - 1;
+        }
+
+        // Timestamps carry a fraction of a nanosecond per packet, so may be
+        // one out from the whole nanoseconds between them.
+        const auto sampleRateHz{static_cast<int64_t>(std::llround(params.sampleRate))};
+        const auto expectedNs{
+            lastHeader->timestamp + ahead * static_cast<int64_t>(Server::Constants::FramesPerPacket) * Server::Constants::NSPS / sampleRateHz
+        };
+        if (std::abs(header.timestamp - expectedNs) > 1) {
+            ++reception.numDiscontinuities;
+        }
+
+        lastHeader = header;
+    }
+
+    //==========================================================================
+
+    PtpScenario::Grandmaster::Grandmaster(PtpScenario &owner, Clock &clock)
+        : ClockTimer(clock),
+          owner(owner)
+    {
+    }
+
+    void PtpScenario::Grandmaster::timerCallback()
+    {
+        const auto ptpNs{owner.toGrandmasterTime(getClock().now())};
+        const auto seconds{static_cast<uint64_t>(ptpNs / Server::Constants::NSPS)};
+        const auto nanoseconds{static_cast<uint32_t>(ptpNs % Server::Constants::NSPS)};
+
+        // A two-step PTPv2 Follow_Up: a 34-byte header, then the precise
+        // origin timestamp, big-endian.
+        std::array<uint8_t, 44> message{};
+        message[0] = static_cast<uint8_t>(Server::Constants::PTPFollowUpMessageType);
+        message[1] = 2;
+        message[3] = static_cast<uint8_t>(message.size());
+        message[30] = static_cast<uint8_t>(sequenceId >> 8);
+        message[31] = static_cast<uint8_t>(sequenceId & 0xff);
+        for (auto i{0}; i < 6; ++i) {
+            message[static_cast<size_t>(34 + i)] = static_cast<uint8_t>(seconds >> (8 * (5 - i)));
+        }
+        for (auto i{0}; i < 4; ++i) {
+            message[static_cast<size_t>(40 + i)] = static_cast<uint8_t>(nanoseconds >> (8 * (3 - i)));
+        }
+        ++sequenceId;
+
+        owner.server.simulateDatagram(Server::Sockets::TimestampListenerSocketParams.name,
+                                      message.data(),
+                                      message.size(),
+                                      "192.168.0.254",
+                                      Server::Sockets::TimestampListenerSocketParams.localPort);
+    }
+}
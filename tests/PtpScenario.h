@@ -0,0 +1,155 @@
+#ifndef ANANASPTPSCENARIO_H
+#define ANANASPTPSCENARIO_H
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <Clock.h>
+#include <Packet.h>
+#include <Server.h>
+
+namespace ananas
+{
+    /**
+     * A simulated Server (see Server::setSimulated()) on a VirtualClock, fed
+     * Follow_Up messages by a simulated PTP grandmaster, and audio by a
+     * simulated audio device, all on the calling thread; so the same
+     * parameters give the same packet clock behaviour, to the nanosecond,
+     * every run, and an hour of it takes seconds. What the server sends
+     * is checked as a client would hear it.
+     */
+    class PtpScenario
+    {
+    public:
+        struct Params
+        {
+            /**
+             * How much faster than the server's local clock the grandmaster
+             * runs, in ppm.
+             */
+            double grandmasterDriftPpm{0.};
+            /**
+             * When the grandmaster's time steps, in local time, and by how
+             * much; a step of 0 for never.
+             */
+            int64_t stepAtNs{0};
+            int64_t stepNs{0};
+            /**
+             * Pace the audio by the server's PtpClock, as a SourceStreamer
+             * does, rather than by the local clock, as an audio device does.
+             */
+            bool paceByPtpClock{false};
+            int blockSize{128};
+            double sampleRate{48000.};
+            /**
+             * Impairment scripts keyed by thread name, as in
+             * resources/impairment; see Server::setImpairment().
+             */
+            juce::var impairments;
+        };
+
+        /**
+         * What a client listening to the first stream would have heard, as
+         * it arrived (i.e. after any impairment).
+         */
+        struct Reception
+        {
+            int64_t numPackets{0};
+            /**
+             * Runs of sequence numbers skipped, and the packets in them;
+             * anything that turns up later counts as late.
+             */
+            int64_t numGaps{0};
+            int64_t numMissing{0};
+            int64_t numLate{0};
+            /**
+             * Packets whose timestamp isn't where the last packet's, and
+             * the frames between them, put it; each step of the packet clock
+             * should make exactly one.
+             */
+            int64_t numDiscontinuities{0};
+        };
+
+        /**
+         * Grandmaster time at local time 0.
+         */
+        constexpr static int64_t GrandmasterEpochNs{1'700'000'000 * Server::Constants::NSPS};
+
+        constexpr static int FollowUpIntervalMs{125};
+
+        /**
+         * Half the client buffer at 48 kHz, beyond which the packet clock
+         * steps.
+         */
+        constexpr static int64_t HalfClientBufferNs{
+            static_cast<int64_t>(Server::Constants::FramesPerPacket * Server::Constants::ClientPacketBufferSize) * Server::Constants::NSPS / 48000 / 2
+        };
+
+        /**
+         * By when the packet clock has locked to the grandmaster: three
+         * Follow_Ups in, as the first two are bad.
+         */
+        constexpr static int64_t LockedByNs{Server::Constants::NSPS};
+
+        explicit PtpScenario(const Params &params);
+
+        ~PtpScenario();
+
+        /**
+         * Deliver audio and Follow_Up messages, and run the audio sender,
+         * until the given local time.
+         */
+        void runUntil(int64_t timeNs);
+
+        [[nodiscard]] int64_t now() const;
+
+        Server::Server &getServer();
+
+        /**
+         * @return The number of times the packet clock has stepped since the
+         * server's metrics were last reset.
+         */
+        [[nodiscard]] int64_t getNumSteps() const;
+
+        /**
+         * @return A statistic of one of the server's metrics, e.g. the
+         * HistogramMaxPropertyID of its MetricsTimestampErrorPropertyID.
+         */
+        [[nodiscard]] juce::var getMetric(const juce::Identifier &histogram, const juce::Identifier &statistic) const;
+
+        [[nodiscard]] const Reception &getReception() const;
+
+        /**
+         * Reset the server's metrics, and the Reception.
+         */
+        void resetMetrics();
+
+    private:
+        class Grandmaster final : public ClockTimer
+        {
+        public:
+            Grandmaster(PtpScenario &owner, Clock &clock);
+
+            void timerCallback() override;
+
+        private:
+            PtpScenario &owner;
+            uint16_t sequenceId{0};
+        };
+
+        const Params params;
+        VirtualClock clock;
+        Server::Server server;
+        Grandmaster grandmaster;
+        juce::AudioBuffer<float> block;
+        int64_t numBlocks{0};
+        Reception reception;
+        std::optional<AudioPacket::Header> lastHeader;
+
+        [[nodiscard]] int64_t toGrandmasterTime(int64_t localNs) const;
+
+        void receive(const uint8_t *data, size_t size);
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PtpScenario)
+    };
+}
+
+#endif //ANANASPTPSCENARIO_H
@@ -0,0 +1,232 @@
+#include <juce_core/juce_core.h>
+#include <ClientFleet.h>
+#include "PtpScenario.h"
+
+namespace ananas
+{
+    /**
+     * Hour-long timing scenarios, played out in simulated time by a simulated
+     * Server (see PtpScenario): grandmaster drift with the audio on the local
+     * clock, and on the PTP clock; the PTP timebase stepping; and client
+     * churn. Each gives the same result, to the nanosecond, every run.
+     */
+    class SimulationTests final : public juce::UnitTest
+    {
+    public:
+        SimulationTests() : UnitTest("Simulated time", "ananas")
+        {
+        }
+
+        void runTest() override
+        {
+            constexpr int64_t minute{60 * Server::Constants::NSPS};
+
+            beginTest("Grandmaster drift against the local clock steps the packet clock at the rate it accrues");
+            for (const auto driftPpm: {50., -50.}) {
+                const auto what{"drift " + juce::String{driftPpm} + " ppm"};
+
+                PtpScenario scenario{{driftPpm}};
+                lock(scenario);
+                scenario.runUntil(60 * minute);
+
+                // Each step is taken once the error goes past half the client
+                // buffer, and takes it back to nothing.
+                const auto expectedSteps{
+                    static_cast<int64_t>(static_cast<double>(scenario.now() - LockedByNs) * std::abs(driftPpm) * 1e-6 / HalfClientBufferNs)
+                };
+                expect(std::abs(scenario.getNumSteps() - expectedSteps) <= 1,
+                       what + ": " + juce::String{scenario.getNumSteps()} + " steps, expected " + juce::String{expectedSteps});
+                expectGreaterThan(getMetric(scenario, Utils::Identifiers::MetricsTimestampStepPropertyID, Utils::Identifiers::HistogramMinPropertyID),
+                                  HalfClientBufferNs, what + ": smallest step");
+                expectLessThan(getMetric(scenario, Utils::Identifiers::MetricsTimestampStepPropertyID, Utils::Identifiers::HistogramMaxPropertyID),
+                               HalfClientBufferNs + getBlockNs() + MarginNs, what + ": largest step");
+                expectLessThan(getMetric(scenario, Utils::Identifiers::MetricsTimestampErrorPropertyID, Utils::Identifiers::HistogramMaxPropertyID),
+                               HalfClientBufferNs + getBlockNs() + MarginNs, what + ": largest error");
+                expectEquals(scenario.getReception().numDiscontinuities, scenario.getNumSteps(), what + ": discontinuities");
+
+                const auto ptpClockStats{scenario.getServer().getPtpClock().getStats()};
+                expect(ptpClockStats[Utils::Identifiers::PtpClockLockedPropertyID], what + ": PTP clock locked");
+                expectWithinAbsoluteError(static_cast<double>(ptpClockStats[Utils::Identifiers::PtpClockRatePpmPropertyID]), driftPpm, .01,
+                                          what + ": PTP clock rate");
+            }
+
+            beginTest("Audio paced by the PTP clock follows grandmaster drift without steps");
+            {
+                PtpScenario scenario{{50., 0, 0, true}};
+                lock(scenario);
+                scenario.runUntil(10 * minute);
+
+                expectEquals(scenario.getNumSteps(), int64_t{0}, "steps");
+                expectLessThan(getMetric(scenario, Utils::Identifiers::MetricsTimestampErrorPropertyID, Utils::Identifiers::HistogramMaxPropertyID),
+                               getBlockNs() + MarginNs, "largest error");
+                expectEquals(static_cast<int>(scenario.getServer().getPtpClock().getStats()[Utils::Identifiers::PtpClockResetsPropertyID]), 0,
+                             "PTP clock resets");
+            }
+
+            beginTest("A PTP step steps the packet clock once, on the third Follow_Up after it");
+            for (const auto stepNs: {Server::Constants::NSPS, -Server::Constants::NSPS}) {
+                const auto what{"step " + juce::String{stepNs / 1'000'000} + " ms"};
+                constexpr int64_t stepAtNs{5 * minute};
+                constexpr int64_t followUpNs{PtpScenario::FollowUpIntervalMs * Server::Constants::NSPS / 1000};
+
+                PtpScenario scenario{{0., stepAtNs, stepNs, true}};
+                lock(scenario);
+
+                // The step arrives with the Follow_Up sent at stepAtNs; two
+                // more bad timestamps and the packet clock follows.
+                scenario.runUntil(stepAtNs + 2 * followUpNs + followUpNs / 2);
+                expectEquals(scenario.getNumSteps(), int64_t{0}, what + ": steps after two bad timestamps");
+                scenario.runUntil(stepAtNs + 3 * followUpNs + followUpNs / 2);
+                expectEquals(scenario.getNumSteps(), int64_t{1}, what + ": steps after three bad timestamps");
+
+                scenario.runUntil(stepAtNs + minute);
+                expectEquals(scenario.getNumSteps(), int64_t{1}, what + ": steps a minute later");
+                expectWithinAbsoluteError(static_cast<int64_t>(getMetric(scenario, Utils::Identifiers::MetricsTimestampStepPropertyID, Utils::Identifiers::HistogramMaxPropertyID)),
+                                          std::abs(stepNs), getBlockNs() + MarginNs, what + ": step size");
+                expectEquals(static_cast<int>(scenario.getServer().getPtpClock().getStats()[Utils::Identifiers::PtpClockResetsPropertyID]), 1,
+                             what + ": PTP clock resets");
+            }
+
+            beginTest("The same scenario plays out identically every run");
+            {
+                std::array<juce::String, 2> results;
+                for (auto &result: results) {
+                    PtpScenario scenario{{-50.}};
+                    scenario.runUntil(10 * minute);
+                    result = juce::JSON::toString(scenario.getServer().getMetrics()[Utils::Identifiers::MetricsTimestampErrorPropertyID], true)
+                             + juce::JSON::toString(scenario.getServer().getMetrics()[Utils::Identifiers::MetricsTimestampStepPropertyID], true)
+                             + juce::JSON::toString(scenario.getServer().getPtpClock().getStats(), true);
+                }
+                expectEquals(results[1], results[0]);
+            }
+
+            beginTest("Client churn plays out identically every run");
+            {
+                const auto first{runChurn(10 * minute)};
+                expectGreaterThan(first.back().disconnections, 0, "disconnections");
+                for (const auto &report: first) {
+                    // Every connected client is listed, as is any that
+                    // dropped off too recently for the list to have noticed.
+                    expectGreaterOrEqual(report.listed, report.connected, "clients listed");
+                    expectLessOrEqual(report.listed - report.connected, report.recentDisconnections, "disconnected clients still listed");
+                }
+
+                const auto second{runChurn(10 * minute)};
+                expect(first == second, "per-minute reports match");
+            }
+        }
+
+    private:
+        constexpr static int64_t HalfClientBufferNs{PtpScenario::HalfClientBufferNs};
+        constexpr static int64_t LockedByNs{PtpScenario::LockedByNs};
+
+        /**
+         * Slack for the lag of the packet clock behind the audio written,
+         * and the drift accrued over a few Follow_Ups.
+         */
+        constexpr static int64_t MarginNs{1'000'000};
+
+        constexpr static int ChurnClients{200};
+
+        struct ChurnReport
+        {
+            int listed;
+            int connected;
+            int disconnections;
+            // Disconnections within a client list timeout of the report.
+            int recentDisconnections;
+
+            bool operator==(const ChurnReport &other) const
+            {
+                return listed == other.listed && connected == other.connected && disconnections == other.disconnections
+                       && recentDisconnections == other.recentDisconnections;
+            }
+        };
+
+        static int64_t getBlockNs()
+        {
+            return PtpScenario::Params{}.blockSize * Server::Constants::NSPS / 48000;
+        }
+
+        static int64_t getMetric(const PtpScenario &scenario, const juce::Identifier &histogram, const juce::Identifier &statistic)
+        {
+            return static_cast<juce::int64>(scenario.getMetric(histogram, statistic));
+        }
+
+        /**
+         * Run past the initial step that locks the packet clock to PTP, and
+         * forget it.
+         */
+        static void lock(PtpScenario &scenario)
+        {
+            scenario.runUntil(LockedByNs);
+            scenario.resetMetrics();
+        }
+
+        /**
+         * Feed a simulated server's client listener from a churning
+         * ClientFleet, reporting once a simulated minute.
+         */
+        static std::vector<ChurnReport> runChurn(const int64_t durationNs)
+        {
+            VirtualClock clock;
+            clock.setDrivingThread();
+
+            Server::Server server{2, clock};
+            server.setSimulated(true);
+
+            FleetParams params;
+            params.numClients = ChurnClients;
+            params.numAuthorities = 0;
+            params.churnPerMinute = .5;
+            params.meanDowntimeS = 10.;
+            ClientFleet fleet{params};
+
+            const ClientFleet::Sink deliver{
+                [&server](ClientFleet::Source, const int index, const void *data, const size_t size)
+                {
+                    server.simulateDatagram(Server::Sockets::ClientListenerSocketParams.name,
+                                            static_cast<const uint8_t *>(data),
+                                            size,
+                                            "10.0.0." + juce::String{index + 1},
+                                            Server::Sockets::ClientListenerSocketParams.localPort);
+                }
+            };
+
+            std::vector<ChurnReport> reports;
+            constexpr int64_t reportIntervalNs{60 * Server::Constants::NSPS};
+            auto nextReportNs{reportIntervalNs};
+
+            // A client is listed until its last announcement is older than
+            // the disconnection threshold, at the next connectivity check.
+            const auto listTimeoutNs{
+                static_cast<int64_t>(Server::Sockets::ClientListenerSocketParams.disconnectionThresholdMs + Server::Constants::ClientConnectednessCheckIntervalMs)
+                * Server::Constants::NSPS / 1000
+            };
+            std::vector<int64_t> disconnectionTimes;
+
+            fleet.advance(0, deliver);
+            while (clock.now() < durationNs) {
+                const auto next{std::min({fleet.getNextDueNs(), clock.getNextTimerDueNs(), nextReportNs})};
+                clock.advanceTo(next);
+                fleet.advance(next, deliver);
+                disconnectionTimes.resize(static_cast<size_t>(fleet.getNumDisconnections()), next);
+
+                if (next >= nextReportNs) {
+                    reports.push_back({
+                        static_cast<int>(server.getClientList()->getCount()),
+                        fleet.getNumConnected(),
+                        fleet.getNumDisconnections(),
+                        static_cast<int>(std::count_if(disconnectionTimes.begin(), disconnectionTimes.end(),
+                                                       [next, listTimeoutNs](const int64_t t) { return t > next - listTimeoutNs; }))
+                    });
+                    nextReportNs += reportIntervalNs;
+                }
+            }
+
+            return reports;
+        }
+    };
+
+    static SimulationTests simulationTests;
+}